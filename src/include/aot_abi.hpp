@@ -0,0 +1,50 @@
+#ifndef AOT_ABI_HPP_
+#define AOT_ABI_HPP_
+
+// Interface between simulator and programs translated ahead of time by rv2cpp.
+// Included by generated sources too, so it depends on standard headers only.
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sim {
+
+static const uint32_t kAotAbiVersion = 2;
+static const size_t kAotCodePageBits = 12;
+static const char* const kAotModuleSymbol = "rv2cpp_module";
+
+// page permission bits, accesses to pages without them are left to interpreter
+static const uint8_t kAotPageRead  = 1u << 0;
+static const uint8_t kAotPageWrite = 1u << 1;
+
+// guest state seen by translated code
+struct AotState {
+    uint32_t regs[32];
+    uint8_t* memory;
+    uint32_t memory_size;
+    const uint8_t* code_pages; // non zero for pages holding decoded code, stores to them are left to interpreter
+    const uint8_t* page_permissions; // kAotPage* bits of pages lying in a single ram or rom region
+    uint64_t n_retired;
+    uint32_t is_exit_requested; // translated code stopped at instruction interpreter has to execute
+};
+
+// runs translated blocks from pc, returns pc interpreter continues from
+using AotRunFunction = uint32_t (*)(AotState* state, uint32_t pc);
+
+struct AotBlockRange {
+    uint32_t start_pc;
+    uint32_t end_pc;
+};
+
+// exported by translated module as kAotModuleSymbol
+struct AotModule {
+    uint32_t abi_version;
+    uint64_t image_key[2]; // of loaded segments and entry point the module was translated from
+    uint32_t n_blocks;
+    const AotBlockRange* blocks;
+    AotRunFunction run;
+};
+
+} // namespace sim
+
+#endif // AOT_ABI_HPP_
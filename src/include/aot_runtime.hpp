@@ -0,0 +1,61 @@
+#ifndef AOT_RUNTIME_HPP_
+#define AOT_RUNTIME_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "aot_abi.hpp"
+#include "cpu.hpp"
+#include "memory.hpp"
+#include "result_cache.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+enum class AotError {
+    kOk            = 0,
+    kCantLoad      = 1,
+    kNoModule      = 2,
+    kAbiMismatch   = 3,
+    kImageMismatch = 4, // translated from other program
+};
+
+// Module translated by rv2cpp and loaded as shared object. Translated code
+// runs until it leaves it or reaches an instruction it left to interpreter.
+// Pages of translated blocks are marked as code, so guest stores to them go
+// through interpreter; once translated bytes change, the module is not used
+// any more and the program continues in the block engine. Accesses to pages
+// the memory map does not permit them on are left to interpreter, which
+// faults as it would without the module.
+class AotRuntime {
+  private:
+    void* handle_ = nullptr;
+    const AotModule* module_ = nullptr;
+    bool is_enabled_ = false;
+
+    Memory* memory_;
+    AotState state_;
+    std::vector<uint8_t> code_; // translated bytes, at the same offsets as in memory
+    std::vector<uint8_t> page_permissions_;
+    uint64_t n_runs_;
+  public:
+    AotError Init(const std::string& path, const ResultKey& image_key, Memory* memory);
+    ~AotRuntime();
+
+    // runs translated code from pc of cpu, which is set to where it stopped
+    void Run(Cpu* cpu, uint64_t* n_retired_instrs);
+
+    // pages written by guest, translated code is disabled if its bytes were changed
+    void CheckWrittenPages(const std::vector<size_t>& pages);
+
+    bool GetIsEnabled() const { return is_enabled_; }
+    uint64_t GetNRuns() const { return n_runs_; }
+};
+
+const char* AotErrorToStr(AotError error);
+
+} // namespace sim
+
+#endif // AOT_RUNTIME_HPP_
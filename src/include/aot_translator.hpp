@@ -0,0 +1,63 @@
+#ifndef AOT_TRANSLATOR_HPP_
+#define AOT_TRANSLATOR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <utility>
+#include <vector>
+
+#include "block_ir.hpp"
+#include "iprogram_loader.hpp"
+#include "memory.hpp"
+#include "result_cache.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+struct AotStats {
+    uint64_t n_blocks;
+    uint64_t n_instrs;
+    uint64_t n_exits; // instructions left to interpreter
+};
+
+// Translates rv32i program to C++ source with a host function per guest
+// block. Blocks start at the entry point, function symbols and every target,
+// fall-through and return address reachable from them by direct control flow.
+// Guest registers are locals of block functions; system, csr, floating point
+// and vector instructions and stores to decoded code return to interpreter.
+class AotTranslator {
+  private:
+    static const size_t kMaxBlockInstrs = 256;
+
+    struct AotBlock {
+        std::vector<IrOp> ops; // lifted without optimization, op per guest instruction
+        Address end_pc;        // after the last translated instruction
+        bool is_exit;          // ends before instruction left to interpreter
+    };
+
+    Memory memory_;
+    std::vector<std::pair<Address, Address>> segments_;
+    ResultKey image_key_;
+    std::map<Address, AotBlock> blocks_; // ordered by start pc
+    AotStats stats_;
+
+    bool IsInImage(const Address pc) const;
+    void DiscoverBlocks(const ploader::IProgramLoader& ploader);
+    void EmitBlock(FILE* out, const Address start_pc, const AotBlock& block);
+  public:
+    void Init(const ploader::IProgramLoader& ploader);
+    ~AotTranslator() = default;
+
+    void Emit(FILE* out, const char* source_name);
+
+    const AotStats& GetStats() const;
+};
+
+// identity of loaded program checked by simulator before it runs translated code
+ResultKey HashAotImage(const ploader::IProgramLoader& ploader);
+
+} // namespace sim
+
+#endif // AOT_TRANSLATOR_HPP_
@@ -0,0 +1,139 @@
+#ifndef BLOCK_CACHE_HPP_
+#define BLOCK_CACHE_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+#include "block_ir.hpp"
+#include "fusion.hpp"
+#include "hle.hpp"
+#include "imemory.hpp"
+#include "instructions.hpp"
+#include "loop_idiom.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+static const size_t kMaxBlockLinks = 2;
+
+// Straight line sequence of decoded instructions ending with control transfer.
+// Once entered, block is executed up to its last instruction.
+struct DecodedBlock {
+    Address start_pc;
+    Address end_pc;        // address after the last guest instruction
+    size_t n_guest_instrs; // fused instruction counts as two guest instructions
+    std::vector<DecodedInstr> instrs;
+    std::vector<IrOp> ops;     // lifted and optionally optimized instrs
+    IrStats ir_stats;          // of lifting and optimizing this block
+
+    FusionCounters n_fusions;
+    uint64_t n_executions;
+
+    LoopIdiom idiom; // kNone unless block starts a recognized loop
+    std::vector<uint8_t> code; // guest bytes the block was decoded from
+
+    // blocks executed after this one, checked by start pc before hash lookup
+    std::array<DecodedBlock*, kMaxBlockLinks> links;
+};
+
+class PredecodeCache;
+class DecodeTable;
+class ControlFlowGraph;
+
+class BlockCache {
+  private:
+    static const size_t kMaxBlockInstrs = 64;
+
+    IMemory* memory_;
+    const HleLayer* hle_;
+    LoopIdiomStats* loop_idiom_stats_; // nullptr if idioms are not recognized
+    bool is_fusion_enabled_;
+    bool is_optimization_enabled_;
+    IrStats ir_stats_;
+    const PredecodeCache* predecode_cache_; // nullptr if blocks are not saved between runs
+    DecodeTable* decode_table_;             // nullptr if instructions are decoded from memory
+    uint64_t n_built_blocks_;
+    uint64_t n_loaded_blocks_;
+    uint64_t n_preformed_blocks_;
+
+    std::unordered_map<Address, DecodedBlock> blocks_;
+    std::unordered_map<size_t, std::vector<Address>> page_blocks_; // code page to starts of its blocks
+    std::vector<size_t> written_pages_;
+    uint64_t n_invalidated_blocks_;
+
+    DecodedBlock* last_block_; // nullptr after blocks are dropped
+    uint64_t n_link_hits_;
+    uint64_t n_lookups_;       // next blocks not found through links
+
+    void TrackCode(const Address start_pc, const size_t size);
+    void AddIrStats(const IrStats& block_stats);
+
+    // decodes up to block terminator, returns address after it
+    Address DecodeInstrs(const Address start_pc, std::vector<DecodedInstr>* instrs) const;
+    // predecoded block is used if its code is the same as in memory
+    bool LoadBlock(const Address start_pc, DecodedBlock* block);
+    DecodedBlock& BuildBlock(const Address start_pc);
+    DecodedBlock& GetNextBlockSlow(const Address pc);
+    void Link(DecodedBlock* from, DecodedBlock* to);
+    void UnlinkAll();
+  public:
+    void Init(IMemory* memory, const HleLayer* hle, LoopIdiomStats* loop_idiom_stats, 
+              bool is_fusion_enabled, bool is_optimization_enabled);
+    ~BlockCache() = default;
+
+    DecodedBlock& GetBlock(const Address pc) {
+        auto block_it = blocks_.find(pc);
+        if (block_it != blocks_.end()) {
+            return block_it->second;
+        }
+
+        return BuildBlock(pc);
+    }
+
+    // block following the last one returned from here
+    DecodedBlock& GetNextBlock(const Address pc) {
+        if (last_block_ != nullptr) {
+            for (DecodedBlock* link : last_block_->links) {
+                if (link != nullptr && link->start_pc == pc) {
+                    n_link_hits_++;
+                    last_block_ = link;
+                    return *link;
+                }
+            }
+        }
+
+        return GetNextBlockSlow(pc);
+    }
+
+    // builds blocks at every block start of the graph and links them along its edges
+    void Preform(const ControlFlowGraph& cfg);
+
+    void SetPredecodeCache(const PredecodeCache* predecode_cache);
+    void SetDecodeTable(DecodeTable* decode_table);
+    const std::unordered_map<Address, DecodedBlock>& GetBlocks() const;
+
+    void Clear();
+    // drops blocks whose code was written since they were decoded
+    void InvalidateWrittenCode();
+    // the same for pages already taken from memory
+    void InvalidatePages(const std::vector<size_t>& pages);
+
+    void ReportFusion(FILE* report_file) const;
+    const IrStats& GetIrStats() const;
+    uint64_t GetNInvalidatedBlocks() const;
+    uint64_t GetNBuiltBlocks() const;
+    uint64_t GetNLoadedBlocks() const;
+    uint64_t GetNPreformedBlocks() const;
+    uint64_t GetNLinkHits() const;
+    uint64_t GetNLookups() const;
+};
+
+bool IsBlockTerminator(InstructionMnemonic mnemonic);
+
+} // namespace sim
+
+#endif // BLOCK_CACHE_HPP_
@@ -0,0 +1,100 @@
+#ifndef BLOCK_IR_HPP_
+#define BLOCK_IR_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "instructions.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+// Register-level IR of decoded block. Immediates are sign extended,
+// pc relative values are resolved at lift time, so most ops do not touch pc.
+// Control transfers and system instructions stay as guest instructions.
+enum class IrOpcode : uint8_t {
+    kLoadImm, // rd = imm
+
+    // rd = rs1 op rs2
+    kAdd, kSub, kSll, kSlt, kSltu, kXor, kSrl, kSra, kOr, kAnd,
+
+    // rd = rs1 op imm
+    kAddImm, kSllImm, kSltImm, kSltuImm, kXorImm, kSrlImm, kSraImm, kOrImm, kAndImm,
+
+    // rd = memory[rs1 + imm]
+    kLoad8, kLoad8u, kLoad16, kLoad16u, kLoad32,
+
+    // memory[rs1 + imm] = rs2
+    kStore8, kStore16, kStore32,
+
+    kGuest, // executed by Cpu::Execute with pc set to pc of instruction
+};
+
+struct IrOp {
+    IrOpcode opcode;
+    uint8_t rd;
+    uint8_t rs1;
+    uint8_t rs2;
+    Register imm;
+
+    Address pc;
+    DecodedInstr guest;
+};
+
+struct IrStats {
+    uint64_t n_lifted;
+    uint64_t n_folded_constants;
+    uint64_t n_folded_addresses;
+    uint64_t n_dead_writes;
+};
+
+// Translates decoded (possibly fused) instructions of block started at start_pc.
+std::vector<IrOp> LiftBlock(const std::vector<DecodedInstr>& instrs, Address start_pc, IrStats* stats);
+
+// Propagates constants, folds address calculations, removes dead register writes.
+// Architectural state at the block end is the same as of unoptimized ops.
+void OptimizeBlock(std::vector<IrOp>* ops, IrStats* stats);
+
+const char* IrOpcodeToStr(IrOpcode opcode);
+
+inline bool IsIrAluRegOp(IrOpcode opcode) {
+    return IrOpcode::kAdd <= opcode && opcode <= IrOpcode::kAnd;
+}
+
+inline bool IsIrAluImmOp(IrOpcode opcode) {
+    return IrOpcode::kAddImm <= opcode && opcode <= IrOpcode::kAndImm;
+}
+
+inline bool IsIrLoadOp(IrOpcode opcode) {
+    return IrOpcode::kLoad8 <= opcode && opcode <= IrOpcode::kLoad32;
+}
+
+inline bool IsIrStoreOp(IrOpcode opcode) {
+    return IrOpcode::kStore8 <= opcode && opcode <= IrOpcode::kStore32;
+}
+
+// single definition of alu semantics for both executor and constant folder,
+// immediate form of opcode is evaluated the same as register one
+inline Register EvaluateIrAlu(IrOpcode opcode, const Register lhs, const Register rhs) {
+    const Register shamt_mask = 0b1'1111;
+
+    switch (opcode) {
+        case IrOpcode::kAdd:  case IrOpcode::kAddImm:  return lhs + rhs;
+        case IrOpcode::kSub:                           return lhs - rhs;
+        case IrOpcode::kSll:  case IrOpcode::kSllImm:  return lhs << (rhs & shamt_mask);
+        case IrOpcode::kSlt:  case IrOpcode::kSltImm:  return static_cast<IRegister>(lhs) < static_cast<IRegister>(rhs) ? 1 : 0;
+        case IrOpcode::kSltu: case IrOpcode::kSltuImm: return lhs < rhs ? 1 : 0;
+        case IrOpcode::kXor:  case IrOpcode::kXorImm:  return lhs ^ rhs;
+        case IrOpcode::kSrl:  case IrOpcode::kSrlImm:  return lhs >> (rhs & shamt_mask);
+        case IrOpcode::kSra:  case IrOpcode::kSraImm:  return static_cast<Register>(static_cast<IRegister>(lhs) >> (rhs & shamt_mask));
+        case IrOpcode::kOr:   case IrOpcode::kOrImm:   return lhs | rhs;
+        case IrOpcode::kAnd:  case IrOpcode::kAndImm:  return lhs & rhs;
+        default:
+            return 0;
+    }
+}
+
+} // namespace sim
+
+#endif // BLOCK_IR_HPP_
@@ -0,0 +1,109 @@
+#ifndef CACHE_MODEL_HPP_
+#define CACHE_MODEL_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "function_map.hpp"
+#include "imemory.hpp"
+#include "imemory_observer.hpp"
+
+namespace sim {
+
+enum class ReplacementPolicy {
+    kLru    = 0,
+    kFifo   = 1,
+    kRandom = 2,
+};
+
+struct CacheConfig {
+    size_t size;
+    size_t associativity;
+    size_t line_size;
+    ReplacementPolicy policy;
+};
+
+struct CacheStats {
+    uint64_t accesses;
+    uint64_t misses;
+    uint64_t writebacks;
+};
+
+// Set associative write-back write-allocate cache, keeps only tags.
+class Cache {
+  private:
+    static constexpr uint64_t kInvalidLine = UINT64_MAX;
+
+    CacheConfig config_;
+    size_t line_shift_;
+    uint64_t set_mask_;
+
+    std::vector<uint64_t> lines_;  // [set][way] -> line number
+    std::vector<uint64_t> stamps_; // last use for lru, insertion for fifo
+    std::vector<uint8_t> dirty_;
+
+    uint64_t clock_;
+    uint64_t random_state_;
+
+    CacheStats stats_;
+
+    size_t ChooseVictim(const size_t set_start);
+  public:
+    void Init(const CacheConfig& config);
+    ~Cache() = default;
+
+    size_t GetLineShift() const { return line_shift_; }
+
+    // returns true on hit, line evicted dirty is returned through writeback_line
+    bool Access(const uint64_t line, const bool is_write, uint64_t* writeback_line);
+
+    const CacheConfig& GetConfig() const;
+    const CacheStats& GetStats() const;
+};
+
+// L1I + L1D backed by a unified L2, fed by the guest memory accesses.
+class CacheHierarchy : public IMemoryObserver {
+  private:
+    enum CacheLevel {
+        kL1i     = 0,
+        kL1d     = 1,
+        kL2      = 2,
+        kNLevels = 3,
+    };
+
+    struct FunctionCacheStats {
+        uint64_t accesses[kNLevels];
+        uint64_t misses[kNLevels];
+    };
+
+    Cache l1i_;
+    Cache l1d_;
+    Cache l2_;
+
+    const FunctionMap* function_map_;
+    size_t current_function_;
+    std::vector<FunctionCacheStats> function_stats_; // indexed by function id
+
+    uint64_t last_fetch_line_;
+
+    void AccessData(const MemAddress address, const size_t size, const bool is_write);
+    void AccessL2(const uint64_t address, const bool is_write);
+  public:
+    void Init(const CacheConfig& l1i, const CacheConfig& l1d, const CacheConfig& l2, const FunctionMap* function_map);
+    ~CacheHierarchy() override = default;
+
+    void OnFetch(const MemAddress pc) override;
+    void OnRead (const MemAddress address, const size_t size) override;
+    void OnWrite(const MemAddress address, const size_t size) override;
+
+    void Report(FILE* report_file) const;
+};
+
+bool IsValidCacheConfig(const CacheConfig& config);
+const char* ReplacementPolicyToStr(ReplacementPolicy policy);
+
+} // namespace sim
+
+#endif // CACHE_MODEL_HPP_
@@ -0,0 +1,80 @@
+#ifndef CONTROL_FLOW_GRAPH_HPP_
+#define CONTROL_FLOW_GRAPH_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "decode_table.hpp"
+#include "iprogram_loader.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+enum class CfgError {
+    kOk           = 0,
+    kCantOpenFile = 1,
+};
+
+enum class CfgEdgeKind : uint8_t {
+    kFallThrough = 0, // next instruction, return site of a call too
+    kTaken       = 1, // conditional branch
+    kJump        = 2, // jal without link
+    kCall        = 3, // jal or jalr with link
+    kIndirect    = 4, // jalr without link, target is a constant
+};
+
+struct CfgEdge {
+    Address to;
+    CfgEdgeKind kind;
+};
+
+struct CfgBlock {
+    Address start_pc;
+    Address end_pc;      // address after the last instruction
+    Address function_pc; // entry of the function block was reached from
+    std::vector<CfgEdge> successors;
+    bool has_unknown_successors; // returns and jalr with targets computed at run time
+};
+
+// Functions, basic blocks and direct edges of the guest program recovered
+// from executable segments at load time. Functions start at the entry point,
+// function symbols, call targets and constants built in registers that point
+// into code; jalr targets are known if rs1 is built by lui/auipc + addi in
+// the same block.
+class ControlFlowGraph {
+  private:
+    std::map<Address, CfgBlock> blocks_;                  // ordered by start pc
+    std::map<Address, std::string> functions_;            // entry to name, from symbols if there is one
+    std::unordered_map<Address, Address> jalr_targets_;   // pc of jalr to its constant target
+    size_t n_edges_;
+
+    // leaders of blocks with functions they were reached from
+    void DiscoverLeaders(const ploader::IProgramLoader& ploader, const DecodeTable& decode_table,
+                         std::map<Address, Address>* leaders);
+    void FormBlocks(const DecodeTable& decode_table, const std::map<Address, Address>& leaders);
+    void CollectSuccessors(const Address pc, const DecodedInstr& dec_instr, CfgBlock* block) const;
+  public:
+    void Init(const ploader::IProgramLoader& ploader, const DecodeTable& decode_table);
+    ~ControlFlowGraph() = default;
+
+    const std::map<Address, CfgBlock>& GetBlocks() const;
+    // block containing pc, nullptr if pc was not reached
+    const CfgBlock* FindBlock(const Address pc) const;
+
+    size_t GetNFunctions() const;
+    size_t GetNEdges() const;
+
+    // graphviz digraph with a cluster per function
+    CfgError DumpDot(const std::string& path) const;
+};
+
+const char* CfgErrorToStr(CfgError error);
+const char* CfgEdgeKindToStr(CfgEdgeKind kind);
+
+} // namespace sim
+
+#endif // CONTROL_FLOW_GRAPH_HPP_
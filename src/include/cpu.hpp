@@ -4,26 +4,76 @@
 #include <cstdint>
 #include <cstdlib>
 
+#include "block_ir.hpp"
 #include "sim_cfg.hpp"
 #include "cpu_defs.hpp"
 #include "decode.hpp"
+#include "edge_profiler.hpp"
+#include "fpu.hpp"
+#include "hle.hpp"
 #include "instructions.hpp"
 #include "imemory.hpp"
+#include "syscall_handler.hpp"
+#include "vector_unit.hpp"
 
 namespace sim {
 
-class Cpu {
+// unprivileged counters, read-only, high halves for rv32
+enum CounterCsr {
+    kCsrCycle    = 0xc00,
+    kCsrTime     = 0xc01,
+    kCsrInstret  = 0xc02,
+    kCsrCycleh   = 0xc80,
+    kCsrTimeh    = 0xc81,
+    kCsrInstreth = 0xc82,
+};
+
+// machine level csr, set by options, each lane of lockstep runs is a hart
+enum HartCsr {
+    kCsrMhartid = 0xf14,
+};
+
+// rv32 and rv64 base isa share the core, width is resolved at compile time.
+// Vector and floating point extensions, hle and block ir are rv32 only
+template <size_t kXlen>
+class BasicCpu {
+  public:
+    using Register = typename XlenTraits<kXlen>::Register;
+    using IRegister = typename XlenTraits<kXlen>::IRegister;
+    using Address = typename XlenTraits<kXlen>::Address;
   private:
     Register pc_;
     Register registers_[kNumberOfRegisters];
     bool is_finished_;
+    VectorUnit vector_unit_;
+    Fpu fpu_;
+    uint64_t instret_base_;
+    Address instret_base_pc_;
+    Register hart_id_;
 
     IMemory* memory_;
+    EdgeProfiler* edge_profiler_;
+    SyscallHandler* syscall_handler_;
+    HleLayer* hle_;
+
+    InstructionError HandleSyscall();
+    InstructionError ExecuteCsr(const DecodedInstr& dec_instr);
 
-    InstructionError SyscallHandler();
+    void RecordTakenBranch(const Register from) {
+        if (edge_profiler_ != nullptr) {
+            edge_profiler_->RecordTakenBranch(static_cast<sim::Address>(from), static_cast<sim::Address>(pc_));
+        }
+    }
+
+    static IRegister SignExtension(const Register uvalue, const size_t starting_bit);
+    // results of lw, lui, auipc and word instructions
+    static Register SignExtendWord(const uint32_t value);
+    static IRegister RegToIReg(const Register uvalue);
+    static Register IRegToReg(const IRegister value);
+    static Register ArithmRightShift(const Register value, const size_t shift);
   public:
     void Init(size_t entry_point, IMemory* memrory);
-    ~Cpu() = default;
+    ~BasicCpu() = default;
 
     Register GetPc() const;
     void SetPc(const Register new_pc);
@@ -31,14 +81,36 @@ class Cpu {
     Register GetRegisterValue(const size_t register_id) const;
     void SetRegisterValue(const size_t register_id, const Register new_value);
 
+    void SetEdgeProfiler(EdgeProfiler* edge_profiler);
+    void SetMemory(IMemory* memory);
+    void SetSyscallHandler(SyscallHandler* syscall_handler);
+    void SetHleLayer(HleLayer* hle);
+    // resets vector state
+    void SetVlen(const size_t vlen);
+    void SetHartId(const Register hart_id);
+
     bool GetIsFinished() const;
     void SetIsFinished(const bool is_finished);
 
+    // false if csr is not implemented
+    bool ReadCsr(const Register csr, Register* value) const;
+    bool WriteCsr(const Register csr, const Register value);
+
+    // instructions retired before the one at pc, set once per block: later 
+    // instructions of the straight-line block derive their count from pc
+    void SetRetiredInstrs(const uint64_t n_retired, const Address pc);
+    uint64_t GetRetiredInstrs() const;
+
     void Dump() const;
     
     InstructionError Execute(DecodedInstr dec_instr);
+    // pc is updated by guest ops only
+    InstructionError ExecuteIr(const IrOp& op) requires (kXlen == 32);
 };
 
+extern template class BasicCpu<32>;
+extern template class BasicCpu<64>;
+
 }
 
 
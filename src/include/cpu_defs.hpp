@@ -46,6 +46,7 @@ enum class InstructionError {
     kOk                 = 0,
     kUnknownInstruction = 1,
     kMisalignedAddress  = 2,
+    kMemoryFault        = 3,
 };
 
 enum class TranslateError {
@@ -55,10 +56,23 @@ enum class TranslateError {
 
 const size_t kSyscallIdRegister = RegisterAliases::kArgument7;
 
+// riscv linux numbering, used by newlib (libgloss/riscv/machine/syscall.h)
 enum SyscallIds {
-    kRead = 63,
-    kWrite = 64,
-    kExit = 93,
+    kOpenat           = 56,
+    kClose            = 57,
+    kLseek            = 62,
+    kRead             = 63,
+    kWrite            = 64,
+    kReadv            = 65,
+    kWritev           = 66,
+    kFstat            = 80,
+    kExit             = 93,
+    kExitGroup        = 94,
+    kClockGettime     = 113,
+    kGettimeofday     = 169,
+    kBrk              = 214,
+    kClockGettime64   = 403,
+    kOpen             = 1024, // newlib only
 };
 
 enum DefaultDesriptors {
@@ -69,6 +83,12 @@ enum DefaultDesriptors {
 
 const char* CpuErrorsToStr(CpuErrors error);
 
+template <size_t kXlen>
+class BasicCpu;
+
+using Cpu = BasicCpu<32>;
+using Cpu64 = BasicCpu<64>;
+
 } // namespace sim
 
 #endif // CPU_DEFS_HPP_
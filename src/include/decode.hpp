@@ -6,8 +6,19 @@
 
 namespace sim {
 
+// instantiated for rv32 and rv64, instructions of the other base isa are unknown
+template <size_t kXlen>
 DecodedInstr Decode(Register enc_instr);
 
+// the same for words that may be data, false if encoding is unknown
+template <size_t kXlen>
+bool TryDecode(Register enc_instr, DecodedInstr* dec_instr);
+
+const char* InstructionMnemonicToStr(InstructionMnemonic mnemonic);
+
+// sign extends imm_size_bit wide immediate of decoded instruction
+Register SignExtendImm(const Register imm, const size_t imm_size_bit);
+
 }; // namespace sim
 
 #endif // DECODE_HPP_
@@ -0,0 +1,82 @@
+#ifndef DECODE_TABLE_HPP_
+#define DECODE_TABLE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "hle.hpp"
+#include "imemory.hpp"
+#include "imemory_observer.hpp"
+#include "instructions.hpp"
+#include "iprogram_loader.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+// Instructions of executable segments decoded once at load time into dense
+// arrays indexed by (pc - segment start) / 4. Entry keeps the word it was
+// decoded from, so a lookup costs an index and a compare with memory; words
+// written since load and words that are not instructions are decoded when
+// they are reached. Only segments executable in the memory map are kept;
+// other pcs are fetched through memory, so unaligned, non executable and mmio
+// fetches fault there. Hooked hle entries are patched into the table.
+class DecodeTable {
+  private:
+    struct Segment {
+        Address start_pc;
+        Address end_pc;
+        std::vector<DecodedInstr> instrs;
+        std::vector<uint32_t> words;
+    };
+
+    IMemory* memory_;
+    const uint8_t* memory_data_;
+    const HleLayer* hle_;
+    IMemoryObserver* observer_; // sees fetches as it would from memory
+    size_t xlen_;
+
+    std::vector<Segment> segments_;
+    DecodedInstr scratch_; // for pc out of segments
+    uint64_t n_redecoded_;
+
+    DecodedInstr DecodeWord(const Address pc, const uint32_t word) const;
+    bool TryDecodeWord(const Address pc, const uint32_t word, DecodedInstr* dec_instr) const;
+    const DecodedInstr& GetSlow(const Address pc);
+  public:
+    void Init(const ploader::IProgramLoader& ploader, IMemory* memory, const HleLayer* hle);
+    ~DecodeTable() = default;
+
+    const DecodedInstr& Get(const Address pc) {
+        for (Segment& segment : segments_) {
+            if (segment.start_pc <= pc && pc < segment.end_pc && pc % kInstrSize == 0) {
+                const size_t index = (pc - segment.start_pc) / kInstrSize;
+                uint32_t word = 0;
+                std::memcpy(&word, memory_data_ + pc, sizeof(word));
+                if (segment.words[index] == word) {
+                    if (observer_ != nullptr) {
+                        observer_->OnFetch(pc);
+                    }
+                    return segment.instrs[index];
+                }
+                break;
+            }
+        }
+
+        return GetSlow(pc);
+    }
+
+    // entry decoded at load time, nullptr if pc is out of executable segments or
+    // its word is not an instruction
+    const DecodedInstr* Find(const Address pc) const;
+
+    void SetObserver(IMemoryObserver* observer);
+
+    size_t GetNInstrs() const;
+    uint64_t GetNRedecoded() const { return n_redecoded_; }
+};
+
+} // namespace sim
+
+#endif // DECODE_TABLE_HPP_
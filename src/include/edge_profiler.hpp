@@ -0,0 +1,57 @@
+#ifndef EDGE_PROFILER_HPP_
+#define EDGE_PROFILER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "sim_cfg.hpp"
+#include "sim_options.hpp"
+
+namespace sim {
+
+enum class ProfilerError {
+    kOk           = 0,
+    kCantOpenFile = 1,
+};
+
+// Aggregates taken control transfers of the guest (branches, jal, jalr)
+// in the same shape as lbr based profiles: branch edges plus the
+// fall-through ranges executed between two taken branches.
+class EdgeProfiler {
+  private:
+    using EdgeKey = uint64_t;
+
+    std::unordered_map<EdgeKey, uint64_t> branches_;
+    std::unordered_map<EdgeKey, uint64_t> ranges_;
+
+    Address range_start_;
+    bool is_finished_;
+
+    static EdgeKey MakeKey(const Address from, const Address to) {
+        return (static_cast<EdgeKey>(from) << 32u) | to;
+    }
+  public:
+    void Init(const Address entry_point);
+    ~EdgeProfiler() = default;
+
+    void RecordTakenBranch(const Address from, const Address to) {
+        branches_[MakeKey(from, to)]++;
+        ranges_[MakeKey(range_start_, from)]++;
+        range_start_ = to;
+    }
+
+    // closes the last fall-through range at the instruction that stopped the guest
+    void Finish(const Address last_pc);
+
+    size_t GetNBranches() const;
+
+    ProfilerError Dump(const std::string& path, BranchProfileFormat format) const;
+};
+
+const char* ProfilerErrorToStr(ProfilerError error);
+
+} // namespace sim
+
+#endif // EDGE_PROFILER_HPP_
@@ -23,8 +23,13 @@ class ElfLoader: public IProgramLoader {
     size_t GetSizeIndex(size_t index) const override;
     size_t GetStartAddrIndex(size_t index) const override;
     size_t GetEndAddrIndex(size_t index) const override;
+    bool GetIsReadableIndex(size_t index) const override;
+    bool GetIsWritableIndex(size_t index) const override;
+    bool GetIsExecutableIndex(size_t index) const override;
     size_t GetEntryPoint() const override;
+    size_t GetXlen() const override;
     size_t GetNLSections() const override;
+    const std::vector<Symbol>& GetSymbols() const override;
 };
 
 }; // namespace ploader
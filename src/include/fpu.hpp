@@ -0,0 +1,118 @@
+#ifndef FPU_HPP_
+#define FPU_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu_defs.hpp"
+#include "imemory.hpp"
+#include "instructions.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+static const size_t kNFpRegisters = 32;
+
+// csr numbers of floating point state
+enum FpCsr {
+    kCsrFflags = 0x001,
+    kCsrFrm    = 0x002,
+    kCsrFcsr   = 0x003,
+};
+
+enum class FpRoundingMode : Register {
+    kRne = 0b000, // to nearest, ties to even
+    kRtz = 0b001, // towards zero
+    kRdn = 0b010, // down
+    kRup = 0b011, // up
+    kRmm = 0b100, // to nearest, ties to max magnitude
+    kDyn = 0b111, // frm of fcsr, valid in instructions only
+};
+
+// accrued exceptions of fflags
+enum FpFlags : Register {
+    kFpInexact   = 1u << 0u,
+    kFpUnderflow = 1u << 1u,
+    kFpOverflow  = 1u << 2u,
+    kFpDivByZero = 1u << 3u,
+    kFpInvalid   = 1u << 4u,
+};
+
+// F and D extensions. Arithmetic runs on host floating point unit, which is
+// kept in round to nearest even: other guest rounding modes are set around a
+// single operation, ties to max magnitude has no host mode and is rounded from
+// result of wider format. Host exception flags are collected per operation.
+class Fpu {
+  private:
+    std::array<uint64_t, kNFpRegisters> registers_; // single precision values are nan-boxed
+    Register frm_;
+    Register fflags_;
+
+    template <typename T>
+    T GetValue(const Register reg) const;
+    template <typename T>
+    void SetValue(const Register reg, const T value);
+
+    // resolves kDyn by frm, reserved modes are illegal
+    bool GetRoundingMode(const Register rm, FpRoundingMode* mode) const;
+
+    template <typename T>
+    InstructionError ExecuteFormat(const DecodedInstr& dec_instr, Cpu* cpu);
+  public:
+    void Init();
+    ~Fpu() = default;
+
+    // false if csr is not floating point one
+    bool ReadCsr(const Register csr, Register* value) const;
+    bool WriteCsr(const Register csr, const Register value);
+
+    // pc is not changed, reserved rounding modes return kUnknownInstruction
+    InstructionError Execute(const DecodedInstr& dec_instr, Cpu* cpu, IMemory* memory);
+
+    void Dump() const;
+};
+
+// rd of these instructions is x register
+inline bool IsFpIntegerDest(InstructionMnemonic mnemonic) {
+    switch (mnemonic) {
+        case InstructionMnemonic::kFcvt_w_s:
+        case InstructionMnemonic::kFcvt_wu_s:
+        case InstructionMnemonic::kFmv_x_w:
+        case InstructionMnemonic::kFeq_s:
+        case InstructionMnemonic::kFlt_s:
+        case InstructionMnemonic::kFle_s:
+        case InstructionMnemonic::kFclass_s:
+        case InstructionMnemonic::kFeq_d:
+        case InstructionMnemonic::kFlt_d:
+        case InstructionMnemonic::kFle_d:
+        case InstructionMnemonic::kFclass_d:
+        case InstructionMnemonic::kFcvt_w_d:
+        case InstructionMnemonic::kFcvt_wu_d:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// rs1 of these instructions is x register
+inline bool IsFpIntegerSource(InstructionMnemonic mnemonic) {
+    switch (mnemonic) {
+        case InstructionMnemonic::kFlw:
+        case InstructionMnemonic::kFsw:
+        case InstructionMnemonic::kFld:
+        case InstructionMnemonic::kFsd:
+        case InstructionMnemonic::kFcvt_s_w:
+        case InstructionMnemonic::kFcvt_s_wu:
+        case InstructionMnemonic::kFmv_w_x:
+        case InstructionMnemonic::kFcvt_d_w:
+        case InstructionMnemonic::kFcvt_d_wu:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace sim
+
+#endif // FPU_HPP_
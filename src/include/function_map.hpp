@@ -0,0 +1,48 @@
+#ifndef FUNCTION_MAP_HPP_
+#define FUNCTION_MAP_HPP_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "iprogram_loader.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+// Maps guest addresses to the guest functions found in the symbol table.
+class FunctionMap {
+  public:
+    static constexpr size_t kUnknownFunction = 0; // id for pc outside of any known function
+  private:
+    struct FunctionRange {
+        Address start_addr;
+        Address end_addr;
+        size_t id;
+    };
+
+    std::vector<FunctionRange> ranges_; // sorted by start address
+    std::vector<std::string> names_;    // indexed by function id
+
+    mutable FunctionRange last_range_;  // consecutive lookups usually hit the same function
+  public:
+    void Init(const std::vector<ploader::Symbol>& symbols);
+    ~FunctionMap() = default;
+
+    size_t Lookup(const Address pc) const {
+        if (last_range_.start_addr <= pc && pc < last_range_.end_addr) {
+            return last_range_.id;
+        }
+
+        return LookupSlow(pc);
+    }
+
+    size_t LookupSlow(const Address pc) const;
+
+    size_t GetNFunctions() const;
+    const std::string& GetName(const size_t id) const;
+};
+
+} // namespace sim
+
+#endif // FUNCTION_MAP_HPP_
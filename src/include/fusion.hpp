@@ -0,0 +1,33 @@
+#ifndef FUSION_HPP_
+#define FUSION_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "instructions.hpp"
+
+namespace sim {
+
+enum FusionKind {
+    kFusionLuiAddi   = 0,
+    kFusionAuipcJalr = 1,
+    kFusionAuipcLw   = 2,
+    kFusionSltBne    = 3,
+    kFusionSltuBne   = 4,
+
+    kNFusionKinds,
+};
+
+using FusionCounters = std::array<uint64_t, kNFusionKinds>;
+
+// Replaces common pairs of adjacent instructions with superinstructions, 
+// counts replaced pairs of each kind in counters.
+void FuseInstructions(std::vector<DecodedInstr>* instrs, FusionCounters* counters);
+
+const char* FusionKindToStr(FusionKind kind);
+
+} // namespace sim
+
+#endif // FUSION_HPP_
@@ -0,0 +1,135 @@
+#ifndef HLE_HPP_
+#define HLE_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "cpu_defs.hpp"
+#include "imemory.hpp"
+#include "instructions.hpp"
+#include "iprogram_loader.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+enum HleRoutine {
+    kHleMemcpy  = 0,
+    kHleMemset  = 1,
+    kHleMemmove = 2,
+    kHleStrlen  = 3,
+    kHleStrcmp  = 4,
+    kHleMemcmp  = 5,
+
+    kHleMulsi3  = 6,
+    kHleMuldi3  = 7,
+    kHleDivsi3  = 8,
+    kHleUdivsi3 = 9,
+    kHleModsi3  = 10,
+    kHleUmodsi3 = 11,
+
+    kHleAdddf3  = 12,
+    kHleSubdf3  = 13,
+    kHleMuldf3  = 14,
+    kHleDivdf3  = 15,
+    kHleAddsf3  = 16,
+    kHleSubsf3  = 17,
+    kHleMulsf3  = 18,
+    kHleDivsf3  = 19,
+
+    kHleEqdf2   = 20,
+    kHleNedf2   = 21,
+    kHleLtdf2   = 22,
+    kHleLedf2   = 23,
+    kHleGtdf2   = 24,
+    kHleGedf2   = 25,
+    kHleUnorddf2 = 26,
+
+    kHleFloatsidf   = 27,
+    kHleFloatunsidf = 28,
+    kHleFixdfsi     = 29,
+    kHleFixunsdfsi  = 30,
+
+    kNHleRoutines,
+};
+
+struct HleRoutineInfo {
+    const char* name;  // guest symbol
+    const char* group;
+    // estimate of guest instructions replaced by one call:
+    // base_instrs + instrs_per_unit * n_units
+    uint64_t base_instrs;
+    uint64_t instrs_per_unit;
+};
+
+struct HleStats {
+    uint64_t n_calls;
+    uint64_t n_units;
+};
+
+// High level emulation: entries of guest functions found in symbol table
+// are decoded as kHleCall, which runs host implementation on guest memory
+// with guest ilp32 abi (a0-a3 in, a0-a1 out) and returns to ra.
+class HleLayer {
+  private:
+    IMemory* memory_;
+    std::unordered_map<Address, HleRoutine> hooks_;
+    std::array<HleStats, kNHleRoutines> stats_;
+
+    // raises the fault guest access to range out of memory would and stops guest
+    void Fault(Cpu* cpu, const MemAddress address, const bool is_write);
+
+    uint64_t Memcpy(Cpu* cpu);
+    uint64_t Memset(Cpu* cpu);
+    uint64_t Memmove(Cpu* cpu);
+    uint64_t Strlen(Cpu* cpu);
+    uint64_t Strcmp(Cpu* cpu);
+    uint64_t Memcmp(Cpu* cpu);
+
+    // libgcc helpers, one unit per call
+    uint64_t IntegerArith(const HleRoutine routine, Cpu* cpu);
+    uint64_t FloatArith(const HleRoutine routine, Cpu* cpu);
+    uint64_t DoubleCompare(const HleRoutine routine, Cpu* cpu);
+    uint64_t Convert(const HleRoutine routine, Cpu* cpu);
+  public:
+    void Init(IMemory* memory, const std::vector<ploader::Symbol>& symbols, const std::vector<std::string>& routines);
+    ~HleLayer() = default;
+
+    bool IsEnabled() const {
+        return !hooks_.empty();
+    }
+
+    // replaces instruction at hooked function entry with kHleCall
+    void PatchHookedInstr(const Address pc, DecodedInstr* dec_instr) const {
+        if (hooks_.empty()) {
+            return;
+        }
+
+        auto hook_it = hooks_.find(pc);
+        if (hook_it != hooks_.end()) {
+            *dec_instr = {
+                .instr_type = InstrType::IType,
+                .opcode = InstructionOpcodes::kUnknown,
+                .instr_mnem = InstructionMnemonic::kHleCall,
+                .instr = {.i_type = {.rd = 0, .rs1 = 0, .imm = static_cast<Register>(hook_it->second), .imm_size_bit = 0}},
+            };
+        }
+    }
+
+    InstructionError Call(const HleRoutine routine, Cpu* cpu);
+
+    void Report(FILE* report_file) const;
+};
+
+const HleRoutineInfo& GetHleRoutineInfo(const HleRoutine routine);
+// expands group names, returns false on unknown name
+bool ResolveHleRoutines(std::string_view names, std::vector<std::string>* routines);
+
+} // namespace sim
+
+#endif // HLE_HPP_
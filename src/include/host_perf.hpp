@@ -0,0 +1,66 @@
+#ifndef HOST_PERF_HPP_
+#define HOST_PERF_HPP_
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+namespace sim {
+
+enum class HostCounter {
+    kCycles       = 0,
+    kInstructions = 1,
+    kBranchMisses = 2,
+    kCacheMisses  = 3,
+
+    kNHostCounters,
+};
+
+static const size_t kNHostCounters = static_cast<size_t>(HostCounter::kNHostCounters);
+
+// internal counters of the simulator sampled at exit
+struct HostPerfStats {
+    uint64_t n_guest_instrs;
+    uint64_t n_predecoded_instrs; // decoded at load time
+    uint64_t n_run_time_decodes;  // written or data words decoded when reached
+    uint64_t n_built_blocks;
+    uint64_t n_loaded_blocks;     // from predecode cache
+    uint64_t n_block_link_hits;
+    uint64_t n_block_lookups;
+    uint64_t n_syscalls;
+    uint64_t syscall_time_ns;
+};
+
+// User space hardware counters of the simulator process opened with
+// perf_event_open, each on its own, so counters the host lacks are only
+// missing from the report. Wall time is measured along with them.
+class HostPerfCounters {
+  private:
+    std::array<int, kNHostCounters> fds_ = {-1, -1, -1, -1};
+    std::array<uint64_t, kNHostCounters> values_;
+
+    std::chrono::steady_clock::time_point start_time_;
+    uint64_t wall_time_ns_;
+  public:
+    // returns number of opened counters
+    size_t Init();
+    ~HostPerfCounters();
+
+    void Start();
+    void Stop();
+
+    bool IsAvailable(HostCounter counter) const;
+    uint64_t Get(HostCounter counter) const;
+    uint64_t GetWallTimeNs() const;
+
+    // json object, counters the host lacks are null
+    void Report(FILE* report_file, const HostPerfStats& stats) const;
+};
+
+const char* HostCounterToStr(HostCounter counter);
+
+} // namespace sim
+
+#endif // HOST_PERF_HPP_
@@ -0,0 +1,32 @@
+#ifndef IIO_BACKEND_HPP_
+#define IIO_BACKEND_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include <sys/types.h>
+
+namespace sim {
+
+// Host side of guest file i/o. Operations take host fds and return
+// -errno on failure. Backend may defer writes and read ahead, so anything
+// accessing fd directly has to Sync() it first; a deferred write that
+// failed is reported by the next operation on its fd.
+class IIoBackend {
+  public:
+    virtual ~IIoBackend() = default;
+
+    virtual ssize_t Read(const int fd, uint8_t* buffer, const size_t size) = 0;
+    virtual ssize_t Write(const int fd, const uint8_t* buffer, const size_t size) = 0;
+    virtual off_t Seek(const int fd, const off_t offset, const int whence) = 0;
+
+    // completes pending i/o of fd, file position becomes the one seen by guest,
+    // returns -errno of a deferred write to fd that failed or 0
+    virtual int Sync(const int fd) = 0;
+    // completes all pending i/o
+    virtual void Flush() = 0;
+};
+
+} // namespace sim
+
+#endif // IIO_BACKEND_HPP_
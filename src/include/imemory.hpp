@@ -3,11 +3,17 @@
 
 #include <cstddef>
 #include <cstdint>
+#include <vector>
 
 namespace sim {
 
 using MemAddress = uint32_t;
 
+// granularity of tracking writes to decoded code
+static const size_t kCodePageBits = 12;
+
+class IMemoryObserver;
+
 class IMemory {
   public:
     virtual void Init(size_t memory_size) = 0;
@@ -15,10 +21,20 @@ class IMemory {
 
     virtual void Dump(size_t start_addr, size_t end_addr) const = 0;
 
+    // rv64 and D extension accesses
+    virtual uint64_t ReadFromMemory64b(const MemAddress address) const = 0;
     virtual uint32_t ReadFromMemory32b(const MemAddress address) const = 0;
     virtual uint16_t ReadFromMemory16b(const MemAddress address) const = 0;
     virtual uint8_t  ReadFromMemory8b (const MemAddress address) const = 0;
 
+    virtual uint32_t FetchInstr32b(const MemAddress address) const = 0;
+    // whole [address, address + size) may be fetched from without a fault
+    virtual bool IsExecutable(const MemAddress address, const size_t size) const = 0;
+    // same for loads and stores, host side accesses to guest memory check them
+    virtual bool IsReadable(const MemAddress address, const size_t size) const = 0;
+    virtual bool IsWritable(const MemAddress address, const size_t size) const = 0;
+
+    virtual void WriteToMemory64b(const uint64_t data, const MemAddress address) = 0;
     virtual void WriteToMemory32b(const uint32_t data, const MemAddress address) = 0;
     virtual void WriteToMemory16b(const uint16_t data, const MemAddress address) = 0;
     virtual void WriteToMemory8b (const uint8_t data, const MemAddress address) = 0;
@@ -27,6 +43,18 @@ class IMemory {
 
     virtual size_t GetMemorySize() const = 0;
     virtual uint8_t* GetData() = 0;
+    // host pointer to [address, address + size) or nullptr if range is out of memory
+    virtual uint8_t* GetHostRange(const MemAddress address, const size_t size) = 0;
+    // writes through host pointers are not seen by memory, writers report them
+    virtual void NotifyHostWrite(const MemAddress address, const size_t size) = 0;
+
+    // pages of marked range hold decoded code, the first write to such page 
+    // unmarks it and records it as written until taken
+    virtual void MarkCode(const MemAddress address, const size_t size) = 0;
+    virtual bool HasWrittenCode() const = 0;
+    virtual void TakeWrittenCodePages(std::vector<size_t>* pages) = 0;
+
+    virtual void SetObserver(IMemoryObserver* observer) = 0;
 };
 
 }; // namespace sim
@@ -0,0 +1,23 @@
+#ifndef IMEMORY_OBSERVER_HPP_
+#define IMEMORY_OBSERVER_HPP_
+
+#include <cstddef>
+
+#include "imemory.hpp"
+
+namespace sim {
+
+// Receives every guest memory access. Instruction fetches are reported before 
+// the data accesses made by the fetched instruction.
+class IMemoryObserver {
+  public:
+    virtual ~IMemoryObserver() = default;
+
+    virtual void OnFetch(const MemAddress pc) = 0;
+    virtual void OnRead (const MemAddress address, const size_t size) = 0;
+    virtual void OnWrite(const MemAddress address, const size_t size) = 0;
+};
+
+}; // namespace sim
+
+#endif // IMEMORY_OBSERVER_HPP_
@@ -0,0 +1,26 @@
+#ifndef IMMIO_DEVICE_HPP_
+#define IMMIO_DEVICE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "imemory.hpp"
+
+namespace sim {
+
+// Device mapped into guest address space. Offsets are from the start of the
+// device, accesses are 1, 2, 4 or 8 bytes and never cross its end.
+class IMmioDevice {
+  public:
+    virtual ~IMmioDevice() = default;
+
+    virtual const char* GetName() const = 0;
+    virtual size_t GetSize() const = 0;
+
+    virtual uint64_t Read(const MemAddress offset, const size_t size) = 0;
+    virtual void Write(const uint64_t data, const MemAddress offset, const size_t size) = 0;
+};
+
+}; // namespace sim
+
+#endif // IMMIO_DEVICE_HPP_
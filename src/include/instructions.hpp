@@ -11,6 +11,8 @@ namespace sim {
 // https://www2.eecs.berkeley.edu/Pubs/TechRpts/2016/EECS-2016-118.pdf
 
 static const sim::Register kOpcodeMask = 0b111'1111;
+// encodings are 32 bit wide in rv32 and rv64
+static const size_t kInstrSize = sizeof(uint32_t);
 
 struct RTypeInstr {
     Register opcode : 7;
@@ -21,6 +23,17 @@ struct RTypeInstr {
     Register funct7 : 7;
 };
 
+// fused multiply-add of F and D extensions
+struct R4TypeInstr {
+    Register opcode : 7;
+    Register rd     : 5;
+    Register funct3 : 3; // rounding mode
+    Register rs1    : 5;
+    Register rs2    : 5;
+    Register fmt    : 2;
+    Register rs3    : 5;
+};
+
 struct ITypeInstr {
     Register opcode : 7;
     Register rd     : 5;
@@ -64,6 +77,30 @@ struct JTypeInstr {
     Register imm_20    : 1;
 };
 
+// OP-V arithmetic and configuration
+struct VTypeInstr {
+    Register opcode : 7;
+    Register vd     : 5;
+    Register funct3 : 3;
+    Register vs1    : 5; // or rs1, simm5
+    Register vs2    : 5;
+    Register vm     : 1; // 0 if masked by v0
+    Register funct6 : 6;
+};
+
+// vector loads and stores, share LOAD-FP and STORE-FP opcodes
+struct VMemTypeInstr {
+    Register opcode : 7;
+    Register vd     : 5; // vs3 of stores
+    Register width  : 3;
+    Register rs1    : 5;
+    Register rs2    : 5; // stride register or lumop/sumop
+    Register vm     : 1;
+    Register mop    : 2;
+    Register mew    : 1;
+    Register nf     : 3;
+};
+
 // opcodes --------------------------------------------------------------------
 
 enum class InstructionOpcodes : Register {
@@ -77,8 +114,18 @@ enum class InstructionOpcodes : Register {
     kStoreInstr     = 0b010'0011, // store family of instructions    
     kArithmImmInstr = 0b001'0011, // arithmetic operations with immediate foi
     kArithmRegInstr = 0b011'0011, // arithmetic operations with register foi
-    kFenceInstr     = 0b000'1111, // fence foi
+    kFenceInstr = 0b000'1111, // fence foi
     kSystemInstr    = 0b111'0011, // system foi   
+    kLoadFpInstr    = 0b000'0111, // flw, fld and vector loads
+    kStoreFpInstr   = 0b010'0111, // fsw, fsd and vector stores
+    kVectorInstr    = 0b101'0111, // vector arithmetic and configuration (OP-V)
+    kMaddInstr      = 0b100'0011, // fmadd
+    kMsubInstr      = 0b100'0111, // fmsub
+    kNmsubInstr     = 0b100'1011, // fnmsub
+    kNmaddInstr     = 0b100'1111, // fnmadd
+    kOpFpInstr      = 0b101'0011, // floating point arithmetic, compares, conversions and moves
+    kArithmImmWordInstr = 0b001'1011, // rv64 only: 32 bit arithmetic operations with immediate
+    kArithmRegWordInstr = 0b011'1011, // rv64 only: 32 bit arithmetic operations with register
 };
 
 // funct3 ---------------------------------------------------------------------
@@ -98,12 +145,15 @@ enum class LoadInstruction : Register {
     kLw  = 0b010, // load word
     kLbu = 0b100, // load byte (usigned)
     kLhu = 0b101, // load half (usigned)
+    kLwu = 0b110, // rv64 only: load word (usigned)
+    kLd  = 0b011, // rv64 only: load double word
 };
 
 enum class StoreInstruction : Register {
     kSb = 0b000, // store byte
     kSh = 0b001, // store half
     kSw = 0b010, // store word
+    kSd = 0b011, // rv64 only: store double word
 };
 
 enum class ArithmImmInstruction : Register {
@@ -134,9 +184,41 @@ enum class FenceInstruction : Register {
     kInstruction = 0b001, // FENCE.I sync for data + instructions
 };
 
+enum class VectorInstruction : Register {
+    kOpIvv = 0b000, // integer vector-vector
+    kOpMvv = 0b010, // mask, reduction, multiply vector-vector
+    kOpIvi = 0b011, // integer vector-immediate
+    kOpIvx = 0b100, // integer vector-scalar
+    kOpMvx = 0b110, // multiply vector-scalar
+    kOpCfg = 0b111, // vsetvli, vsetivli, vsetvl
+};
+
+// element width of vector memory access
+enum class VectorMemWidth : Register {
+    k8  = 0b000,
+    k16 = 0b101,
+    k32 = 0b110,
+};
+
+enum class VectorMemMode : Register {
+    kUnitStride = 0b00,
+    kStrided    = 0b10,
+};
+
+// width of LOAD-FP and STORE-FP, other widths are vector accesses
+enum class FpMemWidth : Register {
+    kWord   = 0b010,
+    kDouble = 0b011,
+};
+
 enum class SystemInstruction : Register {
     kScallSbreak = 0b000,
-    kSread       = 0b010, 
+    kCsrrw      = 0b001,
+    kCsrrs      = 0b010,
+    kCsrrc      = 0b011,
+    kCsrrwi     = 0b101,
+    kCsrrsi     = 0b110,
+    kCsrrci     = 0b111,
 };
 
 // funct7 ---------------------------------------------------------------------
@@ -159,6 +241,75 @@ enum class ArithmImmShiftRight : Register {
     kArithm  = 0b010'0000,
 };
 
+enum class VectorIntFunct6 : Register {
+    kVadd   = 0b000000,
+    kVsub   = 0b000010,
+    kVrsub  = 0b000011,
+    kVminu  = 0b000100,
+    kVmin   = 0b000101,
+    kVmaxu  = 0b000110,
+    kVmax   = 0b000111,
+    kVand   = 0b001001,
+    kVor    = 0b001010,
+    kVxor   = 0b001011,
+    kVmerge = 0b010111, // vmv.v.* if unmasked
+    kVmseq  = 0b011000,
+    kVmsne  = 0b011001,
+    kVmsltu = 0b011010,
+    kVmslt  = 0b011011,
+    kVmsleu = 0b011100,
+    kVmsle  = 0b011101,
+    kVmsgtu = 0b011110,
+    kVmsgt  = 0b011111,
+    kVsll   = 0b100101,
+    kVsrl   = 0b101000,
+    kVsra   = 0b101001,
+};
+
+enum class VectorMaskFunct6 : Register {
+    kVredsum   = 0b000000,
+    kVredand   = 0b000001,
+    kVredor    = 0b000010,
+    kVredxor   = 0b000011,
+    kVredminu  = 0b000100,
+    kVredmin   = 0b000101,
+    kVredmaxu  = 0b000110,
+    kVredmax   = 0b000111,
+    kVwxunary0 = 0b010000, // vmv.x.s, vcpop.m, vfirst.m by vs1; vmv.s.x of OPMVX
+    kVmunary0  = 0b010100, // vid.v by vs1
+    kVmandn    = 0b011000,
+    kVmand     = 0b011001,
+    kVmor      = 0b011010,
+    kVmxor     = 0b011011,
+    kVmorn     = 0b011100,
+    kVmnand    = 0b011101,
+    kVmnor     = 0b011110,
+    kVmxnor    = 0b011111,
+    kVmul      = 0b100101,
+};
+
+// funct7 of OP-FP is funct5 and fmt
+enum class FpFunct5 : Register {
+    kFadd       = 0b00000,
+    kFsub       = 0b00001,
+    kFmul       = 0b00010,
+    kFdiv       = 0b00011,
+    kFsgnj      = 0b00100, // fsgnj, fsgnjn, fsgnjx by funct3
+    kFminMax    = 0b00101, // fmin, fmax by funct3
+    kFcvtFp     = 0b01000, // fcvt.s.d, fcvt.d.s
+    kFsqrt      = 0b01011,
+    kFcompare   = 0b10100, // fle, flt, feq by funct3
+    kFcvtToInt  = 0b11000, // fcvt.w, fcvt.wu by rs2
+    kFcvtInt    = 0b11010, // fcvt.*.w, fcvt.*.wu by rs2
+    kFmvToInt   = 0b11100, // fmv.x.w, fclass by funct3
+    kFmvInt     = 0b11110, // fmv.w.x
+};
+
+enum class FpFormat : Register {
+    kSingle = 0b00,
+    kDouble = 0b01,
+};
+
 enum class SystemInstructionSpecial : Register {
     // imm
     kScall  = 0b0000'0000'0000,
@@ -175,6 +326,15 @@ enum class InstrType {
     BType  = 4,
     UType  = 5,
     JType  = 6,
+    Fused  = 7, // pair of instructions fused by block builder
+    VType  = 8, // vector instruction
+    FType  = 9, // floating point instruction
+};
+
+enum class VectorOperand : uint8_t {
+    kVector = 0, // .vv, .vs, .mm
+    kScalar = 1, // .vx, rs1 is x register
+    kImm    = 2, // .vi
 };
 
 enum class InstructionMnemonic {
@@ -221,6 +381,158 @@ enum class InstructionMnemonic {
     kScall      = 40,
     kSbreak     = 41,
     /// FIXME
+
+    // superinstructions, produced only by block builder:
+    kFusedLuiAddi = 42, // lui rd, hi;    addi rd, rd, lo
+    kFusedAuipcJalr = 43, // auipc rt, hi;  jalr rd, lo(rt)
+    kFusedAuipcLw = 44, // auipc rt, hi;  lw rd, lo(rt)
+    kFusedSltBne = 45, // slt rt, a, b;  bne rt, x0, offset
+    kFusedSltuBne = 46, // sltu rt, a, b; bne rt, x0, offset
+
+    // entry of guest routine emulated by host, i_type.imm is HleRoutine
+    kHleCall        = 47,
+
+    // vector subset (Zve32x), operand form is in v_type.operand
+    kVsetvli    = 48,
+    kVsetivli   = 49,
+    kVsetvl     = 50,
+    kVle8       = 51,
+    kVle16      = 52,
+    kVle32      = 53,
+    kVlse8      = 54,
+    kVlse16     = 55,
+    kVlse32     = 56,
+    kVse8       = 57,
+    kVse16      = 58,
+    kVse32      = 59,
+    kVsse8      = 60,
+    kVsse16     = 61,
+    kVsse32     = 62,
+    kVadd       = 63,
+    kVsub       = 64,
+    kVrsub      = 65,
+    kVminu      = 66,
+    kVmin       = 67,
+    kVmaxu      = 68,
+    kVmax       = 69,
+    kVand       = 70,
+    kVor        = 71,
+    kVxor       = 72,
+    kVsll       = 73,
+    kVsrl       = 74,
+    kVsra       = 75,
+    kVmul       = 76,
+    kVmv_v      = 77, // vmv.v.v/x/i
+    kVmerge     = 78,
+    kVmseq      = 79,
+    kVmsne      = 80,
+    kVmsltu     = 81,
+    kVmslt      = 82,
+    kVmsleu     = 83,
+    kVmsle      = 84,
+    kVmsgtu     = 85,
+    kVmsgt      = 86,
+    kVredsum    = 87,
+    kVredand    = 88,
+    kVredor     = 89,
+    kVredxor    = 90,
+    kVredminu   = 91,
+    kVredmin    = 92,
+    kVredmaxu   = 93,
+    kVredmax    = 94,
+    kVmandn     = 95,
+    kVmand      = 96,
+    kVmor       = 97,
+    kVmxor      = 98,
+    kVmorn      = 99,
+    kVmnand     = 100,
+    kVmnor      = 101,
+    kVmxnor     = 102,
+    kVcpop      = 103,
+    kVfirst     = 104,
+    kVmv_x_s    = 105,
+    kVmv_s_x    = 106,
+    kVid        = 107,
+
+    // F extension, single precision values are nan-boxed in 64 bit registers
+    kFlw        = 108,
+    kFsw        = 109,
+    kFmadd_s    = 110,
+    kFmsub_s    = 111,
+    kFnmsub_s   = 112,
+    kFnmadd_s   = 113,
+    kFadd_s     = 114,
+    kFsub_s     = 115,
+    kFmul_s     = 116,
+    kFdiv_s     = 117,
+    kFsqrt_s    = 118,
+    kFsgnj_s    = 119,
+    kFsgnjn_s   = 120,
+    kFsgnjx_s   = 121,
+    kFmin_s     = 122,
+    kFmax_s     = 123,
+    kFcvt_w_s   = 124,
+    kFcvt_wu_s  = 125,
+    kFmv_x_w    = 126,
+    kFeq_s      = 127,
+    kFlt_s      = 128,
+    kFle_s      = 129,
+    kFclass_s   = 130,
+    kFcvt_s_w   = 131,
+    kFcvt_s_wu  = 132,
+    kFmv_w_x    = 133,
+
+    // D extension
+    kFld        = 134,
+    kFsd        = 135,
+    kFmadd_d    = 136,
+    kFmsub_d    = 137,
+    kFnmsub_d   = 138,
+    kFnmadd_d   = 139,
+    kFadd_d     = 140,
+    kFsub_d     = 141,
+    kFmul_d     = 142,
+    kFdiv_d     = 143,
+    kFsqrt_d    = 144,
+    kFsgnj_d    = 145,
+    kFsgnjn_d   = 146,
+    kFsgnjx_d   = 147,
+    kFmin_d     = 148,
+    kFmax_d     = 149,
+    kFcvt_s_d   = 150,
+    kFcvt_d_s   = 151,
+    kFeq_d      = 152,
+    kFlt_d      = 153,
+    kFle_d      = 154,
+    kFclass_d   = 155,
+    kFcvt_w_d   = 156,
+    kFcvt_wu_d  = 157,
+    kFcvt_d_w   = 158,
+    kFcvt_d_wu  = 159,
+
+    // Zicsr, i_type.imm is csr number, rs1 is uimm5 of immediate forms
+    kCsrrw      = 160,
+    kCsrrs      = 161,
+    kCsrrc      = 162,
+    kCsrrwi     = 163,
+    kCsrrsi     = 164,
+    kCsrrci     = 165,
+
+    // rv64i, word instructions sign extend 32 bit results
+    kLwu        = 166,
+    kLd         = 167,
+    kSd         = 168,
+    kAddiw      = 169,
+    kSlliw      = 170,
+    kSrliw      = 171,
+    kSraiw      = 172,
+    kAddw       = 173,
+    kSubw       = 174,
+    kSllw       = 175,
+    kSrlw       = 176,
+    kSraw       = 177,
+
+    kNMnemonics, // number of mnemonics, keep last
 };
 
 struct DecodedInstr {
@@ -268,6 +580,38 @@ struct DecodedInstr {
             Register imm;
             size_t imm_size_bit;
         } j_type;
+
+        // immediates are already sign extended
+        struct {
+            Register rd;   // destination of first instruction
+            Register rd2;  // destination of second instruction
+            Register rs1;
+            Register rs2;
+            Register imm;  // immediate of first instruction
+            Register imm2; // immediate of second instruction
+        } fused;
+
+        // rd of vset*, vmv.x.s, vcpop.m, vfirst.m is x register in vd,
+        // rs1 of memory and vset* instructions is x register
+        struct {
+            Register vd;   // vs3 of stores
+            Register rs1;  // vs1, x register or uimm5 of vsetivli
+            Register vs2;  // x register of strided access and vsetvl
+            Register imm;  // sign extended simm5, vtypei of vset*
+            VectorOperand operand;
+            bool is_masked; // under v0.t
+        } v_type;
+
+        // rd, rs1 are x registers of moves, compares and conversions to/from
+        // integer, rs1 of loads and stores is always x register
+        struct {
+            Register rd;
+            Register rs1;
+            Register rs2;
+            Register rs3;
+            Register imm; // sign extended offset of loads and stores
+            Register rm;  // rounding mode or funct3
+        } f_type;
     } instr;
 };
 
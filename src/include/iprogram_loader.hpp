@@ -18,12 +18,24 @@ struct LoadingSection {
     size_t start_addr;
     size_t end_addr;
     uint8_t* data;
+    bool is_readable;
+    bool is_writable;
+    bool is_executable;
+};
+
+struct Symbol {
+    std::string name;
+    size_t addr;
+    size_t size;
+    bool is_function;
 };
 
 class IProgramLoader {
   protected:
     std::vector<LoadingSection> lsections;
+    std::vector<Symbol> symbols;
     size_t program_entry_point_;
+    size_t xlen_;
   public:
     virtual PloaderError Init(const std::string& program_path) = 0;
     virtual ~IProgramLoader() = default;
@@ -32,8 +44,14 @@ class IProgramLoader {
     virtual size_t GetSizeIndex(size_t index) const = 0;
     virtual size_t GetStartAddrIndex(size_t index) const = 0;
     virtual size_t GetEndAddrIndex(size_t index) const = 0;
+    virtual bool GetIsReadableIndex(size_t index) const = 0;
+    virtual bool GetIsWritableIndex(size_t index) const = 0;
+    virtual bool GetIsExecutableIndex(size_t index) const = 0;
     virtual size_t GetEntryPoint() const = 0;
+    // 32 or 64, integer register width of the target
+    virtual size_t GetXlen() const = 0;
     virtual size_t GetNLSections() const = 0;
+    virtual const std::vector<Symbol>& GetSymbols() const = 0;
 };
 
 const char* PloaderErrorToStr(PloaderError err);
@@ -0,0 +1,95 @@
+#ifndef LOCKSTEP_HPP_
+#define LOCKSTEP_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "block_cache.hpp"
+#include "block_ir.hpp"
+#include "cpu_defs.hpp"
+#include "hle.hpp"
+#include "iio_backend.hpp"
+#include "instructions.hpp"
+#include "iprogram_loader.hpp"
+#include "memory.hpp"
+#include "sim_cfg.hpp"
+#include "syscall_handler.hpp"
+#include "timer.hpp"
+#include "uart.hpp"
+
+namespace sim {
+
+static const size_t kMaxLanes = 16;
+
+using LaneMask = uint32_t; // bit per lane
+
+struct LockstepStats {
+    uint64_t n_issued_blocks;
+    uint64_t n_issued_instrs; // guest instructions of issued blocks
+    uint64_t n_lane_instrs;   // retired by all lanes
+    uint64_t n_divergences;   // control transfers that split active lanes
+};
+
+// SIMT style execution of up to kMaxLanes instances of one rv32i program, each
+// with its own memory, devices and syscall state. Register files are laid out as
+// structure of arrays, so alu op of decoded block runs as host simd instruction
+// over all lanes. Lanes at the lowest pc are issued together, the others are
+// masked off until they reach it again, which reconverges structured control flow.
+// Issued block stops where the nearest waiting lane is, so blocks are not
+// optimized: their ops have to match guest instructions one to one.
+// Code is decoded from memory of the first lane.
+class LockstepEngine {
+  private:
+    size_t n_lanes_;
+    Register first_hart_;
+    LaneMask live_lanes_;
+
+    alignas(64) Register registers_[kNumberOfRegisters][kMaxLanes];
+    alignas(64) Register pcs_[kMaxLanes];
+    alignas(64) Register imm_lanes_[kMaxLanes]; // immediate of op broadcast to lanes
+    uint64_t n_retired_[kMaxLanes];
+
+    std::vector<Memory> memories_; // memory map is the same as of single instance
+    std::vector<Uart> uarts_;
+    std::vector<Timer> timers_;    // time of a lane is its retired instruction count
+    std::vector<SyscallHandler> syscall_handlers_;
+    HleLayer hle_; // nothing is hooked, lanes run guest routines
+    BlockCache block_cache_;
+    LockstepStats stats_;
+
+    void SetRegister(const size_t register_id, const size_t lane, const Register value) {
+        if (register_id != RegisterAliases::kMachineZero) {
+            registers_[register_id][lane] = value;
+        }
+    }
+
+    // lanes at the lowest pc, join_pc is the next pc other lanes wait at
+    LaneMask SelectLanes(Address* pc, Address* join_pc) const;
+
+    // instructions from join_pc on are left to the joined lanes
+    void ExecuteBlock(const DecodedBlock& block, const LaneMask active, const Address join_pc);
+    void ExecuteOp(const IrOp& op, const Address block_start_pc, const LaneMask active);
+    void ExecuteMemoryOp(const IrOp& op, const LaneMask active);
+    // sets pc of active lanes
+    void ExecuteGuest(const IrOp& op, const Address block_start_pc, const LaneMask active);
+    InstructionError ExecuteCsr(const DecodedInstr& dec_instr, const uint64_t n_retired, const size_t lane);
+    void HandleSyscall(const size_t lane);
+    void RetireInstrs(const LaneMask active, const size_t n_instrs);
+  public:
+    void Init(const ploader::IProgramLoader& ploader, const size_t n_lanes, const Register first_hart,
+              IIoBackend* io_backend);
+    ~LockstepEngine() = default;
+
+    void Run();
+
+    // first non zero exit status of lanes
+    int GetExitCode() const;
+    bool GetIsNondeterministic() const;
+    void Report(FILE* report_file) const;
+};
+
+} // namespace sim
+
+#endif // LOCKSTEP_HPP_
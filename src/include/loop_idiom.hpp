@@ -0,0 +1,88 @@
+#ifndef LOOP_IDIOM_HPP_
+#define LOOP_IDIOM_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu_defs.hpp"
+#include "imemory.hpp"
+#include "instructions.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+enum class LoopIdiomKind : uint8_t {
+    kNone    = 0,
+    kCopy    = 1, // load, store of loaded value
+    kFill    = 2, // store of loop invariant value
+    kCompare = 3, // two loads, exit on mismatch
+};
+
+enum class LoopControl : uint8_t {
+    kNotEqual,     // bne control, bound
+    kLessUnsigned, // bltu control, bound
+};
+
+struct LoopIncrement {
+    uint8_t reg;
+    Register step;
+    bool is_before_exit; // taken before mismatch exit of compare loop
+};
+
+struct LoopAccess {
+    uint8_t base;    // incremented pointer
+    uint8_t reg;     // loaded or stored register
+    Register offset; // from base value at loop entry to the first accessed element
+};
+
+static const size_t kMaxLoopIncrements = 4;
+
+// Guest loop of one block (copy, fill) or of two blocks (compare, the first one
+// ends with exit on mismatch), which is run as a single host operation.
+struct LoopIdiom {
+    LoopIdiomKind kind;
+    uint8_t width;  // bytes per element
+    bool is_signed; // loads sign extend
+    Register step;  // of accessed pointers, +-width
+
+    LoopAccess lhs; // load of copy and compare
+    LoopAccess rhs; // store of copy and fill, second load of compare
+
+    size_t n_increments;
+    std::array<LoopIncrement, kMaxLoopIncrements> increments;
+
+    LoopControl control;
+    uint8_t control_reg; // incremented register tested by loop branch
+    uint8_t bound_reg;   // loop invariant
+
+    size_t n_body_instrs;
+    size_t n_head_instrs; // up to and including mismatch exit
+    Address start_pc;
+    Address end_pc;       // after loop branch
+    Address mismatch_pc;
+};
+
+struct LoopIdiomStats {
+    uint64_t n_recognized;
+    uint64_t n_runs;
+    uint64_t n_fallbacks; // runs left to guest instructions
+    uint64_t n_iterations;
+};
+
+// Matches body of loop started at start_pc. Head is block at start_pc, tail is
+// the block following it, only compare loops use tail.
+bool RecognizeLoopIdiom(const std::vector<DecodedInstr>& head, const std::vector<DecodedInstr>& tail,
+                        Address start_pc, LoopIdiom* idiom);
+
+// Runs all iterations of the loop with final state of guest execution.
+// Returns number of retired guest instructions, 0 if iteration count or
+// accessed memory (overlap, own code, bounds) requires guest execution.
+uint64_t RunLoopIdiom(const LoopIdiom& idiom, Cpu* cpu, IMemory* memory, LoopIdiomStats* stats);
+
+const char* LoopIdiomKindToStr(LoopIdiomKind kind);
+
+} // namespace sim
+
+#endif // LOOP_IDIOM_HPP_
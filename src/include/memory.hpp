@@ -1,30 +1,119 @@
 #ifndef MEMORY_HPP_
 #define MEMORY_HPP_
 
+#include <algorithm>
+#include <array>
 #include <cstdint>
 #include <cstddef>
+#include <utility>
+#include <vector>
 
 #include "imemory.hpp"
+#include "imemory_observer.hpp"
+#include "immio_device.hpp"
+#include "iprogram_loader.hpp"
 
 namespace sim {
 
+enum class MemoryMapError {
+    kOk          = 0,
+    kBadRegion   = 1,
+    kOutOfMemory = 2,
+    kOverlap     = 3,
+};
+
+enum class MemoryRegionKind {
+    kRam  = 0,
+    kRom  = 1,
+    kMmio = 2,
+};
+
+enum MemoryPermission : uint8_t {
+    kPermRead  = 1u << 0,
+    kPermWrite = 1u << 1,
+    kPermExec  = 1u << 2,
+};
+
+struct MemoryRegion {
+    MemAddress start;
+    size_t size;
+    MemoryRegionKind kind;
+    uint8_t permissions;  // MemoryPermission flags
+    IMmioDevice* device;  // mmio only
+};
+
+// Guest address space as a map of regions. Ram and rom are backed by a flat
+// host array at address 0, mmio regions forward accesses to devices. A
+// direct mapped tlb of pages that lie in a single ram or rom region lets
+// such accesses go to the host page after a tag compare; pages split between
+// regions, mmio and faults take the slow path through the map. Faulting
+// reads return 0 and faulting writes are dropped, as core has no traps.
 class Memory : public IMemory {
   private:
+    static const size_t kTlbPageBits = 12;
+    static const size_t kTlbPageSize = size_t{1} << kTlbPageBits;
+    static const size_t kTlbEntries = 64;
+    static constexpr MemAddress kNoPage = UINT32_MAX;
+
+    struct TlbEntry {
+        MemAddress read_page;  // kNoPage if page can not be read through entry
+        MemAddress write_page;
+        MemAddress exec_page;
+        uint8_t* host_page;
+    };
+
     uint8_t* memory_;
     size_t memory_size_;
-  public:
-    void Init(size_t memory_size) override {
-        memory_size_ = memory_size;
-        memory_ = new uint8_t[memory_size_]{};
+
+    std::vector<MemoryRegion> regions_; // ordered by start, not overlapping
+    mutable std::array<TlbEntry, kTlbEntries> tlb_;
+    mutable uint64_t n_faults_;
+
+    IMemoryObserver* observer_;
+
+    std::vector<uint8_t> is_code_page_;
+    std::vector<size_t> written_code_pages_;
+
+    void TrackCodeWrite(const MemAddress address, const size_t size) {
+        size_t last_page = std::min((address + size - 1) >> kCodePageBits, is_code_page_.size() - 1);
+        for (size_t page = address >> kCodePageBits; page <= last_page; page++) {
+            if (is_code_page_[page]) {
+                is_code_page_[page] = false;
+                written_code_pages_.push_back(page);
+            }
+        }
     }
+
+    // region holding whole [address, address + size), nullptr if there is none
+    const MemoryRegion* FindRegion(const MemAddress address, const size_t size) const;
+    void FillTlb(const MemAddress page, const MemoryRegion& region) const;
+    void FlushTlb();
+    void Fault(const MemAddress address, const size_t size, const char* access) const;
+
+    template <typename T>
+    T Load(const MemAddress address) const;
+    template <typename T>
+    void Store(const T data, const MemAddress address);
+    uint64_t LoadSlow(const MemAddress address, const size_t size) const;
+    void StoreSlow(const uint64_t data, const MemAddress address, const size_t size);
+  public:
+    // whole memory is a single ram region with all permissions
+    void Init(size_t memory_size) override;
     ~Memory() override { delete[] memory_; };
 
     void Dump(size_t start_addr, size_t end_addr) const override;
 
+    uint64_t ReadFromMemory64b(const MemAddress address) const override;
     uint32_t ReadFromMemory32b(const MemAddress address) const override;
     uint16_t ReadFromMemory16b(const MemAddress address) const override;
     uint8_t  ReadFromMemory8b (const MemAddress address) const override;
 
+    uint32_t FetchInstr32b(const MemAddress address) const override;
+    bool IsExecutable(const MemAddress address, const size_t size) const override;
+    bool IsReadable(const MemAddress address, const size_t size) const override;
+    bool IsWritable(const MemAddress address, const size_t size) const override;
+
+    void WriteToMemory64b(const uint64_t data, const MemAddress address) override;
     void WriteToMemory32b(const uint32_t data, const MemAddress address) override;
     void WriteToMemory16b(const uint16_t data, const MemAddress address) override;
     void WriteToMemory8b (const uint8_t data, const MemAddress address) override;
@@ -33,8 +122,38 @@ class Memory : public IMemory {
 
     size_t GetMemorySize() const override;
     uint8_t* GetData() override;
+    uint8_t* GetHostRange(const MemAddress address, const size_t size) override;
+    void NotifyHostWrite(const MemAddress address, const size_t size) override;
+
+    void MarkCode(const MemAddress address, const size_t size) override;
+    bool HasWrittenCode() const override {
+        return !written_code_pages_.empty();
+    }
+    void TakeWrittenCodePages(std::vector<size_t>* pages) override;
+    // byte per page of 1 << kCodePageBits, non zero if page holds decoded code
+    const uint8_t* GetCodePages() const {
+        return is_code_page_.data();
+    }
+
+    void SetObserver(IMemoryObserver* observer) override;
+
+    // ram and rom regions are carved out of those they overlap and must lie
+    // in host memory, mmio regions must not overlap anything
+    MemoryMapError AddRegion(const MemoryRegion& region);
+    const std::vector<MemoryRegion>& GetRegions() const;
+    // MemoryPermission flags of ram or rom region holding whole range, 0 if there is none
+    uint8_t GetPermissions(const MemAddress address, const size_t size) const;
+    uint64_t GetNFaults() const;
 };
 
+// regions of program segments and mmio devices at their bases, shared by
+// simulator and lockstep lanes so that they see the same memory map
+void MapProgramRegions(const ploader::IProgramLoader& ploader,
+                       const std::vector<std::pair<MemAddress, IMmioDevice*>>& devices, Memory* memory);
+
+const char* MemoryMapErrorToStr(MemoryMapError error);
+const char* MemoryRegionKindToStr(MemoryRegionKind kind);
+
 } // namespace sim
 
 
@@ -0,0 +1,107 @@
+#ifndef MEMORY_PROFILE_HPP_
+#define MEMORY_PROFILE_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <unordered_map>
+#include <vector>
+
+#include "imemory.hpp"
+#include "imemory_observer.hpp"
+
+namespace sim {
+
+// LRU stack distances of data accesses at cache line granularity. Distance
+// of an access is the number of distinct lines touched since the previous
+// access to its line; it is found in O(log n) with a Fenwick tree that marks
+// the last access time of every line. Times are renumbered when the tree is
+// full, so it holds twice the number of distinct lines at most.
+class StackDistanceProfile {
+  public:
+    // bucket 0 is distance 0, bucket k > 0 is [2^(k-1), 2^k)
+    static const size_t kNBuckets = 34;
+  private:
+    static const size_t kInitialCapacity = 1 << 16;
+
+    std::vector<uint32_t> tree_;                          // 1-based fenwick tree over times
+    std::unordered_map<uint64_t, uint32_t> last_access_;  // line to time of last access
+    uint32_t clock_;
+
+    std::array<uint64_t, kNBuckets> histogram_;
+    uint64_t n_accesses_;
+    uint64_t n_cold_accesses_;
+
+    void Add(uint32_t time, int32_t delta);
+    // marks at times below time
+    uint32_t Sum(uint32_t time) const;
+    void Compact();
+  public:
+    void Init();
+    ~StackDistanceProfile() = default;
+
+    void Access(const uint64_t line);
+
+    const std::array<uint64_t, kNBuckets>& GetHistogram() const;
+    uint64_t GetNAccesses() const;
+    // first accesses to lines, their distance is infinite
+    uint64_t GetNColdAccesses() const;
+    uint64_t GetNLines() const;
+    // of fully associative lru cache with n_lines lines, power of two
+    uint64_t GetNMisses(const uint64_t n_lines) const;
+};
+
+// Stack distance histogram of data accesses and per page heat map of fetches
+// and data accesses over time. Time is measured in fetched instructions and
+// split into epochs; when there are too many of them, neighbours are merged
+// and epochs become twice as long. Accesses are passed on to the next
+// observer.
+class MemoryProfiler : public IMemoryObserver {
+  private:
+    static const size_t kPageShift = 12;
+    static const size_t kInitialEpochLength = 1 << 16;
+    static const size_t kMaxEpochs = 256;
+    static constexpr MemAddress kNoPage = UINT32_MAX;
+
+    struct PageHeat {
+        MemAddress page;
+        std::vector<uint64_t> fetches; // [epoch]
+        std::vector<uint64_t> data;    // [epoch]
+    };
+
+    IMemoryObserver* next_; // nullptr if nobody else observes memory
+
+    size_t line_shift_;
+    StackDistanceProfile stack_distances_;
+
+    std::unordered_map<MemAddress, size_t> page_rows_; // page to index in pages_
+    std::vector<PageHeat> pages_;
+    // fetches stay on a page for long, so its row is kept at hand
+    MemAddress fetch_page_;
+    size_t fetch_row_;
+
+    size_t epoch_;
+    uint64_t epoch_length_;
+    uint64_t epoch_fetches_;
+    uint64_t n_fetches_;
+
+    // row of page in pages_, added if page was not accessed before
+    size_t GetPageRow(const MemAddress page);
+    void AccessData(const MemAddress address, const size_t size);
+    void MergeEpochs();
+  public:
+    void Init(const size_t line_size, IMemoryObserver* next);
+    ~MemoryProfiler() override = default;
+
+    void OnFetch(const MemAddress pc) override;
+    void OnRead (const MemAddress address, const size_t size) override;
+    void OnWrite(const MemAddress address, const size_t size) override;
+
+    // json object with histogram, lru misses of power of two sizes and heat map
+    void Report(FILE* report_file) const;
+};
+
+} // namespace sim
+
+#endif // MEMORY_PROFILE_HPP_
@@ -0,0 +1,137 @@
+#ifndef MEMORY_TRACE_HPP_
+#define MEMORY_TRACE_HPP_
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "imemory.hpp"
+#include "imemory_observer.hpp"
+
+namespace sim {
+
+enum class MemoryTraceError {
+    kOk          = 0,
+    kNoFile      = 1,
+    kIoError     = 2,
+    kCorrupted   = 3,
+    kBadChunk    = 4,
+};
+
+enum class MemoryAccessType : uint8_t {
+    kFetch = 0,
+    kRead  = 1,
+    kWrite = 2,
+
+    kNAccessTypes,
+};
+
+static const size_t kNAccessTypes = static_cast<size_t>(MemoryAccessType::kNAccessTypes);
+
+struct MemoryAccess {
+    MemAddress address;
+    MemAddress pc;   // of instruction making the access, address itself for fetches
+    uint8_t size;
+    MemoryAccessType type;
+};
+
+// Writes every guest fetch, load and store to a trace file. Records are
+// delta encoded per access type into chunks that are decoded independently;
+// full chunks are compressed and written by a background thread, the guest
+// waits only when several chunks are queued. Accesses are passed on to the
+// next observer, so the trace can be recorded along with the cache model.
+class MemoryTraceWriter : public IMemoryObserver {
+  private:
+    static const size_t kChunkRecords = 1 << 18;
+    static const size_t kMaxQueuedChunks = 4;
+
+    struct Chunk {
+        std::vector<uint8_t> data; // encoded records
+        uint32_t n_records;
+        uint64_t first_record;
+        MemAddress base_pc;        // pc of the last fetch before chunk
+    };
+
+    FILE* trace_file_ = nullptr;
+    IMemoryObserver* next_; // nullptr if nobody else observes memory
+
+    Chunk chunk_;
+    MemAddress last_addresses_[kNAccessTypes];
+    size_t last_sizes_[kNAccessTypes];
+    MemAddress last_pc_;
+    uint64_t n_records_;
+    MemoryAccess first_access_; // as reader decodes them, to check trace
+    MemoryAccess last_access_;
+
+    // shared with compressor thread
+    std::thread compressor_;
+    std::mutex mutex_;
+    std::condition_variable queue_cv_;
+    std::deque<Chunk> queue_;
+    bool is_finished_;
+    bool is_write_failed_;
+    uint64_t n_written_bytes_;
+
+    void Append(const MemoryAccessType type, const MemAddress address, const size_t size);
+    void StartChunk();
+    void SubmitChunk();
+    void CompressChunks();
+  public:
+    MemoryTraceError Init(const std::string& path, IMemoryObserver* next);
+    ~MemoryTraceWriter() override;
+
+    void OnFetch(const MemAddress pc) override;
+    void OnRead (const MemAddress address, const size_t size) override;
+    void OnWrite(const MemAddress address, const size_t size) override;
+
+    // writes the rest of records and waits for compressor thread
+    MemoryTraceError Finish();
+
+    uint64_t GetNRecords() const;
+    const MemoryAccess& GetFirstAccess() const;
+    const MemoryAccess& GetLastAccess() const;
+};
+
+// Mapped trace file. Chunks are found when file is opened and decoded on
+// request, different chunks may be decoded by several threads at once.
+class MemoryTraceReader {
+  private:
+    struct ChunkEntry {
+        size_t offset; // of chunk payload in file
+        uint32_t n_records;
+        uint32_t raw_size;
+        uint32_t compressed_size;
+        uint64_t first_record;
+        MemAddress base_pc;
+    };
+
+    const uint8_t* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    std::vector<ChunkEntry> chunks_;
+    uint64_t n_records_;
+  public:
+    // chunks of a truncated trace are read up to the first incomplete one
+    MemoryTraceError Open(const std::string& path);
+    ~MemoryTraceReader();
+
+    size_t GetNChunks() const;
+    uint64_t GetNRecords() const;
+    // index of the first record of chunk in the whole trace
+    uint64_t GetChunkFirstRecord(const size_t chunk_i) const;
+
+    // replaces contents of accesses with records of chunk
+    MemoryTraceError ReadChunk(const size_t chunk_i, std::vector<MemoryAccess>* accesses) const;
+};
+
+const char* MemoryTraceErrorToStr(MemoryTraceError error);
+const char* MemoryAccessTypeToStr(MemoryAccessType type);
+
+} // namespace sim
+
+#endif // MEMORY_TRACE_HPP_
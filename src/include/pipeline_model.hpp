@@ -0,0 +1,105 @@
+#ifndef PIPELINE_MODEL_HPP_
+#define PIPELINE_MODEL_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+#include "instructions.hpp"
+#include "cpu_defs.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+enum class PredictorKind {
+    kStatic  = 0, // backward taken, forward not taken
+    kBimodal = 1, // table of 2-bit counters indexed by pc
+    kGshare  = 2, // table of 2-bit counters indexed by pc xor global history
+};
+
+struct TimingConfig {
+    PredictorKind predictor = PredictorKind::kBimodal;
+    size_t predictor_entries = 4096;
+    size_t return_stack_entries = 8;
+    size_t mispredict_penalty = 2; // branches are resolved in ex
+
+    // cycles from issue of instruction until its result can be forwarded
+    std::array<uint8_t, static_cast<size_t>(InstructionMnemonic::kNMnemonics)> latencies = MakeDefaultLatencies();
+
+    static constexpr std::array<uint8_t, static_cast<size_t>(InstructionMnemonic::kNMnemonics)> MakeDefaultLatencies() {
+        std::array<uint8_t, static_cast<size_t>(InstructionMnemonic::kNMnemonics)> latencies = {};
+        latencies.fill(1);
+
+        // loaded value is available after mem, so the next instruction has to wait one cycle
+        latencies[static_cast<size_t>(InstructionMnemonic::kLb)]  = 2;
+        latencies[static_cast<size_t>(InstructionMnemonic::kLh)]  = 2;
+        latencies[static_cast<size_t>(InstructionMnemonic::kLw)]  = 2;
+        latencies[static_cast<size_t>(InstructionMnemonic::kLbu)] = 2;
+        latencies[static_cast<size_t>(InstructionMnemonic::kLhu)] = 2;
+        latencies[static_cast<size_t>(InstructionMnemonic::kLwu)] = 2;
+        latencies[static_cast<size_t>(InstructionMnemonic::kLd)]  = 2;
+
+        return latencies;
+    }
+};
+
+class BranchPredictor {
+  private:
+    PredictorKind kind_;
+    std::vector<uint8_t> counters_;
+    uint64_t index_mask_;
+    uint64_t global_history_;
+
+    size_t GetIndex(const Address pc) const;
+  public:
+    void Init(PredictorKind kind, size_t n_entries);
+    ~BranchPredictor() = default;
+
+    bool Predict(const Address pc, const bool is_backward) const;
+    void Update(const Address pc, const bool is_taken);
+};
+
+// Cycle approximate model of classic 5-stage in-order pipeline (if id ex mem wb)
+// with full forwarding. Every retired instruction is passed to the model, 
+// which tracks when its operands are ready and what the branch predictor 
+// would have fetched next.
+class PipelineModel {
+  private:
+    static const size_t kPipelineDepth = 5;
+
+    TimingConfig config_;
+    BranchPredictor predictor_;
+    std::vector<Address> return_stack_;
+    std::vector<Address> indirect_targets_; // last target of jalr, returns use return stack
+
+    uint64_t ready_cycle_[kNumberOfRegisters];
+    uint64_t issue_cycle_;
+    uint64_t next_issue_cycle_;
+
+    uint64_t n_instructions_;
+    uint64_t n_data_stalls_;
+    uint64_t n_branches_;
+    uint64_t n_branch_mispredicts_;
+    uint64_t n_indirect_jumps_;
+    uint64_t n_indirect_mispredicts_;
+
+    void PredictControlFlow(const Address pc, const DecodedInstr& instr, const Address next_pc);
+  public:
+    void Init(const TimingConfig& config);
+    ~PipelineModel() = default;
+
+    void OnInstr(const Address pc, const DecodedInstr& instr, const Address next_pc);
+
+    uint64_t GetCycles() const;
+    uint64_t GetInstructions() const;
+
+    void Report(FILE* report_file) const;
+};
+
+const char* PredictorKindToStr(PredictorKind kind);
+
+} // namespace sim
+
+#endif // PIPELINE_MODEL_HPP_
@@ -0,0 +1,59 @@
+#ifndef PREDECODE_CACHE_HPP_
+#define PREDECODE_CACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+
+#include "block_cache.hpp"
+#include "result_cache.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+enum class PredecodeError {
+    kOk        = 0,
+    kNoFile    = 1,
+    kStale     = 2, // built for other program, options or simulator
+    kIoError   = 3,
+    kCorrupted = 4,
+};
+
+// Decoded blocks of a program saved between runs. File is mapped and
+// blocks are copied out of it only when execution reaches them, so start-up
+// does not depend on program size. Key covers everything decoding depends on;
+// code bytes are kept with every block and compared with memory on load.
+class PredecodeCache {
+  private:
+    struct IndexEntry {
+        Address start_pc;
+        uint32_t offset; // of block record in file
+    };
+
+    const uint8_t* mapping_ = nullptr;
+    size_t mapping_size_ = 0;
+    const IndexEntry* index_;
+    size_t n_blocks_;
+
+    const uint8_t* FindRecord(const Address start_pc) const;
+  public:
+    PredecodeError Init(const std::string& path, const ResultKey& key);
+    ~PredecodeCache();
+
+    // false if block was not saved
+    bool LoadBlock(const Address start_pc, DecodedBlock* block) const;
+
+    // saves blocks together with not loaded ones of mapped file, which are
+    // dropped if any of them is corrupted
+    PredecodeError Save(const std::string& path, const ResultKey& key,
+                        const std::unordered_map<Address, DecodedBlock>& blocks) const;
+
+    size_t GetNBlocks() const;
+};
+
+const char* PredecodeErrorToStr(PredecodeError error);
+
+} // namespace sim
+
+#endif // PREDECODE_CACHE_HPP_
@@ -0,0 +1,43 @@
+#ifndef RECORDING_IO_BACKEND_HPP_
+#define RECORDING_IO_BACKEND_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "iio_backend.hpp"
+
+namespace sim {
+
+// Wraps backend of a run whose result is cached: whole host stdin is read
+// in advance, so it can be hashed, and guest reads of it are served from
+// memory; guest writes to stdout and stderr are recorded and passed on.
+class RecordingIoBackend : public IIoBackend {
+  private:
+    IIoBackend* io_backend_;
+
+    std::string input_;
+    size_t input_pos_;
+
+    std::string output_;
+    std::string error_output_;
+  public:
+    // returns false if stdin can't be read
+    bool Init(IIoBackend* io_backend);
+    ~RecordingIoBackend() override = default;
+
+    ssize_t Read(const int fd, uint8_t* buffer, const size_t size) override;
+    ssize_t Write(const int fd, const uint8_t* buffer, const size_t size) override;
+    off_t Seek(const int fd, const off_t offset, const int whence) override;
+
+    int Sync(const int fd) override;
+    void Flush() override;
+
+    const std::string& GetInput() const;
+    const std::string& GetOutput() const;
+    const std::string& GetErrorOutput() const;
+};
+
+} // namespace sim
+
+#endif // RECORDING_IO_BACKEND_HPP_
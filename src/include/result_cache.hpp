@@ -0,0 +1,71 @@
+#ifndef RESULT_CACHE_HPP_
+#define RESULT_CACHE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace sim {
+
+enum class ResultCacheError {
+    kOk        = 0,
+    kMiss      = 1,
+    kIoError   = 2,
+    kCorrupted = 3,
+};
+
+struct ResultKey {
+    uint64_t lo;
+    uint64_t hi;
+
+    bool operator==(const ResultKey&) const = default;
+};
+
+// Streaming 128-bit hash of everything the result depends on,
+// every update is framed by its size
+class ResultHasher {
+  private:
+    uint64_t state_[2];
+    uint64_t n_bytes_;
+  public:
+    void Init();
+    void Update(const void* data, const size_t size);
+    template <typename T>
+    void UpdateValue(const T& value) { Update(&value, sizeof(value)); }
+
+    ResultKey Finish() const;
+};
+
+// what is replayed instead of a run
+struct RunResult {
+    int exit_code;
+    uint64_t n_retired_instrs;
+    std::string output;       // guest stdout
+    std::string error_output; // guest stderr
+    std::string reports;      // statistics of simulator
+};
+
+// On-disk cache of whole run results shared by simulator processes.
+// Entries are written to temporary files and renamed into place, so readers
+// never see partial ones. Hits refresh mtime, and once total size exceeds
+// the limit the least recently used entries are removed under a lock file.
+class ResultCache {
+  private:
+    std::string dir_;
+    size_t max_size_;
+
+    std::string GetEntryPath(const ResultKey& key) const;
+    void Evict() const;
+  public:
+    ResultCacheError Init(const std::string& dir, const size_t max_size);
+    ~ResultCache() = default;
+
+    ResultCacheError Lookup(const ResultKey& key, RunResult* result) const;
+    ResultCacheError Store(const ResultKey& key, const RunResult& result) const;
+};
+
+const char* ResultCacheErrorToStr(ResultCacheError error);
+
+} // namespace sim
+
+#endif // RESULT_CACHE_HPP_
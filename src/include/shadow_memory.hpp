@@ -0,0 +1,68 @@
+#ifndef SHADOW_MEMORY_HPP_
+#define SHADOW_MEMORY_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "imemory.hpp"
+
+namespace sim {
+
+// Copy-on-write overlay of other memory: writes are buffered and visible 
+// only through the overlay until Commit(). Lets the same code run twice
+// from the same state and compare memory side effects.
+class ShadowMemory : public IMemory {
+  private:
+    IMemory* base_;
+    std::unordered_map<MemAddress, uint8_t> writes_;
+
+    uint8_t ReadByte(const MemAddress address) const;
+    void WriteByte(const uint8_t data, const MemAddress address);
+  public:
+    void Init(size_t memory_size) override;
+    ~ShadowMemory() override = default;
+
+    void SetBase(IMemory* base);
+
+    void Dump(size_t start_addr, size_t end_addr) const override;
+
+    uint64_t ReadFromMemory64b(const MemAddress address) const override;
+    uint32_t ReadFromMemory32b(const MemAddress address) const override;
+    uint16_t ReadFromMemory16b(const MemAddress address) const override;
+    uint8_t  ReadFromMemory8b (const MemAddress address) const override;
+
+    uint32_t FetchInstr32b(const MemAddress address) const override;
+    bool IsExecutable(const MemAddress address, const size_t size) const override;
+    bool IsReadable(const MemAddress address, const size_t size) const override;
+    bool IsWritable(const MemAddress address, const size_t size) const override;
+
+    void WriteToMemory64b(const uint64_t data, const MemAddress address) override;
+    void WriteToMemory32b(const uint32_t data, const MemAddress address) override;
+    void WriteToMemory16b(const uint16_t data, const MemAddress address) override;
+    void WriteToMemory8b (const uint8_t data, const MemAddress address) override;
+
+    void MapToMemory(const uint8_t* data_to_map, size_t start_addr, size_t end_addr) override;
+
+    size_t GetMemorySize() const override;
+    // raw data of base memory, buffered writes are not visible through it
+    uint8_t* GetData() override;
+    uint8_t* GetHostRange(const MemAddress address, const size_t size) override;
+    void NotifyHostWrite(const MemAddress address, const size_t size) override;
+
+    // code is tracked by base memory, it sees buffered writes on Commit()
+    void MarkCode(const MemAddress address, const size_t size) override;
+    bool HasWrittenCode() const override;
+    void TakeWrittenCodePages(std::vector<size_t>* pages) override;
+
+    void SetObserver(IMemoryObserver* observer) override;
+
+    const std::unordered_map<MemAddress, uint8_t>& GetWrites() const;
+    void Commit();
+    void Discard();
+};
+
+} // namespace sim
+
+#endif // SHADOW_MEMORY_HPP_
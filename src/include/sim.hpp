@@ -1,25 +1,127 @@
 #ifndef SIM_HPP_
 #define SIM_HPP_
 
+#include "aot_runtime.hpp"
+#include "aot_translator.hpp"
+#include "block_cache.hpp"
+#include "cache_model.hpp"
+#include "control_flow_graph.hpp"
 #include "cpu.hpp"
+#include "decode_table.hpp"
+#include "edge_profiler.hpp"
+#include "function_map.hpp"
+#include "hle.hpp"
+#include "host_perf.hpp"
+#include "lockstep.hpp"
+#include "loop_idiom.hpp"
 #include "memory.hpp"
+#include "memory_profile.hpp"
+#include "memory_trace.hpp"
+#include "pipeline_model.hpp"
+#include "predecode_cache.hpp"
+#include "recording_io_backend.hpp"
+#include "result_cache.hpp"
+#include "shadow_memory.hpp"
+#include "sync_io_backend.hpp"
+#include "syscall_handler.hpp"
+#include "timer.hpp"
+#include "uart.hpp"
+#include "uring_io_backend.hpp"
 // include jit.hpp
 #include "iprogram_loader.hpp"
 #include "sim_cfg.hpp"
+#include "sim_options.hpp"
 
 namespace sim {
 
 class Simulator {
   private:
     Cpu cpu_;
+    // rv64 guests run on it instruction by instruction
+    Cpu64 cpu64_;
+    size_t xlen_;
     Memory memory_;
+    Uart uart_;
+    Timer timer_;
+    // backends outlive syscall handler, it flushes them on destruction
+    SyncIoBackend sync_io_backend_;
+    UringIoBackend uring_io_backend_;
+    RecordingIoBackend recording_io_backend_;
+    SyscallHandler syscall_handler_;
     // jit
+
+    SimOptions options_;
+    FunctionMap function_map_;
+    HleLayer hle_;
+    DecodeTable decode_table_;
+    ControlFlowGraph cfg_;
+    EdgeProfiler edge_profiler_;
+    CacheHierarchy cache_hierarchy_;
+    MemoryTraceWriter mem_trace_writer_;
+    MemoryProfiler mem_profiler_;
+    PipelineModel pipeline_model_;
+    HostPerfCounters host_perf_;
+
+    BlockCache block_cache_;
+    uint64_t n_retired_instrs_;
+
+    PredecodeCache predecode_cache_;
+    ResultKey predecode_key_;
+    std::string predecode_path_; // empty if blocks are not saved between runs
+
+    ShadowMemory reference_memory_;
+    ShadowMemory optimized_memory_;
+    uint64_t n_checked_blocks_;
+    uint64_t n_mismatched_blocks_;
+
+    LoopIdiomStats loop_idiom_stats_;
+
+    AotRuntime aot_runtime_;
+    bool is_aot_;
+
+    LockstepEngine lockstep_engine_;
+    bool is_lockstep_;
+
+    ResultCache result_cache_;
+    ResultKey result_key_;
+    RunResult cached_result_;
+    bool is_result_cached_;
+    bool is_replayed_;
+    // statistics of run, kept in memory while result is recorded
+    FILE* report_file_;
+    char* report_buffer_;
+    size_t report_size_;
+
+    bool IsInstrumented() const;
+    bool IsResultCacheable() const;
+
+    void InitMemoryMap(const ploader::IProgramLoader& ploader, IIoBackend* io_backend);
+    void InitControlFlowGraph(const ploader::IProgramLoader& ploader);
+    void InitPredecodeCache(const ploader::IProgramLoader& ploader);
+    void SavePredecodeCache();
+    bool InitResultCache(const ploader::IProgramLoader& ploader, IIoBackend* io_backend);
+    void StoreResult();
+    void ReplayResult();
+
+    template <size_t kXlen, bool kIsTimed>
+    void RunInstructions(BasicCpu<kXlen>* cpu);
+    void RunGuest();
+    void RunBlocks();
+    void RunBlock();
+    void RunAot();
+    void ExecuteIrOps(Cpu* cpu, const std::vector<IrOp>& ops, size_t n_ops, Address end_pc);
+    void ExecuteBlockChecked(const DecodedBlock& block);
+
+    void CheckMemoryTrace();
+    void DumpReports();
+    void DumpHostPerf();
   public:
-    Simulator(const ploader::IProgramLoader& ploader);
+    Simulator(const ploader::IProgramLoader& ploader, const SimOptions& options);
     ~Simulator() = default;
 
     void Execute();
-    Register FetchInstr();
+    // guest exit status, valid after Execute()
+    int GetExitCode() const;
 };
 
 } // namespace sim
@@ -6,10 +6,32 @@
 
 namespace sim {
     const size_t kMemorySize = 0x80000;
-    
-    using Register = uint32_t;
-    using IRegister = int32_t;
-    using Address = uint32_t;
+    // sample mmio devices, at their places on qemu virt board
+    const uint32_t kTimerBase = 0x02000000;
+    const uint32_t kUartBase  = 0x10000000;
+
+    // integer register width of the base isa, the core is instantiated per width
+    template <size_t kXlen>
+    struct XlenTraits;
+
+    template <>
+    struct XlenTraits<32> {
+        using Register = uint32_t;
+        using IRegister = int32_t;
+        using Address = uint32_t;
+    };
+
+    template <>
+    struct XlenTraits<64> {
+        using Register = uint64_t;
+        using IRegister = int64_t;
+        using Address = uint64_t;
+    };
+
+    // rv32, extensions and the block engine are built for it only
+    using Register = XlenTraits<32>::Register;
+    using IRegister = XlenTraits<32>::IRegister;
+    using Address = XlenTraits<32>::Address;
 }
 
 #endif // SIM_CFG_HPP_
@@ -0,0 +1,85 @@
+#ifndef SIM_OPTIONS_HPP_
+#define SIM_OPTIONS_HPP_
+
+#include <string>
+#include <vector>
+
+#include "cache_model.hpp"
+#include "pipeline_model.hpp"
+
+namespace sim {
+
+enum class OptionsError {
+    kOk             = 0,
+    kNoExecutable   = 1,
+    kUnknownOption  = 2,
+    kBadOptionValue = 3,
+};
+
+enum class BranchProfileFormat {
+    kAutoFdo = 0, // text input of create_gcov/create_llvm_prof (--profiler=text)
+    kLlvm    = 1, // unsymbolized profile of llvm-profgen (--unsymbolized-profile)
+};
+
+enum class IoBackendKind {
+    kSync  = 0,
+    kUring = 1,
+};
+
+struct SimOptions {
+    std::string executable_path;
+
+    std::string branch_profile_path; // empty if branch profiling is disabled
+    BranchProfileFormat branch_profile_format = BranchProfileFormat::kAutoFdo;
+
+    bool is_cache_model_enabled = false;
+    CacheConfig l1i_cache = {.size = 32 * 1024,  .associativity = 8, .line_size = 64, .policy = ReplacementPolicy::kLru};
+    CacheConfig l1d_cache = {.size = 32 * 1024,  .associativity = 8, .line_size = 64, .policy = ReplacementPolicy::kLru};
+    CacheConfig l2_cache  = {.size = 256 * 1024, .associativity = 8, .line_size = 64, .policy = ReplacementPolicy::kLru};
+    std::string cache_report_path; // stderr if empty
+
+    std::string mem_trace_path; // no memory trace if empty
+    bool is_mem_trace_checked = false; // read trace back after run and compare with recorded accesses
+    std::string mem_profile_path; // no memory profile if empty, "-" for stderr
+
+    bool is_timing_enabled = false;
+    TimingConfig timing;
+    std::string timing_report_path; // stderr if empty
+
+    bool is_fusion_enabled = true;
+    std::string fusion_report_path; // no report if empty, "-" for stderr
+
+    bool is_block_opt_enabled = true;
+    bool is_block_opt_checked = false; // run every block unoptimized too and compare
+    bool is_loop_idiom_enabled = true;
+    bool is_preform_enabled = true; // build and link blocks of recovered control flow graph before run
+    std::string cfg_dump_path;      // no graphviz dump if empty
+
+    std::string host_perf_path; // no report if empty, "-" for stderr
+
+    IoBackendKind io_backend = IoBackendKind::kSync;
+
+    std::vector<std::string> hle_routines; // hooked by guest symbol names
+
+    size_t vlen = 128; // bits of vector register, 128 or 256
+
+    size_t n_lanes = 1;    // instances run in lockstep, up to kMaxLanes
+    size_t first_hart = 0; // mhartid, of the first lane in lockstep runs
+
+    bool is_predecode_cached = false;
+    std::string predecode_cache_dir; // next to executable if empty
+
+    std::string aot_module_path; // shared object built from rv2cpp output
+
+    std::string result_cache_dir; // whole runs are not cached if empty
+    size_t result_cache_size = 256 * 1024 * 1024;
+    std::string result_key_options; // options that may change result of run, part of its key
+};
+
+OptionsError ParseOptions(const int argc, const char* const argv[], SimOptions* options);
+const char* OptionsErrorToStr(OptionsError error);
+void PrintUsage(const char* program_name);
+
+} // namespace sim
+
+#endif // SIM_OPTIONS_HPP_
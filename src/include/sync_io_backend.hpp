@@ -0,0 +1,23 @@
+#ifndef SYNC_IO_BACKEND_HPP_
+#define SYNC_IO_BACKEND_HPP_
+
+#include "iio_backend.hpp"
+
+namespace sim {
+
+// every guest operation is a blocking host syscall
+class SyncIoBackend : public IIoBackend {
+  public:
+    ~SyncIoBackend() override = default;
+
+    ssize_t Read(const int fd, uint8_t* buffer, const size_t size) override;
+    ssize_t Write(const int fd, const uint8_t* buffer, const size_t size) override;
+    off_t Seek(const int fd, const off_t offset, const int whence) override;
+
+    int Sync(const int /*fd*/) override { return 0; }
+    void Flush() override {}
+};
+
+} // namespace sim
+
+#endif // SYNC_IO_BACKEND_HPP_
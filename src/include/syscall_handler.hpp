@@ -0,0 +1,81 @@
+#ifndef SYSCALL_HANDLER_HPP_
+#define SYSCALL_HANDLER_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "iio_backend.hpp"
+#include "imemory.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+static const size_t kNSyscallArgs = 6;
+using SyscallArgs = std::array<Register, kNSyscallArgs>;
+
+enum class SyscallError {
+    kOk             = 0,
+    kUnknownSyscall = 1,
+};
+
+// Newlib (libgloss/riscv) compatible subset of linux syscalls.
+// Guest buffers are validated once and passed to io backend without copying,
+// failures are returned to guest as -errno.
+class SyscallHandler {
+  private:
+    static const int kClosedFd = -1;
+    static const size_t kStackReserve = 64 * 1024; // brk never grows into it
+
+    IMemory* memory_;
+    IIoBackend* io_backend_;
+    std::vector<int> host_fds_; // indexed by guest fd
+
+    Address initial_break_;
+    Address program_break_;
+
+    bool is_exited_;
+    int exit_code_;
+    bool is_nondeterministic_; // guest has opened host files or read host time
+
+    uint64_t n_syscalls_;
+    bool is_timed_;
+    uint64_t syscall_time_ns_; // host time spent in handler if it is timed
+
+    int GetHostFd(const Register guest_fd) const;
+    Register AddGuestFd(const int host_fd);
+
+    Register Openat(const Register dir_fd, const Register path, const Register flags, const Register mode);
+    Register Close(const Register guest_fd);
+    Register Lseek(const Register guest_fd, const Register offset, const Register whence);
+    Register Read(const Register guest_fd, const Register buffer, const Register size);
+    Register Write(const Register guest_fd, const Register buffer, const Register size);
+    Register ReadvWritev(const Register guest_fd, const Register iov, const Register iov_count, const bool is_write);
+    Register Fstat(const Register guest_fd, const Register stat);
+    Register ClockGettime(const Register clock_id, const Register timespec);
+    Register Gettimeofday(const Register timeval);
+    Register Brk(const Register new_break);
+
+    SyscallError Dispatch(const Register syscall_id, const SyscallArgs& args, Register* ret_value);
+  public:
+    void Init(IMemory* memory, IIoBackend* io_backend, const Address program_end);
+    ~SyscallHandler();
+
+    // return value of syscall is stored to *ret_value
+    SyscallError Handle(const Register syscall_id, const SyscallArgs& args, Register* ret_value);
+
+    bool GetIsExited() const;
+    int GetExitCode() const;
+    bool GetIsNondeterministic() const;
+
+    void SetIsTimed(bool is_timed);
+    uint64_t GetNSyscalls() const;
+    uint64_t GetSyscallTimeNs() const;
+};
+
+const char* SyscallErrorToStr(SyscallError error);
+
+} // namespace sim
+
+#endif // SYSCALL_HANDLER_HPP_
@@ -0,0 +1,38 @@
+#ifndef TIMER_HPP_
+#define TIMER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+#include "immio_device.hpp"
+
+namespace sim {
+
+// mtime and mtimecmp of a CLINT. Time is the number of retired guest
+// instructions, so runs stay reproducible; it advances by whole blocks when
+// blocks are executed. Core has no interrupts, guests poll mtime.
+class Timer : public IMmioDevice {
+  private:
+    static const MemAddress kMtimecmpOffset = 0x4000;
+    static const MemAddress kMtimeOffset = 0xbff8;
+    static const size_t kSize = 0x10000;
+
+    const uint64_t* n_retired_instrs_;
+    uint64_t time_offset_; // written mtime minus instructions retired by then
+    uint64_t mtimecmp_;
+
+    uint64_t GetTime() const;
+  public:
+    void Init(const uint64_t* n_retired_instrs);
+    ~Timer() override = default;
+
+    const char* GetName() const override;
+    size_t GetSize() const override;
+
+    uint64_t Read(const MemAddress offset, const size_t size) override;
+    void Write(const uint64_t data, const MemAddress offset, const size_t size) override;
+};
+
+} // namespace sim
+
+#endif // TIMER_HPP_
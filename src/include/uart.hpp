@@ -0,0 +1,35 @@
+#ifndef UART_HPP_
+#define UART_HPP_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "iio_backend.hpp"
+#include "immio_device.hpp"
+
+namespace sim {
+
+// Transmit side of a 16550 with byte wide registers. Transmitted bytes go
+// to stdout of the simulator through i/o backend, so they are recorded with
+// the rest of guest output. Receiver never has data.
+class Uart : public IMmioDevice {
+  private:
+    static const size_t kNRegisters = 8;
+
+    IIoBackend* io_backend_;
+    std::array<uint8_t, kNRegisters> registers_; // as written, read back where 16550 allows it
+  public:
+    void Init(IIoBackend* io_backend);
+    ~Uart() override = default;
+
+    const char* GetName() const override;
+    size_t GetSize() const override;
+
+    uint64_t Read(const MemAddress offset, const size_t size) override;
+    void Write(const uint64_t data, const MemAddress offset, const size_t size) override;
+};
+
+} // namespace sim
+
+#endif // UART_HPP_
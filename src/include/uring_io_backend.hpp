@@ -0,0 +1,127 @@
+#ifndef URING_IO_BACKEND_HPP_
+#define URING_IO_BACKEND_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "iio_backend.hpp"
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace sim {
+
+enum class IoBackendError {
+    kOk          = 0,
+    kUnsupported = 1, // built without io_uring or kernel lacks required features
+    kSetupFailed = 2,
+};
+
+// Guest writes are copied to a batch and submitted as one linked chain
+// when batch is full or guest reaches a sync point; adjacent writes
+// to the same fd are merged. Two batches alternate, so guest runs while
+// the previous batch is written. Regular files are read ahead with
+// explicit offsets, reads complete synchronously only when buffer is empty.
+// Once the ring can not be entered, requests in it fail and later i/o is
+// done by blocking syscalls.
+class UringIoBackend : public IIoBackend {
+  private:
+    static constexpr unsigned kRingEntries = 128;
+    static constexpr size_t kNBatches = 2;
+    static constexpr size_t kBatchCapacity = 64 * 1024;
+    static constexpr size_t kMaxBatchWrites = 32;
+    static constexpr size_t kReadAheadSize = 64 * 1024;
+    static constexpr uint64_t kReadTag = 1ull << 63;
+
+    struct PendingWrite {
+        int fd;
+        size_t offset; // in batch data
+        size_t size;
+        ssize_t result;
+    };
+
+    struct WriteBatch {
+        std::vector<uint8_t> data;
+        std::vector<PendingWrite> writes;
+        size_t n_in_flight;
+    };
+
+    struct ReadAhead {
+        bool is_regular;
+        std::vector<uint8_t> buffer;
+        size_t begin;
+        size_t end;
+        off_t file_offset; // of buffer end
+        bool is_in_flight;
+        bool is_eof;
+        int error;
+    };
+
+    int ring_fd_ = -1;
+
+    void* sq_ring_;
+    size_t sq_ring_size_;
+    void* cq_ring_;
+    size_t cq_ring_size_;
+    io_uring_sqe* sqes_;
+    size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_entries_;
+    unsigned* sq_array_;
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    io_uring_cqe* cqes_;
+    unsigned n_unsubmitted_;
+    int ring_error_; // -errno io_uring_enter failed with for good, 0 while ring works
+
+    WriteBatch batches_[kNBatches];
+    size_t current_batch_;
+    std::unordered_map<int, ReadAhead> read_aheads_;
+    std::unordered_map<int, int> write_errors_; // -errno of the first failed deferred write to fd
+
+    uint64_t n_guest_reads_;
+    uint64_t n_guest_writes_;
+    uint64_t n_host_syscalls_;
+
+    io_uring_sqe* GetSqe();
+    void PushSqe();
+    void Enter(const unsigned min_complete);
+    void ReapCompletions();
+    void Complete(const uint64_t user_data, const int32_t result);
+    void FailInFlight();
+    // returns ring_error_ if ring failed before predicate became true
+    template <typename Predicate>
+    int WaitUntil(Predicate is_done);
+
+    void SubmitBatch(const size_t batch_i);
+    void WaitBatch(const size_t batch_i);
+    void FlushWrites();
+    bool HasPendingWrites(const int fd) const;
+    int TakeWriteError(const int fd);
+
+    ReadAhead& GetReadAhead(const int fd);
+    void SubmitReadAhead(const int fd, ReadAhead* read_ahead);
+    void ResetReadAhead(const int fd);
+  public:
+    IoBackendError Init();
+    ~UringIoBackend() override;
+
+    ssize_t Read(const int fd, uint8_t* buffer, const size_t size) override;
+    ssize_t Write(const int fd, const uint8_t* buffer, const size_t size) override;
+    off_t Seek(const int fd, const off_t offset, const int whence) override;
+
+    int Sync(const int fd) override;
+    void Flush() override;
+};
+
+const char* IoBackendErrorToStr(IoBackendError error);
+
+} // namespace sim
+
+#endif // URING_IO_BACKEND_HPP_
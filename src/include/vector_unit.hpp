@@ -0,0 +1,114 @@
+#ifndef VECTOR_UNIT_HPP_
+#define VECTOR_UNIT_HPP_
+
+#include <array>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+
+#include "cpu_defs.hpp"
+#include "imemory.hpp"
+#include "instructions.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+static const size_t kNVectorRegisters = 32;
+static const size_t kMinVlen = 128; // bits
+static const size_t kMaxVlen = 256;
+static const size_t kMaxVlenBytes = kMaxVlen / CHAR_BIT;
+static const size_t kMaxLmul = 8;
+static const size_t kMaxVectorElen = 32; // Zve32x, no 64 bit elements
+
+static const Register kVtypeIllegal = 1u << 31u;
+
+// RVV 1.0 integer subset. Registers of group are adjacent in the register file,
+// so group of LMUL registers is one contiguous run of LMUL * VLEN/8 bytes.
+// Arithmetic runs on the whole group with host simd kernels, results are
+// blended into destination by body mask: tail and masked off elements are
+// left undisturbed (a valid choice for agnostic policies too).
+class VectorUnit {
+  private:
+    size_t vlenb_;
+    Register vl_;
+    Register vtype_;
+    size_t sew_;  // bytes of element, 0 if vtype is illegal
+    size_t lmul_; // registers in group, 1 for fractional lmul
+    size_t vlmax_;
+
+    alignas(32) std::array<uint8_t, kNVectorRegisters * kMaxVlenBytes> registers_;
+
+    uint8_t* GetGroup(const Register reg) {
+        return registers_.data() + reg * vlenb_;
+    }
+    const uint8_t* GetGroup(const Register reg) const {
+        return registers_.data() + reg * vlenb_;
+    }
+
+    bool IsMaskSet(const size_t elem_i) const {
+        return (registers_[elem_i / CHAR_BIT] >> (elem_i % CHAR_BIT)) & 1u;
+    }
+
+    bool IsActive(const size_t elem_i, const bool is_masked) const {
+        return !is_masked || IsMaskSet(elem_i);
+    }
+
+    bool IsGroupAligned(const Register reg) const {
+        return reg % lmul_ == 0;
+    }
+
+    Register GetElement(const uint8_t* group, const size_t elem_i) const;
+    void SetElement(uint8_t* group, const size_t elem_i, const Register value) const;
+
+    void SetConfig(const Register avl, const Register vtype);
+    // writes active body elements of result to group of vd
+    void WriteBody(const Register vd, const uint8_t* result, const bool is_masked);
+
+    InstructionError ExecuteConfig(const DecodedInstr& dec_instr, Cpu* cpu);
+    InstructionError ExecuteMemory(const DecodedInstr& dec_instr, Cpu* cpu, IMemory* memory);
+    InstructionError ExecuteArithm(const DecodedInstr& dec_instr, Cpu* cpu);
+    InstructionError ExecuteCompare(const DecodedInstr& dec_instr, Cpu* cpu);
+    InstructionError ExecuteReduction(const DecodedInstr& dec_instr);
+    InstructionError ExecuteMask(const DecodedInstr& dec_instr, Cpu* cpu);
+    InstructionError ExecuteMove(const DecodedInstr& dec_instr, Cpu* cpu);
+  public:
+    void Init(const size_t vlen);
+    ~VectorUnit() = default;
+
+    size_t GetVlen() const;
+    Register GetVl() const;
+    Register GetVtype() const;
+
+    // pc is not changed, illegal vector state or operands return kUnknownInstruction
+    InstructionError Execute(const DecodedInstr& dec_instr, Cpu* cpu, IMemory* memory);
+
+    void Dump() const;
+};
+
+inline bool IsVectorMemInstr(InstructionMnemonic mnemonic) {
+    return InstructionMnemonic::kVle8 <= mnemonic && mnemonic <= InstructionMnemonic::kVsse32;
+}
+
+inline bool IsVectorStridedInstr(InstructionMnemonic mnemonic) {
+    return (InstructionMnemonic::kVlse8 <= mnemonic && mnemonic <= InstructionMnemonic::kVlse32)
+        || (InstructionMnemonic::kVsse8 <= mnemonic && mnemonic <= InstructionMnemonic::kVsse32);
+}
+
+// vd of these instructions is x register
+inline bool IsVectorScalarDest(InstructionMnemonic mnemonic) {
+    switch (mnemonic) {
+        case InstructionMnemonic::kVsetvli:
+        case InstructionMnemonic::kVsetivli:
+        case InstructionMnemonic::kVsetvl:
+        case InstructionMnemonic::kVcpop:
+        case InstructionMnemonic::kVfirst:
+        case InstructionMnemonic::kVmv_x_s:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace sim
+
+#endif // VECTOR_UNIT_HPP_
@@ -0,0 +1,166 @@
+#include "aot_runtime.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include <dlfcn.h>
+
+#include "log_helper.hpp"
+
+#include "imemory.hpp"
+
+namespace sim {
+
+static_assert(kAotCodePageBits == kCodePageBits, "translated code checks code pages of memory");
+static_assert(sizeof(AotState::regs) / sizeof(AotState::regs[0]) == kNumberOfRegisters);
+
+// AotRuntime public ----------------------------------------------------------
+
+AotError AotRuntime::Init(const std::string& path, const ResultKey& image_key, Memory* memory) {
+    LogFunctionEntry();
+
+    assert(memory != nullptr);
+
+    memory_ = memory;
+    is_enabled_ = false;
+    n_runs_ = 0;
+
+    // path without slash would be searched in library paths
+    const std::string module_path = path.find('/') == std::string::npos ? "./" + path : path;
+    handle_ = dlopen(module_path.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (handle_ == nullptr) {
+        spdlog::error("Cant load aot module: {}", dlerror());
+        return AotError::kCantLoad;
+    }
+
+    module_ = static_cast<const AotModule*>(dlsym(handle_, kAotModuleSymbol));
+    if (module_ == nullptr) {
+        return AotError::kNoModule;
+    }
+
+    if (module_->abi_version != kAotAbiVersion) {
+        return AotError::kAbiMismatch;
+    }
+
+    if (module_->image_key[0] != image_key.lo || module_->image_key[1] != image_key.hi) {
+        return AotError::kImageMismatch;
+    }
+
+    const size_t memory_size = memory_->GetMemorySize();
+    code_.assign(memory_size, 0);
+    for (size_t block_i = 0; block_i < module_->n_blocks; block_i++) {
+        const AotBlockRange& range = module_->blocks[block_i];
+        if (range.start_pc >= range.end_pc || range.end_pc > memory_size) {
+            return AotError::kImageMismatch;
+        }
+
+        const size_t size = range.end_pc - range.start_pc;
+        std::memcpy(code_.data() + range.start_pc, memory_->GetHostRange(range.start_pc, size), size);
+        memory_->MarkCode(range.start_pc, size);
+    }
+
+    // map is fixed by now, pages split between regions get no permissions
+    const size_t kPageSize = size_t{1} << kAotCodePageBits;
+    page_permissions_.assign((memory_size + kPageSize - 1) / kPageSize, 0);
+    for (size_t page = 0; page < page_permissions_.size(); page++) {
+        const size_t page_start = page << kAotCodePageBits;
+        const uint8_t permissions = memory_->GetPermissions(static_cast<MemAddress>(page_start),
+                                                            std::min(kPageSize, memory_size - page_start));
+        page_permissions_[page] = ((permissions & kPermRead)  != 0 ? kAotPageRead  : 0)
+                                | ((permissions & kPermWrite) != 0 ? kAotPageWrite : 0);
+    }
+
+    state_ = {};
+    state_.memory = memory_->GetData();
+    state_.memory_size = static_cast<uint32_t>(memory_size);
+    state_.code_pages = memory_->GetCodePages();
+    state_.page_permissions = page_permissions_.data();
+
+    is_enabled_ = true;
+    spdlog::info("Aot module {} loaded: {} blocks", module_path, module_->n_blocks);
+
+    return AotError::kOk;
+}
+
+AotRuntime::~AotRuntime() {
+    if (handle_ != nullptr) {
+        dlclose(handle_);
+    }
+}
+
+void AotRuntime::Run(Cpu* cpu, uint64_t* n_retired_instrs) {
+    assert(cpu != nullptr);
+    assert(n_retired_instrs != nullptr);
+    assert(is_enabled_);
+
+    for (size_t reg_id = 0; reg_id < kNumberOfRegisters; reg_id++) {
+        state_.regs[reg_id] = cpu->GetRegisterValue(reg_id);
+    }
+    state_.n_retired = 0;
+    state_.is_exit_requested = 0;
+
+    Address pc = module_->run(&state_, cpu->GetPc());
+    if (state_.n_retired == 0) {
+        return ;
+    }
+
+    for (size_t reg_id = 1; reg_id < kNumberOfRegisters; reg_id++) {
+        cpu->SetRegisterValue(reg_id, state_.regs[reg_id]);
+    }
+    cpu->SetPc(pc);
+    *n_retired_instrs += state_.n_retired;
+    n_runs_++;
+}
+
+// page is marked again if translated bytes in it are intact
+void AotRuntime::CheckWrittenPages(const std::vector<size_t>& pages) {
+    LogFunctionEntry();
+
+    if (!is_enabled_) {
+        return ;
+    }
+
+    for (size_t page : pages) {
+        const size_t page_start = page << kCodePageBits;
+        const size_t page_end = std::min(page_start + (size_t{1} << kCodePageBits), code_.size());
+
+        bool is_page_translated = false;
+        for (size_t block_i = 0; block_i < module_->n_blocks; block_i++) {
+            const AotBlockRange& range = module_->blocks[block_i];
+            const size_t start = std::max<size_t>(range.start_pc, page_start);
+            const size_t end = std::min<size_t>(range.end_pc, page_end);
+            if (start >= end) {
+                continue;
+            }
+
+            is_page_translated = true;
+            if (std::memcmp(memory_->GetHostRange(start, end - start), code_.data() + start, end - start) != 0) {
+                spdlog::info("Translated code at 0x{:x} was written, aot module disabled", start);
+                is_enabled_ = false;
+                return ;
+            }
+        }
+
+        if (is_page_translated) {
+            memory_->MarkCode(page_start, page_end - page_start);
+        }
+    }
+}
+
+// global ---------------------------------------------------------------------
+
+const char* AotErrorToStr(AotError error) {
+    switch (error) {
+        case AotError::kOk:            return "no error";
+        case AotError::kCantLoad:      return "cant load aot module";
+        case AotError::kNoModule:      return "shared object is not an rv2cpp module";
+        case AotError::kAbiMismatch:   return "aot module was built for other simulator version";
+        case AotError::kImageMismatch: return "aot module was translated from other program";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+} // namespace sim
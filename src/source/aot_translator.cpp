@@ -0,0 +1,437 @@
+#include "aot_translator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cinttypes>
+#include <set>
+#include <vector>
+
+#include "log_helper.hpp"
+
+#include "aot_abi.hpp"
+#include "block_cache.hpp"
+#include "block_ir.hpp"
+#include "decode.hpp"
+#include "instructions.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static bool IsTranslated(const IrOp& op);
+static void CollectRegisters(const IrOp& op, std::set<size_t>* used, std::set<size_t>* written);
+static void EmitOp(FILE* out, const IrOp& op, const Address start_pc);
+static const char* Reg(const size_t reg_id);
+
+// AotTranslator private ------------------------------------------------------
+
+bool AotTranslator::IsInImage(const Address pc) const {
+    return std::any_of(segments_.begin(), segments_.end(), [pc](const std::pair<Address, Address>& segment) {
+        return segment.first <= pc && pc + kInstrSize <= segment.second;
+    });
+}
+
+// successors are taken from the terminator of the whole decoded block, as
+// interpreter runs the rest of it after translated part exits
+void AotTranslator::DiscoverBlocks(const ploader::IProgramLoader& ploader) {
+    LogFunctionEntry();
+
+    std::vector<Address> worklist = {static_cast<Address>(ploader.GetEntryPoint())};
+    for (const ploader::Symbol& symbol : ploader.GetSymbols()) {
+        if (symbol.is_function) {
+            worklist.push_back(static_cast<Address>(symbol.addr));
+        }
+    }
+
+    std::set<Address> visited;
+    IrStats ir_stats = {};
+    while (!worklist.empty()) {
+        Address start_pc = worklist.back();
+        worklist.pop_back();
+
+        if (start_pc % kInstrSize != 0 || !IsInImage(start_pc) || !visited.insert(start_pc).second) {
+            continue;
+        }
+
+        std::vector<DecodedInstr> instrs;
+        Address pc = start_pc;
+        while (IsInImage(pc) && instrs.size() < kMaxBlockInstrs) {
+            instrs.push_back(Decode<32>(memory_.FetchInstr32b(pc)));
+            pc += kInstrSize;
+            if (IsBlockTerminator(instrs.back().instr_mnem)) {
+                break;
+            }
+        }
+
+        std::vector<IrOp> ops = LiftBlock(instrs, start_pc, &ir_stats);
+        auto exit_it = std::find_if(ops.begin(), ops.end(), [](const IrOp& op) { return !IsTranslated(op); });
+        if (exit_it != ops.begin()) {
+            AotBlock block = {
+                .ops = std::vector<IrOp>(ops.begin(), exit_it),
+                .end_pc = exit_it == ops.end() ? pc : exit_it->pc,
+                .is_exit = exit_it != ops.end(),
+            };
+            blocks_.emplace(start_pc, std::move(block));
+        }
+
+        const DecodedInstr& last_instr = instrs.back();
+        const Address last_pc = pc - kInstrSize;
+        switch (last_instr.instr_mnem) {
+            case InstructionMnemonic::kBeq:
+            case InstructionMnemonic::kBne:
+            case InstructionMnemonic::kBlt:
+            case InstructionMnemonic::kBge:
+            case InstructionMnemonic::kBltu:
+            case InstructionMnemonic::kBgeu:
+                worklist.push_back(last_pc + SignExtendImm(last_instr.instr.b_type.imm, last_instr.instr.b_type.imm_size_bit));
+                worklist.push_back(pc);
+                break;
+            case InstructionMnemonic::kJal:
+                worklist.push_back(last_pc + SignExtendImm(last_instr.instr.j_type.imm, last_instr.instr.j_type.imm_size_bit));
+                if (last_instr.instr.j_type.rd != RegisterAliases::kMachineZero) {
+                    worklist.push_back(pc);
+                }
+                break;
+            case InstructionMnemonic::kJalr:
+                // target is not known, return address is
+                if (last_instr.instr.i_type.rd != RegisterAliases::kMachineZero) {
+                    worklist.push_back(pc);
+                }
+                break;
+            case InstructionMnemonic::kUnkownMnem:
+                break;
+            default:
+                // system instructions and blocks cut by length fall through
+                worklist.push_back(pc);
+                break;
+        }
+    }
+}
+
+// registers live in locals, they are written back once on the way out
+void AotTranslator::EmitBlock(FILE* out, const Address start_pc, const AotBlock& block) {
+    std::set<size_t> used;
+    std::set<size_t> written;
+    for (const IrOp& op : block.ops) {
+        CollectRegisters(op, &used, &written);
+    }
+
+    std::fprintf(out, "// 0x%08" PRIx32 "-0x%08" PRIx32 "\n", start_pc, block.end_pc);
+    std::fprintf(out, "static uint32_t Block_%08" PRIx32 "(AotState* s) {\n", start_pc);
+    std::fprintf(out, "    uint8_t* const m = s->memory;\n");
+    std::fprintf(out, "    const uint32_t mem_size = s->memory_size;\n");
+    std::fprintf(out, "    const uint8_t* const code_pages = s->code_pages;\n");
+    std::fprintf(out, "    const uint8_t* const page_perms = s->page_permissions;\n");
+    std::fprintf(out, "    uint32_t next_pc = 0x%08" PRIx32 "u;\n", block.end_pc);
+    std::fprintf(out, "    uint32_t n_instrs = %zu;\n", block.ops.size());
+    std::fprintf(out, "    uint32_t a = 0;\n");
+    for (size_t reg_id : used) {
+        std::fprintf(out, "    uint32_t %s = s->regs[%zu];\n", Reg(reg_id), reg_id);
+    }
+    std::fprintf(out, "    (void)m; (void)mem_size; (void)code_pages; (void)page_perms; (void)a;\n\n");
+
+    for (const IrOp& op : block.ops) {
+        EmitOp(out, op, start_pc);
+    }
+
+    if (block.is_exit) {
+        std::fprintf(out, "    s->is_exit_requested = 1;\n");
+    }
+    // every op but alu ones and fence may leave the block
+    const bool is_exit_label_used = std::any_of(block.ops.begin(), block.ops.end(), [](const IrOp& op) {
+        return IsIrLoadOp(op.opcode) || IsIrStoreOp(op.opcode)
+            || (op.opcode == IrOpcode::kGuest && op.guest.instr_mnem != InstructionMnemonic::kFence);
+    });
+    if (is_exit_label_used) {
+        std::fprintf(out, "exit:\n");
+    }
+    for (size_t reg_id : written) {
+        std::fprintf(out, "    s->regs[%zu] = %s;\n", reg_id, Reg(reg_id));
+    }
+    std::fprintf(out, "    s->n_retired += n_instrs;\n");
+    std::fprintf(out, "    return next_pc;\n");
+    std::fprintf(out, "}\n\n");
+}
+
+// AotTranslator public -------------------------------------------------------
+
+void AotTranslator::Init(const ploader::IProgramLoader& ploader) {
+    LogFunctionEntry();
+
+    memory_.Init(kMemorySize);
+    segments_.clear();
+    for (size_t index_ls = 0; index_ls < ploader.GetNLSections(); index_ls++) {
+        memory_.MapToMemory(ploader.GetBinIndex(index_ls), ploader.GetStartAddrIndex(index_ls), ploader.GetEndAddrIndex(index_ls));
+        segments_.emplace_back(ploader.GetStartAddrIndex(index_ls), ploader.GetEndAddrIndex(index_ls));
+    }
+
+    image_key_ = HashAotImage(ploader);
+    blocks_.clear();
+    stats_ = {};
+
+    DiscoverBlocks(ploader);
+}
+
+void AotTranslator::Emit(FILE* out, const char* source_name) {
+    LogFunctionEntry();
+
+    assert(out != nullptr);
+    assert(source_name != nullptr);
+
+    std::fprintf(out, "// translated by rv2cpp from %s, do not edit\n", source_name);
+    std::fprintf(out, "// build: c++ -std=c++20 -O2 -shared -fPIC -I<simulator>/src/include <this file> -o <module>.so\n\n");
+    std::fprintf(out, "#include <cstdint>\n#include <cstring>\n\n#include \"aot_abi.hpp\"\n\n");
+    std::fprintf(out, "namespace {\n\nusing sim::AotState;\n\n");
+    std::fprintf(out, "template <typename T>\nstatic inline T Load(const uint8_t* m, uint32_t a) { T v; std::memcpy(&v, m + a, sizeof(T)); return v; }\n");
+    std::fprintf(out, "template <typename T>\nstatic inline void Store(uint8_t* m, uint32_t a, T v) { std::memcpy(m + a, &v, sizeof(T)); }\n\n");
+
+    for (const auto& [start_pc, block] : blocks_) {
+        EmitBlock(out, start_pc, block);
+        stats_.n_blocks++;
+        stats_.n_instrs += block.ops.size();
+        stats_.n_exits += block.is_exit ? 1 : 0;
+    }
+
+    std::fprintf(out, "static uint32_t Run(AotState* s, uint32_t pc) {\n");
+    std::fprintf(out, "    while (s->is_exit_requested == 0) {\n");
+    std::fprintf(out, "        switch (pc) {\n");
+    for (const auto& [start_pc, block] : blocks_) {
+        std::fprintf(out, "            case 0x%08" PRIx32 "u: pc = Block_%08" PRIx32 "(s); break;\n", start_pc, start_pc);
+    }
+    std::fprintf(out, "            default: return pc;\n");
+    std::fprintf(out, "        }\n");
+    std::fprintf(out, "    }\n\n");
+    std::fprintf(out, "    s->is_exit_requested = 0;\n");
+    std::fprintf(out, "    return pc;\n");
+    std::fprintf(out, "}\n\n");
+
+    std::fprintf(out, "static const sim::AotBlockRange kBlocks[] = {\n");
+    for (const auto& [start_pc, block] : blocks_) {
+        std::fprintf(out, "    {0x%08" PRIx32 "u, 0x%08" PRIx32 "u},\n", start_pc, block.end_pc);
+    }
+    std::fprintf(out, "};\n\n} // namespace\n\n");
+
+    std::fprintf(out, "extern \"C\" const sim::AotModule %s = {\n", kAotModuleSymbol);
+    std::fprintf(out, "    .abi_version = %" PRIu32 ",\n", kAotAbiVersion);
+    std::fprintf(out, "    .image_key = {0x%016" PRIx64 "ull, 0x%016" PRIx64 "ull},\n", image_key_.lo, image_key_.hi);
+    std::fprintf(out, "    .n_blocks = %zu,\n", blocks_.size());
+    std::fprintf(out, "    .blocks = kBlocks,\n");
+    std::fprintf(out, "    .run = Run,\n");
+    std::fprintf(out, "};\n");
+}
+
+const AotStats& AotTranslator::GetStats() const {
+    return stats_;
+}
+
+// global ---------------------------------------------------------------------
+
+ResultKey HashAotImage(const ploader::IProgramLoader& ploader) {
+    ResultHasher hasher;
+    hasher.Init();
+
+    hasher.UpdateValue(ploader.GetXlen());
+    hasher.UpdateValue(ploader.GetEntryPoint());
+    for (size_t index_ls = 0; index_ls < ploader.GetNLSections(); index_ls++) {
+        hasher.UpdateValue(ploader.GetStartAddrIndex(index_ls));
+        hasher.Update(ploader.GetBinIndex(index_ls), ploader.GetSizeIndex(index_ls));
+    }
+
+    return hasher.Finish();
+}
+
+// static ---------------------------------------------------------------------
+
+// fence orders nothing for a single hart and is not emitted
+static bool IsTranslated(const IrOp& op) {
+    if (op.opcode != IrOpcode::kGuest) {
+        return true;
+    }
+
+    switch (op.guest.instr_mnem) {
+        case InstructionMnemonic::kJal:
+        case InstructionMnemonic::kJalr:
+        case InstructionMnemonic::kBeq:
+        case InstructionMnemonic::kBne:
+        case InstructionMnemonic::kBlt:
+        case InstructionMnemonic::kBge:
+        case InstructionMnemonic::kBltu:
+        case InstructionMnemonic::kBgeu:
+        case InstructionMnemonic::kFence:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// x0 is never a local
+static void CollectRegisters(const IrOp& op, std::set<size_t>* used, std::set<size_t>* written) {
+    auto use = [used](const size_t reg_id) {
+        if (reg_id != RegisterAliases::kMachineZero) {
+            used->insert(reg_id);
+        }
+    };
+    auto write = [&](const size_t reg_id) {
+        if (reg_id != RegisterAliases::kMachineZero) {
+            used->insert(reg_id);
+            written->insert(reg_id);
+        }
+    };
+
+    if (op.opcode == IrOpcode::kLoadImm) {
+        write(op.rd);
+    } else if (IsIrAluRegOp(op.opcode)) {
+        use(op.rs1);
+        use(op.rs2);
+        write(op.rd);
+    } else if (IsIrAluImmOp(op.opcode) || IsIrLoadOp(op.opcode)) {
+        use(op.rs1);
+        write(op.rd);
+    } else if (IsIrStoreOp(op.opcode)) {
+        use(op.rs1);
+        use(op.rs2);
+    } else if (op.guest.instr_mnem == InstructionMnemonic::kJal) {
+        write(op.guest.instr.j_type.rd);
+    } else if (op.guest.instr_mnem == InstructionMnemonic::kJalr) {
+        use(op.guest.instr.i_type.rs1);
+        write(op.guest.instr.i_type.rd);
+    } else if (op.guest.instr_mnem != InstructionMnemonic::kFence) {
+        use(op.guest.instr.b_type.rs1);
+        use(op.guest.instr.b_type.rs2);
+    }
+}
+
+// every op may leave the block, n_instrs counts instructions retired before it
+static void EmitOp(FILE* out, const IrOp& op, const Address start_pc) {
+    const size_t n_before = (op.pc - start_pc) / kInstrSize;
+    const Address next_pc = op.pc + kInstrSize;
+    const char* rd = Reg(op.rd);
+    const char* rs1 = Reg(op.rs1);
+    const char* rs2 = Reg(op.rs2);
+    const bool is_rd_written = op.rd != RegisterAliases::kMachineZero;
+
+    std::fprintf(out, "    // 0x%08" PRIx32 ": %s\n", op.pc,
+                 op.opcode == IrOpcode::kGuest ? InstructionMnemonicToStr(op.guest.instr_mnem) : IrOpcodeToStr(op.opcode));
+
+    const Register shamt = op.imm & 0b1'1111;
+    switch (op.opcode) {
+        case IrOpcode::kLoadImm:  if (is_rd_written) { std::fprintf(out, "    %s = 0x%" PRIx32 "u;\n", rd, op.imm); } return;
+        case IrOpcode::kAdd:      if (is_rd_written) { std::fprintf(out, "    %s = %s + %s;\n", rd, rs1, rs2); } return;
+        case IrOpcode::kSub:      if (is_rd_written) { std::fprintf(out, "    %s = %s - %s;\n", rd, rs1, rs2); } return;
+        case IrOpcode::kSll:      if (is_rd_written) { std::fprintf(out, "    %s = %s << (%s & 31u);\n", rd, rs1, rs2); } return;
+        case IrOpcode::kSlt:      if (is_rd_written) { std::fprintf(out, "    %s = (int32_t)%s < (int32_t)%s;\n", rd, rs1, rs2); } return;
+        case IrOpcode::kSltu:     if (is_rd_written) { std::fprintf(out, "    %s = %s < %s;\n", rd, rs1, rs2); } return;
+        case IrOpcode::kXor:      if (is_rd_written) { std::fprintf(out, "    %s = %s ^ %s;\n", rd, rs1, rs2); } return;
+        case IrOpcode::kSrl:      if (is_rd_written) { std::fprintf(out, "    %s = %s >> (%s & 31u);\n", rd, rs1, rs2); } return;
+        case IrOpcode::kSra:      if (is_rd_written) { std::fprintf(out, "    %s = (uint32_t)((int32_t)%s >> (%s & 31u));\n", rd, rs1, rs2); } return;
+        case IrOpcode::kOr:       if (is_rd_written) { std::fprintf(out, "    %s = %s | %s;\n", rd, rs1, rs2); } return;
+        case IrOpcode::kAnd:      if (is_rd_written) { std::fprintf(out, "    %s = %s & %s;\n", rd, rs1, rs2); } return;
+        case IrOpcode::kAddImm:   if (is_rd_written) { std::fprintf(out, "    %s = %s + 0x%" PRIx32 "u;\n", rd, rs1, op.imm); } return;
+        case IrOpcode::kSllImm:   if (is_rd_written) { std::fprintf(out, "    %s = %s << %" PRIu32 ";\n", rd, rs1, shamt); } return;
+        case IrOpcode::kSltImm:   if (is_rd_written) { std::fprintf(out, "    %s = (int32_t)%s < (int32_t)0x%" PRIx32 "u;\n", rd, rs1, op.imm); } return;
+        case IrOpcode::kSltuImm:  if (is_rd_written) { std::fprintf(out, "    %s = %s < 0x%" PRIx32 "u;\n", rd, rs1, op.imm); } return;
+        case IrOpcode::kXorImm:   if (is_rd_written) { std::fprintf(out, "    %s = %s ^ 0x%" PRIx32 "u;\n", rd, rs1, op.imm); } return;
+        case IrOpcode::kSrlImm:   if (is_rd_written) { std::fprintf(out, "    %s = %s >> %" PRIu32 ";\n", rd, rs1, shamt); } return;
+        case IrOpcode::kSraImm:   if (is_rd_written) { std::fprintf(out, "    %s = (uint32_t)((int32_t)%s >> %" PRIu32 ");\n", rd, rs1, shamt); } return;
+        case IrOpcode::kOrImm:    if (is_rd_written) { std::fprintf(out, "    %s = %s | 0x%" PRIx32 "u;\n", rd, rs1, op.imm); } return;
+        case IrOpcode::kAndImm:   if (is_rd_written) { std::fprintf(out, "    %s = %s & 0x%" PRIx32 "u;\n", rd, rs1, op.imm); } return;
+        default:
+            break;
+    }
+
+    // out of range accesses and those the memory map would fault are left to interpreter as well
+    if (IsIrLoadOp(op.opcode) || IsIrStoreOp(op.opcode)) {
+        size_t size = 0;
+        const char* load_type = "";
+        switch (op.opcode) {
+            case IrOpcode::kLoad8:   size = 1; load_type = "(uint32_t)(int32_t)Load<int8_t>";   break;
+            case IrOpcode::kLoad8u:  size = 1; load_type = "(uint32_t)Load<uint8_t>";           break;
+            case IrOpcode::kLoad16:  size = 2; load_type = "(uint32_t)(int32_t)Load<int16_t>";  break;
+            case IrOpcode::kLoad16u: size = 2; load_type = "(uint32_t)Load<uint16_t>";          break;
+            case IrOpcode::kLoad32:  size = 4; load_type = "Load<uint32_t>";                    break;
+            case IrOpcode::kStore8:  size = 1; break;
+            case IrOpcode::kStore16: size = 2; break;
+            case IrOpcode::kStore32: size = 4; break;
+            default:
+                assert(0 && "not a memory ir opcode");
+        }
+
+        std::fprintf(out, "    a = %s + 0x%" PRIx32 "u;\n", rs1, op.imm);
+        if (IsIrLoadOp(op.opcode)) {
+            std::fprintf(out, "    if (a > mem_size - %zuu || !(page_perms[a >> %zu] & page_perms[(a + %zuu) >> %zu] & %uu)) "
+                              "{ next_pc = 0x%08" PRIx32 "u; n_instrs = %zu; s->is_exit_requested = 1; goto exit; }\n",
+                         size, kAotCodePageBits, size - 1, kAotCodePageBits, static_cast<unsigned>(kAotPageRead), op.pc, n_before);
+            if (is_rd_written) {
+                std::fprintf(out, "    %s = %s(m, a);\n", rd, load_type);
+            }
+        } else {
+            std::fprintf(out, "    if (a > mem_size - %zuu || !(page_perms[a >> %zu] & page_perms[(a + %zuu) >> %zu] & %uu) "
+                              "|| code_pages[a >> %zu] || code_pages[(a + %zuu) >> %zu]) "
+                              "{ next_pc = 0x%08" PRIx32 "u; n_instrs = %zu; s->is_exit_requested = 1; goto exit; }\n",
+                         size, kAotCodePageBits, size - 1, kAotCodePageBits, static_cast<unsigned>(kAotPageWrite),
+                         kAotCodePageBits, size - 1, kAotCodePageBits, op.pc, n_before);
+            const char* store_type = size == 1 ? "uint8_t" : size == 2 ? "uint16_t" : "uint32_t";
+            std::fprintf(out, "    Store<%s>(m, a, (%s)%s);\n", store_type, store_type, rs2);
+        }
+        return;
+    }
+
+    assert(op.opcode == IrOpcode::kGuest);
+    const DecodedInstr& dec_instr = op.guest;
+    const size_t n_with = n_before + 1;
+    switch (dec_instr.instr_mnem) {
+        case InstructionMnemonic::kJal: {
+            const Address target = op.pc + SignExtendImm(dec_instr.instr.j_type.imm, dec_instr.instr.j_type.imm_size_bit);
+            if (dec_instr.instr.j_type.rd != RegisterAliases::kMachineZero) {
+                std::fprintf(out, "    %s = 0x%08" PRIx32 "u;\n", Reg(dec_instr.instr.j_type.rd), next_pc);
+            }
+            std::fprintf(out, "    next_pc = 0x%08" PRIx32 "u; n_instrs = %zu; goto exit;\n", target, n_with);
+        }
+        break;
+        case InstructionMnemonic::kJalr: {
+            const Register offset = SignExtendImm(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit);
+            std::fprintf(out, "    next_pc = (%s + 0x%" PRIx32 "u) & ~1u;\n", Reg(dec_instr.instr.i_type.rs1), offset);
+            if (dec_instr.instr.i_type.rd != RegisterAliases::kMachineZero) {
+                std::fprintf(out, "    %s = 0x%08" PRIx32 "u;\n", Reg(dec_instr.instr.i_type.rd), next_pc);
+            }
+            std::fprintf(out, "    n_instrs = %zu; goto exit;\n", n_with);
+        }
+        break;
+        case InstructionMnemonic::kFence:
+            break;
+        default: {
+            const char* lhs = Reg(dec_instr.instr.b_type.rs1);
+            const char* rhs = Reg(dec_instr.instr.b_type.rs2);
+            const char* condition_format = "";
+            switch (dec_instr.instr_mnem) {
+                case InstructionMnemonic::kBeq:  condition_format = "%s == %s";                   break;
+                case InstructionMnemonic::kBne:  condition_format = "%s != %s";                   break;
+                case InstructionMnemonic::kBlt:  condition_format = "(int32_t)%s < (int32_t)%s";  break;
+                case InstructionMnemonic::kBge:  condition_format = "(int32_t)%s >= (int32_t)%s"; break;
+                case InstructionMnemonic::kBltu: condition_format = "%s < %s";                    break;
+                case InstructionMnemonic::kBgeu: condition_format = "%s >= %s";                   break;
+                default:
+                    assert(0 && "instruction is not translated");
+            }
+
+            const Address target = op.pc + SignExtendImm(dec_instr.instr.b_type.imm, dec_instr.instr.b_type.imm_size_bit);
+            std::fprintf(out, "    next_pc = (");
+            std::fprintf(out, condition_format, lhs, rhs);
+            std::fprintf(out, ") ? 0x%08" PRIx32 "u : 0x%08" PRIx32 "u; n_instrs = %zu; goto exit;\n", target, next_pc, n_with);
+        }
+        break;
+    }
+}
+
+// x0 reads as constant
+static const char* Reg(const size_t reg_id) {
+    static const char* const kNames[kNumberOfRegisters] = {
+        "0u",  "x1",  "x2",  "x3",  "x4",  "x5",  "x6",  "x7",  "x8",  "x9",  "x10", "x11", "x12", "x13", "x14", "x15",
+        "x16", "x17", "x18", "x19", "x20", "x21", "x22", "x23", "x24", "x25", "x26", "x27", "x28", "x29", "x30", "x31",
+    };
+
+    assert(reg_id < kNumberOfRegisters);
+    return kNames[reg_id];
+}
+
+} // namespace sim
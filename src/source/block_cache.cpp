@@ -0,0 +1,411 @@
+#include "block_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "log_helper.hpp"
+
+#include "block_ir.hpp"
+#include "control_flow_graph.hpp"
+#include "decode.hpp"
+#include "decode_table.hpp"
+#include "fusion.hpp"
+#include "imemory.hpp"
+#include "instructions.hpp"
+#include "loop_idiom.hpp"
+#include "predecode_cache.hpp"
+
+namespace sim {
+
+// BlockCache private ---------------------------------------------------------
+
+Address BlockCache::DecodeInstrs(const Address start_pc, std::vector<DecodedInstr>* instrs) const {
+    Address pc = start_pc;
+    while (instrs->size() < kMaxBlockInstrs) {
+        DecodedInstr dec_instr = {};
+        if (decode_table_ != nullptr) {
+            dec_instr = decode_table_->Get(pc);
+        } else {
+            dec_instr = Decode<32>(memory_->FetchInstr32b(pc));
+            hle_->PatchHookedInstr(pc, &dec_instr);
+        }
+        instrs->push_back(dec_instr);
+        pc += sizeof(Register);
+
+        if (IsBlockTerminator(dec_instr.instr_mnem)) {
+            break;
+        }
+    }
+
+    return pc;
+}
+
+void BlockCache::TrackCode(const Address start_pc, const size_t size) {
+    memory_->MarkCode(start_pc, size);
+
+    size_t last_page = (start_pc + size - 1) >> kCodePageBits;
+    for (size_t page = start_pc >> kCodePageBits; page <= last_page; page++) {
+        // rebuilt block may still be listed by its other page
+        std::vector<Address>& start_pcs = page_blocks_[page];
+        if (std::find(start_pcs.begin(), start_pcs.end(), start_pc) == start_pcs.end()) {
+            start_pcs.push_back(start_pc);
+        }
+    }
+}
+
+void BlockCache::AddIrStats(const IrStats& block_stats) {
+    ir_stats_.n_lifted           += block_stats.n_lifted;
+    ir_stats_.n_folded_constants += block_stats.n_folded_constants;
+    ir_stats_.n_folded_addresses += block_stats.n_folded_addresses;
+    ir_stats_.n_dead_writes      += block_stats.n_dead_writes;
+}
+
+bool BlockCache::LoadBlock(const Address start_pc, DecodedBlock* block) {
+    if (predecode_cache_ == nullptr || !predecode_cache_->LoadBlock(start_pc, block)) {
+        return false;
+    }
+
+    const uint8_t* code = memory_->GetHostRange(start_pc, block->code.size());
+    if (code == nullptr || std::memcmp(code, block->code.data(), block->code.size()) != 0) {
+        spdlog::debug("Predecoded block 0x{:x} is stale", start_pc);
+        return false;
+    }
+
+    // idioms are saved only by runs that recognize them, that is a part of cache key
+    if (block->idiom.kind != LoopIdiomKind::kNone && loop_idiom_stats_ != nullptr) {
+        loop_idiom_stats_->n_recognized++;
+    }
+    // so are optimizations, stats are the same as if block was built
+    AddIrStats(block->ir_stats);
+
+    TrackCode(start_pc, block->code.size());
+    n_loaded_blocks_++;
+
+    return true;
+}
+
+DecodedBlock& BlockCache::BuildBlock(const Address start_pc) {
+    LogFunctionEntry();
+
+    DecodedBlock loaded_block = {};
+    if (LoadBlock(start_pc, &loaded_block)) {
+        return blocks_.emplace(start_pc, std::move(loaded_block)).first->second;
+    }
+
+    DecodedBlock block = {
+        .start_pc = start_pc,
+        .end_pc = start_pc,
+        .n_guest_instrs = 0,
+        .instrs = {},
+        .ops = {},
+        .ir_stats = {},
+        .n_fusions = {},
+        .n_executions = 0,
+        .idiom = {},
+        .code = {},
+        .links = {},
+    };
+
+    block.end_pc = DecodeInstrs(start_pc, &block.instrs);
+    block.n_guest_instrs = block.instrs.size();
+
+    // compare loops continue in the next block, after exit on mismatch
+    if (loop_idiom_stats_ != nullptr) {
+        std::vector<DecodedInstr> tail;
+        if (block.instrs.back().instr_mnem == InstructionMnemonic::kBne) {
+            DecodeInstrs(block.end_pc, &tail);
+        }
+
+        if (RecognizeLoopIdiom(block.instrs, {}, start_pc, &block.idiom) ||
+            (!tail.empty() && RecognizeLoopIdiom(block.instrs, tail, start_pc, &block.idiom))) {
+            loop_idiom_stats_->n_recognized++;
+            spdlog::debug("Loop idiom {} at 0x{:x}", LoopIdiomKindToStr(block.idiom.kind), start_pc);
+        }
+    }
+
+    if (is_fusion_enabled_) {
+        FuseInstructions(&block.instrs, &block.n_fusions);
+    }
+
+    // tail of compare loop is a part of block code too
+    Address code_end = block.idiom.kind == LoopIdiomKind::kCompare ? block.idiom.end_pc : block.end_pc;
+    const uint8_t* code = memory_->GetHostRange(start_pc, code_end - start_pc);
+    assert(code != nullptr);
+    block.code.assign(code, code + (code_end - start_pc));
+    TrackCode(start_pc, code_end - start_pc);
+
+    block.ops = LiftBlock(block.instrs, block.start_pc, &block.ir_stats);
+    if (is_optimization_enabled_) {
+        OptimizeBlock(&block.ops, &block.ir_stats);
+    }
+    AddIrStats(block.ir_stats);
+    n_built_blocks_++;
+
+    spdlog::debug("Built block 0x{:x}-0x{:x}: {} instructions, {} ops", 
+                  block.start_pc, block.end_pc, block.n_guest_instrs, block.ops.size());
+    for (const IrOp& op : block.ops) {
+        spdlog::trace("  {} x{}, x{}, x{}, 0x{:x}", IrOpcodeToStr(op.opcode), op.rd, op.rs1, op.rs2, op.imm);
+    }
+
+    return blocks_.emplace(start_pc, std::move(block)).first->second;
+}
+
+DecodedBlock& BlockCache::GetNextBlockSlow(const Address pc) {
+    n_lookups_++;
+    DecodedBlock& block = GetBlock(pc);
+    if (last_block_ != nullptr) {
+        Link(last_block_, &block);
+    }
+
+    last_block_ = &block;
+    return block;
+}
+
+// links are kept while there are free slots, the first successors seen stay linked
+void BlockCache::Link(DecodedBlock* from, DecodedBlock* to) {
+    assert(from != nullptr);
+    assert(to != nullptr);
+
+    for (DecodedBlock*& link : from->links) {
+        if (link == to) {
+            return;
+        }
+
+        if (link == nullptr) {
+            link = to;
+            return;
+        }
+    }
+}
+
+// links may point to dropped blocks, they are rare enough to unlink everything
+void BlockCache::UnlinkAll() {
+    for (auto& [start_pc, block] : blocks_) {
+        block.links = {};
+    }
+
+    last_block_ = nullptr;
+}
+
+// BlockCache public ----------------------------------------------------------
+
+void BlockCache::Init(IMemory* memory, const HleLayer* hle, LoopIdiomStats* loop_idiom_stats, 
+                      bool is_fusion_enabled, bool is_optimization_enabled) {
+    LogFunctionEntry();
+
+    assert(memory != nullptr);
+    assert(hle != nullptr);
+
+    memory_ = memory;
+    hle_ = hle;
+    loop_idiom_stats_ = loop_idiom_stats;
+    is_fusion_enabled_ = is_fusion_enabled;
+    is_optimization_enabled_ = is_optimization_enabled;
+    ir_stats_ = {};
+    predecode_cache_ = nullptr;
+    decode_table_ = nullptr;
+    n_built_blocks_ = 0;
+    n_loaded_blocks_ = 0;
+    n_preformed_blocks_ = 0;
+    n_invalidated_blocks_ = 0;
+    last_block_ = nullptr;
+    n_link_hits_ = 0;
+    n_lookups_ = 0;
+    blocks_.clear();
+    page_blocks_.clear();
+}
+
+void BlockCache::SetPredecodeCache(const PredecodeCache* predecode_cache) {
+    predecode_cache_ = predecode_cache;
+}
+
+void BlockCache::SetDecodeTable(DecodeTable* decode_table) {
+    decode_table_ = decode_table;
+}
+
+const std::unordered_map<Address, DecodedBlock>& BlockCache::GetBlocks() const {
+    return blocks_;
+}
+
+void BlockCache::Clear() {
+    LogFunctionEntry();
+
+    last_block_ = nullptr;
+    blocks_.clear();
+    page_blocks_.clear();
+}
+
+// decoded block runs up to a terminator through following graph blocks, so
+// its successors are those of the graph block ending at the same pc
+void BlockCache::Preform(const ControlFlowGraph& cfg) {
+    LogFunctionEntry();
+
+    for (const auto& [start_pc, cfg_block] : cfg.GetBlocks()) {
+        if (!blocks_.contains(start_pc)) {
+            GetBlock(start_pc);
+            n_preformed_blocks_++;
+        }
+    }
+
+    for (auto& [start_pc, block] : blocks_) {
+        const CfgBlock* cfg_block = cfg.FindBlock(block.end_pc - kInstrSize);
+        if (cfg_block == nullptr) {
+            continue;
+        }
+
+        if (cfg_block->end_pc != block.end_pc) {
+            // block was cut by length
+            auto next_it = blocks_.find(block.end_pc);
+            if (next_it != blocks_.end()) {
+                Link(&block, &next_it->second);
+            }
+            continue;
+        }
+
+        for (const CfgEdge& edge : cfg_block->successors) {
+            auto next_it = blocks_.find(edge.to);
+            if (next_it != blocks_.end()) {
+                Link(&block, &next_it->second);
+            }
+        }
+    }
+}
+
+// data sharing pages with code also unmarks them, so blocks whose code is 
+// unchanged are kept and their pages are marked again
+void BlockCache::InvalidateWrittenCode() {
+    LogFunctionEntry();
+
+    memory_->TakeWrittenCodePages(&written_pages_);
+    InvalidatePages(written_pages_);
+}
+
+void BlockCache::InvalidatePages(const std::vector<size_t>& pages) {
+    LogFunctionEntry();
+
+    const uint64_t n_invalidated_before = n_invalidated_blocks_;
+
+    for (size_t page : pages) {
+        auto page_it = page_blocks_.find(page);
+        if (page_it == page_blocks_.end()) {
+            continue;
+        }
+
+        std::vector<Address>& start_pcs = page_it->second;
+        auto kept_end = std::remove_if(start_pcs.begin(), start_pcs.end(), [this](Address start_pc) {
+            auto block_it = blocks_.find(start_pc);
+            if (block_it == blocks_.end()) {
+                return true; // invalidated through other page
+            }
+
+            const std::vector<uint8_t>& code = block_it->second.code;
+            if (std::memcmp(memory_->GetHostRange(start_pc, code.size()), code.data(), code.size()) == 0) {
+                memory_->MarkCode(start_pc, code.size());
+                return false;
+            }
+
+            spdlog::debug("Invalidated block 0x{:x}: its code was written", start_pc);
+            blocks_.erase(block_it);
+            n_invalidated_blocks_++;
+            return true;
+        });
+        start_pcs.erase(kept_end, start_pcs.end());
+
+        if (start_pcs.empty()) {
+            page_blocks_.erase(page_it);
+        }
+    }
+
+    if (n_invalidated_blocks_ != n_invalidated_before) {
+        UnlinkAll();
+    }
+}
+
+void BlockCache::ReportFusion(FILE* report_file) const {
+    LogFunctionEntry();
+
+    assert(report_file != nullptr);
+
+    FusionCounters static_fusions = {};
+    FusionCounters dynamic_fusions = {};
+    uint64_t n_guest_instrs = 0;
+    uint64_t n_ops = 0;
+
+    for (const auto& [start_pc, block] : blocks_) {
+        for (size_t kind = 0; kind < kNFusionKinds; kind++) {
+            static_fusions[kind] += block.n_fusions[kind];
+            dynamic_fusions[kind] += block.n_fusions[kind] * block.n_executions;
+        }
+
+        n_guest_instrs += block.n_guest_instrs * block.n_executions;
+        n_ops += block.instrs.size() * block.n_executions;
+    }
+
+    std::fprintf(report_file, "Fusion report (%zu blocks):\n", blocks_.size());
+    std::fprintf(report_file, "  %-12s %10s %14s\n", "pair", "static", "dynamic");
+    for (size_t kind = 0; kind < kNFusionKinds; kind++) {
+        std::fprintf(report_file, "  %-12s %10llu %14llu\n", FusionKindToStr(static_cast<FusionKind>(kind)), 
+                     static_cast<unsigned long long>(static_fusions[kind]),
+                     static_cast<unsigned long long>(dynamic_fusions[kind]));
+    }
+    std::fprintf(report_file, "  guest instructions: %llu, executed ops: %llu (%.2f%% less dispatches)\n",
+                 static_cast<unsigned long long>(n_guest_instrs), static_cast<unsigned long long>(n_ops),
+                 n_guest_instrs == 0 ? 0.0 : 100.0 * static_cast<double>(n_guest_instrs - n_ops) / static_cast<double>(n_guest_instrs));
+}
+
+const IrStats& BlockCache::GetIrStats() const {
+    return ir_stats_;
+}
+
+uint64_t BlockCache::GetNInvalidatedBlocks() const {
+    return n_invalidated_blocks_;
+}
+
+uint64_t BlockCache::GetNBuiltBlocks() const {
+    return n_built_blocks_;
+}
+
+uint64_t BlockCache::GetNLoadedBlocks() const {
+    return n_loaded_blocks_;
+}
+
+uint64_t BlockCache::GetNPreformedBlocks() const {
+    return n_preformed_blocks_;
+}
+
+uint64_t BlockCache::GetNLinkHits() const {
+    return n_link_hits_;
+}
+
+uint64_t BlockCache::GetNLookups() const {
+    return n_lookups_;
+}
+
+// global ---------------------------------------------------------------------
+
+bool IsBlockTerminator(InstructionMnemonic mnemonic) {
+    switch (mnemonic) {
+        case InstructionMnemonic::kJal:
+        case InstructionMnemonic::kJalr:
+        case InstructionMnemonic::kBeq:
+        case InstructionMnemonic::kBne:
+        case InstructionMnemonic::kBlt:
+        case InstructionMnemonic::kBge:
+        case InstructionMnemonic::kBltu:
+        case InstructionMnemonic::kBgeu:
+        case InstructionMnemonic::kFence_i:
+        case InstructionMnemonic::kScall:
+        case InstructionMnemonic::kSbreak:
+        case InstructionMnemonic::kFusedAuipcJalr:
+        case InstructionMnemonic::kFusedSltBne:
+        case InstructionMnemonic::kFusedSltuBne:
+        case InstructionMnemonic::kHleCall:
+        case InstructionMnemonic::kUnkownMnem:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace sim
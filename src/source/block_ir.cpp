@@ -0,0 +1,384 @@
+#include "block_ir.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+
+#include "log_helper.hpp"
+
+#include "cpu_defs.hpp"
+#include "decode.hpp"
+#include "instructions.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+struct SymbolicAddress {
+    bool is_valid;
+    uint8_t base;
+    Register offset;
+};
+
+static bool LiftOpcode(InstructionMnemonic mnemonic, IrOpcode* opcode);
+static bool ToImmOpcode(IrOpcode reg_opcode, IrOpcode* imm_opcode);
+static bool IsCommutative(IrOpcode opcode);
+static bool IsWritingRd(IrOpcode opcode);
+static IrOp MakeOp(IrOpcode opcode, Register rd, Register rs1, Register rs2, Register imm, Address pc);
+
+static void PropagateConstants(std::vector<IrOp>* ops, IrStats* stats);
+static void FoldAddresses(std::vector<IrOp>* ops, IrStats* stats);
+static void EliminateDeadWrites(std::vector<IrOp>* ops, IrStats* stats);
+
+// global ---------------------------------------------------------------------
+
+std::vector<IrOp> LiftBlock(const std::vector<DecodedInstr>& instrs, Address start_pc, IrStats* stats) {
+    LogFunctionEntry();
+
+    assert(stats != nullptr);
+
+    std::vector<IrOp> ops;
+    ops.reserve(instrs.size());
+
+    Address pc = start_pc;
+    for (const DecodedInstr& dec_instr : instrs) {
+        IrOpcode opcode = IrOpcode::kGuest;
+        bool is_lifted = LiftOpcode(dec_instr.instr_mnem, &opcode);
+
+        switch (dec_instr.instr_type) {
+            case InstrType::RType: {
+                if (is_lifted) {
+                    ops.push_back(MakeOp(opcode, dec_instr.instr.r_type.rd, dec_instr.instr.r_type.rs1,
+                                         dec_instr.instr.r_type.rs2, 0, pc));
+                }
+            }
+            break;
+            case InstrType::IType: {
+                if (is_lifted) {
+                    Register imm = SignExtendImm(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit);
+                    ops.push_back(MakeOp(opcode, dec_instr.instr.i_type.rd, dec_instr.instr.i_type.rs1, 0, imm, pc));
+                }
+            }
+            break;
+            case InstrType::SType: {
+                if (is_lifted) {
+                    Register imm = SignExtendImm(dec_instr.instr.s_type.imm, dec_instr.instr.s_type.imm_size_bit);
+                    ops.push_back(MakeOp(opcode, 0, dec_instr.instr.s_type.rs1, dec_instr.instr.s_type.rs2, imm, pc));
+                }
+            }
+            break;
+            case InstrType::UType: {
+                Register imm = dec_instr.instr.u_type.imm << 12u;
+                if (dec_instr.instr_mnem == InstructionMnemonic::kAuipc) {
+                    imm += pc;
+                }
+
+                ops.push_back(MakeOp(IrOpcode::kLoadImm, dec_instr.instr.u_type.rd, 0, 0, imm, pc));
+                is_lifted = true;
+            }
+            break;
+            case InstrType::Fused: {
+                if (dec_instr.instr_mnem == InstructionMnemonic::kFusedLuiAddi) {
+                    ops.push_back(MakeOp(IrOpcode::kLoadImm, dec_instr.instr.fused.rd, 0, 0,
+                                         dec_instr.instr.fused.imm + dec_instr.instr.fused.imm2, pc));
+                    is_lifted = true;
+                } else if (dec_instr.instr_mnem == InstructionMnemonic::kFusedAuipcLw) {
+                    ops.push_back(MakeOp(IrOpcode::kLoadImm, dec_instr.instr.fused.rd, 0, 0,
+                                         pc + dec_instr.instr.fused.imm, pc));
+                    ops.push_back(MakeOp(IrOpcode::kLoad32, dec_instr.instr.fused.rd2, dec_instr.instr.fused.rd, 0,
+                                         dec_instr.instr.fused.imm2, pc + kInstrSize));
+                    is_lifted = true;
+                }
+            }
+            break;
+            default:
+                break;
+        }
+
+        if (!is_lifted) {
+            IrOp op = MakeOp(IrOpcode::kGuest, 0, 0, 0, 0, pc);
+            op.guest = dec_instr;
+            ops.push_back(op);
+        }
+
+        pc += (dec_instr.instr_type == InstrType::Fused ? 2 : 1) * kInstrSize;
+    }
+
+    stats->n_lifted += ops.size();
+
+    return ops;
+}
+
+void OptimizeBlock(std::vector<IrOp>* ops, IrStats* stats) {
+    LogFunctionEntry();
+
+    assert(ops != nullptr);
+    assert(stats != nullptr);
+
+    PropagateConstants(ops, stats);
+    FoldAddresses(ops, stats);
+    EliminateDeadWrites(ops, stats);
+}
+
+const char* IrOpcodeToStr(IrOpcode opcode) {
+    switch (opcode) {
+        case IrOpcode::kLoadImm:  return "li";
+        case IrOpcode::kAdd:      return "add";
+        case IrOpcode::kSub:      return "sub";
+        case IrOpcode::kSll:      return "sll";
+        case IrOpcode::kSlt:      return "slt";
+        case IrOpcode::kSltu:     return "sltu";
+        case IrOpcode::kXor:      return "xor";
+        case IrOpcode::kSrl:      return "srl";
+        case IrOpcode::kSra:      return "sra";
+        case IrOpcode::kOr:       return "or";
+        case IrOpcode::kAnd:      return "and";
+        case IrOpcode::kAddImm:   return "addi";
+        case IrOpcode::kSllImm:   return "slli";
+        case IrOpcode::kSltImm:   return "slti";
+        case IrOpcode::kSltuImm:  return "sltiu";
+        case IrOpcode::kXorImm:   return "xori";
+        case IrOpcode::kSrlImm:   return "srli";
+        case IrOpcode::kSraImm:   return "srai";
+        case IrOpcode::kOrImm:    return "ori";
+        case IrOpcode::kAndImm:   return "andi";
+        case IrOpcode::kLoad8:    return "lb";
+        case IrOpcode::kLoad8u:   return "lbu";
+        case IrOpcode::kLoad16:   return "lh";
+        case IrOpcode::kLoad16u:  return "lhu";
+        case IrOpcode::kLoad32:   return "lw";
+        case IrOpcode::kStore8:   return "sb";
+        case IrOpcode::kStore16:  return "sh";
+        case IrOpcode::kStore32:  return "sw";
+        case IrOpcode::kGuest:    return "guest";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+static bool LiftOpcode(InstructionMnemonic mnemonic, IrOpcode* opcode) {
+    assert(opcode != nullptr);
+
+    switch (mnemonic) {
+        case InstructionMnemonic::kAdd:   *opcode = IrOpcode::kAdd;     return true;
+        case InstructionMnemonic::kSub:   *opcode = IrOpcode::kSub;     return true;
+        case InstructionMnemonic::kSll:   *opcode = IrOpcode::kSll;     return true;
+        case InstructionMnemonic::kSlt:   *opcode = IrOpcode::kSlt;     return true;
+        case InstructionMnemonic::kSltu:  *opcode = IrOpcode::kSltu;    return true;
+        case InstructionMnemonic::kXor:   *opcode = IrOpcode::kXor;     return true;
+        case InstructionMnemonic::kSrl:   *opcode = IrOpcode::kSrl;     return true;
+        case InstructionMnemonic::kSra:   *opcode = IrOpcode::kSra;     return true;
+        case InstructionMnemonic::kOr:    *opcode = IrOpcode::kOr;      return true;
+        case InstructionMnemonic::kAnd:   *opcode = IrOpcode::kAnd;     return true;
+        case InstructionMnemonic::kAddi:  *opcode = IrOpcode::kAddImm;  return true;
+        case InstructionMnemonic::kSlli:  *opcode = IrOpcode::kSllImm;  return true;
+        case InstructionMnemonic::kSlti:  *opcode = IrOpcode::kSltImm;  return true;
+        case InstructionMnemonic::kSltiu: *opcode = IrOpcode::kSltuImm; return true;
+        case InstructionMnemonic::kXori:  *opcode = IrOpcode::kXorImm;  return true;
+        case InstructionMnemonic::kSrli:  *opcode = IrOpcode::kSrlImm;  return true;
+        case InstructionMnemonic::kSrai:  *opcode = IrOpcode::kSraImm;  return true;
+        case InstructionMnemonic::kOri:   *opcode = IrOpcode::kOrImm;   return true;
+        case InstructionMnemonic::kAndi:  *opcode = IrOpcode::kAndImm;  return true;
+        case InstructionMnemonic::kLb:    *opcode = IrOpcode::kLoad8;   return true;
+        case InstructionMnemonic::kLbu:   *opcode = IrOpcode::kLoad8u;  return true;
+        case InstructionMnemonic::kLh:    *opcode = IrOpcode::kLoad16;  return true;
+        case InstructionMnemonic::kLhu:   *opcode = IrOpcode::kLoad16u; return true;
+        case InstructionMnemonic::kLw:    *opcode = IrOpcode::kLoad32;  return true;
+        case InstructionMnemonic::kSb:    *opcode = IrOpcode::kStore8;  return true;
+        case InstructionMnemonic::kSh:    *opcode = IrOpcode::kStore16; return true;
+        case InstructionMnemonic::kSw:    *opcode = IrOpcode::kStore32; return true;
+        default:
+            return false;
+    }
+}
+
+static bool ToImmOpcode(IrOpcode reg_opcode, IrOpcode* imm_opcode) {
+    assert(imm_opcode != nullptr);
+
+    switch (reg_opcode) {
+        case IrOpcode::kAdd:  *imm_opcode = IrOpcode::kAddImm;  return true;
+        case IrOpcode::kSll:  *imm_opcode = IrOpcode::kSllImm;  return true;
+        case IrOpcode::kSlt:  *imm_opcode = IrOpcode::kSltImm;  return true;
+        case IrOpcode::kSltu: *imm_opcode = IrOpcode::kSltuImm; return true;
+        case IrOpcode::kXor:  *imm_opcode = IrOpcode::kXorImm;  return true;
+        case IrOpcode::kSrl:  *imm_opcode = IrOpcode::kSrlImm;  return true;
+        case IrOpcode::kSra:  *imm_opcode = IrOpcode::kSraImm;  return true;
+        case IrOpcode::kOr:   *imm_opcode = IrOpcode::kOrImm;   return true;
+        case IrOpcode::kAnd:  *imm_opcode = IrOpcode::kAndImm;  return true;
+        default:
+            return false;
+    }
+}
+
+static bool IsCommutative(IrOpcode opcode) {
+    return opcode == IrOpcode::kAdd || opcode == IrOpcode::kXor
+        || opcode == IrOpcode::kOr  || opcode == IrOpcode::kAnd;
+}
+
+static bool IsWritingRd(IrOpcode opcode) {
+    return opcode == IrOpcode::kLoadImm || IsIrAluRegOp(opcode) || IsIrAluImmOp(opcode) || IsIrLoadOp(opcode);
+}
+
+static IrOp MakeOp(IrOpcode opcode, Register rd, Register rs1, Register rs2, Register imm, Address pc) {
+    IrOp op = {};
+    op.opcode = opcode;
+    op.rd = static_cast<uint8_t>(rd);
+    op.rs1 = static_cast<uint8_t>(rs1);
+    op.rs2 = static_cast<uint8_t>(rs2);
+    op.imm = imm;
+    op.pc = pc;
+
+    return op;
+}
+
+// registers with known value are tracked from the block start,
+// alu ops with all operands known become kLoadImm, with one known - immediate form
+static void PropagateConstants(std::vector<IrOp>* ops, IrStats* stats) {
+    LogFunctionEntry();
+
+    bool is_known[kNumberOfRegisters] = {};
+    Register values[kNumberOfRegisters] = {};
+    is_known[RegisterAliases::kMachineZero] = true;
+
+    for (IrOp& op : *ops) {
+        if (IsIrAluImmOp(op.opcode) && is_known[op.rs1]) {
+            op.imm = EvaluateIrAlu(op.opcode, values[op.rs1], op.imm);
+            op.opcode = IrOpcode::kLoadImm;
+            stats->n_folded_constants++;
+        } else if (IsIrAluRegOp(op.opcode)) {
+            IrOpcode imm_opcode = IrOpcode::kGuest;
+
+            if (is_known[op.rs1] && is_known[op.rs2]) {
+                op.imm = EvaluateIrAlu(op.opcode, values[op.rs1], values[op.rs2]);
+                op.opcode = IrOpcode::kLoadImm;
+                stats->n_folded_constants++;
+            } else if (is_known[op.rs2] && op.opcode == IrOpcode::kSub) {
+                op.imm = 0 - values[op.rs2];
+                op.opcode = IrOpcode::kAddImm;
+                stats->n_folded_constants++;
+            } else if (is_known[op.rs2] && ToImmOpcode(op.opcode, &imm_opcode)) {
+                op.imm = values[op.rs2];
+                op.opcode = imm_opcode;
+                stats->n_folded_constants++;
+            } else if (is_known[op.rs1] && IsCommutative(op.opcode) && ToImmOpcode(op.opcode, &imm_opcode)) {
+                op.imm = values[op.rs1];
+                op.rs1 = op.rs2;
+                op.opcode = imm_opcode;
+                stats->n_folded_constants++;
+            }
+        } else if ((IsIrLoadOp(op.opcode) || IsIrStoreOp(op.opcode))
+                   && op.rs1 != RegisterAliases::kMachineZero && is_known[op.rs1]) {
+            op.imm += values[op.rs1];
+            op.rs1 = RegisterAliases::kMachineZero;
+            stats->n_folded_addresses++;
+        }
+
+        if (op.opcode == IrOpcode::kGuest) {
+            std::fill(std::begin(is_known), std::end(is_known), false);
+        } else if (IsWritingRd(op.opcode)) {
+            is_known[op.rd] = op.opcode == IrOpcode::kLoadImm;
+            values[op.rd] = op.imm;
+        }
+
+        is_known[RegisterAliases::kMachineZero] = true;
+        values[RegisterAliases::kMachineZero] = 0;
+    }
+}
+
+// registers computed as base + offset are tracked while base is not redefined,
+// memory ops addressed through them use base directly, so address chains
+// like "addi t0, sp, 16; lw a0, 0(t0)" leave dead writes to the next pass
+static void FoldAddresses(std::vector<IrOp>* ops, IrStats* stats) {
+    LogFunctionEntry();
+
+    SymbolicAddress addresses[kNumberOfRegisters] = {};
+
+    for (IrOp& op : *ops) {
+        if ((IsIrLoadOp(op.opcode) || IsIrStoreOp(op.opcode)) && addresses[op.rs1].is_valid) {
+            op.imm += addresses[op.rs1].offset;
+            op.rs1 = addresses[op.rs1].base;
+            stats->n_folded_addresses++;
+        }
+
+        if (op.opcode == IrOpcode::kGuest) {
+            std::fill(std::begin(addresses), std::end(addresses), SymbolicAddress{});
+            continue;
+        }
+
+        if (!IsWritingRd(op.opcode)) {
+            continue;
+        }
+
+        SymbolicAddress new_address = {};
+        if (op.opcode == IrOpcode::kAddImm) {
+            new_address = {.is_valid = true, .base = op.rs1, .offset = op.imm};
+            if (addresses[op.rs1].is_valid) {
+                new_address.base = addresses[op.rs1].base;
+                new_address.offset += addresses[op.rs1].offset;
+            }
+
+            new_address.is_valid = new_address.base != op.rd;
+        }
+
+        for (SymbolicAddress& address : addresses) {
+            if (address.is_valid && address.base == op.rd) {
+                address.is_valid = false;
+            }
+        }
+
+        addresses[op.rd] = op.rd == RegisterAliases::kMachineZero ? SymbolicAddress{} : new_address;
+    }
+}
+
+// every register is live at the block end, loads are never removed
+static void EliminateDeadWrites(std::vector<IrOp>* ops, IrStats* stats) {
+    LogFunctionEntry();
+
+    static_assert(kNumberOfRegisters <= sizeof(uint32_t) * CHAR_BIT);
+
+    const uint32_t kAllLive = ~0u;
+    uint32_t live = kAllLive;
+    std::vector<bool> is_dead(ops->size(), false);
+
+    for (size_t op_i = ops->size(); op_i-- > 0;) {
+        const IrOp& op = (*ops)[op_i];
+
+        if (op.opcode == IrOpcode::kGuest) {
+            live = kAllLive;
+            continue;
+        }
+
+        if (IsWritingRd(op.opcode)) {
+            bool is_live = (live >> op.rd) & 1u;
+            if (!IsIrLoadOp(op.opcode) && (op.rd == RegisterAliases::kMachineZero || !is_live)) {
+                is_dead[op_i] = true;
+                stats->n_dead_writes++;
+                continue;
+            }
+
+            live &= ~(1u << op.rd);
+        }
+
+        if (op.opcode != IrOpcode::kLoadImm) {
+            live |= 1u << op.rs1;
+        }
+        if (IsIrAluRegOp(op.opcode) || IsIrStoreOp(op.opcode)) {
+            live |= 1u << op.rs2;
+        }
+    }
+
+    size_t write_i = 0;
+    for (size_t read_i = 0; read_i < ops->size(); read_i++) {
+        if (!is_dead[read_i]) {
+            (*ops)[write_i++] = (*ops)[read_i];
+        }
+    }
+
+    ops->resize(write_i);
+}
+
+} // namespace sim
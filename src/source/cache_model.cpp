@@ -0,0 +1,280 @@
+#include "cache_model.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+
+#include "log_helper.hpp"
+
+#include "function_map.hpp"
+
+namespace sim {
+
+// Cache private --------------------------------------------------------------
+
+size_t Cache::ChooseVictim(const size_t set_start) {
+    for (size_t way = 0; way < config_.associativity; way++) {
+        if (lines_[set_start + way] == kInvalidLine) {
+            return set_start + way;
+        }
+    }
+
+    if (config_.policy == ReplacementPolicy::kRandom) {
+        // xorshift64
+        random_state_ ^= random_state_ << 13u;
+        random_state_ ^= random_state_ >> 7u;
+        random_state_ ^= random_state_ << 17u;
+
+        return set_start + random_state_ % config_.associativity;
+    }
+
+    size_t victim = set_start;
+    for (size_t way = 1; way < config_.associativity; way++) {
+        if (stamps_[set_start + way] < stamps_[victim]) {
+            victim = set_start + way;
+        }
+    }
+
+    return victim;
+}
+
+// Cache public ---------------------------------------------------------------
+
+void Cache::Init(const CacheConfig& config) {
+    LogFunctionEntry();
+
+    assert(IsValidCacheConfig(config));
+
+    config_ = config;
+    line_shift_ = std::countr_zero(config_.line_size);
+
+    size_t n_lines = config_.size / config_.line_size;
+    set_mask_ = n_lines / config_.associativity - 1;
+
+    lines_.assign(n_lines, kInvalidLine);
+    stamps_.assign(n_lines, 0);
+    dirty_.assign(n_lines, 0);
+
+    clock_ = 0;
+    random_state_ = 0x9E3779B97F4A7C15ull;
+
+    std::memset(&stats_, 0, sizeof(stats_));
+}
+
+bool Cache::Access(const uint64_t line, const bool is_write, uint64_t* writeback_line) {
+    assert(writeback_line != nullptr);
+
+    stats_.accesses++;
+    clock_++;
+
+    const size_t set_start = (line & set_mask_) * config_.associativity;
+    for (size_t way = 0; way < config_.associativity; way++) {
+        size_t slot = set_start + way;
+        if (lines_[slot] != line) {
+            continue;
+        }
+
+        if (config_.policy == ReplacementPolicy::kLru) {
+            stamps_[slot] = clock_;
+        }
+        dirty_[slot] |= is_write;
+
+        *writeback_line = kInvalidLine;
+        return true;
+    }
+
+    stats_.misses++;
+
+    size_t victim = ChooseVictim(set_start);
+    if (lines_[victim] != kInvalidLine && dirty_[victim]) {
+        stats_.writebacks++;
+        *writeback_line = lines_[victim];
+    } else {
+        *writeback_line = kInvalidLine;
+    }
+
+    lines_[victim] = line;
+    stamps_[victim] = clock_;
+    dirty_[victim] = is_write;
+
+    return false;
+}
+
+const CacheConfig& Cache::GetConfig() const {
+    return config_;
+}
+
+const CacheStats& Cache::GetStats() const {
+    return stats_;
+}
+
+// CacheHierarchy private -----------------------------------------------------
+
+void CacheHierarchy::AccessData(const MemAddress address, const size_t size, const bool is_write) {
+    const size_t line_shift = l1d_.GetLineShift();
+    const uint64_t first_line = address >> line_shift;
+    const uint64_t last_line = (static_cast<uint64_t>(address) + size - 1) >> line_shift;
+
+    FunctionCacheStats& func_stats = function_stats_[current_function_];
+
+    for (uint64_t line = first_line; line <= last_line; line++) {
+        func_stats.accesses[kL1d]++;
+
+        uint64_t writeback_line = 0;
+        bool is_hit = l1d_.Access(line, is_write, &writeback_line);
+
+        if (writeback_line != UINT64_MAX) {
+            AccessL2(writeback_line << line_shift, true);
+        }
+
+        if (!is_hit) {
+            func_stats.misses[kL1d]++;
+            AccessL2(line << line_shift, false);
+        }
+    }
+}
+
+// takes address as l1 and l2 line sizes may differ
+void CacheHierarchy::AccessL2(const uint64_t address, const bool is_write) {
+    FunctionCacheStats& func_stats = function_stats_[current_function_];
+    func_stats.accesses[kL2]++;
+
+    uint64_t writeback_line = 0;
+    if (!l2_.Access(address >> l2_.GetLineShift(), is_write, &writeback_line)) {
+        func_stats.misses[kL2]++;
+    }
+}
+
+// CacheHierarchy public ------------------------------------------------------
+
+void CacheHierarchy::Init(const CacheConfig& l1i, const CacheConfig& l1d, const CacheConfig& l2, 
+                          const FunctionMap* function_map) {
+    LogFunctionEntry();
+
+    assert(function_map != nullptr);
+
+    l1i_.Init(l1i);
+    l1d_.Init(l1d);
+    l2_.Init(l2);
+
+    function_map_ = function_map;
+    current_function_ = FunctionMap::kUnknownFunction;
+    function_stats_.assign(function_map_->GetNFunctions(), FunctionCacheStats{});
+
+    last_fetch_line_ = UINT64_MAX;
+}
+
+void CacheHierarchy::OnFetch(const MemAddress pc) {
+    current_function_ = function_map_->Lookup(pc);
+
+    FunctionCacheStats& func_stats = function_stats_[current_function_];
+    func_stats.accesses[kL1i]++;
+
+    // straight line code keeps fetching from the most recently used line,
+    // such fetch is a hit that does not change the replacement state
+    const uint64_t line = pc >> l1i_.GetLineShift();
+    if (line == last_fetch_line_) {
+        return ;
+    }
+    last_fetch_line_ = line;
+
+    uint64_t writeback_line = 0;
+    if (!l1i_.Access(line, false, &writeback_line)) {
+        func_stats.misses[kL1i]++;
+        AccessL2(line << l1i_.GetLineShift(), false);
+    }
+}
+
+void CacheHierarchy::OnRead(const MemAddress address, const size_t size) {
+    AccessData(address, size, false);
+}
+
+void CacheHierarchy::OnWrite(const MemAddress address, const size_t size) {
+    AccessData(address, size, true);
+}
+
+void CacheHierarchy::Report(FILE* report_file) const {
+    LogFunctionEntry();
+
+    assert(report_file != nullptr);
+
+    const char* level_names[kNLevels] = {"L1I", "L1D", "L2"};
+    const Cache* levels[kNLevels] = {&l1i_, &l1d_, &l2_};
+
+    // the fast path of OnFetch does not reach the cache, so l1i accesses come from function stats
+    uint64_t total_accesses[kNLevels] = {};
+    for (const FunctionCacheStats& func_stats : function_stats_) {
+        for (size_t level = 0; level < kNLevels; level++) {
+            total_accesses[level] += func_stats.accesses[level];
+        }
+    }
+
+    std::fprintf(report_file, "Cache model report:\n");
+    for (size_t level = 0; level < kNLevels; level++) {
+        const CacheConfig& config = levels[level]->GetConfig();
+        const CacheStats& stats = levels[level]->GetStats();
+        uint64_t accesses = total_accesses[level];
+
+        std::fprintf(report_file, "  %-3s %7zuB %2zu-way %3zuB lines %-6s: accesses %12llu, misses %12llu (%6.2f%%), writebacks %llu\n",
+                     level_names[level], config.size, config.associativity, config.line_size,
+                     ReplacementPolicyToStr(config.policy),
+                     static_cast<unsigned long long>(accesses),
+                     static_cast<unsigned long long>(stats.misses),
+                     accesses == 0 ? 0.0 : 100.0 * static_cast<double>(stats.misses) / static_cast<double>(accesses),
+                     static_cast<unsigned long long>(stats.writebacks));
+    }
+
+    std::vector<size_t> function_ids;
+    for (size_t id = 0; id < function_stats_.size(); id++) {
+        if (function_stats_[id].accesses[kL1i] != 0 || function_stats_[id].accesses[kL1d] != 0) {
+            function_ids.push_back(id);
+        }
+    }
+
+    auto total_misses = [this](size_t id) {
+        const FunctionCacheStats& func_stats = function_stats_[id];
+        return func_stats.misses[kL1i] + func_stats.misses[kL1d] + func_stats.misses[kL2];
+    };
+    std::stable_sort(function_ids.begin(), function_ids.end(), 
+                     [&](size_t lhs, size_t rhs) { return total_misses(lhs) > total_misses(rhs); });
+
+    std::fprintf(report_file, "  %-24s %12s %10s %12s %10s %12s %10s\n", 
+                 "function", "L1I acc", "L1I miss", "L1D acc", "L1D miss", "L2 acc", "L2 miss");
+    for (size_t id : function_ids) {
+        const FunctionCacheStats& func_stats = function_stats_[id];
+        std::fprintf(report_file, "  %-24s %12llu %10llu %12llu %10llu %12llu %10llu\n", 
+                     function_map_->GetName(id).c_str(),
+                     static_cast<unsigned long long>(func_stats.accesses[kL1i]),
+                     static_cast<unsigned long long>(func_stats.misses[kL1i]),
+                     static_cast<unsigned long long>(func_stats.accesses[kL1d]),
+                     static_cast<unsigned long long>(func_stats.misses[kL1d]),
+                     static_cast<unsigned long long>(func_stats.accesses[kL2]),
+                     static_cast<unsigned long long>(func_stats.misses[kL2]));
+    }
+}
+
+// global ---------------------------------------------------------------------
+
+bool IsValidCacheConfig(const CacheConfig& config) {
+    if (!std::has_single_bit(config.size) 
+        || !std::has_single_bit(config.associativity) 
+        || !std::has_single_bit(config.line_size)) {
+        return false;
+    }
+
+    return config.line_size >= sizeof(uint32_t) && config.associativity * config.line_size <= config.size;
+}
+
+const char* ReplacementPolicyToStr(ReplacementPolicy policy) {
+    switch (policy) {
+        case ReplacementPolicy::kLru:    return "lru";
+        case ReplacementPolicy::kFifo:   return "fifo";
+        case ReplacementPolicy::kRandom: return "random";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+} // namespace sim
@@ -0,0 +1,387 @@
+#include "control_flow_graph.hpp"
+
+#include <cassert>
+#include <chrono>
+#include <cinttypes>
+#include <cstdio>
+#include <utility>
+
+#include "log_helper.hpp"
+
+#include "block_cache.hpp"
+#include "cpu_defs.hpp"
+#include "decode.hpp"
+#include "instructions.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+// constants built in registers since the start of scanned block
+struct KnownRegisters {
+    Register values[kNumberOfRegisters];
+    uint32_t known_mask; // bit per register, x0 is always known
+
+    bool IsKnown(const Register reg_id) const { return (known_mask >> reg_id) & 1u; }
+};
+
+static void TrackConstants(const Address pc, const DecodedInstr& dec_instr, KnownRegisters* known);
+static void SetKnown(const Register reg_id, const Register value, KnownRegisters* known);
+static void SetUnknown(const Register reg_id, KnownRegisters* known);
+
+// ControlFlowGraph private ---------------------------------------------------
+
+// blocks are scanned from their leaders up to a terminator, call targets
+// start new functions, other targets continue the current one
+void ControlFlowGraph::DiscoverLeaders(const ploader::IProgramLoader& ploader, const DecodeTable& decode_table,
+                                       std::map<Address, Address>* leaders) {
+    LogFunctionEntry();
+
+    assert(leaders != nullptr);
+
+    // symbols of any type in code are likely targets, asm labels have no type
+    std::unordered_map<Address, const std::string*> code_symbols;
+    for (const ploader::Symbol& symbol : ploader.GetSymbols()) {
+        if (decode_table.Find(static_cast<Address>(symbol.addr)) != nullptr) {
+            code_symbols.emplace(static_cast<Address>(symbol.addr), &symbol.name);
+        }
+    }
+
+    std::vector<std::pair<Address, Address>> worklist; // leader, function it belongs to
+    auto add_function = [&](const Address function_pc) {
+        auto symbol_it = code_symbols.find(function_pc);
+        char name[2 + 8 + 4 + 1] = {};
+        std::snprintf(name, sizeof(name), "sub_%08" PRIx32, function_pc);
+        if (functions_.emplace(function_pc, symbol_it != code_symbols.end() ? *symbol_it->second : name).second) {
+            worklist.emplace_back(function_pc, function_pc);
+        }
+    };
+
+    for (const ploader::Symbol& symbol : ploader.GetSymbols()) {
+        if (symbol.is_function) {
+            add_function(static_cast<Address>(symbol.addr));
+        }
+    }
+    add_function(static_cast<Address>(ploader.GetEntryPoint()));
+
+    while (!worklist.empty()) {
+        auto [start_pc, function_pc] = worklist.back();
+        worklist.pop_back();
+
+        if (decode_table.Find(start_pc) == nullptr || !leaders->emplace(start_pc, function_pc).second) {
+            continue;
+        }
+
+        KnownRegisters known = {.values = {}, .known_mask = 1u};
+        for (Address pc = start_pc; ; pc += kInstrSize) {
+            const DecodedInstr* dec_instr = decode_table.Find(pc);
+            if (dec_instr == nullptr) {
+                break;
+            }
+
+            // rest of the code was scanned from that leader
+            if (pc != start_pc && leaders->contains(pc)) {
+                worklist.emplace_back(pc, function_pc);
+                break;
+            }
+
+            if (dec_instr->instr_mnem == InstructionMnemonic::kJalr && known.IsKnown(dec_instr->instr.i_type.rs1)) {
+                Register base = known.values[dec_instr->instr.i_type.rs1];
+                Register offset = SignExtendImm(dec_instr->instr.i_type.imm, dec_instr->instr.i_type.imm_size_bit);
+                jalr_targets_[pc] = (base + offset) & ~static_cast<Address>(1);
+            }
+
+            if (IsBlockTerminator(dec_instr->instr_mnem)) {
+                CfgBlock block = {};
+                CollectSuccessors(pc, *dec_instr, &block);
+                for (const CfgEdge& edge : block.successors) {
+                    if (edge.kind == CfgEdgeKind::kCall) {
+                        add_function(edge.to);
+                    } else {
+                        worklist.emplace_back(edge.to, function_pc);
+                    }
+                }
+                break;
+            }
+
+            TrackConstants(pc, *dec_instr, &known);
+
+            // address of a code symbol is loaded to be called through a register
+            if (dec_instr->instr_mnem == InstructionMnemonic::kAddi || dec_instr->instr_mnem == InstructionMnemonic::kLui
+                || dec_instr->instr_mnem == InstructionMnemonic::kAuipc) {
+                Register rd = dec_instr->instr_mnem == InstructionMnemonic::kAddi ? dec_instr->instr.i_type.rd
+                                                                                  : dec_instr->instr.u_type.rd;
+                if (known.IsKnown(rd) && code_symbols.contains(known.values[rd])) {
+                    add_function(known.values[rd]);
+                }
+            }
+        }
+    }
+}
+
+void ControlFlowGraph::FormBlocks(const DecodeTable& decode_table, const std::map<Address, Address>& leaders) {
+    LogFunctionEntry();
+
+    for (const auto& [start_pc, function_pc] : leaders) {
+        CfgBlock block = {
+            .start_pc = start_pc,
+            .end_pc = start_pc,
+            .function_pc = function_pc,
+            .successors = {},
+            .has_unknown_successors = false,
+        };
+
+        // block running into a word that is not an instruction has no successors
+        const DecodedInstr* dec_instr = decode_table.Find(start_pc);
+        while (dec_instr != nullptr) {
+            const Address pc = block.end_pc;
+            block.end_pc += kInstrSize;
+
+            if (IsBlockTerminator(dec_instr->instr_mnem)) {
+                CollectSuccessors(pc, *dec_instr, &block);
+                break;
+            }
+
+            if (leaders.contains(block.end_pc)) {
+                block.successors.push_back({.to = block.end_pc, .kind = CfgEdgeKind::kFallThrough});
+                break;
+            }
+
+            dec_instr = decode_table.Find(block.end_pc);
+        }
+
+        n_edges_ += block.successors.size();
+        blocks_.emplace(start_pc, std::move(block));
+    }
+}
+
+// taken edges go first, so engines linking a limited number of successors
+// prefer them over return sites
+void ControlFlowGraph::CollectSuccessors(const Address pc, const DecodedInstr& dec_instr, CfgBlock* block) const {
+    assert(block != nullptr);
+
+    const Address next_pc = pc + kInstrSize;
+    switch (dec_instr.instr_mnem) {
+        case InstructionMnemonic::kBeq:
+        case InstructionMnemonic::kBne:
+        case InstructionMnemonic::kBlt:
+        case InstructionMnemonic::kBge:
+        case InstructionMnemonic::kBltu:
+        case InstructionMnemonic::kBgeu: {
+            Address target = pc + SignExtendImm(dec_instr.instr.b_type.imm, dec_instr.instr.b_type.imm_size_bit);
+            block->successors.push_back({.to = target, .kind = CfgEdgeKind::kTaken});
+            block->successors.push_back({.to = next_pc, .kind = CfgEdgeKind::kFallThrough});
+        }
+        break;
+
+        case InstructionMnemonic::kJal: {
+            Address target = pc + SignExtendImm(dec_instr.instr.j_type.imm, dec_instr.instr.j_type.imm_size_bit);
+            if (dec_instr.instr.j_type.rd != RegisterAliases::kMachineZero) {
+                block->successors.push_back({.to = target, .kind = CfgEdgeKind::kCall});
+                block->successors.push_back({.to = next_pc, .kind = CfgEdgeKind::kFallThrough});
+            } else {
+                block->successors.push_back({.to = target, .kind = CfgEdgeKind::kJump});
+            }
+        }
+        break;
+
+        case InstructionMnemonic::kJalr: {
+            const bool is_call = dec_instr.instr.i_type.rd != RegisterAliases::kMachineZero;
+            auto target_it = jalr_targets_.find(pc);
+            if (target_it != jalr_targets_.end()) {
+                block->successors.push_back({.to = target_it->second, .kind = is_call ? CfgEdgeKind::kCall : CfgEdgeKind::kIndirect});
+            } else {
+                block->has_unknown_successors = true;
+            }
+
+            if (is_call) {
+                block->successors.push_back({.to = next_pc, .kind = CfgEdgeKind::kFallThrough});
+            }
+        }
+        break;
+
+        // emulated routine returns to its caller
+        case InstructionMnemonic::kHleCall:
+            block->has_unknown_successors = true;
+            break;
+
+        case InstructionMnemonic::kUnkownMnem:
+            break;
+
+        default:
+            // system instructions and fence.i continue with the next one
+            block->successors.push_back({.to = next_pc, .kind = CfgEdgeKind::kFallThrough});
+            break;
+    }
+}
+
+// ControlFlowGraph public ----------------------------------------------------
+
+void ControlFlowGraph::Init(const ploader::IProgramLoader& ploader, const DecodeTable& decode_table) {
+    LogFunctionEntry();
+
+    blocks_.clear();
+    functions_.clear();
+    jalr_targets_.clear();
+    n_edges_ = 0;
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    std::map<Address, Address> leaders;
+    DiscoverLeaders(ploader, decode_table, &leaders);
+    FormBlocks(decode_table, leaders);
+
+    auto build_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time);
+    spdlog::info("Recovered control flow graph in {} us: {} functions, {} blocks, {} edges, {} jalr targets",
+                 build_time.count(), functions_.size(), blocks_.size(), n_edges_, jalr_targets_.size());
+}
+
+const std::map<Address, CfgBlock>& ControlFlowGraph::GetBlocks() const {
+    return blocks_;
+}
+
+const CfgBlock* ControlFlowGraph::FindBlock(const Address pc) const {
+    auto block_it = blocks_.upper_bound(pc);
+    if (block_it == blocks_.begin()) {
+        return nullptr;
+    }
+
+    --block_it;
+    return pc < block_it->second.end_pc ? &block_it->second : nullptr;
+}
+
+size_t ControlFlowGraph::GetNFunctions() const {
+    return functions_.size();
+}
+
+size_t ControlFlowGraph::GetNEdges() const {
+    return n_edges_;
+}
+
+// blocks with unknown successors are drawn with double border
+CfgError ControlFlowGraph::DumpDot(const std::string& path) const {
+    LogFunctionEntry();
+
+    FILE* dot_file = std::fopen(path.c_str(), "w");
+    if (dot_file == nullptr) {
+        spdlog::error("Cant open control flow graph file: {}", path);
+        return CfgError::kCantOpenFile;
+    }
+
+    std::map<Address, std::vector<const CfgBlock*>> function_blocks;
+    for (const auto& [start_pc, block] : blocks_) {
+        function_blocks[block.function_pc].push_back(&block);
+    }
+
+    std::fprintf(dot_file, "digraph cfg {\n");
+    std::fprintf(dot_file, "    node [shape=box, fontname=\"monospace\"];\n");
+    for (const auto& [function_pc, blocks] : function_blocks) {
+        auto function_it = functions_.find(function_pc);
+        std::fprintf(dot_file, "    subgraph \"cluster_%08" PRIx32 "\" {\n", function_pc);
+        std::fprintf(dot_file, "        label=\"%s\";\n", function_it != functions_.end() ? function_it->second.c_str() : "?");
+        for (const CfgBlock* block : blocks) {
+            std::fprintf(dot_file, "        \"%08" PRIx32 "\" [label=\"%08" PRIx32 "-%08" PRIx32 "\"%s];\n",
+                         block->start_pc, block->start_pc, block->end_pc, block->has_unknown_successors ? ", peripheries=2" : "");
+        }
+        std::fprintf(dot_file, "    }\n");
+    }
+
+    for (const auto& [start_pc, block] : blocks_) {
+        for (const CfgEdge& edge : block.successors) {
+            const char* style = "solid";
+            switch (edge.kind) {
+                case CfgEdgeKind::kFallThrough: style = "solid";  break;
+                case CfgEdgeKind::kTaken:       style = "bold";   break;
+                case CfgEdgeKind::kJump:        style = "bold";   break;
+                case CfgEdgeKind::kCall:        style = "dashed"; break;
+                case CfgEdgeKind::kIndirect:    style = "dotted"; break;
+            }
+            std::fprintf(dot_file, "    \"%08" PRIx32 "\" -> \"%08" PRIx32 "\" [style=%s, label=\"%s\"];\n",
+                         start_pc, edge.to, style, CfgEdgeKindToStr(edge.kind));
+        }
+    }
+    std::fprintf(dot_file, "}\n");
+
+    std::fclose(dot_file);
+    return CfgError::kOk;
+}
+
+// global ---------------------------------------------------------------------
+
+const char* CfgErrorToStr(CfgError error) {
+    switch (error) {
+        case CfgError::kOk:           return "no error";
+        case CfgError::kCantOpenFile: return "cant open file";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+const char* CfgEdgeKindToStr(CfgEdgeKind kind) {
+    switch (kind) {
+        case CfgEdgeKind::kFallThrough: return "fall";
+        case CfgEdgeKind::kTaken:       return "taken";
+        case CfgEdgeKind::kJump:        return "jump";
+        case CfgEdgeKind::kCall:        return "call";
+        case CfgEdgeKind::kIndirect:    return "indirect";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+// any other write of an x register makes it unknown
+static void TrackConstants(const Address pc, const DecodedInstr& dec_instr, KnownRegisters* known) {
+    assert(known != nullptr);
+
+    switch (dec_instr.instr_mnem) {
+        case InstructionMnemonic::kLui:
+            SetKnown(dec_instr.instr.u_type.rd, dec_instr.instr.u_type.imm << 12u, known);
+            return;
+        case InstructionMnemonic::kAuipc:
+            SetKnown(dec_instr.instr.u_type.rd, pc + (dec_instr.instr.u_type.imm << 12u), known);
+            return;
+        case InstructionMnemonic::kAddi:
+            if (known->IsKnown(dec_instr.instr.i_type.rs1)) {
+                Register imm = SignExtendImm(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit);
+                SetKnown(dec_instr.instr.i_type.rd, known->values[dec_instr.instr.i_type.rs1] + imm, known);
+            } else {
+                SetUnknown(dec_instr.instr.i_type.rd, known);
+            }
+            return;
+        default:
+            break;
+    }
+
+    switch (dec_instr.instr_type) {
+        case InstrType::RType: SetUnknown(dec_instr.instr.r_type.rd, known); break;
+        case InstrType::IType: SetUnknown(dec_instr.instr.i_type.rd, known); break;
+        case InstrType::UType: SetUnknown(dec_instr.instr.u_type.rd, known); break;
+        case InstrType::JType: SetUnknown(dec_instr.instr.j_type.rd, known); break;
+        case InstrType::SType:
+        case InstrType::BType:
+            break;
+        default:
+            // vector and floating point instructions may write x registers too
+            known->known_mask = 1u;
+            break;
+    }
+}
+
+static void SetKnown(const Register reg_id, const Register value, KnownRegisters* known) {
+    if (reg_id != RegisterAliases::kMachineZero) {
+        known->values[reg_id] = value;
+        known->known_mask |= 1u << reg_id;
+    }
+}
+
+static void SetUnknown(const Register reg_id, KnownRegisters* known) {
+    if (reg_id != RegisterAliases::kMachineZero) {
+        known->known_mask &= ~(1u << reg_id);
+    }
+}
+
+} // namespace sim
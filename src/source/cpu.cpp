@@ -6,8 +6,6 @@
 #include <cstring>
 #include <climits>
 
-#include <unistd.h>
-
 #include "log_helper.hpp"
 
 #include "imemory.hpp"
@@ -21,62 +19,85 @@ namespace sim {
 
 // static ---------------------------------------------------------------------
 
-static IRegister SignExtension(const Register uvalue, const size_t starting_bit);
-static IRegister RegToIReg(const Register uvalue);
-static Register IRegToReg(const IRegister value);
-static Register ArithmRightShift(const Register value, const size_t shift);
-
 static const char* OpcodeToInstrMnemotic(InstructionOpcodes instr_opcode);
 
-// Cpu private ----------------------------------------------------------------
+// BasicCpu private -----------------------------------------------------------
 
-InstructionError Cpu::SyscallHandler() {
+template <size_t kXlen>
+InstructionError BasicCpu<kXlen>::HandleSyscall() {
     LogFunctionEntry();
 
-    spdlog::trace("Syscall number: {}", registers_[RegisterAliases::kArgument7]);
-    for (size_t i = 0; i <= 7; i++) {
-        spdlog::trace("arg{}: {}", i, registers_[RegisterAliases::kArgument0 + i]);
+    assert(syscall_handler_ != nullptr);
+
+    // rv64 guests get rv32 syscall abi: arguments are truncated, result is sign extended
+    SyscallArgs args = {};
+    for (size_t arg_i = 0; arg_i < kNSyscallArgs; arg_i++) {
+        args[arg_i] = static_cast<uint32_t>(GetRegisterValue(RegisterAliases::kArgument0 + arg_i));
     }
 
-    Register syscall_id = registers_[kSyscallIdRegister];
-    switch (syscall_id) {
-        case SyscallIds::kRead: {
-            Register fd_to_read = GetRegisterValue(RegisterAliases::kArgument0);
-            uint8_t* buffer = memory_->GetData() + GetRegisterValue(RegisterAliases::kArgument1);
-            size_t buffer_size = GetRegisterValue(RegisterAliases::kArgument2);
-           
-            ssize_t ret_value = read(fd_to_read, buffer, buffer_size);
-            SetRegisterValue(RegisterAliases::kArgument0, ret_value);
-        }
-        break;
-        case SyscallIds::kWrite: {
-            Register fd_to_write = GetRegisterValue(RegisterAliases::kArgument0);
-            uint8_t* buffer = memory_->GetData() + GetRegisterValue(RegisterAliases::kArgument1);
-            size_t buffer_size = GetRegisterValue(RegisterAliases::kArgument2);
+    sim::Register ret_value = 0;
+    const sim::Register syscall_id = static_cast<uint32_t>(GetRegisterValue(kSyscallIdRegister));
+    SyscallError err = syscall_handler_->Handle(syscall_id, args, &ret_value);
+    SetRegisterValue(RegisterAliases::kArgument0, SignExtendWord(ret_value));
 
-            LogVar(fd_to_write);
-            LogVar((void*)buffer);
-            LogVar(buffer_size);
+    if (syscall_handler_->GetIsExited()) {
+        SetIsFinished(true);
+    }
 
-            ssize_t ret_value = write(fd_to_write, buffer, buffer_size);
-            SetRegisterValue(RegisterAliases::kArgument0, ret_value);
-        }
-        break;
-        case SyscallIds::kExit: {
-            SetIsFinished(true);
-        }
-        break;
+    return err == SyscallError::kOk ? InstructionError::kOk : InstructionError::kUnknownInstruction;
+}
+
+// csr is read before write, immediate forms take uimm5 from rs1 field
+template <size_t kXlen>
+InstructionError BasicCpu<kXlen>::ExecuteCsr(const DecodedInstr& dec_instr) {
+    LogFunctionEntry();
+
+    const InstructionMnemonic mnemonic = dec_instr.instr_mnem;
+    const Register csr = dec_instr.instr.i_type.imm;
+    const Register rs1 = dec_instr.instr.i_type.rs1;
+
+    const bool is_imm = mnemonic == InstructionMnemonic::kCsrrwi
+                     || mnemonic == InstructionMnemonic::kCsrrsi
+                     || mnemonic == InstructionMnemonic::kCsrrci;
+    const Register operand = is_imm ? rs1 : GetRegisterValue(rs1);
+
+    Register old_value = 0;
+    if (!ReadCsr(csr, &old_value)) {
+        spdlog::error("Unknown csr 0x{:x}", csr);
+        return InstructionError::kUnknownInstruction;
+    }
+
+    Register new_value = old_value;
+    switch (mnemonic) {
+        case InstructionMnemonic::kCsrrw:
+        case InstructionMnemonic::kCsrrwi: new_value = operand;              break;
+        case InstructionMnemonic::kCsrrs:
+        case InstructionMnemonic::kCsrrsi: new_value = old_value | operand;  break;
+        case InstructionMnemonic::kCsrrc:
+        case InstructionMnemonic::kCsrrci: new_value = old_value & ~operand; break;
         default:
-            spdlog::error("Unknown syscall");
+            assert(0 && "not a csr instruction");
             return InstructionError::kUnknownInstruction;
     }
 
+    // set and clear with x0 or zero uimm do not write, so counters stay readable by them
+    const bool is_write = mnemonic == InstructionMnemonic::kCsrrw
+                       || mnemonic == InstructionMnemonic::kCsrrwi
+                       || rs1 != 0;
+    if (is_write && !WriteCsr(csr, new_value)) {
+        spdlog::error("Write to read-only csr 0x{:x}", csr);
+        return InstructionError::kUnknownInstruction;
+    }
+
+    SetRegisterValue(dec_instr.instr.i_type.rd, old_value);
+
     return InstructionError::kOk;
 }
 
-// Cpu public -----------------------------------------------------------------
+// BasicCpu public ------------------------------------------------------------
 
-void Cpu::Init(size_t entry_point, IMemory* memory) {
+template <size_t kXlen>
+void BasicCpu<kXlen>::Init(size_t entry_point, IMemory* memory) {
     LogFunctionEntry();
 
     assert(memory != nullptr);
@@ -91,21 +112,33 @@ void Cpu::Init(size_t entry_point, IMemory* memory) {
     spdlog::debug("Cpu init pc: {:x}({})", pc_, pc_);
 
     is_finished_ = false;
+    vector_unit_.Init(kMinVlen);
+    fpu_.Init();
+    instret_base_ = 0;
+    instret_base_pc_ = pc_;
+    hart_id_ = 0;
+
+    edge_profiler_ = nullptr;
+    syscall_handler_ = nullptr;
+    hle_ = nullptr;
 }
 
-Register Cpu::GetPc() const {
+template <size_t kXlen>
+typename BasicCpu<kXlen>::Register BasicCpu<kXlen>::GetPc() const {
     LogFunctionEntry();
 
     return pc_;
 }
 
-void Cpu::SetPc(const Register new_pc) {
+template <size_t kXlen>
+void BasicCpu<kXlen>::SetPc(const Register new_pc) {
     LogFunctionEntry();
 
     pc_ = new_pc;
 }
 
-Register Cpu::GetRegisterValue(const size_t register_id) const {
+template <size_t kXlen>
+typename BasicCpu<kXlen>::Register BasicCpu<kXlen>::GetRegisterValue(const size_t register_id) const {
     assert(register_id < kNumberOfRegisters);
 
     LogFunctionEntry();
@@ -117,7 +150,8 @@ Register Cpu::GetRegisterValue(const size_t register_id) const {
     return registers_[register_id];
 }
 
-void Cpu::SetRegisterValue(const size_t register_id, const Register new_value) {
+template <size_t kXlen>
+void BasicCpu<kXlen>::SetRegisterValue(const size_t register_id, const Register new_value) {
     assert(register_id < kNumberOfRegisters);
 
     LogFunctionEntry();
@@ -129,19 +163,66 @@ void Cpu::SetRegisterValue(const size_t register_id, const Register new_value) {
     registers_[register_id] = new_value;
 }
 
-bool Cpu::GetIsFinished() const {
+template <size_t kXlen>
+void BasicCpu<kXlen>::SetEdgeProfiler(EdgeProfiler* edge_profiler) {
+    LogFunctionEntry();
+
+    edge_profiler_ = edge_profiler;
+}
+
+template <size_t kXlen>
+void BasicCpu<kXlen>::SetSyscallHandler(SyscallHandler* syscall_handler) {
+    LogFunctionEntry();
+
+    syscall_handler_ = syscall_handler;
+}
+
+template <size_t kXlen>
+void BasicCpu<kXlen>::SetHleLayer(HleLayer* hle) {
+    LogFunctionEntry();
+
+    hle_ = hle;
+}
+
+template <size_t kXlen>
+void BasicCpu<kXlen>::SetVlen(const size_t vlen) {
+    LogFunctionEntry();
+
+    vector_unit_.Init(vlen);
+}
+
+template <size_t kXlen>
+void BasicCpu<kXlen>::SetHartId(const Register hart_id) {
+    LogFunctionEntry();
+
+    hart_id_ = hart_id;
+}
+
+template <size_t kXlen>
+void BasicCpu<kXlen>::SetMemory(IMemory* memory) {
+    LogFunctionEntry();
+
+    assert(memory != nullptr);
+
+    memory_ = memory;
+}
+
+template <size_t kXlen>
+bool BasicCpu<kXlen>::GetIsFinished() const {
     LogFunctionEntry();
     
     return is_finished_;    
 }
 
-void Cpu::SetIsFinished(const bool is_finished) {
+template <size_t kXlen>
+void BasicCpu<kXlen>::SetIsFinished(const bool is_finished) {
     LogFunctionEntry();
 
     is_finished_ = is_finished;
 }
 
-void Cpu::Dump() const {
+template <size_t kXlen>
+void BasicCpu<kXlen>::Dump() const {
     LogFunctionEntry();
     
     spdlog::info("");
@@ -161,59 +242,153 @@ void Cpu::Dump() const {
 
     spdlog::info("");
 
+    vector_unit_.Dump();
+    fpu_.Dump();
+
     spdlog::info("Has finished: {}", is_finished_ ? "true" : "false");
 }
 
-InstructionError Cpu::Execute(DecodedInstr dec_instr) {
+template <size_t kXlen>
+bool BasicCpu<kXlen>::ReadCsr(const Register csr, Register* value) const {
+    LogFunctionEntry();
+
+    assert(value != nullptr);
+
+    // one cycle and one time tick per retired instruction keep guest timing deterministic
+    const uint64_t n_retired = GetRetiredInstrs();
+    switch (csr) {
+        case FpCsr::kCsrFflags:
+        case FpCsr::kCsrFrm:
+        case FpCsr::kCsrFcsr:
+            if constexpr (kXlen == 32) {
+                return fpu_.ReadCsr(csr, value);
+            }
+            return false;
+        case CounterCsr::kCsrCycle:
+        case CounterCsr::kCsrTime:
+        case CounterCsr::kCsrInstret:
+            *value = static_cast<Register>(n_retired);
+            return true;
+        case CounterCsr::kCsrCycleh:
+        case CounterCsr::kCsrTimeh:
+        case CounterCsr::kCsrInstreth:
+            // whole counter is read at once in rv64
+            if constexpr (kXlen == 64) {
+                return false;
+            }
+            *value = static_cast<Register>(n_retired >> 32u);
+            return true;
+        case HartCsr::kCsrMhartid:
+            *value = hart_id_;
+            return true;
+        default:
+            return false;
+    }
+}
+
+template <size_t kXlen>
+bool BasicCpu<kXlen>::WriteCsr(const Register csr, const Register value) {
+    LogFunctionEntry();
+
+    switch (csr) {
+        case FpCsr::kCsrFflags:
+        case FpCsr::kCsrFrm:
+        case FpCsr::kCsrFcsr:
+            if constexpr (kXlen == 32) {
+                return fpu_.WriteCsr(csr, value);
+            }
+            return false;
+        default:
+            return false;
+    }
+}
+
+template <size_t kXlen>
+void BasicCpu<kXlen>::SetRetiredInstrs(const uint64_t n_retired, const Address pc) {
+    LogFunctionEntry();
+
+    instret_base_ = n_retired;
+    instret_base_pc_ = pc;
+}
+
+template <size_t kXlen>
+uint64_t BasicCpu<kXlen>::GetRetiredInstrs() const {
+    return instret_base_ + (pc_ - instret_base_pc_) / kInstrSize;
+}
+
+template <size_t kXlen>
+InstructionError BasicCpu<kXlen>::Execute(DecodedInstr dec_instr) {
     LogFunctionEntry();
 
     LogVar(static_cast<Register>(dec_instr.instr_mnem));
     LogVar(pc_);
 
     InstructionError err = InstructionError::kOk;
+    const Register instr_pc = pc_;
+
+    // rv64 decoder does not produce extension instructions
+    if constexpr (kXlen == 32) {
+        // illegal vector instruction is reported and skipped
+        if (dec_instr.instr_type == InstrType::VType) {
+            err = vector_unit_.Execute(dec_instr, this, memory_);
+            pc_ += kInstrSize;
+            return err;
+        }
+
+        // illegal rounding mode is reported and skipped as well
+        if (dec_instr.instr_type == InstrType::FType) {
+            err = fpu_.Execute(dec_instr, this, memory_);
+            pc_ += kInstrSize;
+            return err;
+        }
+    }
 
     switch (dec_instr.instr_mnem) {
         case InstructionMnemonic::kLui: {
-            SetRegisterValue(dec_instr.instr.u_type.rd, dec_instr.instr.u_type.imm << 12u);
-            pc_ += sizeof(Register);
+            SetRegisterValue(dec_instr.instr.u_type.rd, SignExtendWord(dec_instr.instr.u_type.imm << 12u));
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kAuipc: {
-            SetRegisterValue(dec_instr.instr.u_type.rd, (dec_instr.instr.u_type.imm << 12u) + pc_);
-            pc_ += sizeof(Register);
+            SetRegisterValue(dec_instr.instr.u_type.rd, SignExtendWord(dec_instr.instr.u_type.imm << 12u) + pc_);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kJal: {
-            SetRegisterValue(dec_instr.instr.j_type.rd, pc_ + sizeof(Register));
+            SetRegisterValue(dec_instr.instr.j_type.rd, pc_ + kInstrSize);
             Register pc_offset = IRegToReg(SignExtension(dec_instr.instr.j_type.imm, dec_instr.instr.j_type.imm_size_bit - 1));
             LogVar(pc_offset);
             pc_ += pc_offset;
+            RecordTakenBranch(instr_pc);
         }
         break;
         case InstructionMnemonic::kJalr: {
-            Register tmp_pc = pc_ + sizeof(Register); 
+            Register tmp_pc = pc_ + kInstrSize; 
             Register pc_offset = IRegToReg(SignExtension(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit - 1));
             LogVar(pc_offset);
             pc_ = (GetRegisterValue(dec_instr.instr.i_type.rs1) + pc_offset) & (~1);
             SetRegisterValue(dec_instr.instr.i_type.rd, tmp_pc);
+            RecordTakenBranch(instr_pc);
         }
         break;
         case InstructionMnemonic::kBeq: {
             if (!(GetRegisterValue(dec_instr.instr.b_type.rs1) == GetRegisterValue(dec_instr.instr.b_type.rs2))) {
-                pc_ += sizeof(Register);
+                pc_ += kInstrSize;
                 return InstructionError::kOk;
             }
 
             pc_ += IRegToReg(SignExtension(dec_instr.instr.b_type.imm, dec_instr.instr.b_type.imm_size_bit - 1));
+            RecordTakenBranch(instr_pc);
         }
         break;
         case InstructionMnemonic::kBne: {
             if (!(GetRegisterValue(dec_instr.instr.b_type.rs1) != GetRegisterValue(dec_instr.instr.b_type.rs2))) {
-                pc_ += sizeof(Register);
+                pc_ += kInstrSize;
                 return InstructionError::kOk;
             }
 
             pc_ += IRegToReg(SignExtension(dec_instr.instr.b_type.imm, dec_instr.instr.b_type.imm_size_bit - 1));
+            RecordTakenBranch(instr_pc);
         }
         break;
         case InstructionMnemonic::kBlt: {
@@ -221,11 +396,12 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             IRegister rs2_ivalue = RegToIReg(GetRegisterValue(dec_instr.instr.b_type.rs2));
 
             if (!(rs1_ivalue < rs2_ivalue)) {
-                pc_ += sizeof(Register);
+                pc_ += kInstrSize;
                 return InstructionError::kOk;
             }
 
             pc_ += IRegToReg(SignExtension(dec_instr.instr.b_type.imm, dec_instr.instr.b_type.imm_size_bit - 1));
+            RecordTakenBranch(instr_pc);
         }
         break;
         case InstructionMnemonic::kBge: {
@@ -233,53 +409,72 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             IRegister rs2_ivalue = RegToIReg(GetRegisterValue(dec_instr.instr.b_type.rs2));
 
             if (!(rs1_ivalue >= rs2_ivalue)) {
-                pc_ += sizeof(Register);
+                pc_ += kInstrSize;
                 return InstructionError::kOk;
             }
 
             pc_ += IRegToReg(SignExtension(dec_instr.instr.b_type.imm, dec_instr.instr.b_type.imm_size_bit - 1));
+            RecordTakenBranch(instr_pc);
         }
         break;
         case InstructionMnemonic::kBltu: {
             if (!(GetRegisterValue(dec_instr.instr.b_type.rs1) < GetRegisterValue(dec_instr.instr.b_type.rs2))) {
-                pc_ += sizeof(Register);
+                pc_ += kInstrSize;
                 return InstructionError::kOk;
             }
 
             pc_ += IRegToReg(SignExtension(dec_instr.instr.b_type.imm, dec_instr.instr.b_type.imm_size_bit - 1));
+            RecordTakenBranch(instr_pc);
         }
         break;
         case InstructionMnemonic::kBgeu: {
             if (!(GetRegisterValue(dec_instr.instr.b_type.rs1) >= GetRegisterValue(dec_instr.instr.b_type.rs2))) {
-                pc_ += sizeof(Register);
+                pc_ += kInstrSize;
                 return InstructionError::kOk;
             }
 
             pc_ += IRegToReg(SignExtension(dec_instr.instr.b_type.imm, dec_instr.instr.b_type.imm_size_bit - 1));
+            RecordTakenBranch(instr_pc);
         }
         break;
         case InstructionMnemonic::kLb: {
             Address address = GetRegisterValue(dec_instr.instr.i_type.rs1) + IRegToReg(SignExtension(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit - 1));
-            Register loaded_value = IRegToReg(SignExtension(memory_->ReadFromMemory8b(address), sizeof(uint8_t) - 1));
+            Register loaded_value = IRegToReg(SignExtension(memory_->ReadFromMemory8b(address), sizeof(uint8_t) * CHAR_BIT - 1));
             SetRegisterValue(dec_instr.instr.i_type.rd, loaded_value);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kLh: {
             Address address = GetRegisterValue(dec_instr.instr.i_type.rs1) + IRegToReg(SignExtension(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit - 1));
-            Register loaded_value = IRegToReg(SignExtension(memory_->ReadFromMemory16b(address), sizeof(uint16_t) - 1));
+            Register loaded_value = IRegToReg(SignExtension(memory_->ReadFromMemory16b(address), sizeof(uint16_t) * CHAR_BIT - 1));
             SetRegisterValue(dec_instr.instr.i_type.rd, loaded_value);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kLw: {
+            Address address = GetRegisterValue(dec_instr.instr.i_type.rs1) + IRegToReg(SignExtension(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit - 1));
+            Register loaded_value = SignExtendWord(memory_->ReadFromMemory32b(address));
+            SetRegisterValue(dec_instr.instr.i_type.rd, loaded_value);
+
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kLwu: {
             Address address = GetRegisterValue(dec_instr.instr.i_type.rs1) + IRegToReg(SignExtension(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit - 1));
             Register loaded_value = memory_->ReadFromMemory32b(address);
             SetRegisterValue(dec_instr.instr.i_type.rd, loaded_value);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kLd: {
+            Address address = GetRegisterValue(dec_instr.instr.i_type.rs1) + IRegToReg(SignExtension(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit - 1));
+            Register loaded_value = static_cast<Register>(memory_->ReadFromMemory64b(address));
+            SetRegisterValue(dec_instr.instr.i_type.rd, loaded_value);
+
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kLbu: {
@@ -287,7 +482,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register loaded_value = memory_->ReadFromMemory8b(address);
             SetRegisterValue(dec_instr.instr.i_type.rd, loaded_value);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kLhu: {
@@ -295,7 +490,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register loaded_value = memory_->ReadFromMemory16b(address);
             SetRegisterValue(dec_instr.instr.i_type.rd, loaded_value);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSb: {
@@ -304,7 +499,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             
             memory_->WriteToMemory8b(GetRegisterValue(dec_instr.instr.s_type.rs2), address);
             
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSh: {
@@ -313,7 +508,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
 
             memory_->WriteToMemory16b(GetRegisterValue(dec_instr.instr.s_type.rs2), address);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSw: {
@@ -322,7 +517,16 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
 
             memory_->WriteToMemory32b(GetRegisterValue(dec_instr.instr.s_type.rs2), address);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kSd: {
+            Register offset = IRegToReg(SignExtension(dec_instr.instr.s_type.imm, dec_instr.instr.s_type.imm_size_bit - 1));
+            Address address = GetRegisterValue(dec_instr.instr.s_type.rs1) + offset;
+
+            memory_->WriteToMemory64b(GetRegisterValue(dec_instr.instr.s_type.rs2), address);
+
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kAddi: {
@@ -331,7 +535,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = reg_value + imm;
             SetRegisterValue(dec_instr.instr.i_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSlti: {
@@ -340,7 +544,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = RegToIReg(reg_value) < RegToIReg(imm) ? 1 : 0;
             SetRegisterValue(dec_instr.instr.i_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSltiu: {
@@ -349,7 +553,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = reg_value < imm ? 1 : 0;
             SetRegisterValue(dec_instr.instr.i_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kXori: {
@@ -358,7 +562,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = reg_value ^ imm;
             SetRegisterValue(dec_instr.instr.i_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kOri: {
@@ -367,7 +571,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = reg_value | imm;
             SetRegisterValue(dec_instr.instr.i_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kAndi: {
@@ -376,37 +580,37 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = reg_value & imm;
             SetRegisterValue(dec_instr.instr.i_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSlli: {
             Register imm = IRegToReg(SignExtension(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit - 1));
             Register reg_value = GetRegisterValue(dec_instr.instr.i_type.rs1);
-            const Register shmat_mask = 0b1'1111;
+            const Register shmat_mask = kXlen - 1;
             Register result = reg_value << (imm & shmat_mask);
             SetRegisterValue(dec_instr.instr.i_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSrli: {
             Register imm = IRegToReg(SignExtension(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit - 1));
             Register reg_value = GetRegisterValue(dec_instr.instr.i_type.rs1);
-            const Register shmat_mask = 0b1'1111;
+            const Register shmat_mask = kXlen - 1;
             Register result = reg_value >> (imm & shmat_mask);
             SetRegisterValue(dec_instr.instr.i_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSrai: {
             Register imm = IRegToReg(SignExtension(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit - 1));
             Register reg_value = GetRegisterValue(dec_instr.instr.i_type.rs1);
-            const Register shmat_mask = 0b1'1111;
+            const Register shmat_mask = kXlen - 1;
             Register result = ArithmRightShift(reg_value, (imm & shmat_mask));
             SetRegisterValue(dec_instr.instr.i_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kAdd: {
@@ -416,7 +620,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = rs1_value + rs2_value;
             SetRegisterValue(dec_instr.instr.r_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSub: {
@@ -426,7 +630,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = rs1_value - rs2_value;
             SetRegisterValue(dec_instr.instr.r_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSlt: {
@@ -436,7 +640,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = RegToIReg(rs1_value) < RegToIReg(rs2_value) ? 1 : 0;
             SetRegisterValue(dec_instr.instr.r_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSltu: {
@@ -446,7 +650,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = rs1_value < rs2_value ? 1 : 0;
             SetRegisterValue(dec_instr.instr.r_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kXor: {
@@ -456,7 +660,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = rs1_value ^ rs2_value;
             SetRegisterValue(dec_instr.instr.r_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kOr: {
@@ -466,7 +670,7 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = rs1_value | rs2_value;
             SetRegisterValue(dec_instr.instr.r_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kAnd: {
@@ -476,52 +680,142 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
             Register result = rs1_value & rs2_value;
             SetRegisterValue(dec_instr.instr.r_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSll: {
             Register rs1_value = GetRegisterValue(dec_instr.instr.r_type.rs1);
             Register rs2_value = GetRegisterValue(dec_instr.instr.r_type.rs2);
-            const Register shift_mask = 0b1'1111;
+            const Register shift_mask = kXlen - 1;
 
             Register result = rs1_value << (rs2_value & shift_mask);
             SetRegisterValue(dec_instr.instr.r_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSrl: {
             Register rs1_value = GetRegisterValue(dec_instr.instr.r_type.rs1);
             Register rs2_value = GetRegisterValue(dec_instr.instr.r_type.rs2);
-            const Register shift_mask = 0b1'1111;
+            const Register shift_mask = kXlen - 1;
 
             Register result = rs1_value >> (rs2_value & shift_mask);
             SetRegisterValue(dec_instr.instr.r_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSra: {
             Register rs1_value = GetRegisterValue(dec_instr.instr.r_type.rs1);
             Register rs2_value = GetRegisterValue(dec_instr.instr.r_type.rs2);
-            const Register shift_mask = 0b1'1111;
+            const Register shift_mask = kXlen - 1;
 
             Register result = ArithmRightShift(rs1_value, (rs2_value & shift_mask));
             SetRegisterValue(dec_instr.instr.r_type.rd, result);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kAddiw: {
+            Register imm = IRegToReg(SignExtension(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit - 1));
+            uint32_t reg_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.i_type.rs1));
+            Register result = SignExtendWord(reg_value + static_cast<uint32_t>(imm));
+            SetRegisterValue(dec_instr.instr.i_type.rd, result);
+
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kSlliw: {
+            uint32_t reg_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.i_type.rs1));
+            const uint32_t shmat_mask = 0b1'1111;
+            Register result = SignExtendWord(reg_value << (dec_instr.instr.i_type.imm & shmat_mask));
+            SetRegisterValue(dec_instr.instr.i_type.rd, result);
+
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kSrliw: {
+            uint32_t reg_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.i_type.rs1));
+            const uint32_t shmat_mask = 0b1'1111;
+            Register result = SignExtendWord(reg_value >> (dec_instr.instr.i_type.imm & shmat_mask));
+            SetRegisterValue(dec_instr.instr.i_type.rd, result);
+
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kSraiw: {
+            int32_t reg_value = static_cast<int32_t>(GetRegisterValue(dec_instr.instr.i_type.rs1));
+            const uint32_t shmat_mask = 0b1'1111;
+            Register result = SignExtendWord(static_cast<uint32_t>(reg_value >> (dec_instr.instr.i_type.imm & shmat_mask)));
+            SetRegisterValue(dec_instr.instr.i_type.rd, result);
+
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kAddw: {
+            uint32_t rs1_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.r_type.rs1));
+            uint32_t rs2_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.r_type.rs2));
+
+            Register result = SignExtendWord(rs1_value + rs2_value);
+            SetRegisterValue(dec_instr.instr.r_type.rd, result);
+
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kSubw: {
+            uint32_t rs1_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.r_type.rs1));
+            uint32_t rs2_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.r_type.rs2));
+
+            Register result = SignExtendWord(rs1_value - rs2_value);
+            SetRegisterValue(dec_instr.instr.r_type.rd, result);
+
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kSllw: {
+            uint32_t rs1_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.r_type.rs1));
+            uint32_t rs2_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.r_type.rs2));
+            const uint32_t shift_mask = 0b1'1111;
+
+            Register result = SignExtendWord(rs1_value << (rs2_value & shift_mask));
+            SetRegisterValue(dec_instr.instr.r_type.rd, result);
+
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kSrlw: {
+            uint32_t rs1_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.r_type.rs1));
+            uint32_t rs2_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.r_type.rs2));
+            const uint32_t shift_mask = 0b1'1111;
+
+            Register result = SignExtendWord(rs1_value >> (rs2_value & shift_mask));
+            SetRegisterValue(dec_instr.instr.r_type.rd, result);
+
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kSraw: {
+            int32_t rs1_value = static_cast<int32_t>(GetRegisterValue(dec_instr.instr.r_type.rs1));
+            uint32_t rs2_value = static_cast<uint32_t>(GetRegisterValue(dec_instr.instr.r_type.rs2));
+            const uint32_t shift_mask = 0b1'1111;
+
+            Register result = SignExtendWord(static_cast<uint32_t>(rs1_value >> (rs2_value & shift_mask)));
+            SetRegisterValue(dec_instr.instr.r_type.rd, result);
+
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kFence: {
-            assert(0 && "fence is still unsupported");
+            // single hart without devices, memory accesses are already ordered
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kFence_i: {
-            assert(0 && "fence is still unsupported");
+            // memory tracks writes to decoded code, stale blocks are dropped 
+            // before the next block is fetched, fence.i ends a block
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kScall: {
@@ -529,41 +823,212 @@ InstructionError Cpu::Execute(DecodedInstr dec_instr) {
 
             spdlog::info("Syscall instruction encountered");
 
-            err = SyscallHandler();
+            err = HandleSyscall();
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
         }
         break;
         case InstructionMnemonic::kSbreak: {
             SetIsFinished(true);
 
-            pc_ += sizeof(Register);
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kCsrrw:
+        case InstructionMnemonic::kCsrrs:
+        case InstructionMnemonic::kCsrrc:
+        case InstructionMnemonic::kCsrrwi:
+        case InstructionMnemonic::kCsrrsi:
+        case InstructionMnemonic::kCsrrci: {
+            err = ExecuteCsr(dec_instr);
+
+            pc_ += kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kFusedLuiAddi: {
+            SetRegisterValue(dec_instr.instr.fused.rd, dec_instr.instr.fused.imm + dec_instr.instr.fused.imm2);
+
+            pc_ += 2 * kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kFusedAuipcJalr: {
+            Register base = pc_ + dec_instr.instr.fused.imm;
+            SetRegisterValue(dec_instr.instr.fused.rd, base);
+
+            Register jalr_pc = pc_ + kInstrSize;
+            Register target = (GetRegisterValue(dec_instr.instr.fused.rd) + dec_instr.instr.fused.imm2) & (~1);
+            SetRegisterValue(dec_instr.instr.fused.rd2, jalr_pc + kInstrSize);
+            pc_ = target;
+            RecordTakenBranch(jalr_pc);
+        }
+        break;
+        case InstructionMnemonic::kFusedAuipcLw: {
+            Register base = pc_ + dec_instr.instr.fused.imm;
+            SetRegisterValue(dec_instr.instr.fused.rd, base);
+
+            Address address = GetRegisterValue(dec_instr.instr.fused.rd) + dec_instr.instr.fused.imm2;
+            SetRegisterValue(dec_instr.instr.fused.rd2, memory_->ReadFromMemory32b(address));
+
+            pc_ += 2 * kInstrSize;
+        }
+        break;
+        case InstructionMnemonic::kFusedSltBne: {
+            IRegister rs1_ivalue = RegToIReg(GetRegisterValue(dec_instr.instr.fused.rs1));
+            IRegister rs2_ivalue = RegToIReg(GetRegisterValue(dec_instr.instr.fused.rs2));
+            SetRegisterValue(dec_instr.instr.fused.rd, rs1_ivalue < rs2_ivalue ? 1 : 0);
+
+            Register bne_pc = pc_ + kInstrSize;
+            if (GetRegisterValue(dec_instr.instr.fused.rd) == 0) {
+                pc_ += 2 * kInstrSize;
+                return InstructionError::kOk;
+            }
+
+            pc_ = bne_pc + dec_instr.instr.fused.imm2;
+            RecordTakenBranch(bne_pc);
+        }
+        break;
+        case InstructionMnemonic::kFusedSltuBne: {
+            Register rs1_value = GetRegisterValue(dec_instr.instr.fused.rs1);
+            Register rs2_value = GetRegisterValue(dec_instr.instr.fused.rs2);
+            SetRegisterValue(dec_instr.instr.fused.rd, rs1_value < rs2_value ? 1 : 0);
+
+            Register bne_pc = pc_ + kInstrSize;
+            if (GetRegisterValue(dec_instr.instr.fused.rd) == 0) {
+                pc_ += 2 * kInstrSize;
+                return InstructionError::kOk;
+            }
+
+            pc_ = bne_pc + dec_instr.instr.fused.imm2;
+            RecordTakenBranch(bne_pc);
+        }
+        break;
+        case InstructionMnemonic::kHleCall: {
+            if constexpr (kXlen == 32) {
+                assert(hle_ != nullptr);
+
+                // returns to ra as the replaced routine would
+                Register call_pc = pc_;
+                err = hle_->Call(static_cast<HleRoutine>(dec_instr.instr.i_type.imm), this);
+                RecordTakenBranch(call_pc);
+            } else {
+                assert(0 && "hle is rv32 only");
+                return InstructionError::kUnknownInstruction;
+            }
         }
         break;
         case InstructionMnemonic::kUnkownMnem:
         default:
-            assert(0 && "unknown instruction");
+            // faulting fetches decode here too, there are no traps to take
+            spdlog::error("Unknown instruction at pc 0x{:x}, stopping", pc_);
+            SetIsFinished(true);
             return InstructionError::kUnknownInstruction;
     }
 
     return err;
 }
 
-// static ---------------------------------------------------------------------
+template <size_t kXlen>
+InstructionError BasicCpu<kXlen>::ExecuteIr(const IrOp& op) requires (kXlen == 32) {
+    LogFunctionEntry();
 
-static IRegister SignExtension(const Register uvalue, const size_t starting_bit) {
+    switch (op.opcode) {
+        case IrOpcode::kLoadImm: {
+            SetRegisterValue(op.rd, op.imm);
+        }
+        break;
+        case IrOpcode::kAdd:
+        case IrOpcode::kSub:
+        case IrOpcode::kSll:
+        case IrOpcode::kSlt:
+        case IrOpcode::kSltu:
+        case IrOpcode::kXor:
+        case IrOpcode::kSrl:
+        case IrOpcode::kSra:
+        case IrOpcode::kOr:
+        case IrOpcode::kAnd: {
+            SetRegisterValue(op.rd, EvaluateIrAlu(op.opcode, GetRegisterValue(op.rs1), GetRegisterValue(op.rs2)));
+        }
+        break;
+        case IrOpcode::kAddImm:
+        case IrOpcode::kSllImm:
+        case IrOpcode::kSltImm:
+        case IrOpcode::kSltuImm:
+        case IrOpcode::kXorImm:
+        case IrOpcode::kSrlImm:
+        case IrOpcode::kSraImm:
+        case IrOpcode::kOrImm:
+        case IrOpcode::kAndImm: {
+            SetRegisterValue(op.rd, EvaluateIrAlu(op.opcode, GetRegisterValue(op.rs1), op.imm));
+        }
+        break;
+        case IrOpcode::kLoad8: {
+            Address address = GetRegisterValue(op.rs1) + op.imm;
+            SetRegisterValue(op.rd, static_cast<Register>(static_cast<int8_t>(memory_->ReadFromMemory8b(address))));
+        }
+        break;
+        case IrOpcode::kLoad8u: {
+            Address address = GetRegisterValue(op.rs1) + op.imm;
+            SetRegisterValue(op.rd, memory_->ReadFromMemory8b(address));
+        }
+        break;
+        case IrOpcode::kLoad16: {
+            Address address = GetRegisterValue(op.rs1) + op.imm;
+            SetRegisterValue(op.rd, static_cast<Register>(static_cast<int16_t>(memory_->ReadFromMemory16b(address))));
+        }
+        break;
+        case IrOpcode::kLoad16u: {
+            Address address = GetRegisterValue(op.rs1) + op.imm;
+            SetRegisterValue(op.rd, memory_->ReadFromMemory16b(address));
+        }
+        break;
+        case IrOpcode::kLoad32: {
+            Address address = GetRegisterValue(op.rs1) + op.imm;
+            SetRegisterValue(op.rd, memory_->ReadFromMemory32b(address));
+        }
+        break;
+        case IrOpcode::kStore8: {
+            Address address = GetRegisterValue(op.rs1) + op.imm;
+            memory_->WriteToMemory8b(static_cast<uint8_t>(GetRegisterValue(op.rs2)), address);
+        }
+        break;
+        case IrOpcode::kStore16: {
+            Address address = GetRegisterValue(op.rs1) + op.imm;
+            memory_->WriteToMemory16b(static_cast<uint16_t>(GetRegisterValue(op.rs2)), address);
+        }
+        break;
+        case IrOpcode::kStore32: {
+            Address address = GetRegisterValue(op.rs1) + op.imm;
+            memory_->WriteToMemory32b(GetRegisterValue(op.rs2), address);
+        }
+        break;
+        case IrOpcode::kGuest: {
+            pc_ = op.pc;
+            return Execute(op.guest);
+        }
+        default:
+            assert(0 && "unknown ir opcode");
+            return InstructionError::kUnknownInstruction;
+    }
+
+    return InstructionError::kOk;
+}
+
+// BasicCpu static --------------------------------------------------------------
+
+template <size_t kXlen>
+typename BasicCpu<kXlen>::IRegister BasicCpu<kXlen>::SignExtension(const Register uvalue, const size_t starting_bit) {
     LogFunctionEntry();
     LogVar(starting_bit);
 
     static_assert(sizeof(Register) == sizeof(IRegister), "Register and IRegister have different sizes");
 
-    const Register signed_bit_mask = 1 << starting_bit;
+    const Register signed_bit_mask = Register{1} << starting_bit;
     if (!(uvalue & signed_bit_mask)) {
         return RegToIReg(uvalue);
     }
 
     Register res = uvalue;
-    Register move_bit = 1 << (starting_bit + 1);
+    Register move_bit = Register{1} << (starting_bit + 1);
     for (size_t i = starting_bit + 1; i < sizeof(uvalue) * CHAR_BIT; i++) {
         res |= move_bit;
         move_bit <<= 1;
@@ -571,12 +1036,18 @@ static IRegister SignExtension(const Register uvalue, const size_t starting_bit)
     
     IRegister value = RegToIReg(res);
 
-    LogVar(static_cast<uint32_t>(value));
+    LogVar(value);
 
     return value;
 }
 
-static IRegister RegToIReg(const Register uvalue) {
+template <size_t kXlen>
+typename BasicCpu<kXlen>::Register BasicCpu<kXlen>::SignExtendWord(const uint32_t value) {
+    return IRegToReg(static_cast<int32_t>(value));
+}
+
+template <size_t kXlen>
+typename BasicCpu<kXlen>::IRegister BasicCpu<kXlen>::RegToIReg(const Register uvalue) {
     // LogFunctionEntry();
 
     IRegister value = 0;
@@ -587,7 +1058,8 @@ static IRegister RegToIReg(const Register uvalue) {
     return value;
 }
 
-static Register IRegToReg(const IRegister value) {
+template <size_t kXlen>
+typename BasicCpu<kXlen>::Register BasicCpu<kXlen>::IRegToReg(const IRegister value) {
     // LogFunctionEntry();
 
     Register uvalue = 0;
@@ -598,10 +1070,11 @@ static Register IRegToReg(const IRegister value) {
     return uvalue;
 }
 
-static Register ArithmRightShift(const Register value, const size_t shift) {
+template <size_t kXlen>
+typename BasicCpu<kXlen>::Register BasicCpu<kXlen>::ArithmRightShift(const Register value, const size_t shift) {
     LogFunctionEntry();
 
-    Register msb = value & static_cast<Register>((1 << (sizeof(Register) * CHAR_BIT - 1)));
+    Register msb = value & (Register{1} << (sizeof(Register) * CHAR_BIT - 1));
     Register new_value = value >> shift;
 
     for (size_t move_shift = 0; move_shift < shift; move_shift++) {
@@ -612,6 +1085,11 @@ static Register ArithmRightShift(const Register value, const size_t shift) {
     return new_value;
 }
 
+template class BasicCpu<32>;
+template class BasicCpu<64>;
+
+// static ---------------------------------------------------------------------
+
 static const char* OpcodeToInstrMnemotic(InstructionOpcodes instr_opcode) {
     // LogFunctionEntry();
 
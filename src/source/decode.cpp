@@ -2,6 +2,7 @@
 
 #include <cstring>
 #include <cassert>
+#include <climits>
 
 #include "log_helper.hpp"
 
@@ -13,7 +14,19 @@ namespace sim {
 
 // static ---------------------------------------------------------------------
 
+template <size_t kXlen>
 static InstructionMnemonic GetMnemonicFromOpcode(Register opcode);
+static bool IsExtensionOpcode(InstructionOpcodes opcode);
+static InstructionMnemonic GetVectorMemMnemonic(Register instr);
+static InstructionMnemonic GetVectorMnemonic(Register instr);
+static InstructionMnemonic GetFpMnemonic(Register instr);
+static bool IsScalarFpAccess(Register instr);
+
+// words are decoded eagerly before it is known they are code, so unknown
+// encodings are reported to the caller then instead of failing
+static thread_local bool is_eager_decode = false;
+static thread_local bool is_unknown_encoding = false;
+static void OnUnknownEncoding(const char* message);
 
 static RTypeInstr GetRTypeInstr(const Register instr);
 static ITypeInstr GetITypeInstr(const Register instr);
@@ -21,9 +34,13 @@ static STypeInstr GetSTypeInstr(const Register instr);
 static BTypeInstr GetBTypeInstr(const Register instr);
 static UTypeInstr GetUTypeInstr(const Register instr);
 static JTypeInstr GetJTypeInstr(const Register instr);
+static R4TypeInstr GetR4TypeInstr(const Register instr);
+static VTypeInstr GetVTypeInstr(const Register instr);
+static VMemTypeInstr GetVMemTypeInstr(const Register instr);
 
 // global ---------------------------------------------------------------------
 
+template <size_t kXlen>
 DecodedInstr Decode(Register enc_instr) {
     InstructionOpcodes opcode = static_cast<InstructionOpcodes>(enc_instr & kOpcodeMask);
     
@@ -31,7 +48,7 @@ DecodedInstr Decode(Register enc_instr) {
         .instr_type = {},
 
         .opcode = opcode,
-        .instr_mnem = GetMnemonicFromOpcode(enc_instr),
+        .instr_mnem = GetMnemonicFromOpcode<kXlen>(enc_instr),
 
         .instr = {},
     };
@@ -62,7 +79,7 @@ DecodedInstr Decode(Register enc_instr) {
                        + (static_cast<Register>(j_type_instr.imm_11 << 11)) 
                        + (static_cast<Register>(j_type_instr.imm_19_12 << 12)) 
                        + (static_cast<Register>(j_type_instr.imm_20 << 20))),
-                .imm_size_bit = 20,
+                .imm_size_bit = 21,
             };
         }
         break;
@@ -79,7 +96,7 @@ DecodedInstr Decode(Register enc_instr) {
                        + (static_cast<Register>(b_type_instr.imm_11) << 11) 
                        + (static_cast<Register>(b_type_instr.imm_12) << 12) 
                        + (static_cast<Register>(b_type_instr.imm_10_5) << 5),
-                .imm_size_bit = 12,
+                .imm_size_bit = 13,
             };
         }
         break;
@@ -88,6 +105,7 @@ DecodedInstr Decode(Register enc_instr) {
         case InstructionOpcodes::kLoadInstr:
         case InstructionOpcodes::kJalr:
         case InstructionOpcodes::kArithmImmInstr: 
+        case InstructionOpcodes::kArithmImmWordInstr:
         case InstructionOpcodes::kFenceInstr:
         case InstructionOpcodes::kSystemInstr: {
             ITypeInstr i_type_instr = GetITypeInstr(enc_instr);
@@ -118,7 +136,8 @@ DecodedInstr Decode(Register enc_instr) {
         break;
 
         // r_type:
-        case InstructionOpcodes::kArithmRegInstr: {
+        case InstructionOpcodes::kArithmRegInstr:
+        case InstructionOpcodes::kArithmRegWordInstr: {
             RTypeInstr r_type_instr = GetRTypeInstr(enc_instr);
 
             decoded_instr.instr_type = InstrType::RType;
@@ -130,21 +149,355 @@ DecodedInstr Decode(Register enc_instr) {
         }
         break;
 
+        // f_type or v_type:
+        case InstructionOpcodes::kLoadFpInstr:
+        case InstructionOpcodes::kStoreFpInstr: {
+            if (!IsScalarFpAccess(enc_instr)) {
+                VMemTypeInstr v_mem_type_instr = GetVMemTypeInstr(enc_instr);
+
+                decoded_instr.instr_type = InstrType::VType;
+                decoded_instr.instr.v_type = {
+                    .vd = v_mem_type_instr.vd,
+                    .rs1 = v_mem_type_instr.rs1,
+                    .vs2 = v_mem_type_instr.rs2,
+                    .imm = 0,
+                    .operand = VectorOperand::kScalar,
+                    .is_masked = v_mem_type_instr.vm == 0,
+                };
+                break;
+            }
+
+            decoded_instr.instr_type = InstrType::FType;
+            if (opcode == InstructionOpcodes::kLoadFpInstr) {
+                ITypeInstr i_type_instr = GetITypeInstr(enc_instr);
+                decoded_instr.instr.f_type = {
+                    .rd = i_type_instr.rd,
+                    .rs1 = i_type_instr.rs1,
+                    .rs2 = 0,
+                    .rs3 = 0,
+                    .imm = SignExtendImm(i_type_instr.imm, 12),
+                    .rm = i_type_instr.funct3,
+                };
+            } else {
+                STypeInstr s_type_instr = GetSTypeInstr(enc_instr);
+                decoded_instr.instr.f_type = {
+                    .rd = 0,
+                    .rs1 = s_type_instr.rs1,
+                    .rs2 = s_type_instr.rs2,
+                    .rs3 = 0,
+                    .imm = SignExtendImm(static_cast<Register>(s_type_instr.imm_4_0)
+                                         + static_cast<Register>(s_type_instr.imm_11_5 << 5u), 12),
+                    .rm = s_type_instr.funct3,
+                };
+            }
+        }
+        break;
+
+        case InstructionOpcodes::kMaddInstr:
+        case InstructionOpcodes::kMsubInstr:
+        case InstructionOpcodes::kNmsubInstr:
+        case InstructionOpcodes::kNmaddInstr: {
+            R4TypeInstr r4_type_instr = GetR4TypeInstr(enc_instr);
+
+            decoded_instr.instr_type = InstrType::FType;
+            decoded_instr.instr.f_type = {
+                .rd = r4_type_instr.rd,
+                .rs1 = r4_type_instr.rs1,
+                .rs2 = r4_type_instr.rs2,
+                .rs3 = r4_type_instr.rs3,
+                .imm = 0,
+                .rm = r4_type_instr.funct3,
+            };
+        }
+        break;
+
+        case InstructionOpcodes::kOpFpInstr: {
+            RTypeInstr r_type_instr = GetRTypeInstr(enc_instr);
+
+            decoded_instr.instr_type = InstrType::FType;
+            decoded_instr.instr.f_type = {
+                .rd = r_type_instr.rd,
+                .rs1 = r_type_instr.rs1,
+                .rs2 = r_type_instr.rs2,
+                .rs3 = 0,
+                .imm = 0,
+                .rm = r_type_instr.funct3,
+            };
+        }
+        break;
+
+        // v_type:
+        case InstructionOpcodes::kVectorInstr: {
+            VTypeInstr v_type_instr = GetVTypeInstr(enc_instr);
+
+            decoded_instr.instr_type = InstrType::VType;
+            decoded_instr.instr.v_type = {
+                .vd = v_type_instr.vd,
+                .rs1 = v_type_instr.vs1,
+                .vs2 = v_type_instr.vs2,
+                .imm = SignExtendImm(v_type_instr.vs1, 5),
+                .operand = VectorOperand::kVector,
+                .is_masked = v_type_instr.vm == 0,
+            };
+
+            switch (static_cast<VectorInstruction>(v_type_instr.funct3)) {
+                case VectorInstruction::kOpIvx:
+                case VectorInstruction::kOpMvx: 
+                    decoded_instr.instr.v_type.operand = VectorOperand::kScalar;
+                    break;
+                case VectorInstruction::kOpIvi:
+                    decoded_instr.instr.v_type.operand = VectorOperand::kImm;
+                    break;
+                case VectorInstruction::kOpCfg: {
+                    // zimm11 of vsetvli, zimm10 of vsetivli, vsetvl has none
+                    const bool is_vsetivli = decoded_instr.instr_mnem == InstructionMnemonic::kVsetivli;
+                    decoded_instr.instr.v_type.imm = (enc_instr >> 20u) & (is_vsetivli ? 0x3ffu : 0x7ffu);
+                    decoded_instr.instr.v_type.operand = is_vsetivli ? VectorOperand::kImm : VectorOperand::kScalar;
+                    decoded_instr.instr.v_type.is_masked = false;
+                }
+                break;
+                default:
+                    break;
+            }
+        }
+        break;
+
         case InstructionOpcodes::kUnknown:
         default:
-            assert(0 && "Unknown instruction opcode");
+            OnUnknownEncoding("Unknown instruction opcode");
     }
 
     return decoded_instr;
 }
 
+template DecodedInstr Decode<32>(Register enc_instr);
+template DecodedInstr Decode<64>(Register enc_instr);
+
+template <size_t kXlen>
+bool TryDecode(Register enc_instr, DecodedInstr* dec_instr) {
+    assert(dec_instr != nullptr);
+
+    is_eager_decode = true;
+    is_unknown_encoding = false;
+    *dec_instr = Decode<kXlen>(enc_instr);
+    is_eager_decode = false;
+
+    return !is_unknown_encoding;
+}
+
+template bool TryDecode<32>(Register enc_instr, DecodedInstr* dec_instr);
+template bool TryDecode<64>(Register enc_instr, DecodedInstr* dec_instr);
+
+Register SignExtendImm(const Register imm, const size_t imm_size_bit) {
+    assert(0 < imm_size_bit && imm_size_bit <= sizeof(Register) * CHAR_BIT);
+
+    const size_t shift = sizeof(Register) * CHAR_BIT - imm_size_bit;
+    return static_cast<Register>(static_cast<IRegister>(imm << shift) >> shift);
+}
+
+const char* InstructionMnemonicToStr(InstructionMnemonic mnemonic) {
+    switch (mnemonic) {
+        case InstructionMnemonic::kUnkownMnem: return "unknown";
+        case InstructionMnemonic::kLui:        return "lui";
+        case InstructionMnemonic::kAuipc:      return "auipc";
+        case InstructionMnemonic::kJal:        return "jal";
+        case InstructionMnemonic::kJalr:       return "jalr";
+        case InstructionMnemonic::kBeq:        return "beq";
+        case InstructionMnemonic::kBne:        return "bne";
+        case InstructionMnemonic::kBlt:        return "blt";
+        case InstructionMnemonic::kBge:        return "bge";
+        case InstructionMnemonic::kBltu:       return "bltu";
+        case InstructionMnemonic::kBgeu:       return "bgeu";
+        case InstructionMnemonic::kLb:         return "lb";
+        case InstructionMnemonic::kLh:         return "lh";
+        case InstructionMnemonic::kLw:         return "lw";
+        case InstructionMnemonic::kLbu:        return "lbu";
+        case InstructionMnemonic::kLhu:        return "lhu";
+        case InstructionMnemonic::kSb:         return "sb";
+        case InstructionMnemonic::kSh:         return "sh";
+        case InstructionMnemonic::kSw:         return "sw";
+        case InstructionMnemonic::kAddi:       return "addi";
+        case InstructionMnemonic::kSlti:       return "slti";
+        case InstructionMnemonic::kSltiu:      return "sltiu";
+        case InstructionMnemonic::kXori:       return "xori";
+        case InstructionMnemonic::kOri:        return "ori";
+        case InstructionMnemonic::kAndi:       return "andi";
+        case InstructionMnemonic::kSlli:       return "slli";
+        case InstructionMnemonic::kSrli:       return "srli";
+        case InstructionMnemonic::kSrai:       return "srai";
+        case InstructionMnemonic::kAdd:        return "add";
+        case InstructionMnemonic::kSub:        return "sub";
+        case InstructionMnemonic::kSlt:        return "slt";
+        case InstructionMnemonic::kSltu:       return "sltu";
+        case InstructionMnemonic::kXor:        return "xor";
+        case InstructionMnemonic::kOr:         return "or";
+        case InstructionMnemonic::kAnd:        return "and";
+        case InstructionMnemonic::kSll:        return "sll";
+        case InstructionMnemonic::kSrl:        return "srl";
+        case InstructionMnemonic::kSra:        return "sra";
+        case InstructionMnemonic::kFence:      return "fence";
+        case InstructionMnemonic::kFence_i:    return "fence.i";
+        case InstructionMnemonic::kScall:      return "ecall";
+        case InstructionMnemonic::kSbreak:     return "ebreak";
+        case InstructionMnemonic::kFusedLuiAddi:   return "lui+addi";
+        case InstructionMnemonic::kFusedAuipcJalr: return "auipc+jalr";
+        case InstructionMnemonic::kFusedAuipcLw:   return "auipc+lw";
+        case InstructionMnemonic::kFusedSltBne:    return "slt+bne";
+        case InstructionMnemonic::kFusedSltuBne:   return "sltu+bne";
+        case InstructionMnemonic::kHleCall:        return "hle";
+        case InstructionMnemonic::kVsetvli:   return "vsetvli";
+        case InstructionMnemonic::kVsetivli:  return "vsetivli";
+        case InstructionMnemonic::kVsetvl:    return "vsetvl";
+        case InstructionMnemonic::kVle8:      return "vle8";
+        case InstructionMnemonic::kVle16:     return "vle16";
+        case InstructionMnemonic::kVle32:     return "vle32";
+        case InstructionMnemonic::kVlse8:     return "vlse8";
+        case InstructionMnemonic::kVlse16:    return "vlse16";
+        case InstructionMnemonic::kVlse32:    return "vlse32";
+        case InstructionMnemonic::kVse8:      return "vse8";
+        case InstructionMnemonic::kVse16:     return "vse16";
+        case InstructionMnemonic::kVse32:     return "vse32";
+        case InstructionMnemonic::kVsse8:     return "vsse8";
+        case InstructionMnemonic::kVsse16:    return "vsse16";
+        case InstructionMnemonic::kVsse32:    return "vsse32";
+        case InstructionMnemonic::kVadd:      return "vadd";
+        case InstructionMnemonic::kVsub:      return "vsub";
+        case InstructionMnemonic::kVrsub:     return "vrsub";
+        case InstructionMnemonic::kVminu:     return "vminu";
+        case InstructionMnemonic::kVmin:      return "vmin";
+        case InstructionMnemonic::kVmaxu:     return "vmaxu";
+        case InstructionMnemonic::kVmax:      return "vmax";
+        case InstructionMnemonic::kVand:      return "vand";
+        case InstructionMnemonic::kVor:       return "vor";
+        case InstructionMnemonic::kVxor:      return "vxor";
+        case InstructionMnemonic::kVsll:      return "vsll";
+        case InstructionMnemonic::kVsrl:      return "vsrl";
+        case InstructionMnemonic::kVsra:      return "vsra";
+        case InstructionMnemonic::kVmul:      return "vmul";
+        case InstructionMnemonic::kVmv_v:     return "vmv.v";
+        case InstructionMnemonic::kVmerge:    return "vmerge";
+        case InstructionMnemonic::kVmseq:     return "vmseq";
+        case InstructionMnemonic::kVmsne:     return "vmsne";
+        case InstructionMnemonic::kVmsltu:    return "vmsltu";
+        case InstructionMnemonic::kVmslt:     return "vmslt";
+        case InstructionMnemonic::kVmsleu:    return "vmsleu";
+        case InstructionMnemonic::kVmsle:     return "vmsle";
+        case InstructionMnemonic::kVmsgtu:    return "vmsgtu";
+        case InstructionMnemonic::kVmsgt:     return "vmsgt";
+        case InstructionMnemonic::kVredsum:   return "vredsum";
+        case InstructionMnemonic::kVredand:   return "vredand";
+        case InstructionMnemonic::kVredor:    return "vredor";
+        case InstructionMnemonic::kVredxor:   return "vredxor";
+        case InstructionMnemonic::kVredminu:  return "vredminu";
+        case InstructionMnemonic::kVredmin:   return "vredmin";
+        case InstructionMnemonic::kVredmaxu:  return "vredmaxu";
+        case InstructionMnemonic::kVredmax:   return "vredmax";
+        case InstructionMnemonic::kVmandn:    return "vmandn";
+        case InstructionMnemonic::kVmand:     return "vmand";
+        case InstructionMnemonic::kVmor:      return "vmor";
+        case InstructionMnemonic::kVmxor:     return "vmxor";
+        case InstructionMnemonic::kVmorn:     return "vmorn";
+        case InstructionMnemonic::kVmnand:    return "vmnand";
+        case InstructionMnemonic::kVmnor:     return "vmnor";
+        case InstructionMnemonic::kVmxnor:    return "vmxnor";
+        case InstructionMnemonic::kVcpop:     return "vcpop";
+        case InstructionMnemonic::kVfirst:    return "vfirst";
+        case InstructionMnemonic::kVmv_x_s:   return "vmv.x.s";
+        case InstructionMnemonic::kVmv_s_x:   return "vmv.s.x";
+        case InstructionMnemonic::kVid:       return "vid";
+        case InstructionMnemonic::kFlw:         return "flw";
+        case InstructionMnemonic::kFsw:         return "fsw";
+        case InstructionMnemonic::kFmadd_s:     return "fmadd.s";
+        case InstructionMnemonic::kFmsub_s:     return "fmsub.s";
+        case InstructionMnemonic::kFnmsub_s:    return "fnmsub.s";
+        case InstructionMnemonic::kFnmadd_s:    return "fnmadd.s";
+        case InstructionMnemonic::kFadd_s:      return "fadd.s";
+        case InstructionMnemonic::kFsub_s:      return "fsub.s";
+        case InstructionMnemonic::kFmul_s:      return "fmul.s";
+        case InstructionMnemonic::kFdiv_s:      return "fdiv.s";
+        case InstructionMnemonic::kFsqrt_s:     return "fsqrt.s";
+        case InstructionMnemonic::kFsgnj_s:     return "fsgnj.s";
+        case InstructionMnemonic::kFsgnjn_s:    return "fsgnjn.s";
+        case InstructionMnemonic::kFsgnjx_s:    return "fsgnjx.s";
+        case InstructionMnemonic::kFmin_s:      return "fmin.s";
+        case InstructionMnemonic::kFmax_s:      return "fmax.s";
+        case InstructionMnemonic::kFcvt_w_s:    return "fcvt.w.s";
+        case InstructionMnemonic::kFcvt_wu_s:   return "fcvt.wu.s";
+        case InstructionMnemonic::kFmv_x_w:     return "fmv.x.w";
+        case InstructionMnemonic::kFeq_s:       return "feq.s";
+        case InstructionMnemonic::kFlt_s:       return "flt.s";
+        case InstructionMnemonic::kFle_s:       return "fle.s";
+        case InstructionMnemonic::kFclass_s:    return "fclass.s";
+        case InstructionMnemonic::kFcvt_s_w:    return "fcvt.s.w";
+        case InstructionMnemonic::kFcvt_s_wu:   return "fcvt.s.wu";
+        case InstructionMnemonic::kFmv_w_x:     return "fmv.w.x";
+        case InstructionMnemonic::kFld:         return "fld";
+        case InstructionMnemonic::kFsd:         return "fsd";
+        case InstructionMnemonic::kFmadd_d:     return "fmadd.d";
+        case InstructionMnemonic::kFmsub_d:     return "fmsub.d";
+        case InstructionMnemonic::kFnmsub_d:    return "fnmsub.d";
+        case InstructionMnemonic::kFnmadd_d:    return "fnmadd.d";
+        case InstructionMnemonic::kFadd_d:      return "fadd.d";
+        case InstructionMnemonic::kFsub_d:      return "fsub.d";
+        case InstructionMnemonic::kFmul_d:      return "fmul.d";
+        case InstructionMnemonic::kFdiv_d:      return "fdiv.d";
+        case InstructionMnemonic::kFsqrt_d:     return "fsqrt.d";
+        case InstructionMnemonic::kFsgnj_d:     return "fsgnj.d";
+        case InstructionMnemonic::kFsgnjn_d:    return "fsgnjn.d";
+        case InstructionMnemonic::kFsgnjx_d:    return "fsgnjx.d";
+        case InstructionMnemonic::kFmin_d:      return "fmin.d";
+        case InstructionMnemonic::kFmax_d:      return "fmax.d";
+        case InstructionMnemonic::kFcvt_s_d:    return "fcvt.s.d";
+        case InstructionMnemonic::kFcvt_d_s:    return "fcvt.d.s";
+        case InstructionMnemonic::kFeq_d:       return "feq.d";
+        case InstructionMnemonic::kFlt_d:       return "flt.d";
+        case InstructionMnemonic::kFle_d:       return "fle.d";
+        case InstructionMnemonic::kFclass_d:    return "fclass.d";
+        case InstructionMnemonic::kFcvt_w_d:    return "fcvt.w.d";
+        case InstructionMnemonic::kFcvt_wu_d:   return "fcvt.wu.d";
+        case InstructionMnemonic::kFcvt_d_w:    return "fcvt.d.w";
+        case InstructionMnemonic::kFcvt_d_wu:   return "fcvt.d.wu";
+        case InstructionMnemonic::kCsrrw:       return "csrrw";
+        case InstructionMnemonic::kCsrrs:       return "csrrs";
+        case InstructionMnemonic::kCsrrc:       return "csrrc";
+        case InstructionMnemonic::kCsrrwi:      return "csrrwi";
+        case InstructionMnemonic::kCsrrsi:      return "csrrsi";
+        case InstructionMnemonic::kCsrrci:      return "csrrci";
+        case InstructionMnemonic::kLwu:         return "lwu";
+        case InstructionMnemonic::kLd:          return "ld";
+        case InstructionMnemonic::kSd:          return "sd";
+        case InstructionMnemonic::kAddiw:       return "addiw";
+        case InstructionMnemonic::kSlliw:       return "slliw";
+        case InstructionMnemonic::kSrliw:       return "srliw";
+        case InstructionMnemonic::kSraiw:       return "sraiw";
+        case InstructionMnemonic::kAddw:        return "addw";
+        case InstructionMnemonic::kSubw:        return "subw";
+        case InstructionMnemonic::kSllw:        return "sllw";
+        case InstructionMnemonic::kSrlw:        return "srlw";
+        case InstructionMnemonic::kSraw:        return "sraw";
+        case InstructionMnemonic::kNMnemonics:
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
 // static ---------------------------------------------------------------------
 
+// word opcodes and wider loads/stores are legal in rv64 only
+template <size_t kXlen>
 static InstructionMnemonic GetMnemonicFromOpcode(Register instr) {
     InstructionOpcodes opcode = static_cast<InstructionOpcodes>(instr & kOpcodeMask);
 
     LogVar(instr & kOpcodeMask);
 
+    // extensions are rv32 only
+    if constexpr (kXlen == 64) {
+        if (IsExtensionOpcode(opcode)) {
+            return InstructionMnemonic::kUnkownMnem;
+        }
+    }
+
     switch (opcode) {
         case InstructionOpcodes::kLui:   return InstructionMnemonic::kLui;
         case InstructionOpcodes::kAuipc: return InstructionMnemonic::kAuipc;
@@ -163,7 +516,8 @@ static InstructionMnemonic GetMnemonicFromOpcode(Register instr) {
                 case BranchInstruction::kBgeu: return InstructionMnemonic::kBgeu;
 
                 default:
-                    assert(0 && "unkown branch instruction");
+                    OnUnknownEncoding("unkown branch instruction");
+                    return InstructionMnemonic::kUnkownMnem;
             }
         }
         break;
@@ -177,9 +531,20 @@ static InstructionMnemonic GetMnemonicFromOpcode(Register instr) {
                 case LoadInstruction::kLw:  return InstructionMnemonic::kLw;
                 case LoadInstruction::kLbu: return InstructionMnemonic::kLbu;
                 case LoadInstruction::kLhu: return InstructionMnemonic::kLhu;
+                case LoadInstruction::kLwu:
+                    if constexpr (kXlen == 64) {
+                        return InstructionMnemonic::kLwu;
+                    }
+                    break;
+                case LoadInstruction::kLd:
+                    if constexpr (kXlen == 64) {
+                        return InstructionMnemonic::kLd;
+                    }
+                    break;
 
                 default:
-                    assert(0 && "unkown load instruction");
+                    OnUnknownEncoding("unkown load instruction");
+                    return InstructionMnemonic::kUnkownMnem;
             }
         }
         break;
@@ -191,9 +556,15 @@ static InstructionMnemonic GetMnemonicFromOpcode(Register instr) {
                 case StoreInstruction::kSb: return InstructionMnemonic::kSb;
                 case StoreInstruction::kSh: return InstructionMnemonic::kSh;
                 case StoreInstruction::kSw: return InstructionMnemonic::kSw;
+                case StoreInstruction::kSd:
+                    if constexpr (kXlen == 64) {
+                        return InstructionMnemonic::kSd;
+                    }
+                    break;
 
                 default:
-                    assert(0 && "unkown store instruction");
+                    OnUnknownEncoding("unkown store instruction");
+                    return InstructionMnemonic::kUnkownMnem;
             }
         }
         break;
@@ -210,19 +581,24 @@ static InstructionMnemonic GetMnemonicFromOpcode(Register instr) {
                 case ArithmImmInstruction::kAndi:  return InstructionMnemonic::kAndi;
                 case ArithmImmInstruction::kSlli:  return InstructionMnemonic::kSlli;
                 case ArithmImmInstruction::kSraiSrli: {
+                    // rv64 shamt is 6 bit wide, its top bit is the lowest bit of funct7
                     const size_t kShmatWidth = 5;
-                    ArithmImmShiftRight shift_type = static_cast<ArithmImmShiftRight>(i_type_instr.imm >> kShmatWidth);
+                    const Register kShmatHighBit = kXlen == 64 ? 1 : 0;
+                    ArithmImmShiftRight shift_type = static_cast<ArithmImmShiftRight>((i_type_instr.imm >> kShmatWidth) 
+                                                                                    & ~kShmatHighBit);
 
                     switch (shift_type) {
                         case ArithmImmShiftRight::kArithm:  return InstructionMnemonic::kSrai;
                         case ArithmImmShiftRight::kLogical: return InstructionMnemonic::kSrli;
                         default:
-                            assert(0 && "unknown shift");
+                            OnUnknownEncoding("unknown shift");
+                            return InstructionMnemonic::kUnkownMnem;
                     }
                 }
 
                 default:
-                    assert(0 && "unkown arithmetic instruction");
+                    OnUnknownEncoding("unkown arithmetic instruction");
+                    return InstructionMnemonic::kUnkownMnem;
             }
         }
         break;
@@ -236,7 +612,8 @@ static InstructionMnemonic GetMnemonicFromOpcode(Register instr) {
                         case ArithmRegInstructionSpecial::kAdd: return InstructionMnemonic::kAdd;
                         case ArithmRegInstructionSpecial::kSub: return InstructionMnemonic::kSub;
                         default:
-                            assert(0 && "unkown funct7 for arithmetic register operations");
+                            OnUnknownEncoding("unkown funct7 for arithmetic register operations");
+                            return InstructionMnemonic::kUnkownMnem;
                     }
                 }
 
@@ -250,7 +627,8 @@ static InstructionMnemonic GetMnemonicFromOpcode(Register instr) {
                         case ArithmRegInstructionSpecial::kSrl: return InstructionMnemonic::kSrl;
                         case ArithmRegInstructionSpecial::kSra: return InstructionMnemonic::kSra;
                         default:
-                            assert(0 && "unkown funct7 for arithmetic register operations");
+                            OnUnknownEncoding("unkown funct7 for arithmetic register operations");
+                            return InstructionMnemonic::kUnkownMnem;
                     }
                 }
                 
@@ -260,8 +638,79 @@ static InstructionMnemonic GetMnemonicFromOpcode(Register instr) {
         }
         break;
 
+        case InstructionOpcodes::kArithmImmWordInstr: {
+            if constexpr (kXlen != 64) {
+                break;
+            }
+
+            ITypeInstr i_type_instr = GetITypeInstr(instr);
+            switch (static_cast<ArithmImmInstruction>(i_type_instr.funct3)) {
+                case ArithmImmInstruction::kAddi: return InstructionMnemonic::kAddiw;
+                case ArithmImmInstruction::kSlli: return InstructionMnemonic::kSlliw;
+                case ArithmImmInstruction::kSraiSrli: {
+                    const size_t kShmatWidth = 5;
+                    switch (static_cast<ArithmImmShiftRight>(i_type_instr.imm >> kShmatWidth)) {
+                        case ArithmImmShiftRight::kArithm:  return InstructionMnemonic::kSraiw;
+                        case ArithmImmShiftRight::kLogical: return InstructionMnemonic::kSrliw;
+                        default:
+                            OnUnknownEncoding("unknown shift");
+                            return InstructionMnemonic::kUnkownMnem;
+                    }
+                }
+                break;
+
+                default:
+                    OnUnknownEncoding("unkown arithmetic word instruction");
+                    return InstructionMnemonic::kUnkownMnem;
+            }
+        }
+        break;
+
+        case InstructionOpcodes::kArithmRegWordInstr: {
+            if constexpr (kXlen != 64) {
+                break;
+            }
+
+            RTypeInstr r_type_instr = GetRTypeInstr(instr);
+            switch (static_cast<ArithmRegInstruction>(r_type_instr.funct3)) {
+                case ArithmRegInstruction::kAddSub: {
+                    switch (static_cast<ArithmRegInstructionSpecial>(r_type_instr.funct7)) {
+                        case ArithmRegInstructionSpecial::kAdd: return InstructionMnemonic::kAddw;
+                        case ArithmRegInstructionSpecial::kSub: return InstructionMnemonic::kSubw;
+                        default:
+                            OnUnknownEncoding("unkown funct7 for arithmetic register word operations");
+                            return InstructionMnemonic::kUnkownMnem;
+                    }
+                }
+                break;
+                case ArithmRegInstruction::kSll: return InstructionMnemonic::kSllw;
+                case ArithmRegInstruction::kSrlSra: {
+                    switch (static_cast<ArithmRegInstructionSpecial>(r_type_instr.funct7)) {
+                        case ArithmRegInstructionSpecial::kSrl: return InstructionMnemonic::kSrlw;
+                        case ArithmRegInstructionSpecial::kSra: return InstructionMnemonic::kSraw;
+                        default:
+                            OnUnknownEncoding("unkown funct7 for arithmetic register word operations");
+                            return InstructionMnemonic::kUnkownMnem;
+                    }
+                }
+                break;
+
+                default:
+                    OnUnknownEncoding("unkown arithmetic register word instruction");
+                    return InstructionMnemonic::kUnkownMnem;
+            }
+        }
+        break;
+
         case InstructionOpcodes::kFenceInstr: {
-            assert(0 && "fence not implemented yet");
+            ITypeInstr i_type_instr = GetITypeInstr(instr);
+            switch (static_cast<FenceInstruction>(i_type_instr.funct3)) {
+                case FenceInstruction::kDefault:     return InstructionMnemonic::kFence;
+                case FenceInstruction::kInstruction: return InstructionMnemonic::kFence_i;
+                default:
+                    OnUnknownEncoding("unknown fence instruction");
+                    return InstructionMnemonic::kUnkownMnem;
+            }
         }
         break;
 
@@ -275,22 +724,381 @@ static InstructionMnemonic GetMnemonicFromOpcode(Register instr) {
                         case SystemInstructionSpecial::kSbreak: return InstructionMnemonic::kSbreak;
                         
                         default:
-                            assert(0 && "unknown system instruction");
+                            OnUnknownEncoding("unknown system instruction");
+                            return InstructionMnemonic::kUnkownMnem;
                     }
                 }
-                case SystemInstruction::kSread: {
-                    assert(0 && "fence not implemented");
-                }
+                break;
+                case SystemInstruction::kCsrrw:  return InstructionMnemonic::kCsrrw;
+                case SystemInstruction::kCsrrs:  return InstructionMnemonic::kCsrrs;
+                case SystemInstruction::kCsrrc:  return InstructionMnemonic::kCsrrc;
+                case SystemInstruction::kCsrrwi: return InstructionMnemonic::kCsrrwi;
+                case SystemInstruction::kCsrrsi: return InstructionMnemonic::kCsrrsi;
+                case SystemInstruction::kCsrrci: return InstructionMnemonic::kCsrrci;
+
+                default:
+                    OnUnknownEncoding("unknown system instruction");
+                    return InstructionMnemonic::kUnkownMnem;
             }
         }
         break;
 
+        case InstructionOpcodes::kLoadFpInstr: {
+            if (!IsScalarFpAccess(instr)) {
+                return GetVectorMemMnemonic(instr);
+            }
+
+            ITypeInstr i_type_instr = GetITypeInstr(instr);
+            return static_cast<FpMemWidth>(i_type_instr.funct3) == FpMemWidth::kWord ? InstructionMnemonic::kFlw
+                                                                                     : InstructionMnemonic::kFld;
+        }
+        case InstructionOpcodes::kStoreFpInstr: {
+            if (!IsScalarFpAccess(instr)) {
+                return GetVectorMemMnemonic(instr);
+            }
+
+            STypeInstr s_type_instr = GetSTypeInstr(instr);
+            return static_cast<FpMemWidth>(s_type_instr.funct3) == FpMemWidth::kWord ? InstructionMnemonic::kFsw
+                                                                                     : InstructionMnemonic::kFsd;
+        }
+        case InstructionOpcodes::kVectorInstr: return GetVectorMnemonic(instr);
+
+        case InstructionOpcodes::kMaddInstr:
+        case InstructionOpcodes::kMsubInstr:
+        case InstructionOpcodes::kNmsubInstr:
+        case InstructionOpcodes::kNmaddInstr:
+        case InstructionOpcodes::kOpFpInstr: return GetFpMnemonic(instr);
+
         case InstructionOpcodes::kUnknown:
         default:
-            spdlog::critical("Unknown opcode");
-            assert(0 && "unkown opcode");
+            OnUnknownEncoding("unkown opcode");
+            return InstructionMnemonic::kUnkownMnem;
+    }
+
+    return InstructionMnemonic::kUnkownMnem;
+}
+
+static bool IsExtensionOpcode(InstructionOpcodes opcode) {
+    switch (opcode) {
+        case InstructionOpcodes::kLoadFpInstr:
+        case InstructionOpcodes::kStoreFpInstr:
+        case InstructionOpcodes::kVectorInstr:
+        case InstructionOpcodes::kMaddInstr:
+        case InstructionOpcodes::kMsubInstr:
+        case InstructionOpcodes::kNmsubInstr:
+        case InstructionOpcodes::kNmaddInstr:
+        case InstructionOpcodes::kOpFpInstr:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// unit-stride and strided accesses of one field, 8..32 bit elements
+static InstructionMnemonic GetVectorMemMnemonic(Register instr) {
+    VMemTypeInstr v_mem_type_instr = GetVMemTypeInstr(instr);
+    const bool is_load = (instr & kOpcodeMask) == static_cast<Register>(InstructionOpcodes::kLoadFpInstr);
+
+    if (v_mem_type_instr.nf != 0 || v_mem_type_instr.mew != 0) {
+        OnUnknownEncoding("segment vector accesses are not supported");
+        return InstructionMnemonic::kUnkownMnem;
+    }
+
+    size_t width_i = 0;
+    switch (static_cast<VectorMemWidth>(v_mem_type_instr.width)) {
+        case VectorMemWidth::k8:  width_i = 0; break;
+        case VectorMemWidth::k16: width_i = 1; break;
+        case VectorMemWidth::k32: width_i = 2; break;
+        default:
+            OnUnknownEncoding("unsupported vector element width");
+            return InstructionMnemonic::kUnkownMnem;
+    }
+
+    static const InstructionMnemonic kUnitLoads[]    = {InstructionMnemonic::kVle8,  InstructionMnemonic::kVle16,  InstructionMnemonic::kVle32};
+    static const InstructionMnemonic kUnitStores[]   = {InstructionMnemonic::kVse8,  InstructionMnemonic::kVse16,  InstructionMnemonic::kVse32};
+    static const InstructionMnemonic kStridedLoads[] = {InstructionMnemonic::kVlse8, InstructionMnemonic::kVlse16, InstructionMnemonic::kVlse32};
+    static const InstructionMnemonic kStridedStores[] = {InstructionMnemonic::kVsse8, InstructionMnemonic::kVsse16, InstructionMnemonic::kVsse32};
+
+    switch (static_cast<VectorMemMode>(v_mem_type_instr.mop)) {
+        case VectorMemMode::kUnitStride: {
+            if (v_mem_type_instr.rs2 != 0) {
+                OnUnknownEncoding("whole register, mask and fault-only-first accesses are not supported");
+                return InstructionMnemonic::kUnkownMnem;
+            }
+
+            return is_load ? kUnitLoads[width_i] : kUnitStores[width_i];
+        }
+        case VectorMemMode::kStrided: return is_load ? kStridedLoads[width_i] : kStridedStores[width_i];
+        default:
+            OnUnknownEncoding("indexed vector accesses are not supported");
+    }
+
+    return InstructionMnemonic::kUnkownMnem;
+}
+
+static InstructionMnemonic GetVectorMnemonic(Register instr) {
+    VTypeInstr v_type_instr = GetVTypeInstr(instr);
+    const VectorInstruction form = static_cast<VectorInstruction>(v_type_instr.funct3);
+    const bool is_vv = form == VectorInstruction::kOpIvv;
+    const bool is_vi = form == VectorInstruction::kOpIvi;
+
+    switch (form) {
+        case VectorInstruction::kOpCfg: {
+            if ((instr >> 31u) == 0) {
+                return InstructionMnemonic::kVsetvli;
+            }
+            if ((instr >> 30u) == 0b11) {
+                return InstructionMnemonic::kVsetivli;
+            }
+            if (v_type_instr.funct6 == 0b100000) {
+                return InstructionMnemonic::kVsetvl;
+            }
+
+            OnUnknownEncoding("unknown vector configuration instruction");
+        }
+        break;
+
+        case VectorInstruction::kOpIvv:
+        case VectorInstruction::kOpIvx:
+        case VectorInstruction::kOpIvi: {
+            switch (static_cast<VectorIntFunct6>(v_type_instr.funct6)) {
+                case VectorIntFunct6::kVadd:  return InstructionMnemonic::kVadd;
+                case VectorIntFunct6::kVand:  return InstructionMnemonic::kVand;
+                case VectorIntFunct6::kVor:   return InstructionMnemonic::kVor;
+                case VectorIntFunct6::kVxor:  return InstructionMnemonic::kVxor;
+                case VectorIntFunct6::kVsll:  return InstructionMnemonic::kVsll;
+                case VectorIntFunct6::kVsrl:  return InstructionMnemonic::kVsrl;
+                case VectorIntFunct6::kVsra:  return InstructionMnemonic::kVsra;
+                case VectorIntFunct6::kVmseq: return InstructionMnemonic::kVmseq;
+                case VectorIntFunct6::kVmsne: return InstructionMnemonic::kVmsne;
+                case VectorIntFunct6::kVmsleu: return InstructionMnemonic::kVmsleu;
+                case VectorIntFunct6::kVmsle: return InstructionMnemonic::kVmsle;
+                case VectorIntFunct6::kVmerge: {
+                    if (v_type_instr.vm == 0) {
+                        return InstructionMnemonic::kVmerge;
+                    }
+                    if (v_type_instr.vs2 == 0) {
+                        return InstructionMnemonic::kVmv_v;
+                    }
+                }
+                break;
+
+                // no immediate form
+                case VectorIntFunct6::kVsub:   if (!is_vi) return InstructionMnemonic::kVsub;   break;
+                case VectorIntFunct6::kVminu:  if (!is_vi) return InstructionMnemonic::kVminu;  break;
+                case VectorIntFunct6::kVmin:   if (!is_vi) return InstructionMnemonic::kVmin;   break;
+                case VectorIntFunct6::kVmaxu:  if (!is_vi) return InstructionMnemonic::kVmaxu;  break;
+                case VectorIntFunct6::kVmax:   if (!is_vi) return InstructionMnemonic::kVmax;   break;
+                case VectorIntFunct6::kVmsltu: if (!is_vi) return InstructionMnemonic::kVmsltu; break;
+                case VectorIntFunct6::kVmslt:  if (!is_vi) return InstructionMnemonic::kVmslt;  break;
+
+                // no vector-vector form
+                case VectorIntFunct6::kVrsub:  if (!is_vv) return InstructionMnemonic::kVrsub;  break;
+                case VectorIntFunct6::kVmsgtu: if (!is_vv) return InstructionMnemonic::kVmsgtu; break;
+                case VectorIntFunct6::kVmsgt:  if (!is_vv) return InstructionMnemonic::kVmsgt;  break;
+
+                default:
+                    break;
+            }
+
+            OnUnknownEncoding("unknown vector integer instruction");
+        }
+        break;
+
+        case VectorInstruction::kOpMvv: {
+            switch (static_cast<VectorMaskFunct6>(v_type_instr.funct6)) {
+                case VectorMaskFunct6::kVredsum:  return InstructionMnemonic::kVredsum;
+                case VectorMaskFunct6::kVredand:  return InstructionMnemonic::kVredand;
+                case VectorMaskFunct6::kVredor:   return InstructionMnemonic::kVredor;
+                case VectorMaskFunct6::kVredxor:  return InstructionMnemonic::kVredxor;
+                case VectorMaskFunct6::kVredminu: return InstructionMnemonic::kVredminu;
+                case VectorMaskFunct6::kVredmin:  return InstructionMnemonic::kVredmin;
+                case VectorMaskFunct6::kVredmaxu: return InstructionMnemonic::kVredmaxu;
+                case VectorMaskFunct6::kVredmax:  return InstructionMnemonic::kVredmax;
+                case VectorMaskFunct6::kVmandn:   return InstructionMnemonic::kVmandn;
+                case VectorMaskFunct6::kVmand:    return InstructionMnemonic::kVmand;
+                case VectorMaskFunct6::kVmor:     return InstructionMnemonic::kVmor;
+                case VectorMaskFunct6::kVmxor:    return InstructionMnemonic::kVmxor;
+                case VectorMaskFunct6::kVmorn:    return InstructionMnemonic::kVmorn;
+                case VectorMaskFunct6::kVmnand:   return InstructionMnemonic::kVmnand;
+                case VectorMaskFunct6::kVmnor:    return InstructionMnemonic::kVmnor;
+                case VectorMaskFunct6::kVmxnor:   return InstructionMnemonic::kVmxnor;
+                case VectorMaskFunct6::kVmul:     return InstructionMnemonic::kVmul;
+                case VectorMaskFunct6::kVwxunary0: {
+                    switch (v_type_instr.vs1) {
+                        case 0b00000: return InstructionMnemonic::kVmv_x_s;
+                        case 0b10000: return InstructionMnemonic::kVcpop;
+                        case 0b10001: return InstructionMnemonic::kVfirst;
+                        default:
+                            break;
+                    }
+                }
+                break;
+                case VectorMaskFunct6::kVmunary0: {
+                    if (v_type_instr.vs1 == 0b10001 && v_type_instr.vs2 == 0) {
+                        return InstructionMnemonic::kVid;
+                    }
+                }
+                break;
+                default:
+                    break;
+            }
+
+            OnUnknownEncoding("unknown vector mask instruction");
+        }
+        break;
+
+        case VectorInstruction::kOpMvx: {
+            switch (static_cast<VectorMaskFunct6>(v_type_instr.funct6)) {
+                case VectorMaskFunct6::kVmul: return InstructionMnemonic::kVmul;
+                case VectorMaskFunct6::kVwxunary0: {
+                    if (v_type_instr.vs2 == 0) {
+                        return InstructionMnemonic::kVmv_s_x;
+                    }
+                }
+                break;
+                default:
+                    break;
+            }
+
+            OnUnknownEncoding("unknown vector scalar instruction");
+        }
+        break;
+
+        default:
+            OnUnknownEncoding("floating point vector instructions are not supported");
+    }
+
+    return InstructionMnemonic::kUnkownMnem;
+}
+
+static bool IsScalarFpAccess(Register instr) {
+    ITypeInstr i_type_instr = GetITypeInstr(instr);
+    switch (static_cast<FpMemWidth>(i_type_instr.funct3)) {
+        case FpMemWidth::kWord:
+        case FpMemWidth::kDouble:
+            return true;
+        default:
+            return false;
+    }
+}
+
+// single and double precision, fmt of fused multiply-add is in bits of funct7 too
+static InstructionMnemonic GetFpMnemonic(Register instr) {
+    RTypeInstr r_type_instr = GetRTypeInstr(instr);
+    const InstructionOpcodes opcode = static_cast<InstructionOpcodes>(instr & kOpcodeMask);
+    const FpFormat fmt = static_cast<FpFormat>(r_type_instr.funct7 & 0b11u);
+
+    if (fmt != FpFormat::kSingle && fmt != FpFormat::kDouble) {
+        OnUnknownEncoding("half and quad precision are not supported");
+        return InstructionMnemonic::kUnkownMnem;
+    }
+
+    const bool is_double = fmt == FpFormat::kDouble;
+    auto by_fmt = [is_double](InstructionMnemonic single, InstructionMnemonic dbl) {
+        return is_double ? dbl : single;
+    };
+
+    switch (opcode) {
+        case InstructionOpcodes::kMaddInstr:  return by_fmt(InstructionMnemonic::kFmadd_s,  InstructionMnemonic::kFmadd_d);
+        case InstructionOpcodes::kMsubInstr:  return by_fmt(InstructionMnemonic::kFmsub_s,  InstructionMnemonic::kFmsub_d);
+        case InstructionOpcodes::kNmsubInstr: return by_fmt(InstructionMnemonic::kFnmsub_s, InstructionMnemonic::kFnmsub_d);
+        case InstructionOpcodes::kNmaddInstr: return by_fmt(InstructionMnemonic::kFnmadd_s, InstructionMnemonic::kFnmadd_d);
+        default:
+            break;
     }
 
+    const Register funct3 = r_type_instr.funct3;
+    const Register rs2 = r_type_instr.rs2;
+
+    switch (static_cast<FpFunct5>(r_type_instr.funct7 >> 2u)) {
+        case FpFunct5::kFadd: return by_fmt(InstructionMnemonic::kFadd_s, InstructionMnemonic::kFadd_d);
+        case FpFunct5::kFsub: return by_fmt(InstructionMnemonic::kFsub_s, InstructionMnemonic::kFsub_d);
+        case FpFunct5::kFmul: return by_fmt(InstructionMnemonic::kFmul_s, InstructionMnemonic::kFmul_d);
+        case FpFunct5::kFdiv: return by_fmt(InstructionMnemonic::kFdiv_s, InstructionMnemonic::kFdiv_d);
+        case FpFunct5::kFsqrt: {
+            if (rs2 == 0) {
+                return by_fmt(InstructionMnemonic::kFsqrt_s, InstructionMnemonic::kFsqrt_d);
+            }
+        }
+        break;
+        case FpFunct5::kFsgnj: {
+            switch (funct3) {
+                case 0b000: return by_fmt(InstructionMnemonic::kFsgnj_s,  InstructionMnemonic::kFsgnj_d);
+                case 0b001: return by_fmt(InstructionMnemonic::kFsgnjn_s, InstructionMnemonic::kFsgnjn_d);
+                case 0b010: return by_fmt(InstructionMnemonic::kFsgnjx_s, InstructionMnemonic::kFsgnjx_d);
+                default:
+                    break;
+            }
+        }
+        break;
+        case FpFunct5::kFminMax: {
+            switch (funct3) {
+                case 0b000: return by_fmt(InstructionMnemonic::kFmin_s, InstructionMnemonic::kFmin_d);
+                case 0b001: return by_fmt(InstructionMnemonic::kFmax_s, InstructionMnemonic::kFmax_d);
+                default:
+                    break;
+            }
+        }
+        break;
+        case FpFunct5::kFcvtFp: {
+            // rs2 is format of source
+            if (is_double && rs2 == static_cast<Register>(FpFormat::kSingle)) {
+                return InstructionMnemonic::kFcvt_d_s;
+            }
+            if (!is_double && rs2 == static_cast<Register>(FpFormat::kDouble)) {
+                return InstructionMnemonic::kFcvt_s_d;
+            }
+        }
+        break;
+        case FpFunct5::kFcompare: {
+            switch (funct3) {
+                case 0b000: return by_fmt(InstructionMnemonic::kFle_s, InstructionMnemonic::kFle_d);
+                case 0b001: return by_fmt(InstructionMnemonic::kFlt_s, InstructionMnemonic::kFlt_d);
+                case 0b010: return by_fmt(InstructionMnemonic::kFeq_s, InstructionMnemonic::kFeq_d);
+                default:
+                    break;
+            }
+        }
+        break;
+        case FpFunct5::kFcvtToInt: {
+            switch (rs2) {
+                case 0b00000: return by_fmt(InstructionMnemonic::kFcvt_w_s,  InstructionMnemonic::kFcvt_w_d);
+                case 0b00001: return by_fmt(InstructionMnemonic::kFcvt_wu_s, InstructionMnemonic::kFcvt_wu_d);
+                default:
+                    break;
+            }
+        }
+        break;
+        case FpFunct5::kFcvtInt: {
+            switch (rs2) {
+                case 0b00000: return by_fmt(InstructionMnemonic::kFcvt_s_w,  InstructionMnemonic::kFcvt_d_w);
+                case 0b00001: return by_fmt(InstructionMnemonic::kFcvt_s_wu, InstructionMnemonic::kFcvt_d_wu);
+                default:
+                    break;
+            }
+        }
+        break;
+        case FpFunct5::kFmvToInt: {
+            if (rs2 == 0 && funct3 == 0b000 && !is_double) {
+                return InstructionMnemonic::kFmv_x_w;
+            }
+            if (rs2 == 0 && funct3 == 0b001) {
+                return by_fmt(InstructionMnemonic::kFclass_s, InstructionMnemonic::kFclass_d);
+            }
+        }
+        break;
+        case FpFunct5::kFmvInt: {
+            if (rs2 == 0 && funct3 == 0b000 && !is_double) {
+                return InstructionMnemonic::kFmv_w_x;
+            }
+        }
+        break;
+        default:
+            break;
+    }
+
+    OnUnknownEncoding("unknown floating point instruction");
     return InstructionMnemonic::kUnkownMnem;
 }
 
@@ -388,4 +1196,37 @@ static JTypeInstr GetJTypeInstr(const Register instr) {
     return j_type_instr;
 }
 
+static R4TypeInstr GetR4TypeInstr(const Register instr) {
+    R4TypeInstr r4_type_instr = {};
+    std::memcpy(&r4_type_instr, &instr, sizeof(instr));
+
+    return r4_type_instr;
+}
+
+static VTypeInstr GetVTypeInstr(const Register instr) {
+    VTypeInstr v_type_instr = {};
+    std::memcpy(&v_type_instr, &instr, sizeof(instr));
+
+    return v_type_instr;
+}
+
+static VMemTypeInstr GetVMemTypeInstr(const Register instr) {
+    VMemTypeInstr v_mem_type_instr = {};
+    std::memcpy(&v_mem_type_instr, &instr, sizeof(instr));
+
+    return v_mem_type_instr;
+}
+
+static void OnUnknownEncoding([[maybe_unused]] const char* message) {
+    if (is_eager_decode) {
+        is_unknown_encoding = true;
+        return;
+    }
+
+#if !defined (NDEBUG)
+    spdlog::critical("Unknown encoding: {}", message);
+#endif // NDEBUG
+    assert(0 && "unknown encoding");
+}
+
 } // namespace sim
@@ -0,0 +1,150 @@
+#include "decode_table.hpp"
+
+#include <cassert>
+#include <chrono>
+
+#include "log_helper.hpp"
+
+#include "decode.hpp"
+
+namespace sim {
+
+// DecodeTable private --------------------------------------------------------
+
+DecodedInstr DecodeTable::DecodeWord(const Address pc, const uint32_t word) const {
+    if (xlen_ == 64) {
+        return Decode<64>(word);
+    }
+
+    DecodedInstr dec_instr = Decode<32>(word);
+    hle_->PatchHookedInstr(pc, &dec_instr);
+    return dec_instr;
+}
+
+bool DecodeTable::TryDecodeWord(const Address pc, const uint32_t word, DecodedInstr* dec_instr) const {
+    if (xlen_ == 64) {
+        return TryDecode<64>(word, dec_instr);
+    }
+
+    if (!TryDecode<32>(word, dec_instr)) {
+        return false;
+    }
+
+    hle_->PatchHookedInstr(pc, dec_instr);
+    return true;
+}
+
+// written and data words are decoded now and kept, other pcs are decoded every time
+const DecodedInstr& DecodeTable::GetSlow(const Address pc) {
+    if (pc % kInstrSize != 0 || !memory_->IsExecutable(pc, kInstrSize)) {
+        // memory reports the fault and observes the fetch
+        scratch_ = DecodeWord(pc, memory_->FetchInstr32b(pc));
+        return scratch_;
+    }
+
+    if (observer_ != nullptr) {
+        observer_->OnFetch(pc);
+    }
+
+    uint32_t word = 0;
+    std::memcpy(&word, memory_data_ + pc, sizeof(word));
+
+    for (Segment& segment : segments_) {
+        if (segment.start_pc <= pc && pc < segment.end_pc) {
+            const size_t index = (pc - segment.start_pc) / kInstrSize;
+            segment.words[index] = word;
+            segment.instrs[index] = DecodeWord(pc, word);
+            n_redecoded_++;
+            return segment.instrs[index];
+        }
+    }
+
+    scratch_ = DecodeWord(pc, word);
+    return scratch_;
+}
+
+// DecodeTable public ---------------------------------------------------------
+
+void DecodeTable::Init(const ploader::IProgramLoader& ploader, IMemory* memory, const HleLayer* hle) {
+    LogFunctionEntry();
+
+    assert(memory != nullptr);
+    assert(hle != nullptr);
+
+    memory_ = memory;
+    memory_data_ = memory->GetData();
+    hle_ = hle;
+    observer_ = nullptr;
+    xlen_ = ploader.GetXlen();
+    segments_.clear();
+    scratch_ = {};
+    n_redecoded_ = 0;
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    size_t n_text_bytes = 0;
+    size_t n_data_words = 0;
+    for (size_t index_ls = 0; index_ls < ploader.GetNLSections(); index_ls++) {
+        if (!ploader.GetIsExecutableIndex(index_ls)) {
+            continue;
+        }
+
+        // instructions are word aligned, a word is never read past segment end
+        Segment segment = {};
+        segment.start_pc = static_cast<Address>(ploader.GetStartAddrIndex(index_ls)) & ~static_cast<Address>(kInstrSize - 1);
+        const size_t n_words = (ploader.GetEndAddrIndex(index_ls) - segment.start_pc) / kInstrSize;
+        segment.end_pc = segment.start_pc + static_cast<Address>(n_words * kInstrSize);
+        // segment the memory map did not make executable is fetched through memory and faults
+        if (n_words != 0 && !memory->IsExecutable(segment.start_pc, n_words * kInstrSize)) {
+            spdlog::warn("Segment at 0x{:x} is not executable in memory map, it is not predecoded", segment.start_pc);
+            continue;
+        }
+        n_text_bytes += n_words * kInstrSize;
+
+        segment.words.resize(n_words);
+        std::memcpy(segment.words.data(), memory_data_ + segment.start_pc, n_words * kInstrSize);
+        segment.instrs.resize(n_words);
+        for (size_t word_i = 0; word_i < n_words; word_i++) {
+            const Address pc = segment.start_pc + static_cast<Address>(word_i * kInstrSize);
+            if (!TryDecodeWord(pc, segment.words[word_i], &segment.instrs[word_i])) {
+                // data word, mismatch sends it to the decoder if it ever runs
+                segment.words[word_i] = ~segment.words[word_i];
+                n_data_words++;
+            }
+        }
+
+        segments_.push_back(std::move(segment));
+    }
+
+    auto build_time = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start_time);
+    spdlog::info("Predecoded {} bytes of executable segments in {} us, {} words are not instructions", n_text_bytes,
+                 build_time.count(), n_data_words);
+}
+
+const DecodedInstr* DecodeTable::Find(const Address pc) const {
+    for (const Segment& segment : segments_) {
+        if (segment.start_pc <= pc && pc < segment.end_pc && pc % kInstrSize == 0) {
+            const size_t index = (pc - segment.start_pc) / kInstrSize;
+            uint32_t word = 0;
+            std::memcpy(&word, memory_data_ + pc, sizeof(word));
+            return segment.words[index] == word ? &segment.instrs[index] : nullptr;
+        }
+    }
+
+    return nullptr;
+}
+
+void DecodeTable::SetObserver(IMemoryObserver* observer) {
+    observer_ = observer;
+}
+
+size_t DecodeTable::GetNInstrs() const {
+    size_t n_instrs = 0;
+    for (const Segment& segment : segments_) {
+        n_instrs += segment.instrs.size();
+    }
+
+    return n_instrs;
+}
+
+} // namespace sim
@@ -0,0 +1,111 @@
+#include "edge_profiler.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <utility>
+#include <vector>
+
+#include "log_helper.hpp"
+
+#include "sim_options.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+using CountedEdge = std::pair<uint64_t, uint64_t>; // key, count
+
+static std::vector<CountedEdge> SortEdges(const std::unordered_map<uint64_t, uint64_t>& edges);
+
+// EdgeProfiler public --------------------------------------------------------
+
+void EdgeProfiler::Init(const Address entry_point) {
+    LogFunctionEntry();
+
+    branches_.clear();
+    ranges_.clear();
+
+    range_start_ = entry_point;
+    is_finished_ = false;
+}
+
+void EdgeProfiler::Finish(const Address last_pc) {
+    LogFunctionEntry();
+
+    if (is_finished_) {
+        return ;
+    }
+
+    ranges_[MakeKey(range_start_, last_pc)]++;
+    is_finished_ = true;
+}
+
+size_t EdgeProfiler::GetNBranches() const {
+    return branches_.size();
+}
+
+// Both formats list addresses in hex without prefix:
+//   autofdo: <n ranges> {begin-end:count} <n addresses> {addr:count} <n branches> {from->to:count}
+//   llvm:    <n ranges> {begin-end:count} <n branches> {from->to:count}
+// Ranges are inclusive and end at the address of the taken branch.
+// Address samples are not collected, so the autofdo address section is empty.
+ProfilerError EdgeProfiler::Dump(const std::string& path, BranchProfileFormat format) const {
+    LogFunctionEntry();
+
+    FILE* profile_file = std::fopen(path.c_str(), "w");
+    if (profile_file == nullptr) {
+        spdlog::error("Cant open branch profile file: {}", path);
+        return ProfilerError::kCantOpenFile;
+    }
+
+    std::vector<CountedEdge> ranges = SortEdges(ranges_);
+    std::vector<CountedEdge> branches = SortEdges(branches_);
+
+    std::fprintf(profile_file, "%zu\n", ranges.size());
+    for (const CountedEdge& range : ranges) {
+        std::fprintf(profile_file, "%llx-%llx:%llu\n", 
+                     static_cast<unsigned long long>(range.first >> 32u),
+                     static_cast<unsigned long long>(range.first & UINT32_MAX),
+                     static_cast<unsigned long long>(range.second));
+    }
+
+    if (format == BranchProfileFormat::kAutoFdo) {
+        std::fprintf(profile_file, "0\n");
+    }
+
+    std::fprintf(profile_file, "%zu\n", branches.size());
+    for (const CountedEdge& branch : branches) {
+        std::fprintf(profile_file, "%llx->%llx:%llu\n", 
+                     static_cast<unsigned long long>(branch.first >> 32u),
+                     static_cast<unsigned long long>(branch.first & UINT32_MAX),
+                     static_cast<unsigned long long>(branch.second));
+    }
+
+    std::fclose(profile_file);
+
+    spdlog::info("Branch profile dumped to {}: {} ranges, {} branches", path, ranges.size(), branches.size());
+
+    return ProfilerError::kOk;
+}
+
+const char* ProfilerErrorToStr(ProfilerError error) {
+    switch (error) {
+        case ProfilerError::kOk:           return "no error";
+        case ProfilerError::kCantOpenFile: return "cant open file";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+static std::vector<CountedEdge> SortEdges(const std::unordered_map<uint64_t, uint64_t>& edges) {
+    std::vector<CountedEdge> sorted_edges(edges.begin(), edges.end());
+    std::sort(sorted_edges.begin(), sorted_edges.end());
+
+    return sorted_edges;
+}
+
+} // namespace sim
@@ -15,6 +15,7 @@ ploader::PloaderError ploader::ElfLoader::Init(const std::string& program_path)
     LogFunctionEntry();
 
     program_entry_point_ = 0;
+    xlen_ = 0;
 
     ELFIO::elfio elf;
     if (!elf.load(program_path)) {
@@ -22,7 +23,8 @@ ploader::PloaderError ploader::ElfLoader::Init(const std::string& program_path)
         return ploader::PloaderError::kCantLoadBin;
     }
     
-    bool is_correct_bitness   = elf.get_class()    == ELFIO::ELFCLASS32;
+    bool is_correct_bitness   = elf.get_class()    == ELFIO::ELFCLASS32 
+                             || elf.get_class()    == ELFIO::ELFCLASS64;
     bool is_correct_endianess = elf.get_encoding() == ELFIO::ELFDATA2LSB; 
     bool is_correct_arch      = elf.get_machine()  == ELFIO::EM_RISCV;
 
@@ -30,6 +32,8 @@ ploader::PloaderError ploader::ElfLoader::Init(const std::string& program_path)
         return ploader::PloaderError::kWrongTarget;
     }
 
+    xlen_ = elf.get_class() == ELFIO::ELFCLASS64 ? 64 : 32;
+
     for (size_t i = 0; i < elf.segments.size(); i++) {
         const auto* segment = elf.segments[i];
 
@@ -39,7 +43,7 @@ ploader::PloaderError ploader::ElfLoader::Init(const std::string& program_path)
             size_t end_addr = start_addr + segment->get_memory_size();
 
             size_t ls_size = end_addr - start_addr;
-            uint8_t* ls_bin = new uint8_t[ls_size];
+            uint8_t* ls_bin = new uint8_t[ls_size]{}; // bss part is zero
             size_t ls_start_addr = start_addr;
             size_t ls_end_addr= end_addr;
 
@@ -49,12 +53,54 @@ ploader::PloaderError ploader::ElfLoader::Init(const std::string& program_path)
                 .start_addr = ls_start_addr,    
                 .end_addr = ls_end_addr,
                 .data = ls_bin,
+                .is_readable = (segment->get_flags() & ELFIO::PF_R) != 0,
+                .is_writable = (segment->get_flags() & ELFIO::PF_W) != 0,
+                .is_executable = (segment->get_flags() & ELFIO::PF_X) != 0,
             };
 
             lsections.push_back(lsection);
         }
     }
 
+    for (size_t i = 0; i < elf.sections.size(); i++) {
+        ELFIO::section* section = elf.sections[i];
+
+        if (section->get_type() != ELFIO::SHT_SYMTAB) {
+            continue;
+        }
+
+        ELFIO::const_symbol_section_accessor symbol_accessor(elf, section);
+        for (ELFIO::Elf_Xword sym_i = 0; sym_i < symbol_accessor.get_symbols_num(); sym_i++) {
+            std::string name;
+            ELFIO::Elf64_Addr value = 0;
+            ELFIO::Elf_Xword size = 0;
+            unsigned char bind = 0;
+            unsigned char type = 0;
+            ELFIO::Elf_Half section_index = 0;
+            unsigned char other = 0;
+
+            symbol_accessor.get_symbol(sym_i, name, value, size, bind, type, section_index, other);
+            if (name.empty() || section_index == ELFIO::SHN_UNDEF) {
+                continue;
+            }
+
+            if (type != ELFIO::STT_FUNC && type != ELFIO::STT_OBJECT && type != ELFIO::STT_NOTYPE) {
+                continue;
+            }
+
+            Symbol symbol = {
+                .name = name,
+                .addr = value,
+                .size = size,
+                .is_function = type == ELFIO::STT_FUNC,
+            };
+
+            symbols.push_back(symbol);
+        }
+    }
+
+    spdlog::debug("Loaded {} symbols", symbols.size());
+
     program_entry_point_ = elf.get_entry();
 
     return ploader::PloaderError::kOk;
@@ -76,10 +122,30 @@ size_t ploader::ElfLoader::GetEndAddrIndex(size_t index) const {
     return lsections[index].end_addr;
 }
 
+bool ploader::ElfLoader::GetIsReadableIndex(size_t index) const {
+    return lsections[index].is_readable;
+}
+
+bool ploader::ElfLoader::GetIsWritableIndex(size_t index) const {
+    return lsections[index].is_writable;
+}
+
+bool ploader::ElfLoader::GetIsExecutableIndex(size_t index) const {
+    return lsections[index].is_executable;
+}
+
 size_t ploader::ElfLoader::GetEntryPoint() const {
     return program_entry_point_;
 }
 
+size_t ploader::ElfLoader::GetXlen() const {
+    return xlen_;
+}
+
 size_t ploader::ElfLoader::GetNLSections() const {
     return lsections.size();
 }
+
+const std::vector<ploader::Symbol>& ploader::ElfLoader::GetSymbols() const {
+    return symbols;
+}
@@ -0,0 +1,656 @@
+#include "fpu.hpp"
+
+#include <bit>
+#include <cassert>
+#include <cfenv>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include "log_helper.hpp"
+
+#include "cpu.hpp"
+#include "cpu_defs.hpp"
+#include "instructions.hpp"
+#include "sim_cfg.hpp"
+#include "spdlog/spdlog.h"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+// riscv returns canonical nan instead of propagating payloads
+static const uint64_t kCanonicalNanD = 0x7ff8000000000000;
+static const uint32_t kCanonicalNanF = 0x7fc00000;
+static const uint64_t kNanBox = 0xffffffff00000000;
+
+static const Register kFrmMask = 0b111;
+static const Register kFflagsMask = 0b1'1111;
+static const Register kFrmShift = 5;
+
+enum class FpOp {
+    kAdd, kSub, kMul, kDiv, kSqrt,
+    kMadd, kMsub, kNmsub, kNmadd,
+};
+
+// wide format has at least 2 more significand bits, so result rounded to odd
+// in it is rounded to T as exact result would be
+template <typename T>
+struct FpTraits;
+
+template <>
+struct FpTraits<float> {
+    using Bits = uint32_t;
+    using Wide = double;
+    static constexpr Bits kCanonicalNan = kCanonicalNanF;
+};
+
+template <>
+struct FpTraits<double> {
+    using Bits = uint64_t;
+    using Wide = long double;
+    static constexpr Bits kCanonicalNan = kCanonicalNanD;
+};
+
+static_assert(std::numeric_limits<long double>::digits >= std::numeric_limits<double>::digits + 2,
+              "ties to max magnitude of double precision needs wider host long double");
+static_assert(std::endian::native == std::endian::little, "lowest significand bits are expected in the first bytes");
+
+template <typename W>
+static W Evaluate(const FpOp op, const W lhs, const W rhs, const W addend);
+template <typename T>
+static T EvaluateRounded(const FpOp op, const FpRoundingMode mode, const T lhs, const T rhs, const T addend,
+                         Register* flags);
+template <typename T>
+static T RoundToFormat(const typename FpTraits<T>::Wide value, const FpRoundingMode mode, Register* flags);
+template <typename T>
+static Register ConvertToInt(const T value, const FpRoundingMode mode, const bool is_unsigned, Register* flags);
+template <typename T>
+static T GetMinMax(const T lhs, const T rhs, const bool is_max, Register* flags);
+template <typename T>
+static Register Classify(const T value);
+template <typename T>
+static T InjectSign(const T value, const T sign_source, const InstructionMnemonic mnemonic);
+template <typename T>
+static bool IsSignalingNan(const T value);
+template <typename T>
+static T Canonicalize(const T value);
+
+static bool GetFpOp(InstructionMnemonic mnemonic, FpOp* op);
+static int GetHostRoundingMode(const FpRoundingMode mode);
+static Register GetHostFlags();
+
+// keeps host operation between changes of floating point environment
+template <typename T>
+static T OptBarrier(T value) {
+    asm volatile("" : "+m"(value));
+    return value;
+}
+
+template <typename T>
+static void ForceEval(T value) {
+    asm volatile("" : : "m"(value));
+}
+
+// Fpu private ----------------------------------------------------------------
+
+template <typename T>
+T Fpu::GetValue(const Register reg) const {
+    if constexpr (std::is_same_v<T, float>) {
+        // single precision value which is not nan-boxed reads as canonical nan
+        if ((registers_[reg] & kNanBox) != kNanBox) {
+            return std::bit_cast<float>(kCanonicalNanF);
+        }
+
+        return std::bit_cast<float>(static_cast<uint32_t>(registers_[reg]));
+    } else {
+        return std::bit_cast<double>(registers_[reg]);
+    }
+}
+
+template <typename T>
+void Fpu::SetValue(const Register reg, const T value) {
+    if constexpr (std::is_same_v<T, float>) {
+        registers_[reg] = kNanBox | std::bit_cast<uint32_t>(value);
+    } else {
+        registers_[reg] = std::bit_cast<uint64_t>(value);
+    }
+}
+
+bool Fpu::GetRoundingMode(const Register rm, FpRoundingMode* mode) const {
+    assert(mode != nullptr);
+
+    Register resolved = rm == static_cast<Register>(FpRoundingMode::kDyn) ? frm_ : rm;
+    if (resolved > static_cast<Register>(FpRoundingMode::kRmm)) {
+        return false;
+    }
+
+    *mode = static_cast<FpRoundingMode>(resolved);
+    return true;
+}
+
+template <typename T>
+InstructionError Fpu::ExecuteFormat(const DecodedInstr& dec_instr, Cpu* cpu) {
+    LogFunctionEntry();
+
+    using Wide = typename FpTraits<T>::Wide;
+
+    const auto& f_type = dec_instr.instr.f_type;
+    const InstructionMnemonic mnemonic = dec_instr.instr_mnem;
+
+    const T lhs = GetValue<T>(f_type.rs1);
+    const T rhs = GetValue<T>(f_type.rs2);
+    Register flags = 0;
+
+    FpOp op = FpOp::kAdd;
+    if (GetFpOp(mnemonic, &op)) {
+        FpRoundingMode mode = FpRoundingMode::kRne;
+        if (!GetRoundingMode(f_type.rm, &mode)) {
+            return InstructionError::kUnknownInstruction;
+        }
+
+        const T addend = GetValue<T>(f_type.rs3);
+        SetValue<T>(f_type.rd, Canonicalize(EvaluateRounded(op, mode, lhs, rhs, addend, &flags)));
+
+        // riscv raises invalid for inf * 0 even with quiet nan addend, host fma does not
+        const bool is_fused = op == FpOp::kMadd || op == FpOp::kMsub || op == FpOp::kNmsub || op == FpOp::kNmadd;
+        if (is_fused && ((std::isinf(lhs) && rhs == 0) || (lhs == 0 && std::isinf(rhs)))) {
+            flags |= kFpInvalid;
+        }
+        fflags_ |= flags;
+
+        return InstructionError::kOk;
+    }
+
+    switch (mnemonic) {
+        case InstructionMnemonic::kFsgnj_s:
+        case InstructionMnemonic::kFsgnjn_s:
+        case InstructionMnemonic::kFsgnjx_s:
+        case InstructionMnemonic::kFsgnj_d:
+        case InstructionMnemonic::kFsgnjn_d:
+        case InstructionMnemonic::kFsgnjx_d: {
+            SetValue<T>(f_type.rd, InjectSign(lhs, rhs, mnemonic));
+        }
+        break;
+        case InstructionMnemonic::kFmin_s:
+        case InstructionMnemonic::kFmin_d: {
+            SetValue<T>(f_type.rd, GetMinMax(lhs, rhs, false, &flags));
+        }
+        break;
+        case InstructionMnemonic::kFmax_s:
+        case InstructionMnemonic::kFmax_d: {
+            SetValue<T>(f_type.rd, GetMinMax(lhs, rhs, true, &flags));
+        }
+        break;
+        case InstructionMnemonic::kFeq_s:
+        case InstructionMnemonic::kFeq_d: {
+            // quiet compare
+            if (IsSignalingNan(lhs) || IsSignalingNan(rhs)) {
+                flags |= kFpInvalid;
+            }
+            cpu->SetRegisterValue(f_type.rd, lhs == rhs ? 1 : 0);
+        }
+        break;
+        case InstructionMnemonic::kFlt_s:
+        case InstructionMnemonic::kFlt_d:
+        case InstructionMnemonic::kFle_s:
+        case InstructionMnemonic::kFle_d: {
+            // signaling compares, any nan is invalid
+            if (std::isnan(lhs) || std::isnan(rhs)) {
+                flags |= kFpInvalid;
+            }
+            const bool is_less = mnemonic == InstructionMnemonic::kFlt_s || mnemonic == InstructionMnemonic::kFlt_d;
+            const bool result = is_less ? std::isless(lhs, rhs) : std::islessequal(lhs, rhs);
+            cpu->SetRegisterValue(f_type.rd, result ? 1 : 0);
+        }
+        break;
+        case InstructionMnemonic::kFclass_s:
+        case InstructionMnemonic::kFclass_d: {
+            cpu->SetRegisterValue(f_type.rd, Classify(lhs));
+        }
+        break;
+        case InstructionMnemonic::kFcvt_w_s:
+        case InstructionMnemonic::kFcvt_wu_s:
+        case InstructionMnemonic::kFcvt_w_d:
+        case InstructionMnemonic::kFcvt_wu_d: {
+            FpRoundingMode mode = FpRoundingMode::kRne;
+            if (!GetRoundingMode(f_type.rm, &mode)) {
+                return InstructionError::kUnknownInstruction;
+            }
+
+            const bool is_unsigned = mnemonic == InstructionMnemonic::kFcvt_wu_s
+                                  || mnemonic == InstructionMnemonic::kFcvt_wu_d;
+            cpu->SetRegisterValue(f_type.rd, ConvertToInt(lhs, mode, is_unsigned, &flags));
+        }
+        break;
+        case InstructionMnemonic::kFcvt_s_w:
+        case InstructionMnemonic::kFcvt_s_wu:
+        case InstructionMnemonic::kFcvt_d_w:
+        case InstructionMnemonic::kFcvt_d_wu: {
+            FpRoundingMode mode = FpRoundingMode::kRne;
+            if (!GetRoundingMode(f_type.rm, &mode)) {
+                return InstructionError::kUnknownInstruction;
+            }
+
+            const Register value = cpu->GetRegisterValue(f_type.rs1);
+            const bool is_unsigned = mnemonic == InstructionMnemonic::kFcvt_s_wu
+                                  || mnemonic == InstructionMnemonic::kFcvt_d_wu;
+            // 32 bit integers are exact in wide format, double precision ones never round
+            const Wide wide = is_unsigned ? static_cast<Wide>(value)
+                                          : static_cast<Wide>(static_cast<int32_t>(value));
+            SetValue<T>(f_type.rd, RoundToFormat<T>(wide, mode, &flags));
+        }
+        break;
+        default:
+            assert(0 && "not a floating point instruction of format");
+            return InstructionError::kUnknownInstruction;
+    }
+
+    fflags_ |= flags;
+
+    return InstructionError::kOk;
+}
+
+// Fpu public -----------------------------------------------------------------
+
+void Fpu::Init() {
+    LogFunctionEntry();
+
+    registers_.fill(0);
+    frm_ = static_cast<Register>(FpRoundingMode::kRne);
+    fflags_ = 0;
+}
+
+bool Fpu::ReadCsr(const Register csr, Register* value) const {
+    assert(value != nullptr);
+
+    switch (csr) {
+        case FpCsr::kCsrFflags: *value = fflags_;                         return true;
+        case FpCsr::kCsrFrm:    *value = frm_;                            return true;
+        case FpCsr::kCsrFcsr:   *value = (frm_ << kFrmShift) | fflags_;   return true;
+        default:
+            return false;
+    }
+}
+
+// frm keeps reserved values, instructions using them as dynamic mode are illegal
+bool Fpu::WriteCsr(const Register csr, const Register value) {
+    switch (csr) {
+        case FpCsr::kCsrFflags: {
+            fflags_ = value & kFflagsMask;
+        }
+        break;
+        case FpCsr::kCsrFrm: {
+            frm_ = value & kFrmMask;
+        }
+        break;
+        case FpCsr::kCsrFcsr: {
+            fflags_ = value & kFflagsMask;
+            frm_ = (value >> kFrmShift) & kFrmMask;
+        }
+        break;
+        default:
+            return false;
+    }
+
+    return true;
+}
+
+InstructionError Fpu::Execute(const DecodedInstr& dec_instr, Cpu* cpu, IMemory* memory) {
+    LogFunctionEntry();
+
+    assert(dec_instr.instr_type == InstrType::FType);
+    assert(cpu != nullptr);
+    assert(memory != nullptr);
+
+    const auto& f_type = dec_instr.instr.f_type;
+    const InstructionMnemonic mnemonic = dec_instr.instr_mnem;
+
+    InstructionError err = InstructionError::kOk;
+    switch (mnemonic) {
+        case InstructionMnemonic::kFlw: {
+            Address address = cpu->GetRegisterValue(f_type.rs1) + f_type.imm;
+            registers_[f_type.rd] = kNanBox | memory->ReadFromMemory32b(address);
+        }
+        break;
+        case InstructionMnemonic::kFld: {
+            Address address = cpu->GetRegisterValue(f_type.rs1) + f_type.imm;
+            registers_[f_type.rd] = memory->ReadFromMemory64b(address);
+        }
+        break;
+        case InstructionMnemonic::kFsw: {
+            Address address = cpu->GetRegisterValue(f_type.rs1) + f_type.imm;
+            memory->WriteToMemory32b(static_cast<uint32_t>(registers_[f_type.rs2]), address);
+        }
+        break;
+        case InstructionMnemonic::kFsd: {
+            Address address = cpu->GetRegisterValue(f_type.rs1) + f_type.imm;
+            memory->WriteToMemory64b(registers_[f_type.rs2], address);
+        }
+        break;
+        case InstructionMnemonic::kFmv_x_w: {
+            // raw bits, without nan-box check
+            cpu->SetRegisterValue(f_type.rd, static_cast<Register>(registers_[f_type.rs1]));
+        }
+        break;
+        case InstructionMnemonic::kFmv_w_x: {
+            registers_[f_type.rd] = kNanBox | cpu->GetRegisterValue(f_type.rs1);
+        }
+        break;
+        case InstructionMnemonic::kFcvt_s_d: {
+            FpRoundingMode mode = FpRoundingMode::kRne;
+            if (!GetRoundingMode(f_type.rm, &mode)) {
+                err = InstructionError::kUnknownInstruction;
+                break;
+            }
+
+            Register flags = 0;
+            SetValue<float>(f_type.rd, Canonicalize(RoundToFormat<float>(GetValue<double>(f_type.rs1), mode, &flags)));
+            fflags_ |= flags;
+        }
+        break;
+        case InstructionMnemonic::kFcvt_d_s: {
+            // widening is exact
+            const float value = GetValue<float>(f_type.rs1);
+            if (IsSignalingNan(value)) {
+                fflags_ |= kFpInvalid;
+            }
+            SetValue<double>(f_type.rd, Canonicalize(static_cast<double>(value)));
+        }
+        break;
+        default: {
+            const bool is_double = InstructionMnemonic::kFld <= mnemonic && mnemonic <= InstructionMnemonic::kFcvt_d_wu;
+            err = is_double ? ExecuteFormat<double>(dec_instr, cpu) : ExecuteFormat<float>(dec_instr, cpu);
+        }
+        break;
+    }
+
+    if (err != InstructionError::kOk) {
+        spdlog::error("Floating point instruction {} with reserved rounding mode", InstructionMnemonicToStr(mnemonic));
+    }
+
+    return err;
+}
+
+void Fpu::Dump() const {
+    LogFunctionEntry();
+
+    spdlog::info("Fp frm: {}, fflags: 0x{:x}", frm_, fflags_);
+
+    for (size_t reg_i = 0; reg_i < kNFpRegisters; reg_i++) {
+        if (registers_[reg_i] == 0) {
+            continue;
+        }
+
+        if ((registers_[reg_i] & kNanBox) == kNanBox) {
+            spdlog::info("Register f{}: 0x{:016x}({}f)", reg_i, registers_[reg_i], GetValue<float>(reg_i));
+        } else {
+            spdlog::info("Register f{}: 0x{:016x}({})", reg_i, registers_[reg_i], GetValue<double>(reg_i));
+        }
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+// guest division by zero is defined by ieee 754, not a host bug
+template <typename W>
+__attribute__((no_sanitize("float-divide-by-zero")))
+static W Evaluate(const FpOp op, const W lhs, const W rhs, const W addend) {
+    switch (op) {
+        case FpOp::kAdd:   return lhs + rhs;
+        case FpOp::kSub:   return lhs - rhs;
+        case FpOp::kMul:   return lhs * rhs;
+        case FpOp::kDiv:   return lhs / rhs;
+        case FpOp::kSqrt:  return std::sqrt(lhs);
+        // single rounding of fused operations, negation is exact
+        case FpOp::kMadd:  return std::fma(lhs, rhs, addend);
+        case FpOp::kMsub:  return std::fma(lhs, rhs, -addend);
+        case FpOp::kNmsub: return std::fma(-lhs, rhs, addend);
+        case FpOp::kNmadd: return std::fma(-lhs, rhs, -addend);
+        default:
+            assert(0 && "unknown enum value");
+            return 0;
+    }
+}
+
+template <typename T>
+static T EvaluateRounded(const FpOp op, const FpRoundingMode mode, const T lhs, const T rhs, const T addend,
+                         Register* flags) {
+    using Wide = typename FpTraits<T>::Wide;
+
+    // round to nearest even is the host mode, so the common case does not touch it
+    if (mode != FpRoundingMode::kRmm) {
+        const bool is_nearest = mode == FpRoundingMode::kRne;
+        if (!is_nearest) {
+            std::fesetround(GetHostRoundingMode(mode));
+        }
+
+        std::feclearexcept(FE_ALL_EXCEPT);
+        T result = Evaluate(op, OptBarrier(lhs), OptBarrier(rhs), OptBarrier(addend));
+        ForceEval(result);
+        *flags |= GetHostFlags();
+
+        if (!is_nearest) {
+            std::fesetround(FE_TONEAREST);
+        }
+
+        return result;
+    }
+
+    // result truncated in wide format with sticky lowest bit (rounded to odd)
+    // is rounded to T as the exact one
+    std::fesetround(FE_TOWARDZERO);
+    std::feclearexcept(FE_ALL_EXCEPT);
+    Wide wide = Evaluate(op, static_cast<Wide>(OptBarrier(lhs)), static_cast<Wide>(OptBarrier(rhs)),
+                         static_cast<Wide>(OptBarrier(addend)));
+    ForceEval(wide);
+    const Register wide_flags = GetHostFlags();
+    std::fesetround(FE_TONEAREST);
+
+    if ((wide_flags & kFpInexact) != 0 && std::isfinite(wide)) {
+        uint64_t low_bits = 0;
+        std::memcpy(&low_bits, &wide, sizeof(low_bits));
+        low_bits |= 1;
+        std::memcpy(&wide, &low_bits, sizeof(low_bits));
+    }
+
+    // wide format does not overflow or underflow on T operands
+    *flags |= wide_flags & (kFpInvalid | kFpDivByZero);
+
+    return RoundToFormat<T>(wide, mode, flags);
+}
+
+template <typename T>
+static T RoundToFormat(const typename FpTraits<T>::Wide value, const FpRoundingMode mode, Register* flags) {
+    using Wide = typename FpTraits<T>::Wide;
+
+    const bool is_host_mode = mode != FpRoundingMode::kRmm && mode != FpRoundingMode::kRne;
+    if (is_host_mode) {
+        std::fesetround(GetHostRoundingMode(mode));
+    }
+
+    std::feclearexcept(FE_ALL_EXCEPT);
+    T result = static_cast<T>(OptBarrier(value));
+    ForceEval(result);
+    *flags |= GetHostFlags();
+
+    if (is_host_mode) {
+        std::fesetround(FE_TONEAREST);
+    }
+
+    if (mode != FpRoundingMode::kRmm || !std::isfinite(result) || static_cast<Wide>(result) == value) {
+        return result;
+    }
+
+    // exact tie was rounded to even, max magnitude takes neighbour away from zero
+    const T other = std::nextafter(result, value > static_cast<Wide>(result) ? std::numeric_limits<T>::infinity()
+                                                                          : -std::numeric_limits<T>::infinity());
+    const bool is_tie = value - static_cast<Wide>(result) == static_cast<Wide>(other) - value;
+    if (is_tie && std::fabs(other) > std::fabs(result)) {
+        return other;
+    }
+
+    return result;
+}
+
+// out of range values and nans saturate with invalid flag
+template <typename T>
+static Register ConvertToInt(const T value, const FpRoundingMode mode, const bool is_unsigned, Register* flags) {
+    const Register max = is_unsigned ? UINT32_MAX : static_cast<Register>(INT32_MAX);
+    const Register min = is_unsigned ? 0 : static_cast<Register>(INT32_MIN);
+
+    if (std::isnan(value)) {
+        *flags |= kFpInvalid;
+        return max;
+    }
+
+    T rounded = value;
+    switch (mode) {
+        case FpRoundingMode::kRne: rounded = std::nearbyint(value); break; // host mode
+        case FpRoundingMode::kRtz: rounded = std::trunc(value);     break;
+        case FpRoundingMode::kRdn: rounded = std::floor(value);     break;
+        case FpRoundingMode::kRup: rounded = std::ceil(value);      break;
+        case FpRoundingMode::kRmm: rounded = std::round(value);     break;
+        default:
+            assert(0 && "unknown rounding mode");
+    }
+
+    const double lower = is_unsigned ? 0.0 : static_cast<double>(INT32_MIN);
+    const double upper = is_unsigned ? static_cast<double>(UINT32_MAX) : static_cast<double>(INT32_MAX);
+    if (static_cast<double>(rounded) < lower) {
+        *flags |= kFpInvalid;
+        return min;
+    }
+    if (static_cast<double>(rounded) > upper) {
+        *flags |= kFpInvalid;
+        return max;
+    }
+
+    if (rounded != value) {
+        *flags |= kFpInexact;
+    }
+
+    return is_unsigned ? static_cast<Register>(static_cast<uint32_t>(rounded))
+                       : static_cast<Register>(static_cast<int32_t>(rounded));
+}
+
+// ieee 754-2019 minimumNumber and maximumNumber, -0 is less than +0
+template <typename T>
+static T GetMinMax(const T lhs, const T rhs, const bool is_max, Register* flags) {
+    if (IsSignalingNan(lhs) || IsSignalingNan(rhs)) {
+        *flags |= kFpInvalid;
+    }
+
+    if (std::isnan(lhs) && std::isnan(rhs)) {
+        return Canonicalize(lhs);
+    }
+    if (std::isnan(lhs)) {
+        return rhs;
+    }
+    if (std::isnan(rhs)) {
+        return lhs;
+    }
+
+    if (lhs == rhs) {
+        // equal zeros differ by sign only
+        const bool is_lhs_taken = is_max ? !std::signbit(lhs) : std::signbit(lhs);
+        return is_lhs_taken ? lhs : rhs;
+    }
+
+    return (lhs < rhs) != is_max ? lhs : rhs;
+}
+
+template <typename T>
+static Register Classify(const T value) {
+    const bool is_negative = std::signbit(value);
+
+    switch (std::fpclassify(value)) {
+        case FP_INFINITE:  return is_negative ? 1u << 0u : 1u << 7u;
+        case FP_NORMAL:    return is_negative ? 1u << 1u : 1u << 6u;
+        case FP_SUBNORMAL: return is_negative ? 1u << 2u : 1u << 5u;
+        case FP_ZERO:      return is_negative ? 1u << 3u : 1u << 4u;
+        case FP_NAN:       return IsSignalingNan(value) ? 1u << 8u : 1u << 9u;
+        default:
+            assert(0 && "unknown floating point class");
+            return 0;
+    }
+}
+
+template <typename T>
+static T InjectSign(const T value, const T sign_source, const InstructionMnemonic mnemonic) {
+    using Bits = typename FpTraits<T>::Bits;
+
+    const Bits kSignMask = Bits{1} << (sizeof(Bits) * CHAR_BIT - 1);
+    const Bits value_bits = std::bit_cast<Bits>(value);
+    const Bits source_sign = std::bit_cast<Bits>(sign_source) & kSignMask;
+
+    Bits sign = source_sign;
+    switch (mnemonic) {
+        case InstructionMnemonic::kFsgnjn_s:
+        case InstructionMnemonic::kFsgnjn_d: sign = source_sign ^ kSignMask;                break;
+        case InstructionMnemonic::kFsgnjx_s:
+        case InstructionMnemonic::kFsgnjx_d: sign = source_sign ^ (value_bits & kSignMask); break;
+        default:
+            break;
+    }
+
+    return std::bit_cast<T>((value_bits & ~kSignMask) | sign);
+}
+
+template <typename T>
+static bool IsSignalingNan(const T value) {
+    using Bits = typename FpTraits<T>::Bits;
+
+    const Bits kQuietBit = Bits{1} << (std::numeric_limits<T>::digits - 2);
+    return std::isnan(value) && (std::bit_cast<Bits>(value) & kQuietBit) == 0;
+}
+
+template <typename T>
+static T Canonicalize(const T value) {
+    return std::isnan(value) ? std::bit_cast<T>(FpTraits<T>::kCanonicalNan) : value;
+}
+
+static bool GetFpOp(InstructionMnemonic mnemonic, FpOp* op) {
+    switch (mnemonic) {
+        case InstructionMnemonic::kFadd_s:   case InstructionMnemonic::kFadd_d:   *op = FpOp::kAdd;   return true;
+        case InstructionMnemonic::kFsub_s:   case InstructionMnemonic::kFsub_d:   *op = FpOp::kSub;   return true;
+        case InstructionMnemonic::kFmul_s:   case InstructionMnemonic::kFmul_d:   *op = FpOp::kMul;   return true;
+        case InstructionMnemonic::kFdiv_s:   case InstructionMnemonic::kFdiv_d:   *op = FpOp::kDiv;   return true;
+        case InstructionMnemonic::kFsqrt_s:  case InstructionMnemonic::kFsqrt_d:  *op = FpOp::kSqrt;  return true;
+        case InstructionMnemonic::kFmadd_s:  case InstructionMnemonic::kFmadd_d:  *op = FpOp::kMadd;  return true;
+        case InstructionMnemonic::kFmsub_s:  case InstructionMnemonic::kFmsub_d:  *op = FpOp::kMsub;  return true;
+        case InstructionMnemonic::kFnmsub_s: case InstructionMnemonic::kFnmsub_d: *op = FpOp::kNmsub; return true;
+        case InstructionMnemonic::kFnmadd_s: case InstructionMnemonic::kFnmadd_d: *op = FpOp::kNmadd; return true;
+        default:
+            return false;
+    }
+}
+
+static int GetHostRoundingMode(const FpRoundingMode mode) {
+    switch (mode) {
+        case FpRoundingMode::kRne: return FE_TONEAREST;
+        case FpRoundingMode::kRtz: return FE_TOWARDZERO;
+        case FpRoundingMode::kRdn: return FE_DOWNWARD;
+        case FpRoundingMode::kRup: return FE_UPWARD;
+        default:
+            assert(0 && "rounding mode has no host equivalent");
+            return FE_TONEAREST;
+    }
+}
+
+// host and riscv both detect tininess after rounding
+static Register GetHostFlags() {
+    const int host_flags = std::fetestexcept(FE_ALL_EXCEPT);
+
+    Register flags = 0;
+    if ((host_flags & FE_INEXACT)   != 0) { flags |= kFpInexact;   }
+    if ((host_flags & FE_UNDERFLOW) != 0) { flags |= kFpUnderflow; }
+    if ((host_flags & FE_OVERFLOW)  != 0) { flags |= kFpOverflow;  }
+    if ((host_flags & FE_DIVBYZERO) != 0) { flags |= kFpDivByZero; }
+    if ((host_flags & FE_INVALID)   != 0) { flags |= kFpInvalid;   }
+
+    return flags;
+}
+
+} // namespace sim
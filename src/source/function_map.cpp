@@ -0,0 +1,82 @@
+#include "function_map.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+#include "log_helper.hpp"
+
+#include "instructions.hpp"
+#include "iprogram_loader.hpp"
+
+namespace sim {
+
+void FunctionMap::Init(const std::vector<ploader::Symbol>& symbols) {
+    LogFunctionEntry();
+
+    ranges_.clear();
+    names_.clear();
+    names_.push_back("<unknown>");
+
+    for (const ploader::Symbol& symbol : symbols) {
+        if (!symbol.is_function) {
+            continue;
+        }
+
+        FunctionRange range = {
+            .start_addr = static_cast<Address>(symbol.addr),
+            .end_addr = static_cast<Address>(symbol.addr + symbol.size),
+            .id = names_.size(),
+        };
+
+        ranges_.push_back(range);
+        names_.push_back(symbol.name);
+    }
+
+    std::sort(ranges_.begin(), ranges_.end(), 
+              [](const FunctionRange& lhs, const FunctionRange& rhs) { return lhs.start_addr < rhs.start_addr; });
+
+    // symbols of hand written code often have zero size, so they span up to the next function
+    for (size_t i = 0; i < ranges_.size(); i++) {
+        if (ranges_[i].end_addr > ranges_[i].start_addr) {
+            continue;
+        }
+
+        ranges_[i].end_addr = (i + 1 < ranges_.size()) ? ranges_[i + 1].start_addr : ranges_[i].start_addr + kInstrSize;
+    }
+
+    last_range_ = {
+        .start_addr = 0,
+        .end_addr = 0,
+        .id = kUnknownFunction,
+    };
+
+    spdlog::debug("Function map: {} functions", ranges_.size());
+}
+
+size_t FunctionMap::LookupSlow(const Address pc) const {
+    auto next_range = std::upper_bound(ranges_.begin(), ranges_.end(), pc,
+                                       [](const Address addr, const FunctionRange& range) { return addr < range.start_addr; });
+    if (next_range == ranges_.begin()) {
+        return kUnknownFunction;
+    }
+
+    const FunctionRange& range = *(next_range - 1);
+    if (pc >= range.end_addr) {
+        return kUnknownFunction;
+    }
+
+    last_range_ = range;
+    return range.id;
+}
+
+size_t FunctionMap::GetNFunctions() const {
+    return names_.size();
+}
+
+const std::string& FunctionMap::GetName(const size_t id) const {
+    assert(id < names_.size());
+
+    return names_[id];
+}
+
+} // namespace sim
@@ -0,0 +1,145 @@
+#include "fusion.hpp"
+
+#include <cassert>
+
+#include "log_helper.hpp"
+
+#include "cpu_defs.hpp"
+#include "decode.hpp"
+#include "instructions.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static bool TryFusePair(const DecodedInstr& first, const DecodedInstr& second, DecodedInstr* fused, FusionKind* kind);
+
+// global ---------------------------------------------------------------------
+
+void FuseInstructions(std::vector<DecodedInstr>* instrs, FusionCounters* counters) {
+    LogFunctionEntry();
+
+    assert(instrs != nullptr);
+    assert(counters != nullptr);
+
+    std::vector<DecodedInstr>& block = *instrs;
+
+    size_t write_i = 0;
+    size_t read_i = 0;
+    while (read_i < block.size()) {
+        DecodedInstr fused = {};
+        FusionKind kind = kNFusionKinds;
+
+        if (read_i + 1 < block.size() && TryFusePair(block[read_i], block[read_i + 1], &fused, &kind)) {
+            block[write_i++] = fused;
+            (*counters)[kind]++;
+            read_i += 2;
+        } else {
+            block[write_i++] = block[read_i++];
+        }
+    }
+
+    block.resize(write_i);
+}
+
+const char* FusionKindToStr(FusionKind kind) {
+    switch (kind) {
+        case kFusionLuiAddi:   return InstructionMnemonicToStr(InstructionMnemonic::kFusedLuiAddi);
+        case kFusionAuipcJalr: return InstructionMnemonicToStr(InstructionMnemonic::kFusedAuipcJalr);
+        case kFusionAuipcLw:   return InstructionMnemonicToStr(InstructionMnemonic::kFusedAuipcLw);
+        case kFusionSltBne:    return InstructionMnemonicToStr(InstructionMnemonic::kFusedSltBne);
+        case kFusionSltuBne:   return InstructionMnemonicToStr(InstructionMnemonic::kFusedSltuBne);
+        case kNFusionKinds:
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+// second instruction has to consume the register written by the first one,
+// so both architectural writes are kept by fused instruction
+static bool TryFusePair(const DecodedInstr& first, const DecodedInstr& second, DecodedInstr* fused, FusionKind* kind) {
+    assert(fused != nullptr);
+    assert(kind != nullptr);
+
+    fused->instr_type = InstrType::Fused;
+    fused->opcode = first.opcode;
+
+    switch (first.instr_mnem) {
+        case InstructionMnemonic::kLui: {
+            Register rt = first.instr.u_type.rd;
+            if (second.instr_mnem != InstructionMnemonic::kAddi 
+                || second.instr.i_type.rs1 != rt || second.instr.i_type.rd != rt) {
+                return false;
+            }
+
+            fused->instr_mnem = InstructionMnemonic::kFusedLuiAddi;
+            fused->instr.fused = {
+                .rd = rt,
+                .rd2 = rt,
+                .rs1 = 0,
+                .rs2 = 0,
+                .imm = first.instr.u_type.imm << 12u,
+                .imm2 = SignExtendImm(second.instr.i_type.imm, second.instr.i_type.imm_size_bit),
+            };
+            *kind = kFusionLuiAddi;
+
+            return true;
+        }
+
+        case InstructionMnemonic::kAuipc: {
+            Register rt = first.instr.u_type.rd;
+            if (second.instr_mnem == InstructionMnemonic::kJalr && second.instr.i_type.rs1 == rt) {
+                fused->instr_mnem = InstructionMnemonic::kFusedAuipcJalr;
+                *kind = kFusionAuipcJalr;
+            } else if (second.instr_mnem == InstructionMnemonic::kLw && second.instr.i_type.rs1 == rt) {
+                fused->instr_mnem = InstructionMnemonic::kFusedAuipcLw;
+                *kind = kFusionAuipcLw;
+            } else {
+                return false;
+            }
+
+            fused->instr.fused = {
+                .rd = rt,
+                .rd2 = second.instr.i_type.rd,
+                .rs1 = 0,
+                .rs2 = 0,
+                .imm = first.instr.u_type.imm << 12u,
+                .imm2 = SignExtendImm(second.instr.i_type.imm, second.instr.i_type.imm_size_bit),
+            };
+
+            return true;
+        }
+
+        case InstructionMnemonic::kSlt:
+        case InstructionMnemonic::kSltu: {
+            Register rt = first.instr.r_type.rd;
+            if (second.instr_mnem != InstructionMnemonic::kBne 
+                || second.instr.b_type.rs1 != rt || second.instr.b_type.rs2 != RegisterAliases::kMachineZero) {
+                return false;
+            }
+
+            bool is_signed = first.instr_mnem == InstructionMnemonic::kSlt;
+            fused->instr_mnem = is_signed ? InstructionMnemonic::kFusedSltBne : InstructionMnemonic::kFusedSltuBne;
+            fused->instr.fused = {
+                .rd = rt,
+                .rd2 = 0,
+                .rs1 = first.instr.r_type.rs1,
+                .rs2 = first.instr.r_type.rs2,
+                .imm = 0,
+                .imm2 = SignExtendImm(second.instr.b_type.imm, second.instr.b_type.imm_size_bit),
+            };
+            *kind = is_signed ? kFusionSltBne : kFusionSltuBne;
+
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+} // namespace sim
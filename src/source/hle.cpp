@@ -0,0 +1,613 @@
+#include "hle.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "log_helper.hpp"
+
+#include "cpu.hpp"
+#include "cpu_defs.hpp"
+#include "imemory.hpp"
+#include "iprogram_loader.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+// costs are of byte-at-a-time loops of newlib built for rv32i,
+// units are bytes processed
+static const HleRoutineInfo kHleRoutines[kNHleRoutines] = {
+    [kHleMemcpy]  = {.name = "memcpy",  .group = "libc", .base_instrs = 4, .instrs_per_unit = 5},
+    [kHleMemset]  = {.name = "memset",  .group = "libc", .base_instrs = 4, .instrs_per_unit = 3},
+    [kHleMemmove] = {.name = "memmove", .group = "libc", .base_instrs = 6, .instrs_per_unit = 5},
+    [kHleStrlen]  = {.name = "strlen",  .group = "libc", .base_instrs = 3, .instrs_per_unit = 3},
+    [kHleStrcmp]  = {.name = "strcmp",  .group = "libc", .base_instrs = 3, .instrs_per_unit = 6},
+    [kHleMemcmp]  = {.name = "memcmp",  .group = "libc", .base_instrs = 3, .instrs_per_unit = 6},
+
+    // shift-and-add and soft-fp code of libgcc for rv32i, units are calls
+    [kHleMulsi3]  = {.name = "__mulsi3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 100},
+    [kHleMuldi3]  = {.name = "__muldi3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 330},
+    [kHleDivsi3]  = {.name = "__divsi3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 170},
+    [kHleUdivsi3] = {.name = "__udivsi3", .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 160},
+    [kHleModsi3]  = {.name = "__modsi3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 170},
+    [kHleUmodsi3] = {.name = "__umodsi3", .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 165},
+
+    [kHleAdddf3]  = {.name = "__adddf3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 90},
+    [kHleSubdf3]  = {.name = "__subdf3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 90},
+    [kHleMuldf3]  = {.name = "__muldf3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 600},
+    [kHleDivdf3]  = {.name = "__divdf3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 900},
+    [kHleAddsf3]  = {.name = "__addsf3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 60},
+    [kHleSubsf3]  = {.name = "__subsf3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 60},
+    [kHleMulsf3]  = {.name = "__mulsf3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 150},
+    [kHleDivsf3]  = {.name = "__divsf3",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 250},
+
+    [kHleEqdf2]    = {.name = "__eqdf2",    .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 30},
+    [kHleNedf2]    = {.name = "__nedf2",    .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 30},
+    [kHleLtdf2]    = {.name = "__ltdf2",    .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 30},
+    [kHleLedf2]    = {.name = "__ledf2",    .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 30},
+    [kHleGtdf2]    = {.name = "__gtdf2",    .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 30},
+    [kHleGedf2]    = {.name = "__gedf2",    .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 30},
+    [kHleUnorddf2] = {.name = "__unorddf2", .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 15},
+
+    [kHleFloatsidf]   = {.name = "__floatsidf",   .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 40},
+    [kHleFloatunsidf] = {.name = "__floatunsidf", .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 35},
+    [kHleFixdfsi]     = {.name = "__fixdfsi",     .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 30},
+    [kHleFixunsdfsi]  = {.name = "__fixunsdfsi",  .group = "libgcc", .base_instrs = 1, .instrs_per_unit = 30},
+};
+
+// riscv soft-fp returns canonical nan instead of propagating payloads
+static const uint64_t kCanonicalNanD = 0x7ff8000000000000;
+static const uint32_t kCanonicalNanF = 0x7fc00000;
+
+static size_t FindMismatch(const uint8_t* lhs, const uint8_t* rhs, const size_t size);
+
+static double GetDoubleArg(const Cpu* cpu, const size_t low_register);
+static void SetDoubleResult(Cpu* cpu, const double value);
+static float GetFloatArg(const Cpu* cpu, const size_t register_id);
+static void SetFloatResult(Cpu* cpu, const float value);
+
+// HleLayer private -----------------------------------------------------------
+
+// first byte of range out of memory is accessed through memory, so fault is
+// counted and logged as the one of guest load or store
+void HleLayer::Fault(Cpu* cpu, const MemAddress address, const bool is_write) {
+    MemAddress fault_address = std::max<MemAddress>(address, static_cast<MemAddress>(memory_->GetMemorySize()));
+
+    if (is_write) {
+        memory_->WriteToMemory8b(0, fault_address);
+    } else {
+        memory_->ReadFromMemory8b(fault_address);
+    }
+
+    // there are no traps to take, as with unknown instructions
+    spdlog::error("Memory fault in HLE routine at pc 0x{:x}, stopping", cpu->GetPc());
+    cpu->SetIsFinished(true);
+}
+
+uint64_t HleLayer::Memcpy(Cpu* cpu) {
+    Register dst = cpu->GetRegisterValue(RegisterAliases::kArgument0);
+    Register src = cpu->GetRegisterValue(RegisterAliases::kArgument1);
+    Register size = cpu->GetRegisterValue(RegisterAliases::kArgument2);
+
+    // empty range is not accessed, whatever it points to
+    if (size == 0) {
+        return 0;
+    }
+
+    uint8_t* host_dst = memory_->GetHostRange(dst, size);
+    uint8_t* host_src = memory_->GetHostRange(src, size);
+    if (host_dst == nullptr || host_src == nullptr) {
+        spdlog::error("memcpy out of guest memory: 0x{:x} <- 0x{:x}, size {}", dst, src, size);
+        // source is read before destination is written
+        if (host_src == nullptr) {
+            Fault(cpu, src, false);
+        } else {
+            Fault(cpu, dst, true);
+        }
+        return 0;
+    }
+
+    // overlapping memcpy is undefined, keep it deterministic
+    std::memmove(host_dst, host_src, size);
+    memory_->NotifyHostWrite(dst, size);
+
+    return size;
+}
+
+uint64_t HleLayer::Memset(Cpu* cpu) {
+    Register dst = cpu->GetRegisterValue(RegisterAliases::kArgument0);
+    Register value = cpu->GetRegisterValue(RegisterAliases::kArgument1);
+    Register size = cpu->GetRegisterValue(RegisterAliases::kArgument2);
+
+    // empty range is not accessed, whatever it points to
+    if (size == 0) {
+        return 0;
+    }
+
+    uint8_t* host_dst = memory_->GetHostRange(dst, size);
+    if (host_dst == nullptr) {
+        spdlog::error("memset out of guest memory: 0x{:x}, size {}", dst, size);
+        Fault(cpu, dst, true);
+        return 0;
+    }
+
+    std::memset(host_dst, static_cast<uint8_t>(value), size);
+    memory_->NotifyHostWrite(dst, size);
+
+    return size;
+}
+
+uint64_t HleLayer::Memmove(Cpu* cpu) {
+    Register dst = cpu->GetRegisterValue(RegisterAliases::kArgument0);
+    Register src = cpu->GetRegisterValue(RegisterAliases::kArgument1);
+    Register size = cpu->GetRegisterValue(RegisterAliases::kArgument2);
+
+    // empty range is not accessed, whatever it points to
+    if (size == 0) {
+        return 0;
+    }
+
+    uint8_t* host_dst = memory_->GetHostRange(dst, size);
+    uint8_t* host_src = memory_->GetHostRange(src, size);
+    if (host_dst == nullptr || host_src == nullptr) {
+        spdlog::error("memmove out of guest memory: 0x{:x} <- 0x{:x}, size {}", dst, src, size);
+        // source is read before destination is written
+        if (host_src == nullptr) {
+            Fault(cpu, src, false);
+        } else {
+            Fault(cpu, dst, true);
+        }
+        return 0;
+    }
+
+    std::memmove(host_dst, host_src, size);
+    memory_->NotifyHostWrite(dst, size);
+
+    return size;
+}
+
+uint64_t HleLayer::Strlen(Cpu* cpu) {
+    Register str = cpu->GetRegisterValue(RegisterAliases::kArgument0);
+
+    uint8_t* host_str = memory_->GetHostRange(str, 0);
+    const void* terminator = host_str == nullptr ? nullptr
+                           : std::memchr(host_str, '\0', memory_->GetMemorySize() - str);
+    if (terminator == nullptr) {
+        spdlog::error("strlen out of guest memory: 0x{:x}", str);
+        Fault(cpu, str, false);
+        return 0;
+    }
+
+    size_t length = static_cast<size_t>(static_cast<const uint8_t*>(terminator) - host_str);
+    cpu->SetRegisterValue(RegisterAliases::kArgument0, static_cast<Register>(length));
+
+    return length + 1;
+}
+
+// result is difference of the first mismatched bytes as newlib returns
+uint64_t HleLayer::Strcmp(Cpu* cpu) {
+    Register lhs = cpu->GetRegisterValue(RegisterAliases::kArgument0);
+    Register rhs = cpu->GetRegisterValue(RegisterAliases::kArgument1);
+
+    uint8_t* host_lhs = memory_->GetHostRange(lhs, 0);
+    uint8_t* host_rhs = memory_->GetHostRange(rhs, 0);
+    if (host_lhs == nullptr || host_rhs == nullptr) {
+        spdlog::error("strcmp out of guest memory: 0x{:x}, 0x{:x}", lhs, rhs);
+        Fault(cpu, host_lhs == nullptr ? lhs : rhs, false);
+        return 0;
+    }
+
+    size_t lhs_limit = memory_->GetMemorySize() - lhs;
+    size_t rhs_limit = memory_->GetMemorySize() - rhs;
+    size_t lhs_length = strnlen(reinterpret_cast<const char*>(host_lhs), lhs_limit);
+    size_t size = std::min(std::min(lhs_length + 1, lhs_limit), rhs_limit);
+
+    // mismatch is found at terminator of the shorter string at the latest
+    size_t mismatch = FindMismatch(host_lhs, host_rhs, size);
+    // no terminator or mismatch before end of memory, guest goes on to read past it
+    if (mismatch == size && size < lhs_length + 1) {
+        spdlog::error("strcmp out of guest memory: 0x{:x}, 0x{:x}", lhs, rhs);
+        Fault(cpu, static_cast<MemAddress>(size == lhs_limit ? lhs + size : rhs + size), false);
+        return 0;
+    }
+
+    IRegister result = 0;
+    if (mismatch < size) {
+        result = static_cast<IRegister>(host_lhs[mismatch]) - static_cast<IRegister>(host_rhs[mismatch]);
+    }
+
+    cpu->SetRegisterValue(RegisterAliases::kArgument0, static_cast<Register>(result));
+
+    return std::min(mismatch + 1, size);
+}
+
+uint64_t HleLayer::Memcmp(Cpu* cpu) {
+    Register lhs = cpu->GetRegisterValue(RegisterAliases::kArgument0);
+    Register rhs = cpu->GetRegisterValue(RegisterAliases::kArgument1);
+    Register size = cpu->GetRegisterValue(RegisterAliases::kArgument2);
+
+    // empty ranges are not accessed, whatever they point to
+    if (size == 0) {
+        cpu->SetRegisterValue(RegisterAliases::kArgument0, 0);
+        return 0;
+    }
+
+    uint8_t* host_lhs = memory_->GetHostRange(lhs, size);
+    uint8_t* host_rhs = memory_->GetHostRange(rhs, size);
+    if (host_lhs == nullptr || host_rhs == nullptr) {
+        spdlog::error("memcmp out of guest memory: 0x{:x}, 0x{:x}, size {}", lhs, rhs, size);
+        Fault(cpu, host_lhs == nullptr ? lhs : rhs, false);
+        return 0;
+    }
+
+    size_t mismatch = FindMismatch(host_lhs, host_rhs, size);
+    IRegister result = 0;
+    if (mismatch < size) {
+        result = static_cast<IRegister>(host_lhs[mismatch]) - static_cast<IRegister>(host_rhs[mismatch]);
+    }
+
+    cpu->SetRegisterValue(RegisterAliases::kArgument0, static_cast<Register>(result));
+
+    return std::min<uint64_t>(mismatch + 1, size);
+}
+
+// division follows libgcc div.S, which matches rv32m: x / 0 is -1, x % 0 is x,
+// INT_MIN / -1 overflows to INT_MIN with remainder 0
+uint64_t HleLayer::IntegerArith(const HleRoutine routine, Cpu* cpu) {
+    Register lhs = cpu->GetRegisterValue(RegisterAliases::kArgument0);
+    Register rhs = cpu->GetRegisterValue(RegisterAliases::kArgument1);
+    IRegister lhs_ivalue = static_cast<IRegister>(lhs);
+    IRegister rhs_ivalue = static_cast<IRegister>(rhs);
+    bool is_overflow = lhs_ivalue == std::numeric_limits<IRegister>::min() && rhs_ivalue == -1;
+
+    Register result = 0;
+    switch (routine) {
+        case kHleMulsi3: {
+            result = lhs * rhs;
+        }
+        break;
+        case kHleMuldi3: {
+            // operands are a0:a1 and a2:a3, result is low half of product in a0:a1
+            uint64_t lhs_wide = (static_cast<uint64_t>(rhs) << 32) | lhs;
+            uint64_t rhs_wide = (static_cast<uint64_t>(cpu->GetRegisterValue(RegisterAliases::kArgument3)) << 32) 
+                              | cpu->GetRegisterValue(RegisterAliases::kArgument2);
+            uint64_t product = lhs_wide * rhs_wide;
+            result = static_cast<Register>(product);
+            cpu->SetRegisterValue(RegisterAliases::kArgument1, static_cast<Register>(product >> 32));
+        }
+        break;
+        case kHleDivsi3: {
+            result = rhs == 0 ? ~Register{0} 
+                   : is_overflow ? lhs 
+                   : static_cast<Register>(lhs_ivalue / rhs_ivalue);
+        }
+        break;
+        case kHleUdivsi3: {
+            result = rhs == 0 ? ~Register{0} : lhs / rhs;
+        }
+        break;
+        case kHleModsi3: {
+            result = rhs == 0 ? lhs 
+                   : is_overflow ? 0 
+                   : static_cast<Register>(lhs_ivalue % rhs_ivalue);
+        }
+        break;
+        case kHleUmodsi3: {
+            result = rhs == 0 ? lhs : lhs % rhs;
+        }
+        break;
+        default:
+            assert(0 && "not an integer helper");
+    }
+
+    cpu->SetRegisterValue(RegisterAliases::kArgument0, result);
+
+    return 1;
+}
+
+// host sse arithmetic rounds to nearest even as soft-fp does,
+// with nans canonicalized results are bit exact
+uint64_t HleLayer::FloatArith(const HleRoutine routine, Cpu* cpu) {
+    double lhs_double = GetDoubleArg(cpu, RegisterAliases::kArgument0);
+    double rhs_double = GetDoubleArg(cpu, RegisterAliases::kArgument2);
+    float lhs_float = GetFloatArg(cpu, RegisterAliases::kArgument0);
+    float rhs_float = GetFloatArg(cpu, RegisterAliases::kArgument1);
+
+    switch (routine) {
+        case kHleAdddf3: SetDoubleResult(cpu, lhs_double + rhs_double); break;
+        case kHleSubdf3: SetDoubleResult(cpu, lhs_double - rhs_double); break;
+        case kHleMuldf3: SetDoubleResult(cpu, lhs_double * rhs_double); break;
+        case kHleDivdf3: SetDoubleResult(cpu, lhs_double / rhs_double); break;
+        case kHleAddsf3: SetFloatResult(cpu, lhs_float + rhs_float);    break;
+        case kHleSubsf3: SetFloatResult(cpu, lhs_float - rhs_float);    break;
+        case kHleMulsf3: SetFloatResult(cpu, lhs_float * rhs_float);    break;
+        case kHleDivsf3: SetFloatResult(cpu, lhs_float / rhs_float);    break;
+        default:
+            assert(0 && "not a float arithmetic helper");
+    }
+
+    return 1;
+}
+
+// ordered results are -1, 0, 1; unordered one is chosen by libgcc so that
+// the comparison the helper is called for turns out false
+uint64_t HleLayer::DoubleCompare(const HleRoutine routine, Cpu* cpu) {
+    double lhs = GetDoubleArg(cpu, RegisterAliases::kArgument0);
+    double rhs = GetDoubleArg(cpu, RegisterAliases::kArgument2);
+    bool is_unordered = std::isnan(lhs) || std::isnan(rhs);
+    IRegister ordered = lhs < rhs ? -1 : (lhs > rhs ? 1 : 0);
+
+    IRegister result = 0;
+    switch (routine) {
+        case kHleEqdf2:
+        case kHleNedf2:    result = is_unordered ? 1 : ordered;  break;
+        case kHleLtdf2:
+        case kHleLedf2:    result = is_unordered ? 2 : ordered;  break;
+        case kHleGtdf2:
+        case kHleGedf2:    result = is_unordered ? -2 : ordered; break;
+        case kHleUnorddf2: result = is_unordered ? 1 : 0;        break;
+        default:
+            assert(0 && "not a compare helper");
+    }
+
+    cpu->SetRegisterValue(RegisterAliases::kArgument0, static_cast<Register>(result));
+
+    return 1;
+}
+
+// conversions to integer truncate and saturate, nan saturates by its sign
+uint64_t HleLayer::Convert(const HleRoutine routine, Cpu* cpu) {
+    Register arg = cpu->GetRegisterValue(RegisterAliases::kArgument0);
+
+    switch (routine) {
+        case kHleFloatsidf: {
+            SetDoubleResult(cpu, static_cast<double>(static_cast<IRegister>(arg)));
+        }
+        break;
+        case kHleFloatunsidf: {
+            SetDoubleResult(cpu, static_cast<double>(arg));
+        }
+        break;
+        case kHleFixdfsi: {
+            double value = std::trunc(GetDoubleArg(cpu, RegisterAliases::kArgument0));
+            IRegister result = 0;
+            if (std::isnan(value)) {
+                result = std::signbit(value) ? std::numeric_limits<IRegister>::min() : std::numeric_limits<IRegister>::max();
+            } else if (value >= 0x1p31) {
+                result = std::numeric_limits<IRegister>::max();
+            } else if (value < -0x1p31) {
+                result = std::numeric_limits<IRegister>::min();
+            } else {
+                result = static_cast<IRegister>(value);
+            }
+            cpu->SetRegisterValue(RegisterAliases::kArgument0, static_cast<Register>(result));
+        }
+        break;
+        case kHleFixunsdfsi: {
+            double value = std::trunc(GetDoubleArg(cpu, RegisterAliases::kArgument0));
+            Register result = 0;
+            if (std::isnan(value)) {
+                result = std::signbit(value) ? 0 : std::numeric_limits<Register>::max();
+            } else if (value >= 0x1p32) {
+                result = std::numeric_limits<Register>::max();
+            } else if (value > 0) {
+                result = static_cast<Register>(value);
+            }
+            cpu->SetRegisterValue(RegisterAliases::kArgument0, result);
+        }
+        break;
+        default:
+            assert(0 && "not a conversion helper");
+    }
+
+    return 1;
+}
+
+// HleLayer public ------------------------------------------------------------
+
+void HleLayer::Init(IMemory* memory, const std::vector<ploader::Symbol>& symbols, const std::vector<std::string>& routines) {
+    LogFunctionEntry();
+
+    assert(memory != nullptr);
+
+    memory_ = memory;
+    hooks_.clear();
+    stats_ = {};
+
+    for (const std::string& routine_name : routines) {
+        size_t routine = 0;
+        while (routine < kNHleRoutines && routine_name != kHleRoutines[routine].name) {
+            routine++;
+        }
+        assert(routine < kNHleRoutines && "routine names are checked by options parser");
+
+        auto symbol_it = std::find_if(symbols.begin(), symbols.end(), [&routine_name](const ploader::Symbol& symbol) {
+            return symbol.is_function && symbol.name == routine_name;
+        });
+        if (symbol_it == symbols.end()) {
+            spdlog::warn("HLE routine {} is not found in symbol table", routine_name);
+            continue;
+        }
+
+        hooks_[static_cast<Address>(symbol_it->addr)] = static_cast<HleRoutine>(routine);
+        spdlog::info("HLE routine {} hooked at 0x{:x}", routine_name, symbol_it->addr);
+    }
+}
+
+InstructionError HleLayer::Call(const HleRoutine routine, Cpu* cpu) {
+    LogFunctionEntry();
+
+    assert(cpu != nullptr);
+
+    uint64_t n_units = 0;
+    switch (routine) {
+        case kHleMemcpy:  n_units = Memcpy(cpu);  break;
+        case kHleMemset:  n_units = Memset(cpu);  break;
+        case kHleMemmove: n_units = Memmove(cpu); break;
+        case kHleStrlen:  n_units = Strlen(cpu);  break;
+        case kHleStrcmp:  n_units = Strcmp(cpu);  break;
+        case kHleMemcmp:  n_units = Memcmp(cpu);  break;
+
+        case kHleMulsi3:
+        case kHleMuldi3:
+        case kHleDivsi3:
+        case kHleUdivsi3:
+        case kHleModsi3:
+        case kHleUmodsi3:
+            n_units = IntegerArith(routine, cpu);
+            break;
+        case kHleAdddf3:
+        case kHleSubdf3:
+        case kHleMuldf3:
+        case kHleDivdf3:
+        case kHleAddsf3:
+        case kHleSubsf3:
+        case kHleMulsf3:
+        case kHleDivsf3:
+            n_units = FloatArith(routine, cpu);
+            break;
+        case kHleEqdf2:
+        case kHleNedf2:
+        case kHleLtdf2:
+        case kHleLedf2:
+        case kHleGtdf2:
+        case kHleGedf2:
+        case kHleUnorddf2:
+            n_units = DoubleCompare(routine, cpu);
+            break;
+        case kHleFloatsidf:
+        case kHleFloatunsidf:
+        case kHleFixdfsi:
+        case kHleFixunsdfsi:
+            n_units = Convert(routine, cpu);
+            break;
+        case kNHleRoutines:
+        default:
+            assert(0 && "unknown hle routine");
+            return InstructionError::kUnknownInstruction;
+    }
+
+    // faulted routine does not return, pc is left at its entry
+    if (cpu->GetIsFinished()) {
+        return InstructionError::kMemoryFault;
+    }
+
+    stats_[routine].n_calls++;
+    stats_[routine].n_units += n_units;
+
+    cpu->SetPc(cpu->GetRegisterValue(RegisterAliases::kRetAddr));
+
+    return InstructionError::kOk;
+}
+
+void HleLayer::Report(FILE* report_file) const {
+    LogFunctionEntry();
+
+    assert(report_file != nullptr);
+
+    uint64_t n_saved_instrs = 0;
+    std::fprintf(report_file, "HLE:");
+    for (size_t routine = 0; routine < kNHleRoutines; routine++) {
+        const HleStats& stats = stats_[routine];
+        if (stats.n_calls == 0) {
+            continue;
+        }
+
+        const HleRoutineInfo& info = kHleRoutines[routine];
+        n_saved_instrs += stats.n_calls * info.base_instrs + stats.n_units * info.instrs_per_unit;
+        std::fprintf(report_file, " %s %llu calls,", info.name, static_cast<unsigned long long>(stats.n_calls));
+    }
+    std::fprintf(report_file, " ~%llu guest instructions saved\n", static_cast<unsigned long long>(n_saved_instrs));
+}
+
+// global ---------------------------------------------------------------------
+
+const HleRoutineInfo& GetHleRoutineInfo(const HleRoutine routine) {
+    assert(routine < kNHleRoutines);
+
+    return kHleRoutines[routine];
+}
+
+bool ResolveHleRoutines(std::string_view names, std::vector<std::string>* routines) {
+    LogFunctionEntry();
+
+    assert(routines != nullptr);
+
+    while (!names.empty()) {
+        size_t comma = names.find(',');
+        std::string_view name = names.substr(0, comma);
+        names = comma == std::string_view::npos ? std::string_view{} : names.substr(comma + 1);
+
+        bool is_found = false;
+        for (const HleRoutineInfo& info : kHleRoutines) {
+            if (name == info.name || name == info.group || name == "all") {
+                routines->push_back(info.name);
+                is_found = true;
+            }
+        }
+
+        if (!is_found) {
+            spdlog::error("Unknown HLE routine: {}", name);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// static ---------------------------------------------------------------------
+
+// compares by 8 bytes, host is little endian so the lowest differing bit
+// belongs to the first mismatched byte
+static size_t FindMismatch(const uint8_t* lhs, const uint8_t* rhs, const size_t size) {
+    size_t index = 0;
+    for (; index + sizeof(uint64_t) <= size; index += sizeof(uint64_t)) {
+        uint64_t lhs_word = 0;
+        uint64_t rhs_word = 0;
+        std::memcpy(&lhs_word, lhs + index, sizeof(uint64_t));
+        std::memcpy(&rhs_word, rhs + index, sizeof(uint64_t));
+        if (lhs_word != rhs_word) {
+            return index + static_cast<size_t>(std::countr_zero(lhs_word ^ rhs_word)) / CHAR_BIT;
+        }
+    }
+
+    for (; index < size; index++) {
+        if (lhs[index] != rhs[index]) {
+            return index;
+        }
+    }
+
+    return size;
+}
+
+// doubles are passed in register pairs, low word first
+static double GetDoubleArg(const Cpu* cpu, const size_t low_register) {
+    uint64_t bits = (static_cast<uint64_t>(cpu->GetRegisterValue(low_register + 1)) << 32) 
+                  | cpu->GetRegisterValue(low_register);
+
+    return std::bit_cast<double>(bits);
+}
+
+static void SetDoubleResult(Cpu* cpu, const double value) {
+    uint64_t bits = std::isnan(value) ? kCanonicalNanD : std::bit_cast<uint64_t>(value);
+
+    cpu->SetRegisterValue(RegisterAliases::kArgument0, static_cast<Register>(bits));
+    cpu->SetRegisterValue(RegisterAliases::kArgument1, static_cast<Register>(bits >> 32));
+}
+
+static float GetFloatArg(const Cpu* cpu, const size_t register_id) {
+    return std::bit_cast<float>(cpu->GetRegisterValue(register_id));
+}
+
+static void SetFloatResult(Cpu* cpu, const float value) {
+    uint32_t bits = std::isnan(value) ? kCanonicalNanF : std::bit_cast<uint32_t>(value);
+
+    cpu->SetRegisterValue(RegisterAliases::kArgument0, bits);
+}
+
+} // namespace sim
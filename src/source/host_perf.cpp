@@ -0,0 +1,229 @@
+#include "host_perf.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#if defined (SIM_HAS_PERF_EVENT)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // SIM_HAS_PERF_EVENT
+
+#include "log_helper.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static void ReportRatio(FILE* report_file, const char* name, bool is_available, uint64_t numerator, uint64_t denominator);
+
+#if defined (SIM_HAS_PERF_EVENT)
+
+static const uint64_t kPerfConfigs[kNHostCounters] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_BRANCH_MISSES,
+    PERF_COUNT_HW_CACHE_MISSES,
+};
+
+// layout of read() with PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING
+struct PerfReadValue {
+    uint64_t value;
+    uint64_t time_enabled;
+    uint64_t time_running;
+};
+
+static int PerfEventOpen(perf_event_attr* attr) {
+    return static_cast<int>(syscall(SYS_perf_event_open, attr, 0, -1, -1, 0));
+}
+
+// HostPerfCounters public ----------------------------------------------------
+
+// kernel side is excluded, so unprivileged runs may count too; time of
+// syscalls is measured by syscall handler instead
+size_t HostPerfCounters::Init() {
+    LogFunctionEntry();
+
+    size_t n_opened = 0;
+    for (size_t counter_i = 0; counter_i < kNHostCounters; counter_i++) {
+        perf_event_attr attr = {};
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = kPerfConfigs[counter_i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // counters may be multiplexed when the host has fewer of them
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+        fds_[counter_i] = PerfEventOpen(&attr);
+        if (fds_[counter_i] < 0) {
+            spdlog::warn("perf_event_open of {} failed: {}", HostCounterToStr(static_cast<HostCounter>(counter_i)),
+                         std::strerror(errno));
+            continue;
+        }
+
+        n_opened++;
+    }
+
+    values_ = {};
+    wall_time_ns_ = 0;
+
+    return n_opened;
+}
+
+HostPerfCounters::~HostPerfCounters() {
+    for (int fd : fds_) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+}
+
+void HostPerfCounters::Start() {
+    LogFunctionEntry();
+
+    for (int fd : fds_) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    start_time_ = std::chrono::steady_clock::now();
+}
+
+void HostPerfCounters::Stop() {
+    LogFunctionEntry();
+
+    wall_time_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time_).count();
+
+    for (size_t counter_i = 0; counter_i < kNHostCounters; counter_i++) {
+        int fd = fds_[counter_i];
+        if (fd < 0) {
+            continue;
+        }
+
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        PerfReadValue read_value = {};
+        // counter that was never scheduled has nothing to scale
+        if (read(fd, &read_value, sizeof(read_value)) != sizeof(read_value) || read_value.time_running == 0) {
+            spdlog::warn("{} counter was not read", HostCounterToStr(static_cast<HostCounter>(counter_i)));
+            close(fd);
+            fds_[counter_i] = -1;
+            continue;
+        }
+
+        // count over the time counter was running is extrapolated to the time it was enabled
+        uint64_t value = read_value.value;
+        if (read_value.time_running < read_value.time_enabled) {
+            value = static_cast<uint64_t>(static_cast<double>(value) * static_cast<double>(read_value.time_enabled)
+                                          / static_cast<double>(read_value.time_running));
+        }
+
+        values_[counter_i] = value;
+    }
+}
+
+#else // SIM_HAS_PERF_EVENT
+
+size_t HostPerfCounters::Init() {
+    spdlog::warn("Built without perf_event_open, only wall time is measured");
+
+    values_ = {};
+    wall_time_ns_ = 0;
+
+    return 0;
+}
+
+HostPerfCounters::~HostPerfCounters() {}
+
+void HostPerfCounters::Start() {
+    start_time_ = std::chrono::steady_clock::now();
+}
+
+void HostPerfCounters::Stop() {
+    wall_time_ns_ = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time_).count();
+}
+
+#endif // SIM_HAS_PERF_EVENT
+
+bool HostPerfCounters::IsAvailable(HostCounter counter) const {
+    return fds_[static_cast<size_t>(counter)] >= 0;
+}
+
+uint64_t HostPerfCounters::Get(HostCounter counter) const {
+    return values_[static_cast<size_t>(counter)];
+}
+
+uint64_t HostPerfCounters::GetWallTimeNs() const {
+    return wall_time_ns_;
+}
+
+void HostPerfCounters::Report(FILE* report_file, const HostPerfStats& stats) const {
+    LogFunctionEntry();
+
+    assert(report_file != nullptr);
+
+    std::fprintf(report_file, "{\n");
+    std::fprintf(report_file, "  \"guest_instructions\": %llu,\n", static_cast<unsigned long long>(stats.n_guest_instrs));
+    std::fprintf(report_file, "  \"wall_time_ns\": %llu,\n", static_cast<unsigned long long>(wall_time_ns_));
+
+    std::fprintf(report_file, "  \"host_counters\": {");
+    for (size_t counter_i = 0; counter_i < kNHostCounters; counter_i++) {
+        HostCounter counter = static_cast<HostCounter>(counter_i);
+        std::fprintf(report_file, "%s\"%s\": ", counter_i == 0 ? "" : ", ", HostCounterToStr(counter));
+        if (IsAvailable(counter)) {
+            std::fprintf(report_file, "%llu", static_cast<unsigned long long>(Get(counter)));
+        } else {
+            std::fprintf(report_file, "null");
+        }
+    }
+    std::fprintf(report_file, "},\n");
+
+    ReportRatio(report_file, "host_cycles_per_guest_instruction", IsAvailable(HostCounter::kCycles),
+                Get(HostCounter::kCycles), stats.n_guest_instrs);
+    ReportRatio(report_file, "host_instructions_per_guest_instruction", IsAvailable(HostCounter::kInstructions),
+                Get(HostCounter::kInstructions), stats.n_guest_instrs);
+    ReportRatio(report_file, "host_ns_per_guest_instruction", true, wall_time_ns_, stats.n_guest_instrs);
+
+    std::fprintf(report_file, "  \"decode\": {\"predecoded_instructions\": %llu, \"run_time_decodes\": %llu, "
+                              "\"built_blocks\": %llu, \"loaded_blocks\": %llu},\n",
+                 static_cast<unsigned long long>(stats.n_predecoded_instrs), static_cast<unsigned long long>(stats.n_run_time_decodes),
+                 static_cast<unsigned long long>(stats.n_built_blocks), static_cast<unsigned long long>(stats.n_loaded_blocks));
+    std::fprintf(report_file, "  \"block_dispatch\": {\"link_hits\": %llu, \"lookups\": %llu},\n",
+                 static_cast<unsigned long long>(stats.n_block_link_hits), static_cast<unsigned long long>(stats.n_block_lookups));
+    std::fprintf(report_file, "  \"syscalls\": {\"count\": %llu, \"time_ns\": %llu, \"time_share\": %.4f}\n",
+                 static_cast<unsigned long long>(stats.n_syscalls), static_cast<unsigned long long>(stats.syscall_time_ns),
+                 wall_time_ns_ == 0 ? 0.0 : static_cast<double>(stats.syscall_time_ns) / static_cast<double>(wall_time_ns_));
+    std::fprintf(report_file, "}\n");
+}
+
+// global ---------------------------------------------------------------------
+
+const char* HostCounterToStr(HostCounter counter) {
+    switch (counter) {
+        case HostCounter::kCycles:       return "cycles";
+        case HostCounter::kInstructions: return "instructions";
+        case HostCounter::kBranchMisses: return "branch_misses";
+        case HostCounter::kCacheMisses:  return "cache_misses";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+static void ReportRatio(FILE* report_file, const char* name, bool is_available, uint64_t numerator, uint64_t denominator) {
+    if (!is_available || denominator == 0) {
+        std::fprintf(report_file, "  \"%s\": null,\n", name);
+        return ;
+    }
+
+    std::fprintf(report_file, "  \"%s\": %.3f,\n", name, static_cast<double>(numerator) / static_cast<double>(denominator));
+}
+
+} // namespace sim
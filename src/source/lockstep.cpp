@@ -0,0 +1,542 @@
+#include "lockstep.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "log_helper.hpp"
+
+#include "block_ir.hpp"
+#include "cpu.hpp"
+#include "decode.hpp"
+#include "instructions.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static bool IsBranchTaken(const InstructionMnemonic mnemonic, const Register lhs, const Register rhs);
+static void ApplyLaneAlu(const IrOpcode opcode, Register* dst, const Register* lhs, const Register* rhs,
+                         const LaneMask active);
+
+// visits set bits of mask, lowest lane first
+#define FOR_EACH_LANE(lane, mask) \
+    for (LaneMask lane##_bits = (mask), lane = 0; \
+         lane##_bits != 0 && (lane = std::countr_zero(lane##_bits), true); lane##_bits &= lane##_bits - 1)
+
+// LockstepEngine private -----------------------------------------------------
+
+LaneMask LockstepEngine::SelectLanes(Address* pc, Address* join_pc) const {
+    assert(pc != nullptr);
+    assert(join_pc != nullptr);
+    assert(live_lanes_ != 0);
+
+    Address min_pc = pcs_[std::countr_zero(live_lanes_)];
+    FOR_EACH_LANE(lane, live_lanes_) {
+        min_pc = std::min(min_pc, pcs_[lane]);
+    }
+
+    LaneMask selected = 0;
+    Address next_pc = std::numeric_limits<Address>::max();
+    FOR_EACH_LANE(lane, live_lanes_) {
+        if (pcs_[lane] == min_pc) {
+            selected |= 1u << lane;
+        } else {
+            next_pc = std::min(next_pc, pcs_[lane]);
+        }
+    }
+
+    *pc = min_pc;
+    *join_pc = next_pc;
+    return selected;
+}
+
+// non guest ops do not maintain pc, so it is set after the last of them
+void LockstepEngine::ExecuteBlock(const DecodedBlock& block, const LaneMask active, const Address join_pc) {
+    if (block.start_pc < join_pc && join_pc < block.end_pc) {
+        for (size_t op_i = 0; block.ops[op_i].pc < join_pc; op_i++) {
+            ExecuteOp(block.ops[op_i], block.start_pc, active);
+        }
+
+        FOR_EACH_LANE(lane, active) {
+            pcs_[lane] = join_pc;
+        }
+
+        RetireInstrs(active, (join_pc - block.start_pc) / kInstrSize);
+        return;
+    }
+
+    for (const IrOp& op : block.ops) {
+        ExecuteOp(op, block.start_pc, active);
+    }
+
+    if (block.ops.empty() || block.ops.back().opcode != IrOpcode::kGuest) {
+        FOR_EACH_LANE(lane, active) {
+            pcs_[lane] = block.end_pc;
+        }
+    }
+
+    RetireInstrs(active, block.n_guest_instrs);
+}
+
+void LockstepEngine::RetireInstrs(const LaneMask active, const size_t n_instrs) {
+    FOR_EACH_LANE(lane, active) {
+        n_retired_[lane] += n_instrs;
+    }
+
+    stats_.n_issued_blocks++;
+    stats_.n_issued_instrs += n_instrs;
+    stats_.n_lane_instrs += std::popcount(active) * n_instrs;
+}
+
+void LockstepEngine::ExecuteOp(const IrOp& op, const Address block_start_pc, const LaneMask active) {
+    if (op.opcode == IrOpcode::kLoadImm) {
+        std::fill(imm_lanes_, imm_lanes_ + kMaxLanes, op.imm);
+        if (op.rd != RegisterAliases::kMachineZero) {
+            ApplyLaneAlu(IrOpcode::kOrImm, registers_[op.rd], registers_[RegisterAliases::kMachineZero], imm_lanes_, active);
+        }
+    } else if (IsIrAluRegOp(op.opcode)) {
+        if (op.rd != RegisterAliases::kMachineZero) {
+            ApplyLaneAlu(op.opcode, registers_[op.rd], registers_[op.rs1], registers_[op.rs2], active);
+        }
+    } else if (IsIrAluImmOp(op.opcode)) {
+        std::fill(imm_lanes_, imm_lanes_ + kMaxLanes, op.imm);
+        if (op.rd != RegisterAliases::kMachineZero) {
+            ApplyLaneAlu(op.opcode, registers_[op.rd], registers_[op.rs1], imm_lanes_, active);
+        }
+    } else if (IsIrLoadOp(op.opcode) || IsIrStoreOp(op.opcode)) {
+        ExecuteMemoryOp(op, active);
+    } else {
+        ExecuteGuest(op, block_start_pc, active);
+    }
+}
+
+// lanes have own memories, so accesses are not vectorized
+void LockstepEngine::ExecuteMemoryOp(const IrOp& op, const LaneMask active) {
+    FOR_EACH_LANE(lane, active) {
+        Memory& memory = memories_[lane];
+        const Address address = registers_[op.rs1][lane] + op.imm;
+        const Register value = registers_[op.rs2][lane];
+
+        switch (op.opcode) {
+            case IrOpcode::kLoad8:   SetRegister(op.rd, lane, static_cast<Register>(static_cast<int8_t>(memory.ReadFromMemory8b(address))));   break;
+            case IrOpcode::kLoad8u:  SetRegister(op.rd, lane, memory.ReadFromMemory8b(address));                                             break;
+            case IrOpcode::kLoad16:  SetRegister(op.rd, lane, static_cast<Register>(static_cast<int16_t>(memory.ReadFromMemory16b(address)))); break;
+            case IrOpcode::kLoad16u: SetRegister(op.rd, lane, memory.ReadFromMemory16b(address));                                            break;
+            case IrOpcode::kLoad32:  SetRegister(op.rd, lane, memory.ReadFromMemory32b(address));                                            break;
+            case IrOpcode::kStore8:  memory.WriteToMemory8b(static_cast<uint8_t>(value), address);                                           break;
+            case IrOpcode::kStore16: memory.WriteToMemory16b(static_cast<uint16_t>(value), address);                                         break;
+            case IrOpcode::kStore32: memory.WriteToMemory32b(value, address);                                                                break;
+            default:
+                assert(0 && "not a memory ir opcode");
+        }
+    }
+}
+
+void LockstepEngine::ExecuteGuest(const IrOp& op, const Address block_start_pc, const LaneMask active) {
+    const DecodedInstr& dec_instr = op.guest;
+    const Address next_pc = op.pc + kInstrSize;
+
+    switch (dec_instr.instr_mnem) {
+        case InstructionMnemonic::kBeq:
+        case InstructionMnemonic::kBne:
+        case InstructionMnemonic::kBlt:
+        case InstructionMnemonic::kBge:
+        case InstructionMnemonic::kBltu:
+        case InstructionMnemonic::kBgeu: {
+            const Address target = op.pc + SignExtendImm(dec_instr.instr.b_type.imm, dec_instr.instr.b_type.imm_size_bit);
+
+            LaneMask taken = 0;
+            FOR_EACH_LANE(lane, active) {
+                if (IsBranchTaken(dec_instr.instr_mnem, registers_[dec_instr.instr.b_type.rs1][lane],
+                                  registers_[dec_instr.instr.b_type.rs2][lane])) {
+                    taken |= 1u << lane;
+                }
+            }
+
+            FOR_EACH_LANE(lane, active) {
+                pcs_[lane] = (taken & (1u << lane)) ? target : next_pc;
+            }
+
+            if (taken != 0 && taken != active) {
+                stats_.n_divergences++;
+            }
+        }
+        break;
+        case InstructionMnemonic::kJal: {
+            const Address target = op.pc + SignExtendImm(dec_instr.instr.j_type.imm, dec_instr.instr.j_type.imm_size_bit);
+            FOR_EACH_LANE(lane, active) {
+                SetRegister(dec_instr.instr.j_type.rd, lane, next_pc);
+                pcs_[lane] = target;
+            }
+        }
+        break;
+        case InstructionMnemonic::kJalr: {
+            const Register offset = SignExtendImm(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit);
+            FOR_EACH_LANE(lane, active) {
+                pcs_[lane] = (registers_[dec_instr.instr.i_type.rs1][lane] + offset) & ~1u;
+                SetRegister(dec_instr.instr.i_type.rd, lane, next_pc);
+            }
+
+            const Address first_target = pcs_[std::countr_zero(active)];
+            FOR_EACH_LANE(lane, active) {
+                if (pcs_[lane] != first_target) {
+                    stats_.n_divergences++;
+                    break;
+                }
+            }
+        }
+        break;
+        case InstructionMnemonic::kScall: {
+            FOR_EACH_LANE(lane, active) {
+                HandleSyscall(lane);
+                pcs_[lane] = next_pc;
+            }
+        }
+        break;
+        case InstructionMnemonic::kSbreak: {
+            live_lanes_ &= ~active;
+            FOR_EACH_LANE(lane, active) {
+                pcs_[lane] = next_pc;
+            }
+        }
+        break;
+        case InstructionMnemonic::kCsrrw:
+        case InstructionMnemonic::kCsrrs:
+        case InstructionMnemonic::kCsrrc:
+        case InstructionMnemonic::kCsrrwi:
+        case InstructionMnemonic::kCsrrsi:
+        case InstructionMnemonic::kCsrrci: {
+            // blocks are straight-line and not fused, instructions before op retire with it
+            const uint64_t n_block_instrs = (op.pc - block_start_pc) / kInstrSize;
+            FOR_EACH_LANE(lane, active) {
+                ExecuteCsr(dec_instr, n_retired_[lane] + n_block_instrs, lane);
+                pcs_[lane] = next_pc;
+            }
+        }
+        break;
+        case InstructionMnemonic::kFence:
+        case InstructionMnemonic::kFence_i: {
+            // code of lanes is decoded from memory of the first one,
+            // its written blocks are dropped before the next issue
+            FOR_EACH_LANE(lane, active) {
+                pcs_[lane] = next_pc;
+            }
+        }
+        break;
+        default: {
+            // illegal instruction is reported and skipped as Cpu does
+            spdlog::error("Instruction {} at 0x{:x} is not supported by lockstep execution",
+                          InstructionMnemonicToStr(dec_instr.instr_mnem), op.pc);
+            FOR_EACH_LANE(lane, active) {
+                pcs_[lane] = next_pc;
+            }
+        }
+        break;
+    }
+}
+
+// counters and hart id are readable only
+InstructionError LockstepEngine::ExecuteCsr(const DecodedInstr& dec_instr, const uint64_t n_retired, const size_t lane) {
+    const InstructionMnemonic mnemonic = dec_instr.instr_mnem;
+    const Register csr = dec_instr.instr.i_type.imm;
+
+    Register value = 0;
+    switch (csr) {
+        case CounterCsr::kCsrCycle:
+        case CounterCsr::kCsrTime:
+        case CounterCsr::kCsrInstret:
+            value = static_cast<Register>(n_retired);
+            break;
+        case CounterCsr::kCsrCycleh:
+        case CounterCsr::kCsrTimeh:
+        case CounterCsr::kCsrInstreth:
+            value = static_cast<Register>(n_retired >> 32u);
+            break;
+        case HartCsr::kCsrMhartid:
+            value = first_hart_ + static_cast<Register>(lane);
+            break;
+        default:
+            spdlog::error("Csr 0x{:x} is not supported by lockstep execution", csr);
+            return InstructionError::kUnknownInstruction;
+    }
+
+    const bool is_write = mnemonic == InstructionMnemonic::kCsrrw
+                       || mnemonic == InstructionMnemonic::kCsrrwi
+                       || dec_instr.instr.i_type.rs1 != 0;
+    if (is_write) {
+        spdlog::error("Write to read-only csr 0x{:x}", csr);
+        return InstructionError::kUnknownInstruction;
+    }
+
+    SetRegister(dec_instr.instr.i_type.rd, lane, value);
+
+    return InstructionError::kOk;
+}
+
+void LockstepEngine::HandleSyscall(const size_t lane) {
+    SyscallArgs args = {};
+    for (size_t arg_i = 0; arg_i < kNSyscallArgs; arg_i++) {
+        args[arg_i] = registers_[RegisterAliases::kArgument0 + arg_i][lane];
+    }
+
+    Register ret_value = 0;
+    SyscallHandler& syscall_handler = syscall_handlers_[lane];
+    SyscallError err = syscall_handler.Handle(registers_[kSyscallIdRegister][lane], args, &ret_value);
+    if (err != SyscallError::kOk) {
+        spdlog::error("Error occurd while syscall of lane {}", lane);
+    }
+    SetRegister(RegisterAliases::kArgument0, lane, ret_value);
+
+    if (syscall_handler.GetIsExited()) {
+        live_lanes_ &= ~(1u << lane);
+    }
+}
+
+// LockstepEngine public ------------------------------------------------------
+
+void LockstepEngine::Init(const ploader::IProgramLoader& ploader, const size_t n_lanes, const Register first_hart,
+                          IIoBackend* io_backend) {
+    LogFunctionEntry();
+
+    assert(0 < n_lanes && n_lanes <= kMaxLanes);
+    assert(io_backend != nullptr);
+
+    n_lanes_ = n_lanes;
+    first_hart_ = first_hart;
+    live_lanes_ = static_cast<LaneMask>((uint64_t{1} << n_lanes) - 1);
+
+    std::memset(registers_, 0, sizeof(registers_));
+    std::memset(n_retired_, 0, sizeof(n_retired_));
+    std::fill(pcs_, pcs_ + kMaxLanes, static_cast<Address>(ploader.GetEntryPoint()));
+
+    // devices are mapped by pointers, so vectors are not resized after this
+    memories_.resize(n_lanes);
+    uarts_.resize(n_lanes);
+    timers_.resize(n_lanes);
+    syscall_handlers_.resize(n_lanes);
+    for (size_t lane = 0; lane < n_lanes; lane++) {
+        Memory& memory = memories_[lane];
+        memory.Init(kMemorySize);
+
+        Address program_end = 0;
+        for (size_t index_ls = 0; index_ls < ploader.GetNLSections(); index_ls++) {
+            memory.MapToMemory(ploader.GetBinIndex(index_ls), ploader.GetStartAddrIndex(index_ls), ploader.GetEndAddrIndex(index_ls));
+            program_end = std::max(program_end, static_cast<Address>(ploader.GetEndAddrIndex(index_ls)));
+        }
+
+        uarts_[lane].Init(io_backend);
+        timers_[lane].Init(&n_retired_[lane]);
+        MapProgramRegions(ploader, {{kUartBase, &uarts_[lane]}, {kTimerBase, &timers_[lane]}}, &memory);
+
+        syscall_handlers_[lane].Init(&memory, io_backend, program_end);
+
+        registers_[RegisterAliases::kStackPointer][lane] = static_cast<Register>(memory.GetMemorySize()) - sizeof(Register);
+        registers_[RegisterAliases::kRetAddr][lane] = kStartingReturnAddress;
+    }
+
+    // fused pairs are not executed by lanes, blocks stop at joins so they are not optimized
+    hle_.Init(&memories_[0], ploader.GetSymbols(), {});
+    block_cache_.Init(&memories_[0], &hle_, nullptr, false, false);
+
+    stats_ = {};
+}
+
+void LockstepEngine::Run() {
+    LogFunctionEntry();
+
+    while (live_lanes_ != 0) {
+        if (memories_[0].HasWrittenCode()) {
+            block_cache_.InvalidateWrittenCode();
+        }
+
+        Address pc = 0;
+        Address join_pc = 0;
+        LaneMask active = SelectLanes(&pc, &join_pc);
+
+        DecodedBlock& block = block_cache_.GetBlock(pc);
+        block.n_executions++;
+        ExecuteBlock(block, active, join_pc);
+    }
+}
+
+int LockstepEngine::GetExitCode() const {
+    for (size_t lane = 0; lane < n_lanes_; lane++) {
+        int exit_code = syscall_handlers_[lane].GetExitCode();
+        if (exit_code != 0) {
+            return exit_code;
+        }
+    }
+
+    return 0;
+}
+
+bool LockstepEngine::GetIsNondeterministic() const {
+    return std::any_of(syscall_handlers_.begin(), syscall_handlers_.end(),
+                       [](const SyscallHandler& syscall_handler) { return syscall_handler.GetIsNondeterministic(); });
+}
+
+void LockstepEngine::Report(FILE* report_file) const {
+    LogFunctionEntry();
+
+    assert(report_file != nullptr);
+
+    const uint64_t n_lane_slots = stats_.n_issued_instrs * n_lanes_;
+    std::fprintf(report_file, "Lockstep execution report (%zu lanes):\n", n_lanes_);
+    std::fprintf(report_file, "  issued blocks:       %llu\n", static_cast<unsigned long long>(stats_.n_issued_blocks));
+    std::fprintf(report_file, "  issued instructions: %llu\n", static_cast<unsigned long long>(stats_.n_issued_instrs));
+    std::fprintf(report_file, "  lane instructions:   %llu\n", static_cast<unsigned long long>(stats_.n_lane_instrs));
+    std::fprintf(report_file, "  lane utilization:    %.2f%%\n",
+                 n_lane_slots == 0 ? 0.0 : 100.0 * static_cast<double>(stats_.n_lane_instrs) / static_cast<double>(n_lane_slots));
+    std::fprintf(report_file, "  divergent branches:  %llu\n", static_cast<unsigned long long>(stats_.n_divergences));
+
+    for (size_t lane = 0; lane < n_lanes_; lane++) {
+        std::fprintf(report_file, "  hart %u: exit code %d, %llu instructions\n",
+                     static_cast<unsigned>(first_hart_ + lane), syscall_handlers_[lane].GetExitCode(),
+                     static_cast<unsigned long long>(n_retired_[lane]));
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+static bool IsBranchTaken(const InstructionMnemonic mnemonic, const Register lhs, const Register rhs) {
+    switch (mnemonic) {
+        case InstructionMnemonic::kBeq:  return lhs == rhs;
+        case InstructionMnemonic::kBne:  return lhs != rhs;
+        case InstructionMnemonic::kBlt:  return static_cast<IRegister>(lhs) <  static_cast<IRegister>(rhs);
+        case InstructionMnemonic::kBge:  return static_cast<IRegister>(lhs) >= static_cast<IRegister>(rhs);
+        case InstructionMnemonic::kBltu: return lhs <  rhs;
+        case InstructionMnemonic::kBgeu: return lhs >= rhs;
+        default:
+            assert(0 && "not a branch");
+            return false;
+    }
+}
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+
+#if defined(__AVX512F__)
+using LaneVector = __m512i;
+#define LANE_VECTOR_OP(name) _mm512_##name
+#define LANE_VECTOR_SI(name) _mm512_##name##_si512
+
+static inline void StoreLanes(Register* dst, LaneVector value, LaneMask mask) {
+    _mm512_mask_store_epi32(dst, static_cast<__mmask16>(mask), value);
+}
+
+static inline LaneVector SltLanes(LaneVector lhs, LaneVector rhs) {
+    return _mm512_maskz_set1_epi32(_mm512_cmplt_epi32_mask(lhs, rhs), 1);
+}
+
+// zero masked forms, unmasked ones start from undefined vector that gcc reports as uninitialized
+static inline LaneVector SllLanes(LaneVector lhs, LaneVector rhs) { return _mm512_maskz_sllv_epi32(0xffff, lhs, rhs); }
+static inline LaneVector SrlLanes(LaneVector lhs, LaneVector rhs) { return _mm512_maskz_srlv_epi32(0xffff, lhs, rhs); }
+static inline LaneVector SraLanes(LaneVector lhs, LaneVector rhs) { return _mm512_maskz_srav_epi32(0xffff, lhs, rhs); }
+
+static inline LaneVector SltuLanes(LaneVector lhs, LaneVector rhs) {
+    return _mm512_maskz_set1_epi32(_mm512_cmplt_epu32_mask(lhs, rhs), 1);
+}
+#else
+using LaneVector = __m256i;
+#define LANE_VECTOR_OP(name) _mm256_##name
+#define LANE_VECTOR_SI(name) _mm256_##name##_si256
+
+static inline void StoreLanes(Register* dst, LaneVector value, LaneMask mask) {
+    const LaneVector lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+    const LaneVector store_mask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(static_cast<int>(mask)), lane_bits), lane_bits);
+    _mm256_maskstore_epi32(reinterpret_cast<int*>(dst), store_mask, value);
+}
+
+static inline LaneVector SltLanes(LaneVector lhs, LaneVector rhs) {
+    return _mm256_srli_epi32(_mm256_cmpgt_epi32(rhs, lhs), 31);
+}
+
+static inline LaneVector SllLanes(LaneVector lhs, LaneVector rhs) { return _mm256_sllv_epi32(lhs, rhs); }
+static inline LaneVector SrlLanes(LaneVector lhs, LaneVector rhs) { return _mm256_srlv_epi32(lhs, rhs); }
+static inline LaneVector SraLanes(LaneVector lhs, LaneVector rhs) { return _mm256_srav_epi32(lhs, rhs); }
+
+// unsigned compare is signed one of values with flipped sign bits
+static inline LaneVector SltuLanes(LaneVector lhs, LaneVector rhs) {
+    const LaneVector sign = _mm256_set1_epi32(INT32_MIN);
+    return SltLanes(_mm256_xor_si256(lhs, sign), _mm256_xor_si256(rhs, sign));
+}
+#endif
+
+static const size_t kLanesPerVector = sizeof(LaneVector) / sizeof(Register);
+static_assert(kMaxLanes % kLanesPerVector == 0);
+
+static inline LaneVector LoadLanes(const Register* src) {
+    return LANE_VECTOR_SI(load)(reinterpret_cast<const LaneVector*>(src));
+}
+
+// rows of register file are 64 byte aligned
+template <typename Kernel>
+static inline void RunLanes(Register* dst, const Register* lhs, const Register* rhs, const LaneMask active, Kernel kernel) {
+    const LaneMask vector_mask = (LaneMask{1} << kLanesPerVector) - 1;
+
+    for (size_t lane = 0; lane < kMaxLanes; lane += kLanesPerVector) {
+        const LaneMask mask = (active >> lane) & vector_mask;
+        if (mask != 0) {
+            StoreLanes(dst + lane, kernel(LoadLanes(lhs + lane), LoadLanes(rhs + lane)), mask);
+        }
+    }
+}
+
+#define LANE_KERNEL(expr) \
+    RunLanes(dst, lhs, rhs, active, [=](LaneVector a, [[maybe_unused]] LaneVector b) { return expr; }); return true;
+
+static bool RunHostKernel(const IrOpcode opcode, Register* dst, const Register* lhs, const Register* rhs,
+                          const LaneMask active) {
+    const LaneVector shamt_mask = LANE_VECTOR_OP(set1_epi32)(0b1'1111);
+
+    switch (opcode) {
+        case IrOpcode::kAdd:  case IrOpcode::kAddImm:  LANE_KERNEL(LANE_VECTOR_OP(add_epi32)(a, b))
+        case IrOpcode::kSub:                           LANE_KERNEL(LANE_VECTOR_OP(sub_epi32)(a, b))
+        case IrOpcode::kSll:  case IrOpcode::kSllImm:  LANE_KERNEL(SllLanes(a, LANE_VECTOR_SI(and)(b, shamt_mask)))
+        case IrOpcode::kSlt:  case IrOpcode::kSltImm:  LANE_KERNEL(SltLanes(a, b))
+        case IrOpcode::kSltu: case IrOpcode::kSltuImm: LANE_KERNEL(SltuLanes(a, b))
+        case IrOpcode::kXor:  case IrOpcode::kXorImm:  LANE_KERNEL(LANE_VECTOR_SI(xor)(a, b))
+        case IrOpcode::kSrl:  case IrOpcode::kSrlImm:  LANE_KERNEL(SrlLanes(a, LANE_VECTOR_SI(and)(b, shamt_mask)))
+        case IrOpcode::kSra:  case IrOpcode::kSraImm:  LANE_KERNEL(SraLanes(a, LANE_VECTOR_SI(and)(b, shamt_mask)))
+        case IrOpcode::kOr:   case IrOpcode::kOrImm:   LANE_KERNEL(LANE_VECTOR_SI(or)(a, b))
+        case IrOpcode::kAnd:  case IrOpcode::kAndImm:  LANE_KERNEL(LANE_VECTOR_SI(and)(a, b))
+        default:
+            return false;
+    }
+}
+
+#undef LANE_KERNEL
+#undef LANE_VECTOR_SI
+#undef LANE_VECTOR_OP
+
+#else
+
+// no host simd, lanes are evaluated one by one
+static bool RunHostKernel(const IrOpcode /*opcode*/, Register* /*dst*/, const Register* /*lhs*/,
+                          const Register* /*rhs*/, const LaneMask /*active*/) {
+    return false;
+}
+
+#endif
+
+// dst may be the same as lhs or rhs, inactive lanes are left untouched
+static void ApplyLaneAlu(const IrOpcode opcode, Register* dst, const Register* lhs, const Register* rhs,
+                         const LaneMask active) {
+    if (RunHostKernel(opcode, dst, lhs, rhs, active)) {
+        return ;
+    }
+
+    FOR_EACH_LANE(lane, active) {
+        dst[lane] = EvaluateIrAlu(opcode, lhs[lane], rhs[lane]);
+    }
+}
+
+#undef FOR_EACH_LANE
+
+} // namespace sim
@@ -0,0 +1,398 @@
+#include "loop_idiom.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <limits>
+
+#include "log_helper.hpp"
+
+#include "cpu.hpp"
+#include "cpu_defs.hpp"
+#include "decode.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static const size_t kMaxLoopBodyInstrs = 16;
+
+struct AccessRange {
+    Address low;
+    uint8_t* host;
+};
+
+static bool GetLoadWidth(InstructionMnemonic mnemonic, uint8_t* width, bool* is_signed);
+static bool GetStoreWidth(InstructionMnemonic mnemonic, uint8_t* width);
+static bool CountIterations(const LoopIdiom& idiom, Register control, Register bound, uint64_t* n_iterations);
+static bool GetAccessRange(const LoopIdiom& idiom, const LoopAccess& access, Register base, uint64_t n_iterations,
+                           bool is_store, IMemory* memory, AccessRange* range);
+static Register LoadElement(const LoopIdiom& idiom, const uint8_t* element);
+static bool IsOverlapping(uint64_t lhs, uint64_t lhs_size, uint64_t rhs, uint64_t rhs_size);
+
+// global ---------------------------------------------------------------------
+
+bool RecognizeLoopIdiom(const std::vector<DecodedInstr>& head, const std::vector<DecodedInstr>& tail,
+                        Address start_pc, LoopIdiom* idiom) {
+    LogFunctionEntry();
+
+    assert(idiom != nullptr);
+
+    std::vector<DecodedInstr> body = head;
+    body.insert(body.end(), tail.begin(), tail.end());
+    if (body.size() < 2 || body.size() > kMaxLoopBodyInstrs) {
+        return false;
+    }
+
+    LoopIdiom loop = {};
+    loop.n_body_instrs = body.size();
+    loop.n_head_instrs = tail.empty() ? body.size() : head.size();
+    loop.start_pc = start_pc;
+    loop.end_pc = start_pc + static_cast<Address>(body.size() * kInstrSize);
+
+    const DecodedInstr& branch = body.back();
+    Address branch_pc = loop.end_pc - kInstrSize;
+    if ((branch.instr_mnem != InstructionMnemonic::kBne && branch.instr_mnem != InstructionMnemonic::kBltu) ||
+        branch_pc + SignExtendImm(branch.instr.b_type.imm, branch.instr.b_type.imm_size_bit) != start_pc) {
+        return false;
+    }
+
+    // pointer increments seen so far, to get offsets of accesses from values at loop entry
+    std::array<Register, kNumberOfRegisters> deltas = {};
+    std::array<bool, kNumberOfRegisters> is_written = {};
+    std::vector<LoopAccess> loads;
+    std::vector<LoopAccess> stores;
+    bool is_stored_after_load = false;
+
+    size_t n_scanned = tail.empty() ? body.size() - 1 : head.size() - 1;
+    for (size_t instr_i = 0; instr_i < body.size() - 1; instr_i++) {
+        if (instr_i == n_scanned) {
+            continue; // mismatch exit
+        }
+
+        const DecodedInstr& dec_instr = body[instr_i];
+        uint8_t width = 0;
+        bool is_signed = false;
+        if (GetLoadWidth(dec_instr.instr_mnem, &width, &is_signed)) {
+            uint8_t rs1 = static_cast<uint8_t>(dec_instr.instr.i_type.rs1);
+            uint8_t rd = static_cast<uint8_t>(dec_instr.instr.i_type.rd);
+            if (rd == 0 || is_written[rd] || instr_i > n_scanned ||
+                (loop.width != 0 && (loop.width != width || loop.is_signed != is_signed))) {
+                return false;
+            }
+
+            loop.width = width;
+            loop.is_signed = is_signed;
+            is_written[rd] = true;
+            loads.push_back({.base = rs1, .reg = rd,
+                             .offset = SignExtendImm(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit) + deltas[rs1]});
+        } else if (GetStoreWidth(dec_instr.instr_mnem, &width)) {
+            uint8_t rs1 = static_cast<uint8_t>(dec_instr.instr.s_type.rs1);
+            if (loop.width != 0 && loop.width != width) {
+                return false;
+            }
+
+            loop.width = width;
+            is_stored_after_load = is_written[dec_instr.instr.s_type.rs2];
+            stores.push_back({.base = rs1, .reg = static_cast<uint8_t>(dec_instr.instr.s_type.rs2),
+                              .offset = SignExtendImm(dec_instr.instr.s_type.imm, dec_instr.instr.s_type.imm_size_bit) + deltas[rs1]});
+        } else if (dec_instr.instr_mnem == InstructionMnemonic::kAddi &&
+                   dec_instr.instr.i_type.rd == dec_instr.instr.i_type.rs1 && dec_instr.instr.i_type.rd != 0) {
+            uint8_t reg = static_cast<uint8_t>(dec_instr.instr.i_type.rd);
+            if (is_written[reg] || loop.n_increments == kMaxLoopIncrements) {
+                return false;
+            }
+
+            Register step = SignExtendImm(dec_instr.instr.i_type.imm, dec_instr.instr.i_type.imm_size_bit);
+            is_written[reg] = true;
+            deltas[reg] += step;
+            loop.increments[loop.n_increments++] = {.reg = reg, .step = step, .is_before_exit = instr_i < n_scanned};
+        } else {
+            return false;
+        }
+    }
+
+    if (!tail.empty()) {
+        const DecodedInstr& exit = head.back();
+        if (exit.instr_mnem != InstructionMnemonic::kBne || loads.size() != 2 || !stores.empty()) {
+            return false;
+        }
+
+        uint8_t exit_rs1 = static_cast<uint8_t>(exit.instr.b_type.rs1);
+        uint8_t exit_rs2 = static_cast<uint8_t>(exit.instr.b_type.rs2);
+        if (!((exit_rs1 == loads[0].reg && exit_rs2 == loads[1].reg) || (exit_rs1 == loads[1].reg && exit_rs2 == loads[0].reg))) {
+            return false;
+        }
+
+        Address exit_pc = start_pc + static_cast<Address>((head.size() - 1) * kInstrSize);
+        loop.kind = LoopIdiomKind::kCompare;
+        loop.lhs = loads[0];
+        loop.rhs = loads[1];
+        loop.mismatch_pc = exit_pc + SignExtendImm(exit.instr.b_type.imm, exit.instr.b_type.imm_size_bit);
+    } else if (loads.size() == 1 && stores.size() == 1 && stores[0].reg == loads[0].reg && is_stored_after_load) {
+        loop.kind = LoopIdiomKind::kCopy;
+        loop.lhs = loads[0];
+        loop.rhs = stores[0];
+    } else if (loads.empty() && stores.size() == 1 && !is_written[stores[0].reg]) {
+        loop.kind = LoopIdiomKind::kFill;
+        loop.rhs = stores[0];
+    } else {
+        return false;
+    }
+
+    // accessed pointers move by one element per iteration in the same direction
+    std::array<Register, kNumberOfRegisters> steps = {};
+    for (size_t increment_i = 0; increment_i < loop.n_increments; increment_i++) {
+        steps[loop.increments[increment_i].reg] = loop.increments[increment_i].step;
+    }
+    loop.step = steps[loop.rhs.base];
+    if ((loop.step != loop.width && loop.step != -static_cast<Register>(loop.width)) ||
+        (loop.kind != LoopIdiomKind::kFill && (steps[loop.lhs.base] != loop.step || loop.lhs.base == loop.rhs.base))) {
+        return false;
+    }
+
+    uint8_t branch_rs1 = static_cast<uint8_t>(branch.instr.b_type.rs1);
+    uint8_t branch_rs2 = static_cast<uint8_t>(branch.instr.b_type.rs2);
+    if (branch.instr_mnem == InstructionMnemonic::kBne && steps[branch_rs1] == 0) {
+        std::swap(branch_rs1, branch_rs2);
+    }
+    loop.control = branch.instr_mnem == InstructionMnemonic::kBne ? LoopControl::kNotEqual : LoopControl::kLessUnsigned;
+    loop.control_reg = branch_rs1;
+    loop.bound_reg = branch_rs2;
+    if (steps[loop.control_reg] == 0 || is_written[loop.bound_reg] || loop.control_reg == 0 ||
+        (loop.control == LoopControl::kLessUnsigned && static_cast<IRegister>(steps[loop.control_reg]) < 0)) {
+        return false;
+    }
+
+    *idiom = loop;
+
+    return true;
+}
+
+uint64_t RunLoopIdiom(const LoopIdiom& idiom, Cpu* cpu, IMemory* memory, LoopIdiomStats* stats) {
+    LogFunctionEntry();
+
+    assert(idiom.kind != LoopIdiomKind::kNone);
+    assert(cpu != nullptr);
+    assert(memory != nullptr);
+    assert(stats != nullptr);
+
+    stats->n_runs++;
+
+    uint64_t n_iterations = 0;
+    AccessRange lhs = {};
+    AccessRange rhs = {};
+    uint64_t size = 0;
+    bool is_runnable = CountIterations(idiom, cpu->GetRegisterValue(idiom.control_reg),
+                                       cpu->GetRegisterValue(idiom.bound_reg), &n_iterations);
+    if (is_runnable) {
+        size = n_iterations * idiom.width;
+        bool is_rhs_store = idiom.kind != LoopIdiomKind::kCompare;
+        is_runnable = GetAccessRange(idiom, idiom.rhs, cpu->GetRegisterValue(idiom.rhs.base), n_iterations, is_rhs_store,
+                                     memory, &rhs) &&
+                      (idiom.kind == LoopIdiomKind::kFill ||
+                       GetAccessRange(idiom, idiom.lhs, cpu->GetRegisterValue(idiom.lhs.base), n_iterations, false,
+                                      memory, &lhs));
+    }
+
+    // stores into loop code and copies reading already copied elements stay with guest
+    if (is_runnable && idiom.kind != LoopIdiomKind::kCompare) {
+        is_runnable = !IsOverlapping(rhs.low, size, idiom.start_pc, idiom.end_pc - idiom.start_pc);
+    }
+    if (is_runnable && idiom.kind == LoopIdiomKind::kCopy && IsOverlapping(lhs.low, size, rhs.low, size)) {
+        is_runnable = static_cast<IRegister>(idiom.step) > 0 ? rhs.low <= lhs.low : rhs.low >= lhs.low;
+    }
+
+    if (!is_runnable) {
+        stats->n_fallbacks++;
+        return 0;
+    }
+
+    // element index in iteration order to its host offset
+    auto element_offset = [&idiom, n_iterations](uint64_t index) {
+        return static_cast<IRegister>(idiom.step) > 0 ? index * idiom.width : (n_iterations - 1 - index) * idiom.width;
+    };
+
+    uint64_t n_completed = n_iterations;
+    Address next_pc = idiom.end_pc;
+    uint64_t n_retired_instrs = n_iterations * idiom.n_body_instrs;
+    switch (idiom.kind) {
+        case LoopIdiomKind::kCopy: {
+            Register last_value = LoadElement(idiom, lhs.host + element_offset(n_iterations - 1));
+            std::memmove(rhs.host, lhs.host, size);
+            memory->NotifyHostWrite(rhs.low, size);
+            cpu->SetRegisterValue(idiom.lhs.reg, last_value);
+        }
+        break;
+        case LoopIdiomKind::kFill: {
+            Register value = cpu->GetRegisterValue(idiom.rhs.reg);
+            if (idiom.width == 1) {
+                std::memset(rhs.host, static_cast<uint8_t>(value), size);
+            } else {
+                for (uint64_t offset = 0; offset < size; offset += idiom.width) {
+                    std::memcpy(rhs.host + offset, &value, idiom.width);
+                }
+            }
+            memory->NotifyHostWrite(rhs.low, size);
+        }
+        break;
+        case LoopIdiomKind::kCompare: {
+            uint64_t mismatch = n_iterations;
+            if (std::memcmp(lhs.host, rhs.host, size) != 0) {
+                for (uint64_t index = 0; index < n_iterations; index++) {
+                    if (std::memcmp(lhs.host + element_offset(index), rhs.host + element_offset(index), idiom.width) != 0) {
+                        mismatch = index;
+                        break;
+                    }
+                }
+            }
+
+            uint64_t last = std::min(mismatch, n_iterations - 1);
+            cpu->SetRegisterValue(idiom.lhs.reg, LoadElement(idiom, lhs.host + element_offset(last)));
+            cpu->SetRegisterValue(idiom.rhs.reg, LoadElement(idiom, rhs.host + element_offset(last)));
+            if (mismatch < n_iterations) {
+                n_completed = mismatch;
+                next_pc = idiom.mismatch_pc;
+                n_retired_instrs = mismatch * idiom.n_body_instrs + idiom.n_head_instrs;
+            }
+        }
+        break;
+        case LoopIdiomKind::kNone:
+        default:
+            assert(0 && "unknown enum value");
+            return 0;
+    }
+
+    bool is_exited_on_mismatch = next_pc != idiom.end_pc;
+    for (size_t increment_i = 0; increment_i < idiom.n_increments; increment_i++) {
+        const LoopIncrement& increment = idiom.increments[increment_i];
+        uint64_t n_steps = n_completed + (is_exited_on_mismatch && increment.is_before_exit ? 1 : 0);
+        Register value = cpu->GetRegisterValue(increment.reg) + static_cast<Register>(n_steps) * increment.step;
+        cpu->SetRegisterValue(increment.reg, value);
+    }
+    cpu->SetPc(next_pc);
+
+    stats->n_iterations += n_completed;
+
+    return n_retired_instrs;
+}
+
+const char* LoopIdiomKindToStr(LoopIdiomKind kind) {
+    switch (kind) {
+        case LoopIdiomKind::kNone:    return "none";
+        case LoopIdiomKind::kCopy:    return "copy";
+        case LoopIdiomKind::kFill:    return "fill";
+        case LoopIdiomKind::kCompare: return "compare";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+static bool GetLoadWidth(InstructionMnemonic mnemonic, uint8_t* width, bool* is_signed) {
+    switch (mnemonic) {
+        case InstructionMnemonic::kLb:  *width = 1; *is_signed = true;  return true;
+        case InstructionMnemonic::kLbu: *width = 1; *is_signed = false; return true;
+        case InstructionMnemonic::kLh:  *width = 2; *is_signed = true;  return true;
+        case InstructionMnemonic::kLhu: *width = 2; *is_signed = false; return true;
+        case InstructionMnemonic::kLw:  *width = 4; *is_signed = false; return true;
+        default:
+            return false;
+    }
+}
+
+static bool GetStoreWidth(InstructionMnemonic mnemonic, uint8_t* width) {
+    switch (mnemonic) {
+        case InstructionMnemonic::kSb: *width = 1; return true;
+        case InstructionMnemonic::kSh: *width = 2; return true;
+        case InstructionMnemonic::kSw: *width = 4; return true;
+        default:
+            return false;
+    }
+}
+
+// loop branch is the last instruction, so it sees control register after
+// all increments of the iteration
+static bool CountIterations(const LoopIdiom& idiom, Register control, Register bound, uint64_t* n_iterations) {
+    Register step = 0;
+    for (size_t increment_i = 0; increment_i < idiom.n_increments; increment_i++) {
+        if (idiom.increments[increment_i].reg == idiom.control_reg) {
+            step = idiom.increments[increment_i].step;
+        }
+    }
+    assert(step != 0);
+
+    if (idiom.control == LoopControl::kNotEqual) {
+        bool is_up = static_cast<IRegister>(step) > 0;
+        Register distance = is_up ? bound - control : control - bound;
+        Register abs_step = is_up ? step : -step;
+        // equal at entry means wrapping around the whole address space
+        if (distance == 0 || distance % abs_step != 0) {
+            return false;
+        }
+
+        *n_iterations = distance / abs_step;
+        return true;
+    }
+
+    uint64_t n_steps = control < bound ? (static_cast<uint64_t>(bound - control) + step - 1) / step : 1;
+    if (static_cast<uint64_t>(control) + n_steps * step > std::numeric_limits<Register>::max()) {
+        return false;
+    }
+
+    *n_iterations = n_steps;
+    return true;
+}
+
+// ranges guest accesses would fault on, mmio or split between regions included,
+// stay with guest so that faults are the same
+static bool GetAccessRange(const LoopIdiom& idiom, const LoopAccess& access, Register base, uint64_t n_iterations,
+                           bool is_store, IMemory* memory, AccessRange* range) {
+    uint64_t size = n_iterations * idiom.width;
+    uint64_t first = static_cast<Register>(base + access.offset);
+    uint64_t span = (n_iterations - 1) * idiom.width;
+    if (static_cast<IRegister>(idiom.step) < 0 && first < span) {
+        return false;
+    }
+
+    uint64_t low = static_cast<IRegister>(idiom.step) > 0 ? first : first - span;
+    if (low + size > memory->GetMemorySize()) {
+        return false;
+    }
+
+    range->low = static_cast<Address>(low);
+    if (is_store ? !memory->IsWritable(range->low, size) : !memory->IsReadable(range->low, size)) {
+        return false;
+    }
+
+    range->host = memory->GetHostRange(range->low, size);
+
+    return range->host != nullptr;
+}
+
+static Register LoadElement(const LoopIdiom& idiom, const uint8_t* element) {
+    switch (idiom.width) {
+        case 1: {
+            uint8_t value = element[0];
+            return idiom.is_signed ? static_cast<Register>(static_cast<int8_t>(value)) : value;
+        }
+        case 2: {
+            uint16_t value = 0;
+            std::memcpy(&value, element, sizeof(value));
+            return idiom.is_signed ? static_cast<Register>(static_cast<int16_t>(value)) : value;
+        }
+        default: {
+            uint32_t value = 0;
+            std::memcpy(&value, element, sizeof(value));
+            return value;
+        }
+    }
+}
+
+static bool IsOverlapping(uint64_t lhs, uint64_t lhs_size, uint64_t rhs, uint64_t rhs_size) {
+    return lhs < rhs + rhs_size && rhs < lhs + lhs_size;
+}
+
+} // namespace sim
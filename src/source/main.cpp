@@ -6,6 +6,7 @@
 
 #include "elf_loader.hpp"
 #include "sim.hpp"
+#include "sim_options.hpp"
 
 int main(const int argc, const char* const argv[]) {
     auto logger = spdlog::basic_logger_mt("simulator", "simulator.log", true);
@@ -18,14 +19,17 @@ int main(const int argc, const char* const argv[]) {
     spdlog::set_level(spdlog::level::debug);
 #endif // NDEBUG
 
-    if (argc < 2) {
-        std::cerr << "[Error]: Executable file was not passed" << std::endl;
-        spdlog::error("Executable file was not passed");
+    sim::SimOptions options;
+    sim::OptionsError options_error = sim::ParseOptions(argc, argv, &options);
+    if (options_error != sim::OptionsError::kOk) {
+        std::cerr << "[Error]: " << sim::OptionsErrorToStr(options_error) << std::endl;
+        spdlog::error("Cant parse options: {}", sim::OptionsErrorToStr(options_error));
+        sim::PrintUsage(argv[0]);
         return EXIT_FAILURE;
     }
 
     ploader::ElfLoader elf_loader;
-    ploader::PloaderError load_error = elf_loader.Init(argv[1]);
+    ploader::PloaderError load_error = elf_loader.Init(options.executable_path);
     if (load_error != ploader::PloaderError::kOk) {
         std::cerr << "[Error]: cant load executable," << ploader::PloaderErrorToStr(load_error) << std::endl;
         spdlog::error("Cant load elf", ploader::PloaderErrorToStr(load_error));
@@ -35,10 +39,10 @@ int main(const int argc, const char* const argv[]) {
 
     spdlog::info("Elf loaded");
     
-    sim::Simulator simulator(elf_loader);
+    sim::Simulator simulator(elf_loader, options);
 
     simulator.Execute();
 
-    return EXIT_SUCCESS;
+    return simulator.GetExitCode();
 }
 
@@ -1,14 +1,135 @@
 #include "memory.hpp"
 
+#include <algorithm>
 #include <cerrno>
 #include <cstdint>
 #include <cstdio>
 #include <cassert>
 #include <cstring>
+#include <iostream>
 
 #include "log_helper.hpp"
 
-// Memory ---------------------------------------------------------------------
+// Memory private -------------------------------------------------------------
+
+const sim::MemoryRegion* sim::Memory::FindRegion(const MemAddress address, const size_t size) const {
+    auto it = std::upper_bound(regions_.begin(), regions_.end(), address,
+                               [](const MemAddress addr, const MemoryRegion& region) { return addr < region.start; });
+    if (it == regions_.begin()) {
+        return nullptr;
+    }
+
+    const MemoryRegion& region = *std::prev(it);
+    if (address - region.start >= region.size || size > region.size - (address - region.start)) {
+        return nullptr;
+    }
+
+    return &region;
+}
+
+// only pages lying in a single region get an entry, so its permissions hold for the whole page
+void sim::Memory::FillTlb(const MemAddress page, const MemoryRegion& region) const {
+    assert(region.kind != MemoryRegionKind::kMmio);
+
+    const MemAddress page_start = page << kTlbPageBits;
+    if (page_start < region.start || page_start - region.start + kTlbPageSize > region.size) {
+        return ;
+    }
+
+    TlbEntry& entry = tlb_[page & (kTlbEntries - 1)];
+    entry.read_page  = (region.permissions & kPermRead)  != 0 ? page : kNoPage;
+    entry.write_page = (region.permissions & kPermWrite) != 0 ? page : kNoPage;
+    entry.exec_page  = (region.permissions & kPermExec)  != 0 ? page : kNoPage;
+    entry.host_page = memory_ + page_start;
+}
+
+void sim::Memory::FlushTlb() {
+    for (TlbEntry& entry : tlb_) {
+        entry = {.read_page = kNoPage, .write_page = kNoPage, .exec_page = kNoPage, .host_page = nullptr};
+    }
+}
+
+void sim::Memory::Fault(const MemAddress address, const size_t size, const char* access) const {
+    n_faults_++;
+    spdlog::error("Memory fault: {} of {} bytes at 0x{:x}", access, size, address);
+}
+
+template <typename T>
+T sim::Memory::Load(const MemAddress address) const {
+    const MemAddress page = address >> kTlbPageBits;
+    const TlbEntry& entry = tlb_[page & (kTlbEntries - 1)];
+    if (entry.read_page == page && (address & (kTlbPageSize - 1)) <= kTlbPageSize - sizeof(T)) {
+        T value = 0;
+        std::memcpy(&value, entry.host_page + (address & (kTlbPageSize - 1)), sizeof(T));
+        return value;
+    }
+
+    return static_cast<T>(LoadSlow(address, sizeof(T)));
+}
+
+template <typename T>
+void sim::Memory::Store(const T data, const MemAddress address) {
+    const MemAddress page = address >> kTlbPageBits;
+    const TlbEntry& entry = tlb_[page & (kTlbEntries - 1)];
+    if (entry.write_page == page && (address & (kTlbPageSize - 1)) <= kTlbPageSize - sizeof(T)) {
+        TrackCodeWrite(address, sizeof(T));
+        std::memcpy(entry.host_page + (address & (kTlbPageSize - 1)), &data, sizeof(T));
+        return ;
+    }
+
+    StoreSlow(data, address, sizeof(T));
+}
+
+uint64_t sim::Memory::LoadSlow(const MemAddress address, const size_t size) const {
+    const MemoryRegion* region = FindRegion(address, size);
+    if (region == nullptr || (region->permissions & kPermRead) == 0) {
+        Fault(address, size, "read");
+        return 0;
+    }
+
+    if (region->kind == MemoryRegionKind::kMmio) {
+        return region->device->Read(address - region->start, size);
+    }
+
+    FillTlb(address >> kTlbPageBits, *region);
+
+    uint64_t value = 0;
+    std::memcpy(&value, memory_ + address, size);
+    return value;
+}
+
+void sim::Memory::StoreSlow(const uint64_t data, const MemAddress address, const size_t size) {
+    const MemoryRegion* region = FindRegion(address, size);
+    if (region == nullptr || (region->permissions & kPermWrite) == 0) {
+        Fault(address, size, "write");
+        return ;
+    }
+
+    if (region->kind == MemoryRegionKind::kMmio) {
+        region->device->Write(data, address - region->start, size);
+        return ;
+    }
+
+    FillTlb(address >> kTlbPageBits, *region);
+
+    TrackCodeWrite(address, size);
+    std::memcpy(memory_ + address, &data, size);
+}
+
+// Memory public --------------------------------------------------------------
+
+void sim::Memory::Init(size_t memory_size) {
+    memory_size_ = memory_size;
+    memory_ = new uint8_t[memory_size_]{};
+    observer_ = nullptr;
+    is_code_page_.assign(((memory_size_ - 1) >> kCodePageBits) + 1, false);
+    written_code_pages_.clear();
+
+    regions_ = {{.start = 0, .size = memory_size_, .kind = MemoryRegionKind::kRam,
+                 .permissions = kPermRead | kPermWrite | kPermExec, .device = nullptr}};
+    FlushTlb();
+    n_faults_ = 0;
+}
 
 void sim::Memory::Dump(size_t start_addr, size_t end_addr) const {
     LogFunctionEntry();
@@ -36,6 +157,22 @@ void sim::Memory::Dump(size_t start_addr, size_t end_addr) const {
     LogVar(end_addr);
 }
 
+uint64_t sim::Memory::ReadFromMemory64b(const MemAddress address) const {
+    LogFunctionEntry();
+   
+    LogVar(address);
+
+    if (address % sizeof(uint64_t) != 0) {
+        spdlog::warn("Unaligned address memory access");
+    }
+
+    if (observer_ != nullptr) {
+        observer_->OnRead(address, sizeof(uint64_t));
+    }
+
+    return Load<uint64_t>(address);
+}
+
 uint32_t sim::Memory::ReadFromMemory32b(const MemAddress address) const {
     LogFunctionEntry();
    
@@ -45,7 +182,11 @@ uint32_t sim::Memory::ReadFromMemory32b(const MemAddress address) const {
         spdlog::warn("Unaligned address memory access");
     }
 
-    return *reinterpret_cast<uint32_t*>(memory_ + address);
+    if (observer_ != nullptr) {
+        observer_->OnRead(address, sizeof(uint32_t));
+    }
+
+    return Load<uint32_t>(address);
 }
 
 uint16_t sim::Memory::ReadFromMemory16b(const MemAddress address) const {
@@ -57,7 +198,11 @@ uint16_t sim::Memory::ReadFromMemory16b(const MemAddress address) const {
         spdlog::warn("Unaligned address memory access");
     }
 
-    return *reinterpret_cast<uint16_t*>(memory_ + address);
+    if (observer_ != nullptr) {
+        observer_->OnRead(address, sizeof(uint16_t));
+    }
+
+    return Load<uint16_t>(address);
 }
 
 uint8_t sim::Memory::ReadFromMemory8b(const MemAddress address) const {
@@ -69,7 +214,73 @@ uint8_t sim::Memory::ReadFromMemory8b(const MemAddress address) const {
         spdlog::warn("Unaligned address memory access");
     }
 
-    return *reinterpret_cast<uint8_t*>(memory_ + address);
+    if (observer_ != nullptr) {
+        observer_->OnRead(address, sizeof(uint8_t));
+    }
+
+    return Load<uint8_t>(address);
+}
+
+uint32_t sim::Memory::FetchInstr32b(const MemAddress address) const {
+    LogFunctionEntry();
+   
+    LogVar(address);
+
+    if (address % sizeof(uint32_t) != 0) {
+        spdlog::warn("Unaligned instruction fetch");
+    }
+
+    if (observer_ != nullptr) {
+        observer_->OnFetch(address);
+    }
+
+    const MemAddress page = address >> kTlbPageBits;
+    const TlbEntry& entry = tlb_[page & (kTlbEntries - 1)];
+    uint32_t word = 0;
+    if (entry.exec_page == page && (address & (kTlbPageSize - 1)) <= kTlbPageSize - sizeof(word)) {
+        std::memcpy(&word, entry.host_page + (address & (kTlbPageSize - 1)), sizeof(word));
+        return word;
+    }
+
+    const MemoryRegion* region = FindRegion(address, sizeof(word));
+    if (region == nullptr || region->kind == MemoryRegionKind::kMmio || (region->permissions & kPermExec) == 0) {
+        Fault(address, sizeof(word), "fetch");
+        return 0;
+    }
+
+    FillTlb(page, *region);
+    std::memcpy(&word, memory_ + address, sizeof(word));
+    return word;
+}
+
+bool sim::Memory::IsExecutable(const MemAddress address, const size_t size) const {
+    const MemoryRegion* region = FindRegion(address, size);
+    return region != nullptr && region->kind != MemoryRegionKind::kMmio && (region->permissions & kPermExec) != 0;
+}
+
+bool sim::Memory::IsReadable(const MemAddress address, const size_t size) const {
+    return (GetPermissions(address, size) & kPermRead) != 0;
+}
+
+bool sim::Memory::IsWritable(const MemAddress address, const size_t size) const {
+    return (GetPermissions(address, size) & kPermWrite) != 0;
+}
+
+void sim::Memory::WriteToMemory64b(const uint64_t data, const MemAddress address) {
+    LogFunctionEntry();
+
+    LogVar(data);
+    LogVar(address);
+
+    if (address % sizeof(uint64_t) != 0) {
+        spdlog::warn("Unaligned address memory access");
+    }
+
+    if (observer_ != nullptr) {
+        observer_->OnWrite(address, sizeof(uint64_t));
+    }
+
+    Store<uint64_t>(data, address);
 }
 
 void sim::Memory::WriteToMemory32b(const uint32_t data, const MemAddress address) {
@@ -82,7 +293,11 @@ void sim::Memory::WriteToMemory32b(const uint32_t data, const MemAddress address
         spdlog::warn("Unaligned address memory access");
     }
 
-    *reinterpret_cast<uint32_t*>(memory_ + address) = data;
+    if (observer_ != nullptr) {
+        observer_->OnWrite(address, sizeof(uint32_t));
+    }
+
+    Store<uint32_t>(data, address);
 }
 
 void sim::Memory::WriteToMemory16b(const uint16_t data, const MemAddress address) {
@@ -95,7 +310,11 @@ void sim::Memory::WriteToMemory16b(const uint16_t data, const MemAddress address
         spdlog::warn("Unaligned address memory access");
     }
 
-    *reinterpret_cast<uint16_t*>(memory_ + address) = data;
+    if (observer_ != nullptr) {
+        observer_->OnWrite(address, sizeof(uint16_t));
+    }
+
+    Store<uint16_t>(data, address);
 }
 
 void sim::Memory::WriteToMemory8b(const uint8_t data, const MemAddress address) {
@@ -108,7 +327,11 @@ void sim::Memory::WriteToMemory8b(const uint8_t data, const MemAddress address)
         spdlog::warn("Unaligned address memory access");
     }
 
-    *reinterpret_cast<uint8_t*>(memory_ + address) = data;
+    if (observer_ != nullptr) {
+        observer_->OnWrite(address, sizeof(uint8_t));
+    }
+
+    Store<uint8_t>(data, address);
 }
 
 void sim::Memory::MapToMemory(const uint8_t* data_to_map, size_t start_addr, size_t end_addr) {
@@ -133,3 +356,183 @@ uint8_t* sim::Memory::GetData() {
     return memory_;
 }
 
+uint8_t* sim::Memory::GetHostRange(const MemAddress address, const size_t size) {
+    LogFunctionEntry();
+
+    if (address > memory_size_ || size > memory_size_ - address) {
+        spdlog::warn("Out of memory host range: 0x{:x}, size {}", address, size);
+        return nullptr;
+    }
+
+    return memory_ + address;
+}
+
+void sim::Memory::NotifyHostWrite(const MemAddress address, const size_t size) {
+    LogFunctionEntry();
+
+    if (size != 0) {
+        TrackCodeWrite(address, size);
+    }
+}
+
+void sim::Memory::MarkCode(const MemAddress address, const size_t size) {
+    LogFunctionEntry();
+
+    assert(size != 0);
+
+    size_t last_page = std::min((address + size - 1) >> kCodePageBits, is_code_page_.size() - 1);
+    for (size_t page = address >> kCodePageBits; page <= last_page; page++) {
+        is_code_page_[page] = true;
+    }
+}
+
+void sim::Memory::TakeWrittenCodePages(std::vector<size_t>* pages) {
+    LogFunctionEntry();
+
+    assert(pages != nullptr);
+
+    pages->swap(written_code_pages_);
+    written_code_pages_.clear();
+}
+
+void sim::Memory::SetObserver(IMemoryObserver* observer) {
+    LogFunctionEntry();
+
+    observer_ = observer;
+}
+
+sim::MemoryMapError sim::Memory::AddRegion(const MemoryRegion& region) {
+    LogFunctionEntry();
+
+    bool is_mmio = region.kind == MemoryRegionKind::kMmio;
+    if (region.size == 0 || region.start + static_cast<uint64_t>(region.size) > (uint64_t{1} << 32) 
+        || is_mmio != (region.device != nullptr)) {
+        return MemoryMapError::kBadRegion;
+    }
+
+    if (!is_mmio && region.start + region.size > memory_size_) {
+        return MemoryMapError::kOutOfMemory;
+    }
+
+    // parts of overlapped ram and rom regions outside the new one are kept
+    std::vector<MemoryRegion> regions;
+    for (const MemoryRegion& other : regions_) {
+        bool is_overlapped = other.start < region.start + region.size && region.start < other.start + other.size;
+        if (!is_overlapped) {
+            regions.push_back(other);
+            continue;
+        }
+
+        if (is_mmio || other.kind == MemoryRegionKind::kMmio) {
+            return MemoryMapError::kOverlap;
+        }
+
+        if (other.start < region.start) {
+            MemoryRegion left = other;
+            left.size = region.start - other.start;
+            regions.push_back(left);
+        }
+
+        if (region.start + region.size < other.start + other.size) {
+            MemoryRegion right = other;
+            right.start = static_cast<MemAddress>(region.start + region.size);
+            right.size = other.start + other.size - right.start;
+            regions.push_back(right);
+        }
+    }
+
+    regions.push_back(region);
+    std::sort(regions.begin(), regions.end(), [](const MemoryRegion& lhs, const MemoryRegion& rhs) { return lhs.start < rhs.start; });
+    regions_.swap(regions);
+    FlushTlb();
+
+    return MemoryMapError::kOk;
+}
+
+const std::vector<sim::MemoryRegion>& sim::Memory::GetRegions() const {
+    return regions_;
+}
+
+uint8_t sim::Memory::GetPermissions(const MemAddress address, const size_t size) const {
+    const MemoryRegion* region = FindRegion(address, size);
+    if (region == nullptr || region->kind == MemoryRegionKind::kMmio) {
+        return 0;
+    }
+
+    return region->permissions;
+}
+
+uint64_t sim::Memory::GetNFaults() const {
+    return n_faults_;
+}
+
+// global ---------------------------------------------------------------------
+
+// segments get permissions of their p_flags, the rest of memory stays ram
+// with all of them for heap, stack and anything guest copies code to
+void sim::MapProgramRegions(const ploader::IProgramLoader& ploader,
+                            const std::vector<std::pair<MemAddress, IMmioDevice*>>& devices, Memory* memory) {
+    LogFunctionEntry();
+
+    assert(memory != nullptr);
+
+    for (size_t index_ls = 0; index_ls < ploader.GetNLSections(); index_ls++) {
+        uint8_t permissions = (ploader.GetIsReadableIndex(index_ls) ? kPermRead : 0)
+                            | (ploader.GetIsWritableIndex(index_ls) ? kPermWrite : 0)
+                            | (ploader.GetIsExecutableIndex(index_ls) ? kPermExec : 0);
+        MemoryRegion region = {
+            .start = static_cast<MemAddress>(ploader.GetStartAddrIndex(index_ls)),
+            .size = ploader.GetSizeIndex(index_ls),
+            .kind = ploader.GetIsWritableIndex(index_ls) ? MemoryRegionKind::kRam : MemoryRegionKind::kRom,
+            .permissions = permissions,
+            .device = nullptr,
+        };
+        if (region.size == 0) {
+            continue;
+        }
+
+        MemoryMapError err = memory->AddRegion(region);
+        if (err != MemoryMapError::kOk) {
+            std::cerr << "[Warning]: segment at 0x" << std::hex << region.start << std::dec << " is not mapped, "
+                      << MemoryMapErrorToStr(err) << std::endl;
+        }
+    }
+
+    for (const auto& [base, device] : devices) {
+        MemoryRegion region = {
+            .start = base,
+            .size = device->GetSize(),
+            .kind = MemoryRegionKind::kMmio,
+            .permissions = kPermRead | kPermWrite,
+            .device = device,
+        };
+
+        MemoryMapError err = memory->AddRegion(region);
+        if (err != MemoryMapError::kOk) {
+            std::cerr << "[Warning]: " << device->GetName() << " is not mapped, " << MemoryMapErrorToStr(err) << std::endl;
+        }
+    }
+}
+
+const char* sim::MemoryMapErrorToStr(MemoryMapError error) {
+    switch (error) {
+        case MemoryMapError::kOk:          return "ok";
+        case MemoryMapError::kBadRegion:   return "bad region";
+        case MemoryMapError::kOutOfMemory: return "region is out of host memory";
+        case MemoryMapError::kOverlap:     return "region overlaps mmio";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+const char* sim::MemoryRegionKindToStr(MemoryRegionKind kind) {
+    switch (kind) {
+        case MemoryRegionKind::kRam:  return "ram";
+        case MemoryRegionKind::kRom:  return "rom";
+        case MemoryRegionKind::kMmio: return "mmio";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
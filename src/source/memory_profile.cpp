@@ -0,0 +1,318 @@
+#include "memory_profile.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+
+#include "log_helper.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static void ReportCounts(FILE* report_file, const std::vector<uint64_t>& counts, const size_t n_epochs);
+static void MergePairs(std::vector<uint64_t>* counts);
+
+// StackDistanceProfile private -----------------------------------------------
+
+void StackDistanceProfile::Add(uint32_t time, int32_t delta) {
+    for (size_t i = static_cast<size_t>(time) + 1; i < tree_.size(); i += i & (~i + 1)) {
+        tree_[i] += delta;
+    }
+}
+
+uint32_t StackDistanceProfile::Sum(uint32_t time) const {
+    uint32_t sum = 0;
+    for (size_t i = time; i > 0; i -= i & (~i + 1)) {
+        sum += tree_[i];
+    }
+
+    return sum;
+}
+
+// only the last access of every line is marked, so live lines are
+// renumbered to the first times keeping their order
+void StackDistanceProfile::Compact() {
+    std::vector<std::pair<uint32_t, uint32_t*>> times;
+    times.reserve(last_access_.size());
+    for (auto& [line, time] : last_access_) {
+        times.emplace_back(time, &time);
+    }
+    std::sort(times.begin(), times.end());
+
+    const size_t n_lines = times.size();
+    for (size_t i = 0; i < n_lines; i++) {
+        *times[i].second = static_cast<uint32_t>(i);
+    }
+
+    size_t capacity = tree_.size() - 1;
+    while (capacity < 2 * n_lines) {
+        capacity *= 2;
+    }
+
+    // node i covers times (i - lowbit(i), i], all of them below n_lines are marked
+    tree_.assign(capacity + 1, 0);
+    for (size_t i = 1; i <= capacity; i++) {
+        size_t low = i - (i & (~i + 1));
+        tree_[i] = static_cast<uint32_t>(std::min(i, n_lines) - std::min(low, n_lines));
+    }
+
+    clock_ = static_cast<uint32_t>(n_lines);
+}
+
+// StackDistanceProfile public ------------------------------------------------
+
+void StackDistanceProfile::Init() {
+    LogFunctionEntry();
+
+    tree_.assign(kInitialCapacity + 1, 0);
+    last_access_.clear();
+    clock_ = 0;
+
+    histogram_ = {};
+    n_accesses_ = 0;
+    n_cold_accesses_ = 0;
+}
+
+void StackDistanceProfile::Access(const uint64_t line) {
+    if (clock_ == tree_.size() - 1) {
+        Compact();
+    }
+
+    n_accesses_++;
+
+    auto [it, is_cold] = last_access_.try_emplace(line, clock_);
+    if (is_cold) {
+        n_cold_accesses_++;
+    } else {
+        // lines marked after the previous access, the line itself is at it
+        uint32_t prev_time = it->second;
+        uint64_t distance = last_access_.size() - Sum(prev_time + 1);
+        histogram_[std::bit_width(distance)]++;
+
+        Add(prev_time, -1);
+        it->second = clock_;
+    }
+
+    Add(clock_, 1);
+    clock_++;
+}
+
+const std::array<uint64_t, StackDistanceProfile::kNBuckets>& StackDistanceProfile::GetHistogram() const {
+    return histogram_;
+}
+
+uint64_t StackDistanceProfile::GetNAccesses() const {
+    return n_accesses_;
+}
+
+uint64_t StackDistanceProfile::GetNColdAccesses() const {
+    return n_cold_accesses_;
+}
+
+uint64_t StackDistanceProfile::GetNLines() const {
+    return last_access_.size();
+}
+
+// access hits if its distance is below the number of lines,
+// buckets above the one of n_lines start at n_lines or further
+uint64_t StackDistanceProfile::GetNMisses(const uint64_t n_lines) const {
+    assert(std::has_single_bit(n_lines));
+
+    uint64_t n_misses = n_cold_accesses_;
+    for (size_t bucket_i = std::countr_zero(n_lines) + 1; bucket_i < kNBuckets; bucket_i++) {
+        n_misses += histogram_[bucket_i];
+    }
+
+    return n_misses;
+}
+
+// MemoryProfiler private -----------------------------------------------------
+
+size_t MemoryProfiler::GetPageRow(const MemAddress page) {
+    auto [it, is_new] = page_rows_.try_emplace(page, pages_.size());
+    if (is_new) {
+        pages_.push_back({.page = page, .fetches = {}, .data = {}});
+    }
+
+    return it->second;
+}
+
+void MemoryProfiler::AccessData(const MemAddress address, const size_t size) {
+    const uint64_t first_line = address >> line_shift_;
+    const uint64_t last_line = (static_cast<uint64_t>(address) + size - 1) >> line_shift_;
+    for (uint64_t line = first_line; line <= last_line; line++) {
+        stack_distances_.Access(line);
+    }
+
+    PageHeat& heat = pages_[GetPageRow(address >> kPageShift)];
+    if (heat.data.size() <= epoch_) {
+        heat.data.resize(epoch_ + 1, 0);
+    }
+    heat.data[epoch_]++;
+}
+
+void MemoryProfiler::MergeEpochs() {
+    for (PageHeat& heat : pages_) {
+        MergePairs(&heat.fetches);
+        MergePairs(&heat.data);
+    }
+
+    epoch_ /= 2;
+    epoch_length_ *= 2;
+}
+
+// MemoryProfiler public ------------------------------------------------------
+
+void MemoryProfiler::Init(const size_t line_size, IMemoryObserver* next) {
+    LogFunctionEntry();
+
+    assert(std::has_single_bit(line_size));
+
+    next_ = next;
+    line_shift_ = std::countr_zero(line_size);
+    stack_distances_.Init();
+
+    page_rows_.clear();
+    pages_.clear();
+    fetch_page_ = kNoPage;
+    fetch_row_ = 0;
+
+    epoch_ = 0;
+    epoch_length_ = kInitialEpochLength;
+    epoch_fetches_ = 0;
+    n_fetches_ = 0;
+}
+
+void MemoryProfiler::OnFetch(const MemAddress pc) {
+    if (epoch_fetches_ == epoch_length_) {
+        epoch_fetches_ = 0;
+        epoch_++;
+        if (epoch_ == kMaxEpochs) {
+            MergeEpochs();
+        }
+    }
+    epoch_fetches_++;
+    n_fetches_++;
+
+    MemAddress page = pc >> kPageShift;
+    if (page != fetch_page_) {
+        fetch_row_ = GetPageRow(page);
+        fetch_page_ = page;
+    }
+
+    PageHeat& heat = pages_[fetch_row_];
+    if (heat.fetches.size() <= epoch_) {
+        heat.fetches.resize(epoch_ + 1, 0);
+    }
+    heat.fetches[epoch_]++;
+
+    if (next_ != nullptr) {
+        next_->OnFetch(pc);
+    }
+}
+
+void MemoryProfiler::OnRead(const MemAddress address, const size_t size) {
+    AccessData(address, size);
+
+    if (next_ != nullptr) {
+        next_->OnRead(address, size);
+    }
+}
+
+void MemoryProfiler::OnWrite(const MemAddress address, const size_t size) {
+    AccessData(address, size);
+
+    if (next_ != nullptr) {
+        next_->OnWrite(address, size);
+    }
+}
+
+void MemoryProfiler::Report(FILE* report_file) const {
+    LogFunctionEntry();
+
+    assert(report_file != nullptr);
+
+    const size_t line_size = size_t{1} << line_shift_;
+    std::fprintf(report_file, "{\n");
+    std::fprintf(report_file, "  \"line_size\": %zu,\n", line_size);
+    std::fprintf(report_file, "  \"data_accesses\": %llu,\n", static_cast<unsigned long long>(stack_distances_.GetNAccesses()));
+    std::fprintf(report_file, "  \"cold_accesses\": %llu,\n", static_cast<unsigned long long>(stack_distances_.GetNColdAccesses()));
+    std::fprintf(report_file, "  \"distinct_lines\": %llu,\n", static_cast<unsigned long long>(stack_distances_.GetNLines()));
+
+    // [first distance, last distance, accesses] of buckets up to the last used one
+    const auto& histogram = stack_distances_.GetHistogram();
+    size_t n_buckets = StackDistanceProfile::kNBuckets;
+    while (n_buckets > 0 && histogram[n_buckets - 1] == 0) {
+        n_buckets--;
+    }
+
+    std::fprintf(report_file, "  \"stack_distance\": [");
+    for (size_t bucket_i = 0; bucket_i < n_buckets; bucket_i++) {
+        uint64_t first = bucket_i == 0 ? 0 : uint64_t{1} << (bucket_i - 1);
+        uint64_t last = bucket_i == 0 ? 0 : (uint64_t{1} << bucket_i) - 1;
+        std::fprintf(report_file, "%s[%llu, %llu, %llu]", bucket_i == 0 ? "" : ", ", static_cast<unsigned long long>(first),
+                     static_cast<unsigned long long>(last), static_cast<unsigned long long>(histogram[bucket_i]));
+    }
+    std::fprintf(report_file, "],\n");
+
+    // misses of fully associative lru caches until only cold ones are left
+    std::fprintf(report_file, "  \"lru_misses\": [");
+    const uint64_t n_accesses = stack_distances_.GetNAccesses();
+    for (uint64_t n_lines = 1; n_accesses != 0; n_lines *= 2) {
+        uint64_t n_misses = stack_distances_.GetNMisses(n_lines);
+        std::fprintf(report_file, "%s{\"size\": %llu, \"misses\": %llu, \"miss_ratio\": %.4f}", n_lines == 1 ? "" : ", ",
+                     static_cast<unsigned long long>(n_lines * line_size), static_cast<unsigned long long>(n_misses),
+                     static_cast<double>(n_misses) / static_cast<double>(n_accesses));
+        if (n_misses == stack_distances_.GetNColdAccesses()) {
+            break;
+        }
+    }
+    std::fprintf(report_file, "],\n");
+
+    // per page counts of every epoch, pages ordered by address
+    const size_t n_epochs = n_fetches_ == 0 ? 0 : epoch_ + 1;
+    std::vector<const PageHeat*> pages;
+    pages.reserve(pages_.size());
+    for (const PageHeat& heat : pages_) {
+        pages.push_back(&heat);
+    }
+    std::sort(pages.begin(), pages.end(), [](const PageHeat* lhs, const PageHeat* rhs) { return lhs->page < rhs->page; });
+
+    std::fprintf(report_file, "  \"heat_map\": {\"page_size\": %zu, \"epoch_instructions\": %llu, \"epochs\": %zu, \"pages\": [\n",
+                 size_t{1} << kPageShift, static_cast<unsigned long long>(epoch_length_), n_epochs);
+    for (size_t page_i = 0; page_i < pages.size(); page_i++) {
+        const PageHeat& heat = *pages[page_i];
+        std::fprintf(report_file, "    {\"page\": \"0x%08x\", \"fetches\": ", heat.page << kPageShift);
+        ReportCounts(report_file, heat.fetches, n_epochs);
+        std::fprintf(report_file, ", \"data\": ");
+        ReportCounts(report_file, heat.data, n_epochs);
+        std::fprintf(report_file, "}%s\n", page_i + 1 == pages.size() ? "" : ",");
+    }
+    std::fprintf(report_file, "  ]}\n");
+    std::fprintf(report_file, "}\n");
+}
+
+// static ---------------------------------------------------------------------
+
+// counts of epochs after the last access to page are zero
+static void ReportCounts(FILE* report_file, const std::vector<uint64_t>& counts, const size_t n_epochs) {
+    std::fprintf(report_file, "[");
+    for (size_t epoch_i = 0; epoch_i < n_epochs; epoch_i++) {
+        uint64_t count = epoch_i < counts.size() ? counts[epoch_i] : 0;
+        std::fprintf(report_file, "%s%llu", epoch_i == 0 ? "" : ",", static_cast<unsigned long long>(count));
+    }
+    std::fprintf(report_file, "]");
+}
+
+static void MergePairs(std::vector<uint64_t>* counts) {
+    const size_t n_merged = (counts->size() + 1) / 2;
+    for (size_t i = 0; i < n_merged; i++) {
+        uint64_t second = 2 * i + 1 < counts->size() ? (*counts)[2 * i + 1] : 0;
+        (*counts)[i] = (*counts)[2 * i] + second;
+    }
+
+    counts->resize(n_merged);
+}
+
+} // namespace sim
@@ -0,0 +1,604 @@
+#include "memory_trace.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log_helper.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static const char kTraceMagic[8] = {'R', 'V', 'M', 'T', 'R', 'A', 'C', 'E'};
+static const uint32_t kTraceVersion = 1;
+static const uint32_t kChunkMagic = 0x4b4e4843; // "CHNK"
+
+struct TraceHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+// followed by payload, it is stored raw if compressed_size == raw_size
+struct ChunkHeader {
+    uint32_t magic;
+    uint32_t n_records;
+    uint32_t raw_size;
+    uint32_t compressed_size;
+    uint64_t first_record;
+    MemAddress base_pc;
+    uint32_t reserved;
+};
+
+static_assert(std::is_trivially_copyable_v<ChunkHeader>);
+
+// Record is a tag byte: access type in bits 0-1, log2 of size in bits 2-3,
+// bit 4 is set if address follows the previous access of the same type
+// (previous address + its size). Otherwise zigzag varint of address delta
+// from that access follows. Pc of data accesses is the last fetched one.
+static const uint8_t kTagTypeMask = 0b11;
+static const size_t kTagSizeShift = 2;
+static const uint8_t kTagSequential = 1u << 4;
+static const size_t kMaxRecordSize = 1 + 10;
+
+static void AppendVarint(uint64_t value, std::vector<uint8_t>* data);
+static bool ReadVarint(const uint8_t** pos, const uint8_t* end, uint64_t* value);
+
+// LZ77 block format: token with literal length in high and match length
+// (minus kMinMatch) in low nibble, 15 continues in 255-terminated extra
+// bytes; literals, 16-bit offset and extra match length bytes follow.
+// The last sequence has literals only.
+static const size_t kMinMatch = 4;
+static const size_t kHashBits = 16;
+static const size_t kMaxOffset = UINT16_MAX;
+
+static void CompressBlock(const std::vector<uint8_t>& src, std::vector<uint8_t>* dst);
+static bool DecompressBlock(const uint8_t* src, const size_t size, uint8_t* dst, const size_t raw_size);
+static void AppendLength(size_t length, std::vector<uint8_t>* dst);
+static bool ReadLength(const uint8_t** pos, const uint8_t* end, size_t* length);
+
+// MemoryTraceWriter private --------------------------------------------------
+
+void MemoryTraceWriter::Append(const MemoryAccessType type, const MemAddress address, const size_t size) {
+    const size_t type_i = static_cast<size_t>(type);
+
+    uint8_t tag = static_cast<uint8_t>(type_i | (std::countr_zero(size) << kTagSizeShift));
+    if (address == last_addresses_[type_i] + last_sizes_[type_i]) {
+        chunk_.data.push_back(tag | kTagSequential);
+    } else {
+        chunk_.data.push_back(tag);
+        int64_t delta = static_cast<int64_t>(address) - static_cast<int64_t>(last_addresses_[type_i]);
+        AppendVarint((static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63), &chunk_.data);
+    }
+
+    last_addresses_[type_i] = address;
+    last_sizes_[type_i] = size;
+
+    last_access_ = {.address = address, .pc = last_pc_, .size = static_cast<uint8_t>(size), .type = type};
+    if (n_records_ == 0) {
+        first_access_ = last_access_;
+    }
+    n_records_++;
+
+    if (++chunk_.n_records == kChunkRecords) {
+        SubmitChunk();
+    }
+}
+
+// delta state starts over with every chunk
+void MemoryTraceWriter::StartChunk() {
+    chunk_.data.clear();
+    chunk_.data.reserve(kChunkRecords * kMaxRecordSize);
+    chunk_.n_records = 0;
+    chunk_.first_record = n_records_;
+    chunk_.base_pc = last_pc_;
+
+    for (size_t type_i = 0; type_i < kNAccessTypes; type_i++) {
+        last_addresses_[type_i] = 0;
+        last_sizes_[type_i] = 0;
+    }
+}
+
+void MemoryTraceWriter::SubmitChunk() {
+    LogFunctionEntry();
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        queue_cv_.wait(lock, [this]() { return queue_.size() < kMaxQueuedChunks; });
+        queue_.push_back(std::move(chunk_));
+    }
+    queue_cv_.notify_all();
+
+    chunk_ = {};
+    StartChunk();
+}
+
+// runs on compressor thread, only it writes to trace file after Init
+void MemoryTraceWriter::CompressChunks() {
+    std::vector<uint8_t> compressed;
+
+    while (true) {
+        Chunk chunk = {};
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            queue_cv_.wait(lock, [this]() { return !queue_.empty() || is_finished_; });
+            if (queue_.empty()) {
+                return;
+            }
+
+            chunk = std::move(queue_.front());
+            queue_.pop_front();
+        }
+        queue_cv_.notify_all();
+
+        CompressBlock(chunk.data, &compressed);
+        const bool is_stored_raw = compressed.size() >= chunk.data.size();
+        const std::vector<uint8_t>& payload = is_stored_raw ? chunk.data : compressed;
+
+        ChunkHeader header = {
+            .magic = kChunkMagic,
+            .n_records = chunk.n_records,
+            .raw_size = static_cast<uint32_t>(chunk.data.size()),
+            .compressed_size = static_cast<uint32_t>(payload.size()),
+            .first_record = chunk.first_record,
+            .base_pc = chunk.base_pc,
+            .reserved = 0,
+        };
+
+        bool is_written = std::fwrite(&header, sizeof(header), 1, trace_file_) == 1
+                       && std::fwrite(payload.data(), 1, payload.size(), trace_file_) == payload.size();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!is_written) {
+            is_write_failed_ = true;
+        }
+        n_written_bytes_ += sizeof(header) + payload.size();
+    }
+}
+
+// MemoryTraceWriter public ---------------------------------------------------
+
+MemoryTraceError MemoryTraceWriter::Init(const std::string& path, IMemoryObserver* next) {
+    LogFunctionEntry();
+
+    trace_file_ = std::fopen(path.c_str(), "wb");
+    if (trace_file_ == nullptr) {
+        spdlog::error("Cant create memory trace {}: {}", path, std::strerror(errno));
+        return MemoryTraceError::kIoError;
+    }
+
+    TraceHeader header = {.magic = {}, .version = kTraceVersion, .reserved = 0};
+    std::memcpy(header.magic, kTraceMagic, sizeof(kTraceMagic));
+    if (std::fwrite(&header, sizeof(header), 1, trace_file_) != 1) {
+        std::fclose(trace_file_);
+        trace_file_ = nullptr;
+        return MemoryTraceError::kIoError;
+    }
+
+    next_ = next;
+    last_pc_ = 0;
+    n_records_ = 0;
+    first_access_ = {};
+    last_access_ = {};
+    StartChunk();
+
+    queue_.clear();
+    is_finished_ = false;
+    is_write_failed_ = false;
+    n_written_bytes_ = sizeof(header);
+    compressor_ = std::thread(&MemoryTraceWriter::CompressChunks, this);
+
+    return MemoryTraceError::kOk;
+}
+
+MemoryTraceWriter::~MemoryTraceWriter() {
+    if (trace_file_ != nullptr) {
+        Finish();
+    }
+}
+
+void MemoryTraceWriter::OnFetch(const MemAddress pc) {
+    // chunk started after this record begins with its pc
+    last_pc_ = pc;
+    Append(MemoryAccessType::kFetch, pc, sizeof(uint32_t));
+
+    if (next_ != nullptr) {
+        next_->OnFetch(pc);
+    }
+}
+
+void MemoryTraceWriter::OnRead(const MemAddress address, const size_t size) {
+    Append(MemoryAccessType::kRead, address, size);
+
+    if (next_ != nullptr) {
+        next_->OnRead(address, size);
+    }
+}
+
+void MemoryTraceWriter::OnWrite(const MemAddress address, const size_t size) {
+    Append(MemoryAccessType::kWrite, address, size);
+
+    if (next_ != nullptr) {
+        next_->OnWrite(address, size);
+    }
+}
+
+MemoryTraceError MemoryTraceWriter::Finish() {
+    LogFunctionEntry();
+
+    if (trace_file_ == nullptr) {
+        return MemoryTraceError::kNoFile;
+    }
+
+    if (chunk_.n_records != 0) {
+        SubmitChunk();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_finished_ = true;
+    }
+    queue_cv_.notify_all();
+    compressor_.join();
+
+    bool is_failed = is_write_failed_ || std::fclose(trace_file_) != 0;
+    trace_file_ = nullptr;
+
+    spdlog::info("Memory trace: {} records in {} bytes ({:.2f} bytes per record)", n_records_, n_written_bytes_,
+                 n_records_ == 0 ? 0.0 : static_cast<double>(n_written_bytes_) / static_cast<double>(n_records_));
+
+    return is_failed ? MemoryTraceError::kIoError : MemoryTraceError::kOk;
+}
+
+uint64_t MemoryTraceWriter::GetNRecords() const {
+    return n_records_;
+}
+
+const MemoryAccess& MemoryTraceWriter::GetFirstAccess() const {
+    return first_access_;
+}
+
+const MemoryAccess& MemoryTraceWriter::GetLastAccess() const {
+    return last_access_;
+}
+
+// MemoryTraceReader public ---------------------------------------------------
+
+MemoryTraceError MemoryTraceReader::Open(const std::string& path) {
+    LogFunctionEntry();
+
+    chunks_.clear();
+    n_records_ = 0;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? MemoryTraceError::kNoFile : MemoryTraceError::kIoError;
+    }
+
+    struct stat file_stat = {};
+    if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(TraceHeader)) {
+        close(fd);
+        return MemoryTraceError::kCorrupted;
+    }
+
+    size_t size = static_cast<size_t>(file_stat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return MemoryTraceError::kIoError;
+    }
+
+    TraceHeader header = {};
+    std::memcpy(&header, mapping, sizeof(header));
+    if (std::memcmp(header.magic, kTraceMagic, sizeof(kTraceMagic)) != 0 || header.version != kTraceVersion) {
+        munmap(mapping, size);
+        return MemoryTraceError::kCorrupted;
+    }
+
+    mapping_ = static_cast<const uint8_t*>(mapping);
+    mapping_size_ = size;
+
+    size_t offset = sizeof(header);
+    while (offset + sizeof(ChunkHeader) <= mapping_size_) {
+        ChunkHeader chunk_header = {};
+        std::memcpy(&chunk_header, mapping_ + offset, sizeof(chunk_header));
+        offset += sizeof(chunk_header);
+
+        if (chunk_header.magic != kChunkMagic || chunk_header.compressed_size > mapping_size_ - offset
+            || chunk_header.compressed_size > chunk_header.raw_size) {
+            spdlog::warn("Memory trace {} is truncated after {} chunks", path, chunks_.size());
+            break;
+        }
+
+        chunks_.push_back({
+            .offset = offset,
+            .n_records = chunk_header.n_records,
+            .raw_size = chunk_header.raw_size,
+            .compressed_size = chunk_header.compressed_size,
+            .first_record = chunk_header.first_record,
+            .base_pc = chunk_header.base_pc,
+        });
+        n_records_ += chunk_header.n_records;
+        offset += chunk_header.compressed_size;
+    }
+
+    return MemoryTraceError::kOk;
+}
+
+MemoryTraceReader::~MemoryTraceReader() {
+    if (mapping_ != nullptr) {
+        munmap(const_cast<uint8_t*>(mapping_), mapping_size_);
+    }
+}
+
+size_t MemoryTraceReader::GetNChunks() const {
+    return chunks_.size();
+}
+
+uint64_t MemoryTraceReader::GetNRecords() const {
+    return n_records_;
+}
+
+uint64_t MemoryTraceReader::GetChunkFirstRecord(const size_t chunk_i) const {
+    assert(chunk_i < chunks_.size());
+
+    return chunks_[chunk_i].first_record;
+}
+
+MemoryTraceError MemoryTraceReader::ReadChunk(const size_t chunk_i, std::vector<MemoryAccess>* accesses) const {
+    assert(chunk_i < chunks_.size());
+    assert(accesses != nullptr);
+
+    const ChunkEntry& chunk = chunks_[chunk_i];
+    const uint8_t* payload = mapping_ + chunk.offset;
+
+    std::vector<uint8_t> raw;
+    if (chunk.compressed_size != chunk.raw_size) {
+        raw.resize(chunk.raw_size);
+        if (!DecompressBlock(payload, chunk.compressed_size, raw.data(), raw.size())) {
+            return MemoryTraceError::kBadChunk;
+        }
+        payload = raw.data();
+    }
+
+    accesses->clear();
+    accesses->reserve(chunk.n_records);
+
+    MemAddress last_addresses[kNAccessTypes] = {};
+    size_t last_sizes[kNAccessTypes] = {};
+    MemAddress pc = chunk.base_pc;
+
+    const uint8_t* pos = payload;
+    const uint8_t* end = payload + chunk.raw_size;
+    for (uint32_t record_i = 0; record_i < chunk.n_records; record_i++) {
+        if (pos == end) {
+            return MemoryTraceError::kBadChunk;
+        }
+
+        const uint8_t tag = *pos++;
+        const size_t type_i = tag & kTagTypeMask;
+        if (type_i >= kNAccessTypes) {
+            return MemoryTraceError::kBadChunk;
+        }
+
+        MemAddress address = last_addresses[type_i] + static_cast<MemAddress>(last_sizes[type_i]);
+        if ((tag & kTagSequential) == 0) {
+            uint64_t zigzag = 0;
+            if (!ReadVarint(&pos, end, &zigzag)) {
+                return MemoryTraceError::kBadChunk;
+            }
+
+            int64_t delta = static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+            address = static_cast<MemAddress>(static_cast<int64_t>(last_addresses[type_i]) + delta);
+        }
+
+        const MemoryAccessType type = static_cast<MemoryAccessType>(type_i);
+        const size_t size = size_t{1} << ((tag >> kTagSizeShift) & 0b11);
+        if (type == MemoryAccessType::kFetch) {
+            pc = address;
+        }
+
+        accesses->push_back({.address = address, .pc = pc, .size = static_cast<uint8_t>(size), .type = type});
+        last_addresses[type_i] = address;
+        last_sizes[type_i] = size;
+    }
+
+    return MemoryTraceError::kOk;
+}
+
+// global ---------------------------------------------------------------------
+
+const char* MemoryTraceErrorToStr(MemoryTraceError error) {
+    switch (error) {
+        case MemoryTraceError::kOk:        return "no error";
+        case MemoryTraceError::kNoFile:    return "no trace file";
+        case MemoryTraceError::kIoError:   return "i/o error";
+        case MemoryTraceError::kCorrupted: return "not a memory trace";
+        case MemoryTraceError::kBadChunk:  return "corrupted chunk";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+const char* MemoryAccessTypeToStr(MemoryAccessType type) {
+    switch (type) {
+        case MemoryAccessType::kFetch: return "fetch";
+        case MemoryAccessType::kRead:  return "read";
+        case MemoryAccessType::kWrite: return "write";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+static void AppendVarint(uint64_t value, std::vector<uint8_t>* data) {
+    while (value >= 0x80) {
+        data->push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    data->push_back(static_cast<uint8_t>(value));
+}
+
+static bool ReadVarint(const uint8_t** pos, const uint8_t* end, uint64_t* value) {
+    uint64_t result = 0;
+    for (size_t shift = 0; shift < 64; shift += 7) {
+        if (*pos == end) {
+            return false;
+        }
+
+        uint8_t byte = *(*pos)++;
+        result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// greedy matching against the last position with the same 4-byte hash
+static void CompressBlock(const std::vector<uint8_t>& src, std::vector<uint8_t>* dst) {
+    assert(dst != nullptr);
+
+    dst->clear();
+    dst->reserve(src.size() + src.size() / 255 + 16);
+
+    std::vector<uint32_t> table(size_t{1} << kHashBits, 0);
+    auto read32 = [&src](size_t pos) {
+        uint32_t word = 0;
+        std::memcpy(&word, src.data() + pos, sizeof(word));
+        return word;
+    };
+
+    size_t anchor = 0;
+    size_t pos = 0;
+    while (pos + kMinMatch <= src.size()) {
+        const uint32_t word = read32(pos);
+        const size_t hash = (word * 2654435761u) >> (32 - kHashBits);
+        const size_t candidate = table[hash];
+        table[hash] = static_cast<uint32_t>(pos);
+
+        if (candidate >= pos || pos - candidate > kMaxOffset || read32(candidate) != word) {
+            pos++;
+            continue;
+        }
+
+        size_t match_length = kMinMatch;
+        while (pos + match_length < src.size() && src[candidate + match_length] == src[pos + match_length]) {
+            match_length++;
+        }
+
+        const size_t literal_length = pos - anchor;
+        const size_t extra_match_length = match_length - kMinMatch;
+        dst->push_back(static_cast<uint8_t>((std::min<size_t>(literal_length, 15) << 4) | std::min<size_t>(extra_match_length, 15)));
+        if (literal_length >= 15) {
+            AppendLength(literal_length - 15, dst);
+        }
+        dst->insert(dst->end(), src.begin() + anchor, src.begin() + pos);
+
+        const size_t offset = pos - candidate;
+        dst->push_back(static_cast<uint8_t>(offset));
+        dst->push_back(static_cast<uint8_t>(offset >> 8));
+        if (extra_match_length >= 15) {
+            AppendLength(extra_match_length - 15, dst);
+        }
+
+        pos += match_length;
+        anchor = pos;
+    }
+
+    const size_t literal_length = src.size() - anchor;
+    dst->push_back(static_cast<uint8_t>(std::min<size_t>(literal_length, 15) << 4));
+    if (literal_length >= 15) {
+        AppendLength(literal_length - 15, dst);
+    }
+    dst->insert(dst->end(), src.begin() + anchor, src.end());
+}
+
+static bool DecompressBlock(const uint8_t* src, const size_t size, uint8_t* dst, const size_t raw_size) {
+    const uint8_t* pos = src;
+    const uint8_t* end = src + size;
+    size_t out = 0;
+
+    while (pos < end) {
+        const uint8_t token = *pos++;
+
+        size_t literal_length = token >> 4;
+        if (literal_length == 15 && !ReadLength(&pos, end, &literal_length)) {
+            return false;
+        }
+        if (literal_length > static_cast<size_t>(end - pos) || literal_length > raw_size - out) {
+            return false;
+        }
+        std::memcpy(dst + out, pos, literal_length);
+        pos += literal_length;
+        out += literal_length;
+
+        // last sequence
+        if (pos == end) {
+            break;
+        }
+
+        if (end - pos < 2) {
+            return false;
+        }
+        const size_t offset = pos[0] | (static_cast<size_t>(pos[1]) << 8);
+        pos += 2;
+
+        size_t match_length = token & 0xf;
+        if (match_length == 15 && !ReadLength(&pos, end, &match_length)) {
+            return false;
+        }
+        match_length += kMinMatch;
+
+        if (offset == 0 || offset > out || match_length > raw_size - out) {
+            return false;
+        }
+
+        // source may overlap the copied bytes
+        for (size_t byte_i = 0; byte_i < match_length; byte_i++, out++) {
+            dst[out] = dst[out - offset];
+        }
+    }
+
+    return out == raw_size;
+}
+
+static void AppendLength(size_t length, std::vector<uint8_t>* dst) {
+    while (length >= 255) {
+        dst->push_back(255);
+        length -= 255;
+    }
+    dst->push_back(static_cast<uint8_t>(length));
+}
+
+// adds extra bytes to nibble value 15
+static bool ReadLength(const uint8_t** pos, const uint8_t* end, size_t* length) {
+    uint8_t byte = 0;
+    do {
+        if (*pos == end) {
+            return false;
+        }
+
+        byte = *(*pos)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+} // namespace sim
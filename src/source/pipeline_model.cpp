@@ -0,0 +1,294 @@
+#include "pipeline_model.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cstring>
+
+#include "log_helper.hpp"
+
+#include "cpu_defs.hpp"
+#include "fpu.hpp"
+#include "instructions.hpp"
+#include "vector_unit.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static const uint8_t kWeaklyTaken = 2;
+static const uint8_t kCounterMax = 3;
+
+static size_t GetSourceRegisters(const DecodedInstr& instr, Register sources[2]);
+static bool GetDestRegister(const DecodedInstr& instr, Register* dest);
+static bool IsConditionalBranch(InstructionMnemonic mnemonic);
+
+// BranchPredictor private ----------------------------------------------------
+
+size_t BranchPredictor::GetIndex(const Address pc) const {
+    uint64_t index = pc / kInstrSize;
+    if (kind_ == PredictorKind::kGshare) {
+        index ^= global_history_;
+    }
+
+    return index & index_mask_;
+}
+
+// BranchPredictor public -----------------------------------------------------
+
+void BranchPredictor::Init(PredictorKind kind, size_t n_entries) {
+    LogFunctionEntry();
+
+    assert(std::has_single_bit(n_entries));
+
+    kind_ = kind;
+    counters_.assign(n_entries, kWeaklyTaken);
+    index_mask_ = n_entries - 1;
+    global_history_ = 0;
+}
+
+bool BranchPredictor::Predict(const Address pc, const bool is_backward) const {
+    if (kind_ == PredictorKind::kStatic) {
+        return is_backward;
+    }
+
+    return counters_[GetIndex(pc)] >= kWeaklyTaken;
+}
+
+void BranchPredictor::Update(const Address pc, const bool is_taken) {
+    if (kind_ == PredictorKind::kStatic) {
+        return ;
+    }
+
+    uint8_t& counter = counters_[GetIndex(pc)];
+    if (is_taken && counter < kCounterMax) {
+        counter++;
+    } else if (!is_taken && counter > 0) {
+        counter--;
+    }
+
+    global_history_ = ((global_history_ << 1u) | (is_taken ? 1 : 0)) & index_mask_;
+}
+
+// PipelineModel private ------------------------------------------------------
+
+void PipelineModel::PredictControlFlow(const Address pc, const DecodedInstr& instr, const Address next_pc) {
+    const Address fallthrough_pc = pc + kInstrSize;
+    bool is_mispredicted = false;
+
+    if (IsConditionalBranch(instr.instr_mnem)) {
+        const bool is_taken = next_pc != fallthrough_pc;
+        const bool is_backward = (instr.instr.b_type.imm >> (instr.instr.b_type.imm_size_bit - 1)) & 1u;
+
+        n_branches_++;
+        is_mispredicted = predictor_.Predict(pc, is_backward) != is_taken;
+        predictor_.Update(pc, is_taken);
+    } else if (instr.instr_mnem == InstructionMnemonic::kJal) {
+        // direct target is known to btb, only calls are tracked
+        if (instr.instr.j_type.rd == RegisterAliases::kRetAddr && !return_stack_.empty()) {
+            std::rotate(return_stack_.rbegin(), return_stack_.rbegin() + 1, return_stack_.rend());
+            return_stack_.front() = fallthrough_pc;
+        }
+    } else if (instr.instr_mnem == InstructionMnemonic::kJalr) {
+        const bool is_return = instr.instr.i_type.rd == RegisterAliases::kMachineZero 
+                               && instr.instr.i_type.rs1 == RegisterAliases::kRetAddr;
+
+        n_indirect_jumps_++;
+        if (is_return && !return_stack_.empty()) {
+            is_mispredicted = return_stack_.front() != next_pc;
+            std::rotate(return_stack_.begin(), return_stack_.begin() + 1, return_stack_.end());
+        } else {
+            Address& predicted_target = indirect_targets_[(pc / kInstrSize) & (indirect_targets_.size() - 1)];
+            is_mispredicted = predicted_target != next_pc;
+            predicted_target = next_pc;
+        }
+
+        if (instr.instr.i_type.rd == RegisterAliases::kRetAddr && !return_stack_.empty()) {
+            std::rotate(return_stack_.rbegin(), return_stack_.rbegin() + 1, return_stack_.rend());
+            return_stack_.front() = fallthrough_pc;
+        }
+
+        n_indirect_mispredicts_ += is_mispredicted ? 1 : 0;
+    } else {
+        return ;
+    }
+
+    if (is_mispredicted) {
+        n_branch_mispredicts_ += IsConditionalBranch(instr.instr_mnem) ? 1 : 0;
+        next_issue_cycle_ += config_.mispredict_penalty;
+    }
+}
+
+// PipelineModel public -------------------------------------------------------
+
+void PipelineModel::Init(const TimingConfig& config) {
+    LogFunctionEntry();
+
+    config_ = config;
+    predictor_.Init(config_.predictor, config_.predictor_entries);
+    return_stack_.assign(config_.return_stack_entries, 0);
+    indirect_targets_.assign(config_.predictor_entries, 0);
+
+    std::memset(ready_cycle_, 0, sizeof(ready_cycle_));
+    issue_cycle_ = 0;
+    next_issue_cycle_ = 0;
+
+    n_instructions_ = 0;
+    n_data_stalls_ = 0;
+    n_branches_ = 0;
+    n_branch_mispredicts_ = 0;
+    n_indirect_jumps_ = 0;
+    n_indirect_mispredicts_ = 0;
+}
+
+void PipelineModel::OnInstr(const Address pc, const DecodedInstr& instr, const Address next_pc) {
+    n_instructions_++;
+
+    Register sources[2] = {};
+    size_t n_sources = GetSourceRegisters(instr, sources);
+
+    uint64_t issue_cycle = next_issue_cycle_;
+    for (size_t i = 0; i < n_sources; i++) {
+        issue_cycle = std::max(issue_cycle, ready_cycle_[sources[i]]);
+    }
+
+    n_data_stalls_ += issue_cycle - next_issue_cycle_;
+    issue_cycle_ = issue_cycle;
+    next_issue_cycle_ = issue_cycle + 1;
+
+    Register dest = 0;
+    if (GetDestRegister(instr, &dest) && dest != RegisterAliases::kMachineZero) {
+        ready_cycle_[dest] = issue_cycle + config_.latencies[static_cast<size_t>(instr.instr_mnem)];
+    }
+
+    PredictControlFlow(pc, instr, next_pc);
+}
+
+uint64_t PipelineModel::GetCycles() const {
+    if (n_instructions_ == 0) {
+        return 0;
+    }
+
+    // last instruction still has to drain through the rest of the pipeline
+    return issue_cycle_ + kPipelineDepth;
+}
+
+uint64_t PipelineModel::GetInstructions() const {
+    return n_instructions_;
+}
+
+void PipelineModel::Report(FILE* report_file) const {
+    LogFunctionEntry();
+
+    assert(report_file != nullptr);
+
+    uint64_t cycles = GetCycles();
+    auto percent = [](uint64_t part, uint64_t total) {
+        return total == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(total);
+    };
+
+    std::fprintf(report_file, "Pipeline timing report (5-stage in-order, %s predictor, %zu entries):\n",
+                 PredictorKindToStr(config_.predictor), config_.predictor_entries);
+    std::fprintf(report_file, "  cycles:              %llu\n", static_cast<unsigned long long>(cycles));
+    std::fprintf(report_file, "  instructions:        %llu\n", static_cast<unsigned long long>(n_instructions_));
+    std::fprintf(report_file, "  ipc:                 %.3f\n", 
+                 cycles == 0 ? 0.0 : static_cast<double>(n_instructions_) / static_cast<double>(cycles));
+    std::fprintf(report_file, "  data stall cycles:   %llu\n", static_cast<unsigned long long>(n_data_stalls_));
+    std::fprintf(report_file, "  branches:            %llu, mispredicted %llu (%.2f%%)\n", 
+                 static_cast<unsigned long long>(n_branches_), 
+                 static_cast<unsigned long long>(n_branch_mispredicts_),
+                 percent(n_branch_mispredicts_, n_branches_));
+    std::fprintf(report_file, "  indirect jumps:      %llu, mispredicted %llu (%.2f%%)\n", 
+                 static_cast<unsigned long long>(n_indirect_jumps_), 
+                 static_cast<unsigned long long>(n_indirect_mispredicts_),
+                 percent(n_indirect_mispredicts_, n_indirect_jumps_));
+}
+
+// global ---------------------------------------------------------------------
+
+const char* PredictorKindToStr(PredictorKind kind) {
+    switch (kind) {
+        case PredictorKind::kStatic:  return "static";
+        case PredictorKind::kBimodal: return "bimodal";
+        case PredictorKind::kGshare:  return "gshare";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+static size_t GetSourceRegisters(const DecodedInstr& instr, Register sources[2]) {
+    switch (instr.instr_type) {
+        case InstrType::RType:
+            sources[0] = instr.instr.r_type.rs1;
+            sources[1] = instr.instr.r_type.rs2;
+            return 2;
+        case InstrType::IType:
+            sources[0] = instr.instr.i_type.rs1;
+            return 1;
+        case InstrType::SType:
+            sources[0] = instr.instr.s_type.rs1;
+            sources[1] = instr.instr.s_type.rs2;
+            return 2;
+        case InstrType::BType:
+            sources[0] = instr.instr.b_type.rs1;
+            sources[1] = instr.instr.b_type.rs2;
+            return 2;
+        case InstrType::VType: {
+            // only x register operands, vector registers are not tracked
+            size_t n_sources = 0;
+            if (instr.instr.v_type.operand == VectorOperand::kScalar) {
+                sources[n_sources++] = instr.instr.v_type.rs1;
+            }
+            if (IsVectorStridedInstr(instr.instr_mnem) || instr.instr_mnem == InstructionMnemonic::kVsetvl) {
+                sources[n_sources++] = instr.instr.v_type.vs2;
+            }
+            return n_sources;
+        }
+        case InstrType::FType:
+            // only x register operands, f registers are not tracked
+            sources[0] = instr.instr.f_type.rs1;
+            return IsFpIntegerSource(instr.instr_mnem) ? 1 : 0;
+        case InstrType::UType:
+        case InstrType::JType:
+        case InstrType::Uninit:
+        default:
+            return 0;
+    }
+}
+
+static bool GetDestRegister(const DecodedInstr& instr, Register* dest) {
+    assert(dest != nullptr);
+
+    switch (instr.instr_type) {
+        case InstrType::RType: *dest = instr.instr.r_type.rd; return true;
+        case InstrType::IType: *dest = instr.instr.i_type.rd; return true;
+        case InstrType::UType: *dest = instr.instr.u_type.rd; return true;
+        case InstrType::JType: *dest = instr.instr.j_type.rd; return true;
+        case InstrType::VType: *dest = instr.instr.v_type.vd; return IsVectorScalarDest(instr.instr_mnem);
+        case InstrType::FType: *dest = instr.instr.f_type.rd;  return IsFpIntegerDest(instr.instr_mnem);
+        case InstrType::SType:
+        case InstrType::BType:
+        case InstrType::Uninit:
+        default:
+            return false;
+    }
+}
+
+static bool IsConditionalBranch(InstructionMnemonic mnemonic) {
+    switch (mnemonic) {
+        case InstructionMnemonic::kBeq:
+        case InstructionMnemonic::kBne:
+        case InstructionMnemonic::kBlt:
+        case InstructionMnemonic::kBge:
+        case InstructionMnemonic::kBltu:
+        case InstructionMnemonic::kBgeu:
+            return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace sim
@@ -0,0 +1,310 @@
+#include "predecode_cache.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log_helper.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static const uint32_t kPredecodeMagic = 0x44505652; // "RVPD"
+static const uint32_t kPredecodeVersion = 2;
+static const size_t kRecordAlignment = 8;
+
+struct PredecodeHeader {
+    uint32_t magic;
+    uint32_t version;
+    ResultKey key;
+    uint64_t n_blocks;
+};
+
+// followed by instrs, ops and code bytes
+struct BlockRecord {
+    Address start_pc;
+    Address end_pc;
+    uint32_t n_guest_instrs;
+    uint32_t n_instrs;
+    uint32_t n_ops;
+    uint32_t code_size;
+    FusionCounters n_fusions;
+    IrStats ir_stats;
+    LoopIdiom idiom;
+};
+
+// records are raw copies of decoder structures
+static_assert(std::is_trivially_copyable_v<DecodedInstr>);
+static_assert(std::is_trivially_copyable_v<IrOp>);
+static_assert(std::is_trivially_copyable_v<BlockRecord>);
+
+static size_t GetRecordSize(const BlockRecord& record);
+static void AppendBlock(const DecodedBlock& block, std::vector<uint8_t>* file);
+
+// PredecodeCache private -----------------------------------------------------
+
+const uint8_t* PredecodeCache::FindRecord(const Address start_pc) const {
+    const IndexEntry* index_end = index_ + n_blocks_;
+    const IndexEntry* entry = std::lower_bound(index_, index_end, start_pc, [](const IndexEntry& lhs, Address pc) {
+        return lhs.start_pc < pc;
+    });
+
+    if (entry == index_end || entry->start_pc != start_pc) {
+        return nullptr;
+    }
+
+    return mapping_ + entry->offset;
+}
+
+// PredecodeCache public ------------------------------------------------------
+
+PredecodeError PredecodeCache::Init(const std::string& path, const ResultKey& key) {
+    LogFunctionEntry();
+
+    index_ = nullptr;
+    n_blocks_ = 0;
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? PredecodeError::kNoFile : PredecodeError::kIoError;
+    }
+
+    struct stat file_stat = {};
+    if (fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sizeof(PredecodeHeader)) {
+        close(fd);
+        return PredecodeError::kCorrupted;
+    }
+
+    size_t size = static_cast<size_t>(file_stat.st_size);
+    void* mapping = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        return PredecodeError::kIoError;
+    }
+
+    PredecodeHeader header = {};
+    std::memcpy(&header, mapping, sizeof(header));
+
+    PredecodeError err = PredecodeError::kOk;
+    if (header.magic != kPredecodeMagic) {
+        err = PredecodeError::kCorrupted;
+    } else if (header.version != kPredecodeVersion || !(header.key == key)) {
+        err = PredecodeError::kStale;
+    } else if (header.n_blocks > (size - sizeof(header)) / sizeof(IndexEntry)) {
+        err = PredecodeError::kCorrupted;
+    }
+
+    if (err != PredecodeError::kOk) {
+        munmap(mapping, size);
+        return err;
+    }
+
+    mapping_ = static_cast<const uint8_t*>(mapping);
+    mapping_size_ = size;
+    index_ = reinterpret_cast<const IndexEntry*>(mapping_ + sizeof(header));
+    n_blocks_ = header.n_blocks;
+
+    spdlog::info("Mapped {} predecoded blocks from {}", n_blocks_, path);
+    return PredecodeError::kOk;
+}
+
+PredecodeCache::~PredecodeCache() {
+    if (mapping_ != nullptr) {
+        munmap(const_cast<uint8_t*>(mapping_), mapping_size_);
+    }
+}
+
+bool PredecodeCache::LoadBlock(const Address start_pc, DecodedBlock* block) const {
+    assert(block != nullptr);
+
+    if (n_blocks_ == 0) {
+        return false;
+    }
+
+    const uint8_t* record_ptr = FindRecord(start_pc);
+    if (record_ptr == nullptr || record_ptr + sizeof(BlockRecord) > mapping_ + mapping_size_) {
+        return false;
+    }
+
+    BlockRecord record = {};
+    std::memcpy(&record, record_ptr, sizeof(record));
+    if (record.start_pc != start_pc || record_ptr + GetRecordSize(record) > mapping_ + mapping_size_
+        || record.n_instrs == 0) {
+        spdlog::error("Predecoded block 0x{:x} is corrupted", start_pc);
+        return false;
+    }
+
+    const uint8_t* data = record_ptr + sizeof(record);
+    block->start_pc = record.start_pc;
+    block->end_pc = record.end_pc;
+    block->n_guest_instrs = record.n_guest_instrs;
+    block->instrs.resize(record.n_instrs);
+    std::memcpy(block->instrs.data(), data, record.n_instrs * sizeof(DecodedInstr));
+    data += record.n_instrs * sizeof(DecodedInstr);
+    block->ops.resize(record.n_ops);
+    if (record.n_ops != 0) {
+        std::memcpy(block->ops.data(), data, record.n_ops * sizeof(IrOp));
+    }
+    data += record.n_ops * sizeof(IrOp);
+    block->n_fusions = record.n_fusions;
+    block->ir_stats = record.ir_stats;
+    block->n_executions = 0;
+    block->idiom = record.idiom;
+    block->code.assign(data, data + record.code_size);
+
+    return true;
+}
+
+// written to temporary file and renamed, processes that mapped old file keep it
+PredecodeError PredecodeCache::Save(const std::string& path, const ResultKey& key,
+                                    const std::unordered_map<Address, DecodedBlock>& blocks) const {
+    LogFunctionEntry();
+
+    // blocks not reached in this run are kept from mapped file, unless it is
+    // corrupted: then it is replaced by blocks of this run only
+    std::unordered_map<Address, DecodedBlock> kept_blocks;
+    for (size_t block_i = 0; block_i < n_blocks_; block_i++) {
+        const Address start_pc = index_[block_i].start_pc;
+        if (blocks.contains(start_pc)) {
+            continue;
+        }
+
+        DecodedBlock block = {};
+        if (!LoadBlock(start_pc, &block)) {
+            spdlog::warn("Predecode cache {} is corrupted, its blocks are dropped", path);
+            kept_blocks.clear();
+            break;
+        }
+        kept_blocks.emplace(start_pc, std::move(block));
+    }
+
+    std::vector<Address> start_pcs;
+    start_pcs.reserve(blocks.size() + kept_blocks.size());
+    for (const auto& [start_pc, block] : blocks) {
+        start_pcs.push_back(start_pc);
+    }
+    for (const auto& [start_pc, block] : kept_blocks) {
+        start_pcs.push_back(start_pc);
+    }
+    std::sort(start_pcs.begin(), start_pcs.end());
+
+    PredecodeHeader header = {
+        .magic = kPredecodeMagic,
+        .version = kPredecodeVersion,
+        .key = key,
+        .n_blocks = start_pcs.size(),
+    };
+
+    std::vector<uint8_t> file(sizeof(header) + start_pcs.size() * sizeof(IndexEntry));
+    std::memcpy(file.data(), &header, sizeof(header));
+
+    for (size_t block_i = 0; block_i < start_pcs.size(); block_i++) {
+        file.resize((file.size() + kRecordAlignment - 1) & ~(kRecordAlignment - 1));
+        if (file.size() > UINT32_MAX) {
+            return PredecodeError::kIoError;
+        }
+
+        IndexEntry entry = {.start_pc = start_pcs[block_i], .offset = static_cast<uint32_t>(file.size())};
+        std::memcpy(file.data() + sizeof(header) + block_i * sizeof(IndexEntry), &entry, sizeof(entry));
+
+        auto block_it = blocks.find(entry.start_pc);
+        AppendBlock(block_it != blocks.end() ? block_it->second : kept_blocks.at(entry.start_pc), &file);
+    }
+
+    // pids repeat across hosts sharing cache directory, so name is unique by mkostemp
+    std::string tmp_path = path + ".tmp.XXXXXX";
+    int fd = mkostemp(tmp_path.data(), O_CLOEXEC);
+    if (fd < 0) {
+        spdlog::error("Cant create predecode cache {}: {}", tmp_path, std::strerror(errno));
+        return PredecodeError::kIoError;
+    }
+    fchmod(fd, 0644);
+
+    size_t n_written = 0;
+    while (n_written < file.size()) {
+        ssize_t ret = write(fd, file.data() + n_written, file.size() - n_written);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            break;
+        }
+        n_written += static_cast<size_t>(ret);
+    }
+
+    bool is_written = close(fd) == 0 && n_written == file.size();
+    if (!is_written || rename(tmp_path.c_str(), path.c_str()) != 0) {
+        spdlog::error("Cant write predecode cache {}: {}", path, std::strerror(errno));
+        unlink(tmp_path.c_str());
+        return PredecodeError::kIoError;
+    }
+
+    spdlog::info("Saved {} predecoded blocks to {}", start_pcs.size(), path);
+    return PredecodeError::kOk;
+}
+
+size_t PredecodeCache::GetNBlocks() const {
+    return n_blocks_;
+}
+
+// global ---------------------------------------------------------------------
+
+const char* PredecodeErrorToStr(PredecodeError error) {
+    switch (error) {
+        case PredecodeError::kOk:        return "no error";
+        case PredecodeError::kNoFile:    return "no predecode cache file";
+        case PredecodeError::kStale:     return "predecode cache is stale";
+        case PredecodeError::kIoError:   return "predecode cache i/o error";
+        case PredecodeError::kCorrupted: return "corrupted predecode cache";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+static size_t GetRecordSize(const BlockRecord& record) {
+    return sizeof(record) + record.n_instrs * sizeof(DecodedInstr) + record.n_ops * sizeof(IrOp) + record.code_size;
+}
+
+static void AppendBlock(const DecodedBlock& block, std::vector<uint8_t>* file) {
+    assert(file != nullptr);
+
+    BlockRecord record = {
+        .start_pc = block.start_pc,
+        .end_pc = block.end_pc,
+        .n_guest_instrs = static_cast<uint32_t>(block.n_guest_instrs),
+        .n_instrs = static_cast<uint32_t>(block.instrs.size()),
+        .n_ops = static_cast<uint32_t>(block.ops.size()),
+        .code_size = static_cast<uint32_t>(block.code.size()),
+        .n_fusions = block.n_fusions,
+        .ir_stats = block.ir_stats,
+        .idiom = block.idiom,
+    };
+
+    size_t offset = file->size();
+    file->resize(offset + GetRecordSize(record));
+
+    uint8_t* data = file->data() + offset;
+    std::memcpy(data, &record, sizeof(record));
+    data += sizeof(record);
+    std::memcpy(data, block.instrs.data(), block.instrs.size() * sizeof(DecodedInstr));
+    data += block.instrs.size() * sizeof(DecodedInstr);
+    if (!block.ops.empty()) {
+        std::memcpy(data, block.ops.data(), block.ops.size() * sizeof(IrOp));
+    }
+    data += block.ops.size() * sizeof(IrOp);
+    std::memcpy(data, block.code.data(), block.code.size());
+}
+
+} // namespace sim
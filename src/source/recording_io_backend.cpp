@@ -0,0 +1,114 @@
+#include "recording_io_backend.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <unistd.h>
+
+#include "log_helper.hpp"
+
+#include "cpu_defs.hpp"
+
+namespace sim {
+
+// RecordingIoBackend public --------------------------------------------------
+
+bool RecordingIoBackend::Init(IIoBackend* io_backend) {
+    LogFunctionEntry();
+
+    assert(io_backend != nullptr);
+
+    io_backend_ = io_backend;
+    input_.clear();
+    input_pos_ = 0;
+    output_.clear();
+    error_output_.clear();
+
+    const size_t kChunkSize = 64 * 1024;
+    char chunk[kChunkSize];
+    while (true) {
+        ssize_t n_read = read(DefaultDesriptors::kStdin, chunk, kChunkSize);
+        if (n_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n_read < 0) {
+            spdlog::error("Cant read stdin: {}", std::strerror(errno));
+            return false;
+        }
+        if (n_read == 0) {
+            break;
+        }
+
+        input_.append(chunk, static_cast<size_t>(n_read));
+    }
+
+    spdlog::info("Read {} bytes of stdin in advance", input_.size());
+    return true;
+}
+
+ssize_t RecordingIoBackend::Read(const int fd, uint8_t* buffer, const size_t size) {
+    LogFunctionEntry();
+
+    if (fd != DefaultDesriptors::kStdin) {
+        return io_backend_->Read(fd, buffer, size);
+    }
+
+    size_t n_bytes = std::min(size, input_.size() - input_pos_);
+    std::memcpy(buffer, input_.data() + input_pos_, n_bytes);
+    input_pos_ += n_bytes;
+
+    return static_cast<ssize_t>(n_bytes);
+}
+
+ssize_t RecordingIoBackend::Write(const int fd, const uint8_t* buffer, const size_t size) {
+    LogFunctionEntry();
+
+    ssize_t n_written = io_backend_->Write(fd, buffer, size);
+    if (n_written <= 0) {
+        return n_written;
+    }
+
+    const char* data = reinterpret_cast<const char*>(buffer);
+    if (fd == DefaultDesriptors::kStdout) {
+        output_.append(data, static_cast<size_t>(n_written));
+    } else if (fd == DefaultDesriptors::kStderr) {
+        error_output_.append(data, static_cast<size_t>(n_written));
+    }
+
+    return n_written;
+}
+
+// stdin is consumed already, guest sees it as a pipe
+off_t RecordingIoBackend::Seek(const int fd, const off_t offset, const int whence) {
+    LogFunctionEntry();
+
+    if (fd == DefaultDesriptors::kStdin) {
+        return -ESPIPE;
+    }
+
+    return io_backend_->Seek(fd, offset, whence);
+}
+
+int RecordingIoBackend::Sync(const int fd) {
+    return io_backend_->Sync(fd);
+}
+
+void RecordingIoBackend::Flush() {
+    io_backend_->Flush();
+}
+
+const std::string& RecordingIoBackend::GetInput() const {
+    return input_;
+}
+
+const std::string& RecordingIoBackend::GetOutput() const {
+    return output_;
+}
+
+const std::string& RecordingIoBackend::GetErrorOutput() const {
+    return error_output_;
+}
+
+} // namespace sim
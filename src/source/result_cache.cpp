@@ -0,0 +1,341 @@
+#include "result_cache.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <string_view>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "log_helper.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static const uint32_t kEntryMagic = 0x52435652; // "RVCR"
+static const uint32_t kEntryVersion = 1;
+static const char* const kEntrySuffix = ".run";
+static const char* const kLockName = "lock";
+static const time_t kStaleTmpAge = 60 * 60; // left by crashed writers
+
+struct EntryHeader {
+    uint32_t magic;
+    uint32_t version;
+    ResultKey key;
+    int32_t exit_code;
+    uint32_t reserved;
+    uint64_t n_retired_instrs;
+    uint64_t output_size;
+    uint64_t error_output_size;
+    uint64_t reports_size;
+};
+
+static uint64_t Mix64(uint64_t value);
+static bool WriteAll(const int fd, const void* data, const size_t size);
+static bool ReadAll(const int fd, void* data, const size_t size);
+
+// ResultHasher public --------------------------------------------------------
+
+void ResultHasher::Init() {
+    state_[0] = 0x9e3779b97f4a7c15;
+    state_[1] = 0xc2b2ae3d27d4eb4f;
+    n_bytes_ = 0;
+}
+
+void ResultHasher::Update(const void* data, const size_t size) {
+    assert(data != nullptr || size == 0);
+
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    auto absorb = [this](const uint64_t word) {
+        const uint64_t mixed = Mix64(word);
+        state_[0] = std::rotl(state_[0] ^ mixed, 27) * 0x9fb21c651e98df25;
+        state_[1] = std::rotl(state_[1] + (mixed ^ state_[0]), 31) * 0xff51afd7ed558ccd;
+    };
+
+    size_t pos = 0;
+    for (; pos + sizeof(uint64_t) <= size; pos += sizeof(uint64_t)) {
+        uint64_t word = 0;
+        std::memcpy(&word, bytes + pos, sizeof(word));
+        absorb(word);
+    }
+
+    uint64_t tail = 0;
+    if (pos < size) {
+        std::memcpy(&tail, bytes + pos, size - pos);
+    }
+    absorb(tail);
+    absorb(size);
+
+    n_bytes_ += size;
+}
+
+ResultKey ResultHasher::Finish() const {
+    return {.lo = Mix64(state_[0] ^ n_bytes_), .hi = Mix64(state_[1] + state_[0])};
+}
+
+// ResultCache private --------------------------------------------------------
+
+std::string ResultCache::GetEntryPath(const ResultKey& key) const {
+    char name[2 * 16 + 1] = {};
+    std::snprintf(name, sizeof(name), "%016llx%016llx", static_cast<unsigned long long>(key.hi),
+                  static_cast<unsigned long long>(key.lo));
+
+    return dir_ + "/" + name + kEntrySuffix;
+}
+
+// removed entries stay readable for processes that have them open
+void ResultCache::Evict() const {
+    LogFunctionEntry();
+
+    std::string lock_path = dir_ + "/" + kLockName;
+    int lock_fd = open(lock_path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (lock_fd < 0 || flock(lock_fd, LOCK_EX) != 0) {
+        spdlog::error("Cant lock result cache: {}", std::strerror(errno));
+        if (lock_fd >= 0) {
+            close(lock_fd);
+        }
+        return ;
+    }
+
+    struct Entry {
+        std::string name;
+        size_t size;
+        timespec mtime;
+    };
+
+    std::vector<Entry> entries;
+    size_t total_size = 0;
+    time_t now = time(nullptr);
+
+    DIR* dir = opendir(dir_.c_str());
+    if (dir != nullptr) {
+        for (dirent* dir_entry = readdir(dir); dir_entry != nullptr; dir_entry = readdir(dir)) {
+            std::string_view name = dir_entry->d_name;
+            struct stat entry_stat = {};
+            if (fstatat(dirfd(dir), dir_entry->d_name, &entry_stat, AT_SYMLINK_NOFOLLOW) != 0
+                || !S_ISREG(entry_stat.st_mode)) {
+                continue;
+            }
+
+            if (name.ends_with(kEntrySuffix)) {
+                entries.push_back({.name = std::string(name), .size = static_cast<size_t>(entry_stat.st_size),
+                                   .mtime = entry_stat.st_mtim});
+                total_size += static_cast<size_t>(entry_stat.st_size);
+            } else if (name.find(".tmp.") != std::string_view::npos && now - entry_stat.st_mtim.tv_sec > kStaleTmpAge) {
+                unlinkat(dirfd(dir), dir_entry->d_name, 0);
+            }
+        }
+        closedir(dir);
+    }
+
+    // least recently used first
+    std::sort(entries.begin(), entries.end(), [](const Entry& lhs, const Entry& rhs) {
+        return lhs.mtime.tv_sec != rhs.mtime.tv_sec ? lhs.mtime.tv_sec < rhs.mtime.tv_sec
+                                                    : lhs.mtime.tv_nsec < rhs.mtime.tv_nsec;
+    });
+
+    size_t n_evicted = 0;
+    for (const Entry& entry : entries) {
+        if (total_size <= max_size_) {
+            break;
+        }
+
+        std::string entry_path = dir_ + "/" + entry.name;
+        if (unlink(entry_path.c_str()) == 0 || errno == ENOENT) {
+            total_size -= entry.size;
+            n_evicted++;
+        }
+    }
+
+    spdlog::info("Result cache: {} entries evicted, {} bytes kept", n_evicted, total_size);
+    close(lock_fd);
+}
+
+// ResultCache public ---------------------------------------------------------
+
+ResultCacheError ResultCache::Init(const std::string& dir, const size_t max_size) {
+    LogFunctionEntry();
+
+    dir_ = dir;
+    max_size_ = max_size;
+
+    if (mkdir(dir_.c_str(), 0755) != 0 && errno != EEXIST) {
+        spdlog::error("Cant create result cache directory {}: {}", dir_, std::strerror(errno));
+        return ResultCacheError::kIoError;
+    }
+
+    struct stat dir_stat = {};
+    if (stat(dir_.c_str(), &dir_stat) != 0 || !S_ISDIR(dir_stat.st_mode)) {
+        return ResultCacheError::kIoError;
+    }
+
+    return ResultCacheError::kOk;
+}
+
+ResultCacheError ResultCache::Lookup(const ResultKey& key, RunResult* result) const {
+    LogFunctionEntry();
+
+    assert(result != nullptr);
+
+    std::string entry_path = GetEntryPath(key);
+    int fd = open(entry_path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return errno == ENOENT ? ResultCacheError::kMiss : ResultCacheError::kIoError;
+    }
+
+    // sizes come from the file, each is checked against its size before they are summed
+    EntryHeader header = {};
+    struct stat entry_stat = {};
+    bool is_valid = fstat(fd, &entry_stat) == 0
+                 && static_cast<uint64_t>(entry_stat.st_size) >= sizeof(header)
+                 && ReadAll(fd, &header, sizeof(header))
+                 && header.magic == kEntryMagic
+                 && header.version == kEntryVersion
+                 && header.key == key;
+    const uint64_t data_size = is_valid ? static_cast<uint64_t>(entry_stat.st_size) - sizeof(header) : 0;
+    is_valid = is_valid
+            && header.output_size <= data_size
+            && header.error_output_size <= data_size - header.output_size
+            && header.reports_size == data_size - header.output_size - header.error_output_size;
+    if (is_valid) {
+        result->exit_code = header.exit_code;
+        result->n_retired_instrs = header.n_retired_instrs;
+        result->output.resize(header.output_size);
+        result->error_output.resize(header.error_output_size);
+        result->reports.resize(header.reports_size);
+        is_valid = ReadAll(fd, result->output.data(), result->output.size())
+                && ReadAll(fd, result->error_output.data(), result->error_output.size())
+                && ReadAll(fd, result->reports.data(), result->reports.size());
+    }
+    close(fd);
+
+    if (!is_valid) {
+        spdlog::error("Result cache entry {} is corrupted", entry_path);
+        return ResultCacheError::kCorrupted;
+    }
+
+    // recency for eviction, entry may be evicted meanwhile
+    utimensat(AT_FDCWD, entry_path.c_str(), nullptr, 0);
+
+    return ResultCacheError::kOk;
+}
+
+ResultCacheError ResultCache::Store(const ResultKey& key, const RunResult& result) const {
+    LogFunctionEntry();
+
+    std::string entry_path = GetEntryPath(key);
+    // pids repeat across hosts sharing cache directory, so name is unique by mkostemp
+    std::string tmp_path = entry_path + ".tmp.XXXXXX";
+
+    int fd = mkostemp(tmp_path.data(), O_CLOEXEC);
+    if (fd < 0) {
+        spdlog::error("Cant create result cache entry {}: {}", tmp_path, std::strerror(errno));
+        return ResultCacheError::kIoError;
+    }
+    // mkostemp creates it private, entries are readable by all users of cache
+    fchmod(fd, 0644);
+
+    EntryHeader header = {
+        .magic = kEntryMagic,
+        .version = kEntryVersion,
+        .key = key,
+        .exit_code = result.exit_code,
+        .reserved = 0,
+        .n_retired_instrs = result.n_retired_instrs,
+        .output_size = result.output.size(),
+        .error_output_size = result.error_output.size(),
+        .reports_size = result.reports.size(),
+    };
+
+    bool is_written = WriteAll(fd, &header, sizeof(header))
+                   && WriteAll(fd, result.output.data(), result.output.size())
+                   && WriteAll(fd, result.error_output.data(), result.error_output.size())
+                   && WriteAll(fd, result.reports.data(), result.reports.size());
+    is_written = close(fd) == 0 && is_written;
+
+    // concurrent stores of one key write the same result, the last rename wins
+    if (!is_written || rename(tmp_path.c_str(), entry_path.c_str()) != 0) {
+        spdlog::error("Cant write result cache entry {}: {}", entry_path, std::strerror(errno));
+        unlink(tmp_path.c_str());
+        return ResultCacheError::kIoError;
+    }
+
+    Evict();
+
+    return ResultCacheError::kOk;
+}
+
+// global ---------------------------------------------------------------------
+
+const char* ResultCacheErrorToStr(ResultCacheError error) {
+    switch (error) {
+        case ResultCacheError::kOk:        return "no error";
+        case ResultCacheError::kMiss:      return "no cached result";
+        case ResultCacheError::kIoError:   return "result cache i/o error";
+        case ResultCacheError::kCorrupted: return "corrupted result cache entry";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+// murmur3 finalizer
+static uint64_t Mix64(uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccd;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53;
+    value ^= value >> 33;
+
+    return value;
+}
+
+static bool WriteAll(const int fd, const void* data, const size_t size) {
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    size_t n_written = 0;
+    while (n_written < size) {
+        ssize_t ret = write(fd, bytes + n_written, size - n_written);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+
+        n_written += static_cast<size_t>(ret);
+    }
+
+    return true;
+}
+
+static bool ReadAll(const int fd, void* data, const size_t size) {
+    uint8_t* bytes = static_cast<uint8_t*>(data);
+    size_t n_read = 0;
+    while (n_read < size) {
+        ssize_t ret = read(fd, bytes + n_read, size - n_read);
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+        if (ret <= 0) {
+            return false;
+        }
+
+        n_read += static_cast<size_t>(ret);
+    }
+
+    return true;
+}
+
+} // namespace sim
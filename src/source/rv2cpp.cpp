@@ -0,0 +1,62 @@
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+#include "log_helper.hpp"
+
+#include "aot_translator.hpp"
+#include "elf_loader.hpp"
+
+// rv2cpp <executable> <output.cpp>
+// output is compiled to shared object and passed to simulator with --aot
+int main(const int argc, const char* const argv[]) {
+    auto logger = spdlog::basic_logger_mt("rv2cpp", "rv2cpp.log", true);
+    spdlog::set_default_logger(logger);
+
+#if defined (NDEBUG)
+    spdlog::set_level(spdlog::level::info);
+#else // DEBUG
+    spdlog::flush_on(spdlog::level::trace);
+    spdlog::set_level(spdlog::level::debug);
+#endif // NDEBUG
+
+    if (argc != 3) {
+        std::cerr << "Usage: " << argv[0] << " <target_execuable> <output.cpp>" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    ploader::ElfLoader elf_loader;
+    ploader::PloaderError load_error = elf_loader.Init(argv[1]);
+    if (load_error != ploader::PloaderError::kOk) {
+        std::cerr << "[Error]: cant load executable, " << ploader::PloaderErrorToStr(load_error) << std::endl;
+        spdlog::error("Cant load elf: {}", ploader::PloaderErrorToStr(load_error));
+        return EXIT_FAILURE;
+    }
+
+    if (elf_loader.GetXlen() != 32) {
+        std::cerr << "[Error]: only rv32 executables are translated" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    sim::AotTranslator translator;
+    translator.Init(elf_loader);
+
+    FILE* out = std::fopen(argv[2], "w");
+    if (out == nullptr) {
+        std::cerr << "[Error]: cant open " << argv[2] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    translator.Emit(out, argv[1]);
+    if (std::fclose(out) != 0) {
+        std::cerr << "[Error]: cant write " << argv[2] << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const sim::AotStats& stats = translator.GetStats();
+    std::cerr << "translated " << stats.n_blocks << " blocks, " << stats.n_instrs << " instructions, "
+              << stats.n_exits << " blocks end at instructions left to interpreter" << std::endl;
+
+    return EXIT_SUCCESS;
+}
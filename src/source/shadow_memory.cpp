@@ -0,0 +1,188 @@
+#include "shadow_memory.hpp"
+
+#include <cassert>
+#include <climits>
+
+#include "log_helper.hpp"
+
+#include "imemory.hpp"
+
+namespace sim {
+
+// ShadowMemory private -------------------------------------------------------
+
+uint8_t ShadowMemory::ReadByte(const MemAddress address) const {
+    auto write_it = writes_.find(address);
+    if (write_it != writes_.end()) {
+        return write_it->second;
+    }
+
+    assert(address < base_->GetMemorySize());
+
+    // base is not observed: shadow accesses are repeated ones
+    return const_cast<IMemory*>(base_)->GetData()[address];
+}
+
+void ShadowMemory::WriteByte(const uint8_t data, const MemAddress address) {
+    writes_[address] = data;
+}
+
+// ShadowMemory public --------------------------------------------------------
+
+void ShadowMemory::Init(size_t /*memory_size*/) {
+    LogFunctionEntry();
+
+    base_ = nullptr;
+    writes_.clear();
+}
+
+void ShadowMemory::SetBase(IMemory* base) {
+    LogFunctionEntry();
+
+    assert(base != nullptr);
+
+    base_ = base;
+    writes_.clear();
+}
+
+void ShadowMemory::Dump(size_t start_addr, size_t end_addr) const {
+    LogFunctionEntry();
+
+    base_->Dump(start_addr, end_addr);
+}
+
+uint64_t ShadowMemory::ReadFromMemory64b(const MemAddress address) const {
+    uint64_t value = 0;
+    for (size_t byte_i = 0; byte_i < sizeof(uint64_t); byte_i++) {
+        value |= static_cast<uint64_t>(ReadByte(address + byte_i)) << (byte_i * CHAR_BIT);
+    }
+
+    return value;
+}
+
+uint32_t ShadowMemory::ReadFromMemory32b(const MemAddress address) const {
+    uint32_t value = 0;
+    for (size_t byte_i = 0; byte_i < sizeof(uint32_t); byte_i++) {
+        value |= static_cast<uint32_t>(ReadByte(address + byte_i)) << (byte_i * CHAR_BIT);
+    }
+
+    return value;
+}
+
+uint16_t ShadowMemory::ReadFromMemory16b(const MemAddress address) const {
+    uint16_t value = 0;
+    for (size_t byte_i = 0; byte_i < sizeof(uint16_t); byte_i++) {
+        value |= static_cast<uint16_t>(ReadByte(address + byte_i) << (byte_i * CHAR_BIT));
+    }
+
+    return value;
+}
+
+uint8_t ShadowMemory::ReadFromMemory8b(const MemAddress address) const {
+    return ReadByte(address);
+}
+
+uint32_t ShadowMemory::FetchInstr32b(const MemAddress address) const {
+    return ReadFromMemory32b(address);
+}
+
+bool ShadowMemory::IsExecutable(const MemAddress address, const size_t size) const {
+    return base_->IsExecutable(address, size);
+}
+
+bool ShadowMemory::IsReadable(const MemAddress address, const size_t size) const {
+    return base_->IsReadable(address, size);
+}
+
+bool ShadowMemory::IsWritable(const MemAddress address, const size_t size) const {
+    return base_->IsWritable(address, size);
+}
+
+void ShadowMemory::WriteToMemory64b(const uint64_t data, const MemAddress address) {
+    for (size_t byte_i = 0; byte_i < sizeof(uint64_t); byte_i++) {
+        WriteByte(static_cast<uint8_t>(data >> (byte_i * CHAR_BIT)), address + byte_i);
+    }
+}
+
+void ShadowMemory::WriteToMemory32b(const uint32_t data, const MemAddress address) {
+    for (size_t byte_i = 0; byte_i < sizeof(uint32_t); byte_i++) {
+        WriteByte(static_cast<uint8_t>(data >> (byte_i * CHAR_BIT)), address + byte_i);
+    }
+}
+
+void ShadowMemory::WriteToMemory16b(const uint16_t data, const MemAddress address) {
+    for (size_t byte_i = 0; byte_i < sizeof(uint16_t); byte_i++) {
+        WriteByte(static_cast<uint8_t>(data >> (byte_i * CHAR_BIT)), address + byte_i);
+    }
+}
+
+void ShadowMemory::WriteToMemory8b(const uint8_t data, const MemAddress address) {
+    WriteByte(data, address);
+}
+
+void ShadowMemory::MapToMemory(const uint8_t* data_to_map, size_t start_addr, size_t end_addr) {
+    LogFunctionEntry();
+
+    assert(data_to_map != nullptr);
+
+    for (size_t addr = start_addr; addr < end_addr; addr++) {
+        WriteByte(data_to_map[addr - start_addr], static_cast<MemAddress>(addr));
+    }
+}
+
+size_t ShadowMemory::GetMemorySize() const {
+    return base_->GetMemorySize();
+}
+
+uint8_t* ShadowMemory::GetData() {
+    return base_->GetData();
+}
+
+uint8_t* ShadowMemory::GetHostRange(const MemAddress /*address*/, const size_t /*size*/) {
+    assert(0 && "host access would bypass shadow writes");
+    return nullptr;
+}
+
+void ShadowMemory::NotifyHostWrite(const MemAddress /*address*/, const size_t /*size*/) {
+    assert(0 && "host access would bypass shadow writes");
+}
+
+void ShadowMemory::MarkCode(const MemAddress address, const size_t size) {
+    base_->MarkCode(address, size);
+}
+
+bool ShadowMemory::HasWrittenCode() const {
+    return base_->HasWrittenCode();
+}
+
+void ShadowMemory::TakeWrittenCodePages(std::vector<size_t>* pages) {
+    base_->TakeWrittenCodePages(pages);
+}
+
+void ShadowMemory::SetObserver(IMemoryObserver* /*observer*/) {
+    assert(0 && "shadow memory is not observable");
+}
+
+const std::unordered_map<MemAddress, uint8_t>& ShadowMemory::GetWrites() const {
+    return writes_;
+}
+
+void ShadowMemory::Commit() {
+    LogFunctionEntry();
+
+    uint8_t* base_data = base_->GetData();
+    for (const auto& [address, data] : writes_) {
+        base_data[address] = data;
+        base_->NotifyHostWrite(address, sizeof(data));
+    }
+
+    writes_.clear();
+}
+
+void ShadowMemory::Discard() {
+    LogFunctionEntry();
+
+    writes_.clear();
+}
+
+} // namespace sim
@@ -1,6 +1,15 @@
 #include "sim.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
 #include <iostream>
+#include <thread>
+#include <vector>
+
+#include <sys/stat.h>
 
 #include "log_helper.hpp"
 
@@ -11,43 +20,825 @@
 #include "cpu_defs.hpp"
 #include "iprogram_loader.hpp"
 
-sim::Simulator::Simulator(const ploader::IProgramLoader& ploader) 
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static void HashProgram(const ploader::IProgramLoader& ploader, ResultHasher* hasher);
+
+} // namespace sim
+
+sim::Simulator::Simulator(const ploader::IProgramLoader& ploader, const SimOptions& options) 
+    : xlen_(ploader.GetXlen()), options_(options), n_retired_instrs_(0), n_checked_blocks_(0), n_mismatched_blocks_(0),
+      loop_idiom_stats_{}, is_aot_(false), is_result_cached_(false), is_replayed_(false), report_file_(stderr), report_buffer_(nullptr),
+      report_size_(0)
 {
     LogFunctionEntry();
 
     memory_.Init(kMemorySize);
+    Address program_end = 0;
     for (size_t index_ls = 0; index_ls < ploader.GetNLSections(); index_ls++) {   
         memory_.MapToMemory(ploader.GetBinIndex(index_ls), ploader.GetStartAddrIndex(index_ls), ploader.GetEndAddrIndex(index_ls));
+        program_end = std::max(program_end, static_cast<Address>(ploader.GetEndAddrIndex(index_ls)));
+    }
+
+    IIoBackend* io_backend = &sync_io_backend_;
+    if (options_.io_backend == IoBackendKind::kUring) {
+        IoBackendError err = uring_io_backend_.Init();
+        if (err == IoBackendError::kOk) {
+            io_backend = &uring_io_backend_;
+        } else {
+            std::cerr << "[Warning]: " << IoBackendErrorToStr(err) << ", falling back to synchronous i/o" << std::endl;
+        }
+    }
+
+    if (!options_.result_cache_dir.empty()) {
+        if (IsResultCacheable() && InitResultCache(ploader, io_backend)) {
+            is_result_cached_ = true;
+            io_backend = &recording_io_backend_;
+        } else {
+            std::cerr << "[Warning]: run writes files or result cache is unavailable, result is not cached" << std::endl;
+        }
+    }
+
+    syscall_handler_.Init(&memory_, io_backend, program_end);
+    InitMemoryMap(ploader, io_backend);
+    if (!options_.host_perf_path.empty()) {
+        host_perf_.Init();
+        syscall_handler_.SetIsTimed(true);
+    }
+
+    // lanes step through decoded blocks, instrumentation observes single instructions
+    is_lockstep_ = options_.n_lanes > 1;
+    if (is_lockstep_ && (xlen_ != 32 || IsInstrumented() || options_.is_block_opt_checked)) {
+        std::cerr << "[Warning]: lockstep lanes need rv32 without instrumentation, running a single instance" << std::endl;
+        is_lockstep_ = false;
+    }
+    if (is_lockstep_) {
+        lockstep_engine_.Init(ploader, options_.n_lanes, static_cast<Register>(options_.first_hart), io_backend);
     }
 
     cpu_.Init(ploader.GetEntryPoint(), &memory_);
+    cpu_.SetVlen(options_.vlen);
+    cpu_.SetSyscallHandler(&syscall_handler_);
+    cpu_.SetHartId(static_cast<Register>(options_.first_hart));
+    cpu64_.Init(ploader.GetEntryPoint(), &memory_);
+    cpu64_.SetSyscallHandler(&syscall_handler_);
+    cpu64_.SetHartId(options_.first_hart);
+    if (xlen_ == 64 && !options_.hle_routines.empty()) {
+        std::cerr << "[Warning]: hle is not supported for rv64, guest routines are executed" << std::endl;
+    }
+
+    function_map_.Init(ploader.GetSymbols());
+
+    hle_.Init(&memory_, ploader.GetSymbols(), options_.hle_routines);
+    cpu_.SetHleLayer(&hle_);
+
+    // hooked entries are patched into the table
+    decode_table_.Init(ploader, &memory_, &hle_);
+
+    if (!options_.branch_profile_path.empty()) {
+        edge_profiler_.Init(static_cast<Address>(ploader.GetEntryPoint()));
+        cpu_.SetEdgeProfiler(&edge_profiler_);
+        cpu64_.SetEdgeProfiler(&edge_profiler_);
+    }
+
+    // observers pass accesses on, profiler -> trace writer -> cache model
+    IMemoryObserver* observer = nullptr;
+    if (options_.is_cache_model_enabled) {
+        cache_hierarchy_.Init(options_.l1i_cache, options_.l1d_cache, options_.l2_cache, &function_map_);
+        observer = &cache_hierarchy_;
+    }
+
+    if (!options_.mem_trace_path.empty()) {
+        MemoryTraceError err = mem_trace_writer_.Init(options_.mem_trace_path, observer);
+        if (err == MemoryTraceError::kOk) {
+            observer = &mem_trace_writer_;
+        } else {
+            std::cerr << "[Error]: cant record memory trace, " << MemoryTraceErrorToStr(err) << std::endl;
+        }
+    }
+
+    if (!options_.mem_profile_path.empty()) {
+        mem_profiler_.Init(options_.l1d_cache.line_size, observer);
+        observer = &mem_profiler_;
+    }
+
+    if (observer != nullptr) {
+        memory_.SetObserver(observer);
+        decode_table_.SetObserver(observer);
+    }
+
+    if (options_.is_timing_enabled) {
+        pipeline_model_.Init(options_.timing);
+    }
+
+    // checked runs compare blocks only, so loops are left to them
+    bool is_loop_idiom_enabled = options_.is_loop_idiom_enabled && !options_.is_block_opt_checked;
+    block_cache_.Init(&memory_, &hle_, is_loop_idiom_enabled ? &loop_idiom_stats_ : nullptr,
+                      options_.is_fusion_enabled, options_.is_block_opt_enabled);
+    block_cache_.SetDecodeTable(&decode_table_);
+    reference_memory_.SetBase(&memory_);
+    optimized_memory_.SetBase(&memory_);
+
+    // translated code stands in for blocks of the plain block engine
+    if (!options_.aot_module_path.empty()) {
+        if (xlen_ != 32 || IsInstrumented() || is_lockstep_ || options_.is_block_opt_checked || !options_.hle_routines.empty()) {
+            std::cerr << "[Warning]: aot module needs rv32 block engine without instrumentation, checks and hle, "
+                         "it is not used" << std::endl;
+        } else {
+            AotError err = aot_runtime_.Init(options_.aot_module_path, HashAotImage(ploader), &memory_);
+            if (err == AotError::kOk) {
+                is_aot_ = true;
+            } else {
+                std::cerr << "[Warning]: " << AotErrorToStr(err) << ", it is not used" << std::endl;
+            }
+        }
+    }
+
+    // blocks are saved by the block engine only
+    if (options_.is_predecode_cached && xlen_ == 32 && !IsInstrumented() && !is_lockstep_) {
+        InitPredecodeCache(ploader);
+    }
+
+    InitControlFlowGraph(ploader);
 }
 
 void sim::Simulator::Execute() {
     LogFunctionEntry();
 
+    if (is_replayed_) {
+        ReplayResult();
+        return;
+    }
+
+    bool is_host_perf = !options_.host_perf_path.empty();
+    if (is_host_perf) {
+        host_perf_.Start();
+    }
+
+    RunGuest();
+
+    // reports are written out of the measured window
+    if (is_host_perf) {
+        host_perf_.Stop();
+    }
+
+    if (!is_lockstep_) {
+        DumpReports();
+    }
+
+    if (is_host_perf) {
+        DumpHostPerf();
+    }
+
+    if (is_result_cached_) {
+        StoreResult();
+    }
+}
+
+void sim::Simulator::RunGuest() {
+    LogFunctionEntry();
+
+    if (is_lockstep_) {
+        lockstep_engine_.Run();
+        lockstep_engine_.Report(report_file_);
+        return;
+    }
+
+    if (xlen_ == 64) {
+        // block engine and its ir are rv32 only
+        cpu64_.Dump();
+        if (options_.is_timing_enabled) {
+            RunInstructions<64, true>(&cpu64_);
+        } else {
+            RunInstructions<64, false>(&cpu64_);
+        }
+        cpu64_.Dump();
+        spdlog::info("Retired {} instructions", n_retired_instrs_);
+        spdlog::info("Decode table: {} instructions, {} written or data words decoded at run time", decode_table_.GetNInstrs(), decode_table_.GetNRedecoded());
+        return;
+    }
+
     cpu_.Dump();
     // Register cpu_pc = cpu_.GetPc();
     // LogVarX(cpu_pc);
     // memory_.Dump(cpu_pc - 32, cpu_pc + 32);
 
-    while (!cpu_.GetIsFinished()) {
+    if (options_.is_timing_enabled) {
+        RunInstructions<32, true>(&cpu_);
+    } else if (IsInstrumented()) {
+        RunInstructions<32, false>(&cpu_);
+    } else if (is_aot_) {
+        RunAot();
+        SavePredecodeCache();
+        spdlog::info("Aot: {} runs of translated code", aot_runtime_.GetNRuns());
+    } else {
+        RunBlocks();
+        SavePredecodeCache();
+    }
+
+    cpu_.Dump();
+    spdlog::info("Retired {} instructions", n_retired_instrs_);
+
+    const IrStats& ir_stats = block_cache_.GetIrStats();
+    spdlog::info("Block optimizer: {} ops lifted, {} constants folded, {} addresses folded, {} dead writes removed",
+                 ir_stats.n_lifted, ir_stats.n_folded_constants, ir_stats.n_folded_addresses, ir_stats.n_dead_writes);
+    spdlog::info("Block cache: {} blocks invalidated by code writes", block_cache_.GetNInvalidatedBlocks());
+    spdlog::info("Decode table: {} instructions, {} written or data words decoded at run time", decode_table_.GetNInstrs(), decode_table_.GetNRedecoded());
+    spdlog::info("Loop idioms: {} recognized, {} runs, {} left to guest, {} iterations collapsed",
+                 loop_idiom_stats_.n_recognized, loop_idiom_stats_.n_runs, loop_idiom_stats_.n_fallbacks, 
+                 loop_idiom_stats_.n_iterations);
+    if (options_.is_block_opt_checked) {
+        std::fprintf(report_file_, "Block optimizer check: %llu blocks executed, %llu mismatched\n",
+                     static_cast<unsigned long long>(n_checked_blocks_), static_cast<unsigned long long>(n_mismatched_blocks_));
+    }
+}
+
+// timing model is compiled out of the functional loop
+template <size_t kXlen, bool kIsTimed>
+void sim::Simulator::RunInstructions(BasicCpu<kXlen>* cpu) {
+    LogFunctionEntry();
+
+    while (!cpu->GetIsFinished()) {
         spdlog::debug("Start of instruction execution");
-        Register instr = FetchInstr();
-        DecodedInstr dec_instr = Decode(instr);
-        InstructionError err = cpu_.Execute(dec_instr);
+        Address instr_pc = static_cast<Address>(cpu->GetPc());
+        const DecodedInstr& dec_instr = decode_table_.Get(instr_pc);
+        cpu->SetRetiredInstrs(n_retired_instrs_, instr_pc);
+        InstructionError err = cpu->Execute(dec_instr);
         if (err != InstructionError::kOk) {
             spdlog::error("Error occurd while instruction execution");
         }
+        if constexpr (kIsTimed) {
+            pipeline_model_.OnInstr(instr_pc, dec_instr, static_cast<Address>(cpu->GetPc()));
+        }
+        n_retired_instrs_++;
         spdlog::debug("End of instruction execution");
         // cpu_.Dump();
     }
+}
 
-    cpu_.Dump();
+// hooks of instrumentation observe every single instruction, 
+// so instrumented runs step through instructions one by one
+bool sim::Simulator::IsInstrumented() const {
+    return !options_.branch_profile_path.empty() 
+        || options_.is_cache_model_enabled 
+        || !options_.mem_trace_path.empty()
+        || !options_.mem_profile_path.empty()
+        || options_.is_timing_enabled;
+}
+
+void sim::Simulator::InitMemoryMap(const ploader::IProgramLoader& ploader, IIoBackend* io_backend) {
+    LogFunctionEntry();
+
+    uart_.Init(io_backend);
+    timer_.Init(&n_retired_instrs_);
+    MapProgramRegions(ploader, {{kUartBase, &uart_}, {kTimerBase, &timer_}}, &memory_);
+
+    for (const MemoryRegion& region : memory_.GetRegions()) {
+        spdlog::info("Memory map: 0x{:08x}-0x{:08x} {} {}{}{} {}", region.start, region.start + region.size,
+                     MemoryRegionKindToStr(region.kind), (region.permissions & kPermRead) != 0 ? 'r' : '-',
+                     (region.permissions & kPermWrite) != 0 ? 'w' : '-', (region.permissions & kPermExec) != 0 ? 'x' : '-',
+                     region.device != nullptr ? region.device->GetName() : "");
+    }
+}
+
+// graph is recovered for the block engine and for dumps only, preformed
+// blocks come from predecode cache if there is one
+void sim::Simulator::InitControlFlowGraph(const ploader::IProgramLoader& ploader) {
+    LogFunctionEntry();
+
+    bool is_preformed = options_.is_preform_enabled && xlen_ == 32 && !IsInstrumented() && !is_lockstep_;
+    if (!is_preformed && options_.cfg_dump_path.empty()) {
+        return ;
+    }
+
+    cfg_.Init(ploader, decode_table_);
+
+    if (!options_.cfg_dump_path.empty()) {
+        CfgError err = cfg_.DumpDot(options_.cfg_dump_path);
+        if (err != CfgError::kOk) {
+            std::cerr << "[Error]: cant dump control flow graph, " << CfgErrorToStr(err) << std::endl;
+        }
+    }
+
+    if (is_preformed) {
+        block_cache_.Preform(cfg_);
+        spdlog::info("Preformed {} blocks of control flow graph", block_cache_.GetNPreformedBlocks());
+    }
 }
 
-sim::Register sim::Simulator::FetchInstr() {
+// decoded blocks depend on the program, symbols hooked by hle and block engine options
+void sim::Simulator::InitPredecodeCache(const ploader::IProgramLoader& ploader) {
     LogFunctionEntry();
 
-    return memory_.ReadFromMemory32b(cpu_.GetPc());
+    ResultHasher hasher;
+    hasher.Init();
+    HashProgram(ploader, &hasher);
+    hasher.UpdateValue(options_.is_fusion_enabled);
+    hasher.UpdateValue(options_.is_block_opt_enabled);
+    hasher.UpdateValue(options_.is_loop_idiom_enabled && !options_.is_block_opt_checked);
+    for (const std::string& routine : options_.hle_routines) {
+        hasher.Update(routine.data(), routine.size());
+    }
+    predecode_key_ = hasher.Finish();
+
+    if (options_.predecode_cache_dir.empty()) {
+        predecode_path_ = options_.executable_path + ".predecode";
+    } else {
+        if (mkdir(options_.predecode_cache_dir.c_str(), 0755) != 0 && errno != EEXIST) {
+            std::cerr << "[Warning]: cant create predecode cache directory " << options_.predecode_cache_dir << std::endl;
+            return ;
+        }
+
+        char name[2 * 16 + 1] = {};
+        std::snprintf(name, sizeof(name), "%016llx%016llx", static_cast<unsigned long long>(predecode_key_.hi),
+                      static_cast<unsigned long long>(predecode_key_.lo));
+        predecode_path_ = options_.predecode_cache_dir + "/" + name + ".predecode";
+    }
+
+    // stale or broken file is rebuilt at exit
+    PredecodeError err = predecode_cache_.Init(predecode_path_, predecode_key_);
+    if (err == PredecodeError::kOk) {
+        block_cache_.SetPredecodeCache(&predecode_cache_);
+    } else {
+        spdlog::info("Predecoded blocks are not loaded: {}", PredecodeErrorToStr(err));
+    }
 }
+
+// file is rewritten only if this run has decoded new blocks
+void sim::Simulator::SavePredecodeCache() {
+    LogFunctionEntry();
+
+    spdlog::info("Predecode cache: {} blocks loaded, {} decoded", block_cache_.GetNLoadedBlocks(),
+                 block_cache_.GetNBuiltBlocks());
+    if (predecode_path_.empty() || block_cache_.GetNBuiltBlocks() == 0) {
+        return ;
+    }
+
+    PredecodeError err = predecode_cache_.Save(predecode_path_, predecode_key_, block_cache_.GetBlocks());
+    if (err != PredecodeError::kOk) {
+        std::cerr << "[Warning]: decoded blocks are not saved, " << PredecodeErrorToStr(err) << std::endl;
+    }
+}
+
+// results written to files besides standard streams can't be replayed
+bool sim::Simulator::IsResultCacheable() const {
+    return options_.branch_profile_path.empty()
+        && options_.cfg_dump_path.empty()
+        && options_.host_perf_path.empty()
+        && options_.cache_report_path.empty()
+        && options_.mem_trace_path.empty()
+        && options_.mem_profile_path.empty()
+        && options_.timing_report_path.empty()
+        && (options_.fusion_report_path.empty() || options_.fusion_report_path == "-");
+}
+
+// key covers the program, options and whole stdin
+bool sim::Simulator::InitResultCache(const ploader::IProgramLoader& ploader, IIoBackend* io_backend) {
+    LogFunctionEntry();
+
+    ResultCacheError err = result_cache_.Init(options_.result_cache_dir, options_.result_cache_size);
+    if (err != ResultCacheError::kOk) {
+        std::cerr << "[Error]: " << ResultCacheErrorToStr(err) << " in " << options_.result_cache_dir << std::endl;
+        return false;
+    }
+
+    if (!recording_io_backend_.Init(io_backend)) {
+        return false;
+    }
+
+    ResultHasher hasher;
+    hasher.Init();
+    HashProgram(ploader, &hasher);
+    hasher.Update(options_.result_key_options.data(), options_.result_key_options.size());
+    const std::string& input = recording_io_backend_.GetInput();
+    hasher.Update(input.data(), input.size());
+    result_key_ = hasher.Finish();
+
+    err = result_cache_.Lookup(result_key_, &cached_result_);
+    if (err == ResultCacheError::kOk) {
+        spdlog::info("Result cache hit, {} guest instructions are not executed", cached_result_.n_retired_instrs);
+        is_replayed_ = true;
+        return true;
+    }
+
+    report_file_ = open_memstream(&report_buffer_, &report_size_);
+    if (report_file_ == nullptr) {
+        report_file_ = stderr;
+        return false;
+    }
+
+    return true;
+}
+
+// reports were kept in memory, they are shown now as they would be without cache
+void sim::Simulator::StoreResult() {
+    LogFunctionEntry();
+
+    std::fclose(report_file_);
+    report_file_ = stderr;
+    std::fwrite(report_buffer_, 1, report_size_, stderr);
+
+    RunResult result = {
+        .exit_code = GetExitCode(),
+        .n_retired_instrs = n_retired_instrs_,
+        .output = recording_io_backend_.GetOutput(),
+        .error_output = recording_io_backend_.GetErrorOutput(),
+        .reports = std::string(report_buffer_, report_size_),
+    };
+    std::free(report_buffer_);
+    report_buffer_ = nullptr;
+
+    bool is_nondeterministic = is_lockstep_ ? lockstep_engine_.GetIsNondeterministic() 
+                                            : syscall_handler_.GetIsNondeterministic();
+    if (is_nondeterministic) {
+        spdlog::info("Guest has opened files or read host time, result is not cached");
+        return ;
+    }
+
+    ResultCacheError err = result_cache_.Store(result_key_, result);
+    if (err != ResultCacheError::kOk) {
+        std::cerr << "[Warning]: result is not cached, " << ResultCacheErrorToStr(err) << std::endl;
+    }
+}
+
+void sim::Simulator::ReplayResult() {
+    LogFunctionEntry();
+
+    std::fwrite(cached_result_.output.data(), 1, cached_result_.output.size(), stdout);
+    std::fflush(stdout);
+    std::fwrite(cached_result_.error_output.data(), 1, cached_result_.error_output.size(), stderr);
+    std::fwrite(cached_result_.reports.data(), 1, cached_result_.reports.size(), stderr);
+}
+
+void sim::Simulator::RunBlocks() {
+    LogFunctionEntry();
+
+    while (!cpu_.GetIsFinished()) {
+        if (memory_.HasWrittenCode()) {
+            block_cache_.InvalidateWrittenCode();
+        }
+
+        RunBlock();
+    }
+}
+
+void sim::Simulator::RunBlock() {
+    DecodedBlock& block = block_cache_.GetNextBlock(cpu_.GetPc());
+    block.n_executions++;
+
+    if (block.idiom.kind != LoopIdiomKind::kNone) {
+        uint64_t n_idiom_instrs = RunLoopIdiom(block.idiom, &cpu_, &memory_, &loop_idiom_stats_);
+        if (n_idiom_instrs != 0) {
+            n_retired_instrs_ += n_idiom_instrs;
+            return ;
+        }
+    }
+
+    cpu_.SetRetiredInstrs(n_retired_instrs_, block.start_pc);
+    if (options_.is_block_opt_checked) {
+        ExecuteBlockChecked(block);
+    } else {
+        ExecuteIrOps(&cpu_, block.ops, block.ops.size(), block.end_pc);
+    }
+
+    n_retired_instrs_ += block.n_guest_instrs;
+}
+
+// translated code runs as far as it can, a block of the block engine
+// takes the instruction it stopped at
+void sim::Simulator::RunAot() {
+    LogFunctionEntry();
+
+    std::vector<size_t> written_pages;
+    while (!cpu_.GetIsFinished()) {
+        if (memory_.HasWrittenCode()) {
+            memory_.TakeWrittenCodePages(&written_pages);
+            aot_runtime_.CheckWrittenPages(written_pages);
+            block_cache_.InvalidatePages(written_pages);
+        }
+
+        if (aot_runtime_.GetIsEnabled()) {
+            aot_runtime_.Run(&cpu_, &n_retired_instrs_);
+        }
+
+        RunBlock();
+    }
+}
+
+// non guest ops do not maintain pc, so it is set after the last of them
+void sim::Simulator::ExecuteIrOps(Cpu* cpu, const std::vector<IrOp>& ops, size_t n_ops, Address end_pc) {
+    for (size_t op_i = 0; op_i < n_ops; op_i++) {
+        InstructionError err = cpu->ExecuteIr(ops[op_i]);
+        if (err != InstructionError::kOk) {
+            spdlog::error("Error occurd while instruction execution");
+        }
+    }
+
+    if (n_ops == 0 || ops[n_ops - 1].opcode != IrOpcode::kGuest) {
+        cpu->SetPc(end_pc);
+    }
+}
+
+// both forms run on copies of cpu over shadow memories, the trailing system 
+// instruction is excluded as its host side effects can't be repeated
+void sim::Simulator::ExecuteBlockChecked(const DecodedBlock& block) {
+    LogFunctionEntry();
+
+    const DecodedInstr& last_instr = block.instrs.back();
+    bool is_system_terminated = last_instr.instr_mnem == InstructionMnemonic::kScall 
+                             || last_instr.instr_mnem == InstructionMnemonic::kSbreak
+                             || last_instr.instr_mnem == InstructionMnemonic::kHleCall;
+
+    size_t n_instrs = block.instrs.size() - (is_system_terminated ? 1 : 0);
+    size_t n_ops = block.ops.size() - (is_system_terminated ? 1 : 0);
+    Address body_end_pc = block.end_pc - (is_system_terminated ? kInstrSize : 0);
+
+    Cpu reference_cpu = cpu_;
+    reference_cpu.SetMemory(&reference_memory_);
+    for (size_t instr_i = 0; instr_i < n_instrs; instr_i++) {
+        InstructionError err = reference_cpu.Execute(block.instrs[instr_i]);
+        if (err != InstructionError::kOk) {
+            spdlog::error("Error occurd while instruction execution");
+        }
+    }
+
+    Cpu optimized_cpu = cpu_;
+    optimized_cpu.SetMemory(&optimized_memory_);
+    ExecuteIrOps(&optimized_cpu, block.ops, n_ops, body_end_pc);
+
+    n_checked_blocks_++;
+    bool is_mismatched = false;
+    if (reference_cpu.GetPc() != optimized_cpu.GetPc()) {
+        std::cerr << "[Error]: block 0x" << std::hex << block.start_pc << " pc mismatch: 0x" << reference_cpu.GetPc() 
+                  << " != 0x" << optimized_cpu.GetPc() << std::dec << std::endl;
+        is_mismatched = true;
+    }
+    for (size_t reg_i = 0; reg_i < kNumberOfRegisters; reg_i++) {
+        if (reference_cpu.GetRegisterValue(reg_i) != optimized_cpu.GetRegisterValue(reg_i)) {
+            std::cerr << "[Error]: block 0x" << std::hex << block.start_pc << " x" << std::dec << reg_i 
+                      << " mismatch: 0x" << std::hex << reference_cpu.GetRegisterValue(reg_i) 
+                      << " != 0x" << optimized_cpu.GetRegisterValue(reg_i) << std::dec << std::endl;
+            is_mismatched = true;
+        }
+    }
+    if (reference_memory_.GetWrites() != optimized_memory_.GetWrites()) {
+        std::cerr << "[Error]: block 0x" << std::hex << block.start_pc << std::dec << " memory writes mismatch" << std::endl;
+        is_mismatched = true;
+    }
+    if (is_mismatched) {
+        n_mismatched_blocks_++;
+    }
+
+    cpu_ = reference_cpu;
+    cpu_.SetMemory(&memory_);
+    reference_memory_.Commit();
+    optimized_memory_.Discard();
+
+    if (is_system_terminated) {
+        InstructionError err = cpu_.Execute(last_instr);
+        if (err != InstructionError::kOk) {
+            spdlog::error("Error occurd while instruction execution");
+        }
+    }
+}
+
+// trace is read back as analysis tools would, chunks are decoded by several threads at once
+void sim::Simulator::CheckMemoryTrace() {
+    LogFunctionEntry();
+
+    MemoryTraceReader reader;
+    MemoryTraceError err = reader.Open(options_.mem_trace_path);
+    if (err != MemoryTraceError::kOk) {
+        std::cerr << "[Error]: cant read memory trace back, " << MemoryTraceErrorToStr(err) << std::endl;
+        return;
+    }
+
+    const size_t n_chunks = reader.GetNChunks();
+    const size_t n_threads = std::min<size_t>(n_chunks, std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<uint64_t> n_thread_records(n_threads, 0);
+    std::vector<MemoryTraceError> thread_errors(n_threads, MemoryTraceError::kOk);
+    // each is written by the thread decoding its chunk only
+    MemoryAccess first_access = {};
+    MemoryAccess last_access = {};
+
+    std::vector<std::thread> threads;
+    for (size_t thread_i = 0; thread_i < n_threads; thread_i++) {
+        threads.emplace_back([&, thread_i]() {
+            std::vector<MemoryAccess> accesses;
+            for (size_t chunk_i = thread_i; chunk_i < n_chunks; chunk_i += n_threads) {
+                MemoryTraceError chunk_err = reader.ReadChunk(chunk_i, &accesses);
+                if (chunk_err != MemoryTraceError::kOk) {
+                    thread_errors[thread_i] = chunk_err;
+                    return;
+                }
+
+                n_thread_records[thread_i] += accesses.size();
+                if (chunk_i == 0 && !accesses.empty()) {
+                    first_access = accesses.front();
+                }
+                if (chunk_i == n_chunks - 1 && !accesses.empty()) {
+                    last_access = accesses.back();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    for (MemoryTraceError thread_err : thread_errors) {
+        if (thread_err != MemoryTraceError::kOk) {
+            std::cerr << "[Error]: cant read memory trace back, " << MemoryTraceErrorToStr(thread_err) << std::endl;
+            return;
+        }
+    }
+
+    auto is_same_access = [](const MemoryAccess& lhs, const MemoryAccess& rhs) {
+        return lhs.address == rhs.address && lhs.pc == rhs.pc && lhs.size == rhs.size && lhs.type == rhs.type;
+    };
+
+    uint64_t n_records = 0;
+    for (uint64_t n_records_of_thread : n_thread_records) {
+        n_records += n_records_of_thread;
+    }
+
+    bool is_matched = n_records == mem_trace_writer_.GetNRecords()
+                   && is_same_access(first_access, mem_trace_writer_.GetFirstAccess())
+                   && is_same_access(last_access, mem_trace_writer_.GetLastAccess());
+    std::fprintf(report_file_, "Memory trace check: %llu of %llu records read back from %zu chunks on %zu threads, %s\n",
+                 static_cast<unsigned long long>(n_records), static_cast<unsigned long long>(mem_trace_writer_.GetNRecords()),
+                 n_chunks, n_threads, is_matched ? "first and last records match" : "mismatched");
+}
+
+void sim::Simulator::DumpReports() {
+    LogFunctionEntry();
+
+    if (memory_.GetNFaults() != 0) {
+        spdlog::warn("Guest made {} faulting memory accesses", memory_.GetNFaults());
+    }
+
+    if (!options_.branch_profile_path.empty()) {
+        // pc already points past the instruction that has stopped the guest
+        Address final_pc = xlen_ == 64 ? static_cast<Address>(cpu64_.GetPc()) : cpu_.GetPc();
+        edge_profiler_.Finish(final_pc - kInstrSize);
+
+        ProfilerError err = edge_profiler_.Dump(options_.branch_profile_path, options_.branch_profile_format);
+        if (err != ProfilerError::kOk) {
+            std::cerr << "[Error]: cant dump branch profile, " << ProfilerErrorToStr(err) << std::endl;
+        }
+    }
+
+    if (!options_.mem_trace_path.empty()) {
+        MemoryTraceError err = mem_trace_writer_.Finish();
+        if (err != MemoryTraceError::kOk && err != MemoryTraceError::kNoFile) {
+            std::cerr << "[Error]: memory trace is incomplete, " << MemoryTraceErrorToStr(err) << std::endl;
+        } else if (err == MemoryTraceError::kOk && options_.is_mem_trace_checked) {
+            CheckMemoryTrace();
+        }
+    }
+
+    if (!options_.mem_profile_path.empty()) {
+        FILE* report_file = stderr;
+        if (options_.mem_profile_path != "-") {
+            report_file = std::fopen(options_.mem_profile_path.c_str(), "w");
+        }
+
+        if (report_file == nullptr) {
+            std::cerr << "[Error]: cant open memory profile file " << options_.mem_profile_path << std::endl;
+        } else {
+            mem_profiler_.Report(report_file);
+            if (report_file != stderr) {
+                std::fclose(report_file);
+            }
+        }
+    }
+
+    if (options_.is_cache_model_enabled) {
+        FILE* report_file = report_file_;
+        if (!options_.cache_report_path.empty()) {
+            report_file = std::fopen(options_.cache_report_path.c_str(), "w");
+        }
+
+        if (report_file == nullptr) {
+            std::cerr << "[Error]: cant open cache report file " << options_.cache_report_path << std::endl;
+        } else {
+            cache_hierarchy_.Report(report_file);
+            if (report_file != report_file_) {
+                std::fclose(report_file);
+            }
+        }
+    }
+
+    if (options_.is_timing_enabled) {
+        FILE* report_file = report_file_;
+        if (!options_.timing_report_path.empty()) {
+            report_file = std::fopen(options_.timing_report_path.c_str(), "w");
+        }
+
+        if (report_file == nullptr) {
+            std::cerr << "[Error]: cant open timing report file " << options_.timing_report_path << std::endl;
+        } else {
+            pipeline_model_.Report(report_file);
+            if (report_file != report_file_) {
+                std::fclose(report_file);
+            }
+        }
+    }
+
+    if (!options_.fusion_report_path.empty()) {
+        FILE* report_file = report_file_;
+        if (options_.fusion_report_path != "-") {
+            report_file = std::fopen(options_.fusion_report_path.c_str(), "w");
+        }
+
+        if (report_file == nullptr) {
+            std::cerr << "[Error]: cant open fusion report file " << options_.fusion_report_path << std::endl;
+        } else {
+            block_cache_.ReportFusion(report_file);
+            if (report_file != report_file_) {
+                std::fclose(report_file);
+            }
+        }
+    }
+
+    if (hle_.IsEnabled()) {
+        hle_.Report(report_file_);
+    }
+}
+
+// lockstep lanes have syscall handlers of their own, they are not counted
+void sim::Simulator::DumpHostPerf() {
+    LogFunctionEntry();
+
+    HostPerfStats stats = {
+        .n_guest_instrs = n_retired_instrs_,
+        .n_predecoded_instrs = decode_table_.GetNInstrs(),
+        .n_run_time_decodes = decode_table_.GetNRedecoded(),
+        .n_built_blocks = block_cache_.GetNBuiltBlocks(),
+        .n_loaded_blocks = block_cache_.GetNLoadedBlocks(),
+        .n_block_link_hits = block_cache_.GetNLinkHits(),
+        .n_block_lookups = block_cache_.GetNLookups(),
+        .n_syscalls = syscall_handler_.GetNSyscalls(),
+        .syscall_time_ns = syscall_handler_.GetSyscallTimeNs(),
+    };
+
+    FILE* report_file = stderr;
+    if (options_.host_perf_path != "-") {
+        report_file = std::fopen(options_.host_perf_path.c_str(), "w");
+    }
+
+    if (report_file == nullptr) {
+        std::cerr << "[Error]: cant open host perf report file " << options_.host_perf_path << std::endl;
+        return ;
+    }
+
+    host_perf_.Report(report_file, stats);
+    if (report_file != stderr) {
+        std::fclose(report_file);
+    }
+}
+
+int sim::Simulator::GetExitCode() const {
+    if (is_replayed_) {
+        return cached_result_.exit_code;
+    }
+
+    if (is_lockstep_) {
+        return lockstep_engine_.GetExitCode();
+    }
+
+    return syscall_handler_.GetExitCode();
+}
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+// simulator binary is a part of program identity, so rebuilt simulators 
+// do not reuse results and decoded structures of old ones
+static void HashProgram(const ploader::IProgramLoader& ploader, ResultHasher* hasher) {
+    assert(hasher != nullptr);
+
+    struct stat sim_stat = {};
+    if (stat("/proc/self/exe", &sim_stat) == 0) {
+        hasher->UpdateValue(sim_stat.st_size);
+        hasher->UpdateValue(sim_stat.st_mtim.tv_sec);
+        hasher->UpdateValue(sim_stat.st_mtim.tv_nsec);
+    }
+
+    hasher->UpdateValue(ploader.GetXlen());
+    hasher->UpdateValue(ploader.GetEntryPoint());
+    for (size_t index_ls = 0; index_ls < ploader.GetNLSections(); index_ls++) {
+        hasher->UpdateValue(ploader.GetStartAddrIndex(index_ls));
+        hasher->Update(ploader.GetBinIndex(index_ls), ploader.GetSizeIndex(index_ls));
+    }
+    for (const ploader::Symbol& symbol : ploader.GetSymbols()) {
+        hasher->Update(symbol.name.data(), symbol.name.size());
+        hasher->UpdateValue(symbol.addr);
+        hasher->UpdateValue(symbol.size);
+    }
+}
+
+} // namespace sim
@@ -0,0 +1,442 @@
+#include "sim_options.hpp"
+
+#include <bit>
+#include <cassert>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+#include "log_helper.hpp"
+
+#include "cache_model.hpp"
+#include "decode.hpp"
+#include "hle.hpp"
+#include "instructions.hpp"
+#include "lockstep.hpp"
+#include "pipeline_model.hpp"
+#include "vector_unit.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static bool MatchOption(std::string_view arg, std::string_view name, std::string_view* value);
+static bool ParseSize(std::string_view str, size_t* size);
+static bool ParseCacheConfig(std::string_view str, CacheConfig* config);
+static bool ParseLatencies(std::string_view str, TimingConfig* config);
+
+// global ---------------------------------------------------------------------
+
+OptionsError ParseOptions(const int argc, const char* const argv[], SimOptions* options) {
+    LogFunctionEntry();
+
+    assert(options != nullptr);
+
+    for (int arg_i = 1; arg_i < argc; arg_i++) {
+        std::string_view arg = argv[arg_i];
+        std::string_view value;
+
+        if (!arg.starts_with("--")) {
+            if (!options->executable_path.empty()) {
+                spdlog::error("More than one executable passed: {}", arg);
+                return OptionsError::kUnknownOption;
+            }
+
+            options->executable_path = arg;
+            continue;
+        }
+
+        // caches and translated code do not change results
+        if (!arg.starts_with("--result-cache") && !arg.starts_with("--predecode-cache") && !arg.starts_with("--aot")) {
+            options->result_key_options.append(arg).push_back('\n');
+        }
+
+        if (MatchOption(arg, "--predecode-cache", &value)) {
+            options->is_predecode_cached = true;
+            options->predecode_cache_dir = value;
+        } else if (MatchOption(arg, "--aot", &value)) {
+            if (value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->aot_module_path = value;
+        } else if (MatchOption(arg, "--result-cache", &value)) {
+            if (value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->result_cache_dir = value;
+        } else if (MatchOption(arg, "--result-cache-size", &value)) {
+            if (!ParseSize(value, &options->result_cache_size)) {
+                return OptionsError::kBadOptionValue;
+            }
+        } else if (MatchOption(arg, "--branch-profile", &value)) {
+            if (value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->branch_profile_path = value;
+        } else if (MatchOption(arg, "--branch-profile-format", &value)) {
+            if (value == "autofdo") {
+                options->branch_profile_format = BranchProfileFormat::kAutoFdo;
+            } else if (value == "llvm") {
+                options->branch_profile_format = BranchProfileFormat::kLlvm;
+            } else {
+                spdlog::error("Unknown branch profile format: {}", value);
+                return OptionsError::kBadOptionValue;
+            }
+        } else if (MatchOption(arg, "--cache", &value)) {
+            if (!value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_cache_model_enabled = true;
+        } else if (MatchOption(arg, "--cache-l1i", &value)) {
+            if (!ParseCacheConfig(value, &options->l1i_cache)) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_cache_model_enabled = true;
+        } else if (MatchOption(arg, "--cache-l1d", &value)) {
+            if (!ParseCacheConfig(value, &options->l1d_cache)) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_cache_model_enabled = true;
+        } else if (MatchOption(arg, "--cache-l2", &value)) {
+            if (!ParseCacheConfig(value, &options->l2_cache)) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_cache_model_enabled = true;
+        } else if (MatchOption(arg, "--cache-report", &value)) {
+            if (value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->cache_report_path = value;
+        } else if (MatchOption(arg, "--mem-trace", &value)) {
+            if (value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->mem_trace_path = value;
+        } else if (MatchOption(arg, "--mem-profile", &value)) {
+            options->mem_profile_path = value.empty() ? "-" : value;
+        } else if (MatchOption(arg, "--timing", &value)) {
+            if (!value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_timing_enabled = true;
+        } else if (MatchOption(arg, "--timing-predictor", &value)) {
+            if (value == "static") {
+                options->timing.predictor = PredictorKind::kStatic;
+            } else if (value == "bimodal") {
+                options->timing.predictor = PredictorKind::kBimodal;
+            } else if (value == "gshare") {
+                options->timing.predictor = PredictorKind::kGshare;
+            } else {
+                spdlog::error("Unknown branch predictor: {}", value);
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_timing_enabled = true;
+        } else if (MatchOption(arg, "--timing-predictor-entries", &value)) {
+            if (!ParseSize(value, &options->timing.predictor_entries) 
+                || !std::has_single_bit(options->timing.predictor_entries)) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_timing_enabled = true;
+        } else if (MatchOption(arg, "--timing-mispredict-penalty", &value)) {
+            if (!ParseSize(value, &options->timing.mispredict_penalty)) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_timing_enabled = true;
+        } else if (MatchOption(arg, "--timing-latency", &value)) {
+            if (!ParseLatencies(value, &options->timing)) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_timing_enabled = true;
+        } else if (MatchOption(arg, "--timing-report", &value)) {
+            if (value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->timing_report_path = value;
+        } else if (MatchOption(arg, "--no-fusion", &value)) {
+            if (!value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_fusion_enabled = false;
+        } else if (MatchOption(arg, "--fusion-stats", &value)) {
+            options->fusion_report_path = value.empty() ? "-" : value;
+        } else if (MatchOption(arg, "--no-block-opt", &value)) {
+            if (!value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_block_opt_enabled = false;
+        } else if (MatchOption(arg, "--check-block-opt", &value)) {
+            if (!value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_block_opt_checked = true;
+        } else if (MatchOption(arg, "--check-mem-trace", &value)) {
+            if (!value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_mem_trace_checked = true;
+        } else if (MatchOption(arg, "--no-loop-idioms", &value)) {
+            if (!value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_loop_idiom_enabled = false;
+        } else if (MatchOption(arg, "--no-preform", &value)) {
+            if (!value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->is_preform_enabled = false;
+        } else if (MatchOption(arg, "--dump-cfg", &value)) {
+            if (value.empty()) {
+                return OptionsError::kBadOptionValue;
+            }
+
+            options->cfg_dump_path = value;
+        } else if (MatchOption(arg, "--host-perf", &value)) {
+            options->host_perf_path = value.empty() ? "-" : value;
+        } else if (MatchOption(arg, "--io", &value)) {
+            if (value == "sync") {
+                options->io_backend = IoBackendKind::kSync;
+            } else if (value == "uring") {
+                options->io_backend = IoBackendKind::kUring;
+            } else {
+                spdlog::error("Unknown io backend: {}", value);
+                return OptionsError::kBadOptionValue;
+            }
+        } else if (MatchOption(arg, "--hle", &value)) {
+            if (value.empty() || !ResolveHleRoutines(value, &options->hle_routines)) {
+                return OptionsError::kBadOptionValue;
+            }
+        } else if (MatchOption(arg, "--vlen", &value)) {
+            if (!ParseSize(value, &options->vlen) || (options->vlen != kMinVlen && options->vlen != kMaxVlen)) {
+                spdlog::error("Unsupported vector length: {}", value);
+                return OptionsError::kBadOptionValue;
+            }
+        } else if (MatchOption(arg, "--lanes", &value)) {
+            if (!ParseSize(value, &options->n_lanes) || options->n_lanes == 0 || options->n_lanes > kMaxLanes) {
+                spdlog::error("Unsupported number of lanes: {}", value);
+                return OptionsError::kBadOptionValue;
+            }
+        } else if (MatchOption(arg, "--first-hart", &value)) {
+            if (!ParseSize(value, &options->first_hart)) {
+                return OptionsError::kBadOptionValue;
+            }
+        } else {
+            spdlog::error("Unknown option: {}", arg);
+            return OptionsError::kUnknownOption;
+        }
+    }
+
+    if (options->executable_path.empty()) {
+        return OptionsError::kNoExecutable;
+    }
+
+    return OptionsError::kOk;
+}
+
+const char* OptionsErrorToStr(OptionsError error) {
+    switch (error) {
+        case OptionsError::kOk:             return "no error";
+        case OptionsError::kNoExecutable:   return "executable file was not passed";
+        case OptionsError::kUnknownOption:  return "unknown option";
+        case OptionsError::kBadOptionValue: return "bad option value";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+void PrintUsage(const char* program_name) {
+    std::cerr << "Usage: " << program_name << " [options] <executable>\n"
+              << "Options:\n"
+              << "  --branch-profile=<file>          dump taken branch edges for guest pgo\n"
+              << "  --branch-profile-format=<fmt>    autofdo (default) or llvm\n"
+              << "  --cache                          enable cache model with default l1i/l1d/l2\n"
+              << "  --cache-l1i=<size:ways:line[:policy]>\n"
+              << "  --cache-l1d=<size:ways:line[:policy]>\n"
+              << "  --cache-l2=<size:ways:line[:policy]>\n"
+              << "                                   configure cache level, policy is lru, fifo or random\n"
+              << "  --cache-report=<file>            write cache report to file instead of stderr\n"
+              << "  --mem-trace=<file>               record compressed trace of guest fetches, loads and stores\n"
+              << "  --check-mem-trace                read memory trace back after run and compare with recorded accesses\n"
+              << "  --mem-profile[=<file>]           report stack distances and page heat map as json to stderr or file\n"
+              << "  --timing                         enable 5-stage in-order pipeline timing model\n"
+              << "  --timing-predictor=<kind>        static, bimodal (default) or gshare\n"
+              << "  --timing-predictor-entries=<n>   number of predictor counters, power of two\n"
+              << "  --timing-mispredict-penalty=<n>  cycles lost on mispredicted branch\n"
+              << "  --timing-latency=<mnem:n,...>    result latency of instructions, e.g. lw:3,add:1\n"
+              << "  --timing-report=<file>           write timing report to file instead of stderr\n"
+              << "  --no-fusion                      do not fuse instruction pairs in decoded blocks\n"
+              << "  --fusion-stats[=<file>]          report fused pairs to stderr or file\n"
+              << "  --no-block-opt                   execute lifted blocks without optimization\n"
+              << "  --check-block-opt                compare every block against unoptimized execution\n"
+              << "  --no-loop-idioms                 do not run copy/fill/compare loops as host operations\n"
+              << "  --no-preform                     do not build and link blocks of recovered control flow graph before run\n"
+              << "  --dump-cfg=<file>                write recovered control flow graph in graphviz format\n"
+              << "  --host-perf[=<file>]             report host perf counters of the run as json to stderr or file\n"
+              << "  --io=<backend>                   sync (default) or uring guest file i/o\n"
+              << "  --hle=<routine|group,...>        run guest libc/libgcc routines on host, e.g. memcpy,__divsi3 or libc,libgcc\n"
+              << "  --vlen=<bits>                    vector register length, 128 (default) or 256\n"
+              << "  --lanes=<n>                      run n (up to 16) instances of rv32i program in lockstep\n"
+              << "  --first-hart=<n>                 mhartid of the guest or of the first lockstep lane, 0 by default\n"
+              << "  --predecode-cache[=<dir>]        keep decoded blocks between runs next to executable or in dir\n"
+              << "  --aot=<module.so>                run code translated by rv2cpp, interpreter runs the rest\n"
+              << "  --result-cache=<dir>             replay results of identical runs (binary, options, stdin) from dir\n"
+              << "  --result-cache-size=<size>       size limit of result cache, 256m by default\n";
+}
+
+// static ---------------------------------------------------------------------
+
+// accepts both "--name=value" and "--name" (value is empty then)
+static bool MatchOption(std::string_view arg, std::string_view name, std::string_view* value) {
+    assert(value != nullptr);
+
+    if (!arg.starts_with(name)) {
+        return false;
+    }
+
+    std::string_view rest = arg.substr(name.size());
+    if (rest.empty()) {
+        *value = {};
+        return true;
+    }
+
+    if (rest.front() != '=') {
+        return false;
+    }
+
+    *value = rest.substr(1);
+    return true;
+}
+
+// accepts plain number of bytes or number with k/m suffix
+static bool ParseSize(std::string_view str, size_t* size) {
+    assert(size != nullptr);
+
+    size_t multiplier = 1;
+    if (str.ends_with('k') || str.ends_with('K')) {
+        multiplier = 1024;
+        str.remove_suffix(1);
+    } else if (str.ends_with('m') || str.ends_with('M')) {
+        multiplier = 1024 * 1024;
+        str.remove_suffix(1);
+    }
+
+    size_t number = 0;
+    auto [end, err] = std::from_chars(str.data(), str.data() + str.size(), number);
+    if (err != std::errc{} || end != str.data() + str.size()) {
+        return false;
+    }
+
+    *size = number * multiplier;
+    return true;
+}
+
+// <size>:<associativity>:<line size>[:<policy>]
+static bool ParseCacheConfig(std::string_view str, CacheConfig* config) {
+    assert(config != nullptr);
+
+    std::string_view fields[4] = {};
+    size_t n_fields = 0;
+    while (n_fields < 4) {
+        size_t delim = str.find(':');
+        fields[n_fields++] = str.substr(0, delim);
+        if (delim == std::string_view::npos) {
+            break;
+        }
+        str.remove_prefix(delim + 1);
+    }
+
+    if (n_fields < 3) {
+        spdlog::error("Cache config needs at least size, associativity and line size");
+        return false;
+    }
+
+    CacheConfig new_config = *config;
+    if (!ParseSize(fields[0], &new_config.size) 
+        || !ParseSize(fields[1], &new_config.associativity) 
+        || !ParseSize(fields[2], &new_config.line_size)) {
+        return false;
+    }
+
+    if (n_fields == 4) {
+        if (fields[3] == "lru") {
+            new_config.policy = ReplacementPolicy::kLru;
+        } else if (fields[3] == "fifo") {
+            new_config.policy = ReplacementPolicy::kFifo;
+        } else if (fields[3] == "random") {
+            new_config.policy = ReplacementPolicy::kRandom;
+        } else {
+            spdlog::error("Unknown replacement policy: {}", fields[3]);
+            return false;
+        }
+    }
+
+    if (!IsValidCacheConfig(new_config)) {
+        spdlog::error("Cache size, associativity and line size must be powers of two");
+        return false;
+    }
+
+    *config = new_config;
+    return true;
+}
+
+// <mnemonic>:<cycles>[,<mnemonic>:<cycles>...]
+static bool ParseLatencies(std::string_view str, TimingConfig* config) {
+    assert(config != nullptr);
+
+    while (!str.empty()) {
+        size_t delim = str.find(',');
+        std::string_view entry = str.substr(0, delim);
+        str.remove_prefix(delim == std::string_view::npos ? str.size() : delim + 1);
+
+        size_t colon = entry.find(':');
+        if (colon == std::string_view::npos) {
+            return false;
+        }
+
+        std::string_view mnemonic_name = entry.substr(0, colon);
+        size_t latency = 0;
+        if (!ParseSize(entry.substr(colon + 1), &latency) || latency == 0 || latency > UINT8_MAX) {
+            return false;
+        }
+
+        bool is_found = false;
+        for (size_t mnem_i = 1; mnem_i < static_cast<size_t>(InstructionMnemonic::kNMnemonics); mnem_i++) {
+            if (mnemonic_name == InstructionMnemonicToStr(static_cast<InstructionMnemonic>(mnem_i))) {
+                config->latencies[mnem_i] = static_cast<uint8_t>(latency);
+                is_found = true;
+                break;
+            }
+        }
+
+        if (!is_found) {
+            spdlog::error("Unknown instruction in latency table: {}", mnemonic_name);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace sim
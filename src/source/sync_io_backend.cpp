@@ -0,0 +1,32 @@
+#include "sync_io_backend.hpp"
+
+#include <cerrno>
+
+#include <unistd.h>
+
+#include "log_helper.hpp"
+
+namespace sim {
+
+ssize_t SyncIoBackend::Read(const int fd, uint8_t* buffer, const size_t size) {
+    LogFunctionEntry();
+
+    ssize_t n_read = read(fd, buffer, size);
+    return n_read < 0 ? -errno : n_read;
+}
+
+ssize_t SyncIoBackend::Write(const int fd, const uint8_t* buffer, const size_t size) {
+    LogFunctionEntry();
+
+    ssize_t n_written = write(fd, buffer, size);
+    return n_written < 0 ? -errno : n_written;
+}
+
+off_t SyncIoBackend::Seek(const int fd, const off_t offset, const int whence) {
+    LogFunctionEntry();
+
+    off_t new_offset = lseek(fd, offset, whence);
+    return new_offset < 0 ? -errno : new_offset;
+}
+
+} // namespace sim
@@ -0,0 +1,614 @@
+#include "syscall_handler.hpp"
+
+#include <cassert>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "log_helper.hpp"
+
+#include "cpu_defs.hpp"
+#include "imemory.hpp"
+#include "sim_cfg.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+// newlib sys/_default_fcntl.h
+enum GuestOpenFlags : Register {
+    kGuestAccessMask = 0x0003,
+    kGuestAppend     = 0x0008,
+    kGuestCreat      = 0x0200,
+    kGuestTrunc      = 0x0400,
+    kGuestExcl       = 0x0800,
+    kGuestSync       = 0x2000,
+    kGuestNonblock   = 0x4000,
+};
+
+static const Register kGuestAtFdcwd = static_cast<Register>(-100);
+
+// newlib sys/errno.h, values up to ERANGE are the same as linux ones
+enum GuestErrno : Register {
+    kGuestEio             = 5,
+    kGuestErange          = 34,
+    kGuestEnomsg          = 35,
+    kGuestEidrm           = 36,
+    kGuestEdeadlk         = 45,
+    kGuestEnolck          = 46,
+    kGuestEnostr          = 60,
+    kGuestEnodata         = 61,
+    kGuestEtime           = 62,
+    kGuestEnosr           = 63,
+    kGuestEnolink         = 67,
+    kGuestEproto          = 71,
+    kGuestEmultihop       = 74,
+    kGuestEbadmsg         = 77,
+    kGuestEnosys          = 88,
+    kGuestEnotempty       = 90,
+    kGuestEnametoolong    = 91,
+    kGuestEloop           = 92,
+    kGuestEopnotsupp      = 95,
+    kGuestEconnreset      = 104,
+    kGuestEnobufs         = 105,
+    kGuestEnotsock        = 108,
+    kGuestEconnrefused    = 111,
+    kGuestEaddrinuse      = 112,
+    kGuestEtimedout       = 116,
+    kGuestEinprogress     = 119,
+    kGuestEalready        = 120,
+    kGuestEdquot          = 132,
+    kGuestEstale          = 133,
+    kGuestEilseq          = 138,
+    kGuestEoverflow       = 139,
+    kGuestEcanceled       = 140,
+};
+
+// newlib clockid_t values, CLOCK_MONOTONIC differs from linux one
+enum GuestClockIds : Register {
+    kGuestClockRealtime        = 0,
+    kGuestClockLinuxMonotonic  = 1,
+    kGuestClockProcessCputime  = 2,
+    kGuestClockThreadCputime   = 3,
+    kGuestClockMonotonic       = 4,
+};
+
+// libgloss/riscv/kernel_stat.h for rv32 with 64-bit time_t
+static const size_t kGuestStatSize         = 128;
+static const size_t kGuestStatDevOffset    = 0;
+static const size_t kGuestStatInoOffset    = 8;
+static const size_t kGuestStatModeOffset   = 16;
+static const size_t kGuestStatNlinkOffset  = 20;
+static const size_t kGuestStatUidOffset    = 24;
+static const size_t kGuestStatGidOffset    = 28;
+static const size_t kGuestStatRdevOffset   = 32;
+static const size_t kGuestStatSizeOffset   = 48;
+static const size_t kGuestStatBlkszOffset  = 56;
+static const size_t kGuestStatBlocksOffset = 64;
+static const size_t kGuestStatAtimOffset   = 72;
+static const size_t kGuestStatMtimOffset   = 88;
+static const size_t kGuestStatCtimOffset   = 104;
+
+// timespec and timeval: 64-bit seconds followed by 32-bit fraction
+static const size_t kGuestTimeSize           = 16;
+static const size_t kGuestTimeFractionOffset = 8;
+
+static const size_t kGuestIovecSize = 2 * sizeof(Register);
+
+static Register ErrnoToRet(const int error);
+static int ToHostOpenFlags(const Register guest_flags);
+static void StoreGuest32(uint8_t* guest_ptr, const uint32_t value);
+static void StoreGuest64(uint8_t* guest_ptr, const uint64_t value);
+static void StoreGuestTime(uint8_t* guest_ptr, const int64_t seconds, const uint32_t fraction);
+
+// SyscallHandler private -----------------------------------------------------
+
+int SyscallHandler::GetHostFd(const Register guest_fd) const {
+    if (guest_fd >= host_fds_.size()) {
+        return kClosedFd;
+    }
+
+    return host_fds_[guest_fd];
+}
+
+Register SyscallHandler::AddGuestFd(const int host_fd) {
+    for (size_t guest_fd = 0; guest_fd < host_fds_.size(); guest_fd++) {
+        if (host_fds_[guest_fd] == kClosedFd) {
+            host_fds_[guest_fd] = host_fd;
+            return static_cast<Register>(guest_fd);
+        }
+    }
+
+    host_fds_.push_back(host_fd);
+    return static_cast<Register>(host_fds_.size() - 1);
+}
+
+Register SyscallHandler::Openat(const Register dir_fd, const Register path, const Register flags, const Register mode) {
+    LogFunctionEntry();
+
+    is_nondeterministic_ = true;
+
+    int host_dir_fd = AT_FDCWD;
+    if (dir_fd != kGuestAtFdcwd) {
+        host_dir_fd = GetHostFd(dir_fd);
+        if (host_dir_fd == kClosedFd) {
+            return ErrnoToRet(EBADF);
+        }
+    }
+
+    // path has to be terminated inside of guest memory
+    uint8_t* host_path = memory_->GetHostRange(path, 0);
+    if (host_path == nullptr
+        || std::memchr(host_path, '\0', memory_->GetMemorySize() - path) == nullptr) {
+        return ErrnoToRet(EFAULT);
+    }
+
+    // file may be truncated or read by the new fd, deferred writes land before that
+    io_backend_->Flush();
+
+    int host_fd = openat(host_dir_fd, reinterpret_cast<const char*>(host_path), ToHostOpenFlags(flags), mode);
+    if (host_fd < 0) {
+        return ErrnoToRet(errno);
+    }
+
+    spdlog::debug("Opened {} as host fd {}", reinterpret_cast<const char*>(host_path), host_fd);
+
+    return AddGuestFd(host_fd);
+}
+
+Register SyscallHandler::Close(const Register guest_fd) {
+    LogFunctionEntry();
+
+    int host_fd = GetHostFd(guest_fd);
+    if (host_fd == kClosedFd) {
+        return ErrnoToRet(EBADF);
+    }
+
+    // fd is closed even if its deferred writes failed, as host close does
+    host_fds_[guest_fd] = kClosedFd;
+    int write_error = io_backend_->Sync(host_fd);
+
+    // simulator keeps its own standard streams
+    if (host_fd > DefaultDesriptors::kStderr && close(host_fd) != 0 && write_error == 0) {
+        write_error = -errno;
+    }
+
+    return write_error == 0 ? 0 : ErrnoToRet(-write_error);
+}
+
+Register SyscallHandler::Lseek(const Register guest_fd, const Register offset, const Register whence) {
+    LogFunctionEntry();
+
+    int host_fd = GetHostFd(guest_fd);
+    if (host_fd == kClosedFd) {
+        return ErrnoToRet(EBADF);
+    }
+
+    off_t new_offset = io_backend_->Seek(host_fd, static_cast<IRegister>(offset), static_cast<int>(whence));
+    return new_offset < 0 ? ErrnoToRet(static_cast<int>(-new_offset)) : static_cast<Register>(new_offset);
+}
+
+Register SyscallHandler::Read(const Register guest_fd, const Register buffer, const Register size) {
+    LogFunctionEntry();
+
+    int host_fd = GetHostFd(guest_fd);
+    if (host_fd == kClosedFd) {
+        return ErrnoToRet(EBADF);
+    }
+
+    uint8_t* host_buffer = memory_->GetHostRange(buffer, size);
+    if (host_buffer == nullptr) {
+        return ErrnoToRet(EFAULT);
+    }
+
+    ssize_t n_bytes = io_backend_->Read(host_fd, host_buffer, size);
+    if (n_bytes < 0) {
+        return ErrnoToRet(static_cast<int>(-n_bytes));
+    }
+
+    memory_->NotifyHostWrite(buffer, static_cast<size_t>(n_bytes));
+    return static_cast<Register>(n_bytes);
+}
+
+Register SyscallHandler::Write(const Register guest_fd, const Register buffer, const Register size) {
+    LogFunctionEntry();
+
+    int host_fd = GetHostFd(guest_fd);
+    if (host_fd == kClosedFd) {
+        return ErrnoToRet(EBADF);
+    }
+
+    uint8_t* host_buffer = memory_->GetHostRange(buffer, size);
+    if (host_buffer == nullptr) {
+        return ErrnoToRet(EFAULT);
+    }
+
+    ssize_t n_bytes = io_backend_->Write(host_fd, host_buffer, size);
+    return n_bytes < 0 ? ErrnoToRet(static_cast<int>(-n_bytes)) : static_cast<Register>(n_bytes);
+}
+
+Register SyscallHandler::ReadvWritev(const Register guest_fd, const Register iov, const Register iov_count, const bool is_write) {
+    LogFunctionEntry();
+
+    int host_fd = GetHostFd(guest_fd);
+    if (host_fd == kClosedFd) {
+        return ErrnoToRet(EBADF);
+    }
+
+    if (iov_count > IOV_MAX) {
+        return ErrnoToRet(EINVAL);
+    }
+
+    uint8_t* guest_iov = memory_->GetHostRange(iov, iov_count * kGuestIovecSize);
+    if (guest_iov == nullptr) {
+        return ErrnoToRet(EFAULT);
+    }
+
+    // all ranges are validated before any of them is transferred
+    std::vector<iovec> host_iov(iov_count);
+    std::vector<Register> guest_bases(iov_count);
+    for (size_t iov_i = 0; iov_i < iov_count; iov_i++) {
+        Register guest_base = 0;
+        Register guest_size = 0;
+        std::memcpy(&guest_base, guest_iov + iov_i * kGuestIovecSize, sizeof(Register));
+        std::memcpy(&guest_size, guest_iov + iov_i * kGuestIovecSize + sizeof(Register), sizeof(Register));
+
+        uint8_t* host_base = memory_->GetHostRange(guest_base, guest_size);
+        if (host_base == nullptr) {
+            return ErrnoToRet(EFAULT);
+        }
+
+        host_iov[iov_i] = {.iov_base = host_base, .iov_len = guest_size};
+        guest_bases[iov_i] = guest_base;
+    }
+
+    // stops at the first short transfer as host readv/writev does
+    size_t n_bytes = 0;
+    for (size_t iov_i = 0; iov_i < iov_count; iov_i++) {
+        const iovec& iov = host_iov[iov_i];
+        uint8_t* iov_base = static_cast<uint8_t*>(iov.iov_base);
+        ssize_t ret = is_write ? io_backend_->Write(host_fd, iov_base, iov.iov_len)
+                               : io_backend_->Read(host_fd, iov_base, iov.iov_len);
+        if (ret < 0) {
+            return n_bytes == 0 ? ErrnoToRet(static_cast<int>(-ret)) : static_cast<Register>(n_bytes);
+        }
+
+        if (!is_write) {
+            memory_->NotifyHostWrite(guest_bases[iov_i], static_cast<size_t>(ret));
+        }
+
+        n_bytes += static_cast<size_t>(ret);
+        if (static_cast<size_t>(ret) < iov.iov_len) {
+            break;
+        }
+    }
+
+    return static_cast<Register>(n_bytes);
+}
+
+Register SyscallHandler::Fstat(const Register guest_fd, const Register stat) {
+    LogFunctionEntry();
+
+    // host inode numbers and file times
+    is_nondeterministic_ = true;
+
+    int host_fd = GetHostFd(guest_fd);
+    if (host_fd == kClosedFd) {
+        return ErrnoToRet(EBADF);
+    }
+
+    uint8_t* guest_stat = memory_->GetHostRange(stat, kGuestStatSize);
+    if (guest_stat == nullptr) {
+        return ErrnoToRet(EFAULT);
+    }
+
+    int write_error = io_backend_->Sync(host_fd);
+    if (write_error != 0) {
+        return ErrnoToRet(-write_error);
+    }
+
+    struct stat host_stat = {};
+    if (fstat(host_fd, &host_stat) != 0) {
+        return ErrnoToRet(errno);
+    }
+
+    // mode bits are the same for newlib and linux
+    std::memset(guest_stat, 0, kGuestStatSize);
+    memory_->NotifyHostWrite(stat, kGuestStatSize);
+    StoreGuest64(guest_stat + kGuestStatDevOffset,    host_stat.st_dev);
+    StoreGuest64(guest_stat + kGuestStatInoOffset,    host_stat.st_ino);
+    StoreGuest32(guest_stat + kGuestStatModeOffset,   host_stat.st_mode);
+    StoreGuest32(guest_stat + kGuestStatNlinkOffset,  static_cast<uint32_t>(host_stat.st_nlink));
+    StoreGuest32(guest_stat + kGuestStatUidOffset,    host_stat.st_uid);
+    StoreGuest32(guest_stat + kGuestStatGidOffset,    host_stat.st_gid);
+    StoreGuest64(guest_stat + kGuestStatRdevOffset,   host_stat.st_rdev);
+    StoreGuest64(guest_stat + kGuestStatSizeOffset,   static_cast<uint64_t>(host_stat.st_size));
+    StoreGuest32(guest_stat + kGuestStatBlkszOffset,  static_cast<uint32_t>(host_stat.st_blksize));
+    StoreGuest64(guest_stat + kGuestStatBlocksOffset, static_cast<uint64_t>(host_stat.st_blocks));
+    StoreGuestTime(guest_stat + kGuestStatAtimOffset, host_stat.st_atim.tv_sec, static_cast<uint32_t>(host_stat.st_atim.tv_nsec));
+    StoreGuestTime(guest_stat + kGuestStatMtimOffset, host_stat.st_mtim.tv_sec, static_cast<uint32_t>(host_stat.st_mtim.tv_nsec));
+    StoreGuestTime(guest_stat + kGuestStatCtimOffset, host_stat.st_ctim.tv_sec, static_cast<uint32_t>(host_stat.st_ctim.tv_nsec));
+
+    return 0;
+}
+
+Register SyscallHandler::ClockGettime(const Register clock_id, const Register timespec) {
+    LogFunctionEntry();
+
+    is_nondeterministic_ = true;
+
+    clockid_t host_clock_id = CLOCK_REALTIME;
+    switch (clock_id) {
+        case kGuestClockRealtime:       host_clock_id = CLOCK_REALTIME;           break;
+        case kGuestClockLinuxMonotonic:
+        case kGuestClockMonotonic:      host_clock_id = CLOCK_MONOTONIC;          break;
+        case kGuestClockProcessCputime: host_clock_id = CLOCK_PROCESS_CPUTIME_ID; break;
+        case kGuestClockThreadCputime:  host_clock_id = CLOCK_THREAD_CPUTIME_ID;  break;
+        default:
+            return ErrnoToRet(EINVAL);
+    }
+
+    uint8_t* guest_time = memory_->GetHostRange(timespec, kGuestTimeSize);
+    if (guest_time == nullptr) {
+        return ErrnoToRet(EFAULT);
+    }
+
+    struct timespec host_time = {};
+    if (clock_gettime(host_clock_id, &host_time) != 0) {
+        return ErrnoToRet(errno);
+    }
+
+    StoreGuestTime(guest_time, host_time.tv_sec, static_cast<uint32_t>(host_time.tv_nsec));
+    memory_->NotifyHostWrite(timespec, kGuestTimeSize);
+
+    return 0;
+}
+
+Register SyscallHandler::Gettimeofday(const Register timeval) {
+    LogFunctionEntry();
+
+    is_nondeterministic_ = true;
+
+    uint8_t* guest_time = memory_->GetHostRange(timeval, kGuestTimeSize);
+    if (guest_time == nullptr) {
+        return ErrnoToRet(EFAULT);
+    }
+
+    struct timespec host_time = {};
+    clock_gettime(CLOCK_REALTIME, &host_time);
+
+    const long kNsecInUsec = 1000;
+    StoreGuestTime(guest_time, host_time.tv_sec, static_cast<uint32_t>(host_time.tv_nsec / kNsecInUsec));
+    memory_->NotifyHostWrite(timeval, kGuestTimeSize);
+
+    return 0;
+}
+
+// returns new break on success and old one on failure, as linux does
+Register SyscallHandler::Brk(const Register new_break) {
+    LogFunctionEntry();
+
+    size_t break_limit = memory_->GetMemorySize() - kStackReserve;
+    if (new_break >= initial_break_ && new_break <= break_limit) {
+        program_break_ = new_break;
+    }
+
+    return program_break_;
+}
+
+SyscallError SyscallHandler::Dispatch(const Register syscall_id, const SyscallArgs& args, Register* ret_value) {
+    assert(ret_value != nullptr);
+
+    spdlog::trace("Syscall number: {}", syscall_id);
+
+    switch (syscall_id) {
+        case SyscallIds::kOpenat:         *ret_value = Openat(args[0], args[1], args[2], args[3]);            break;
+        case SyscallIds::kOpen:           *ret_value = Openat(kGuestAtFdcwd, args[0], args[1], args[2]);      break;
+        case SyscallIds::kClose:          *ret_value = Close(args[0]);                                        break;
+        case SyscallIds::kLseek:          *ret_value = Lseek(args[0], args[1], args[2]);                      break;
+        case SyscallIds::kRead:           *ret_value = Read(args[0], args[1], args[2]);                       break;
+        case SyscallIds::kWrite:          *ret_value = Write(args[0], args[1], args[2]);                      break;
+        case SyscallIds::kReadv:          *ret_value = ReadvWritev(args[0], args[1], args[2], false);         break;
+        case SyscallIds::kWritev:         *ret_value = ReadvWritev(args[0], args[1], args[2], true);          break;
+        case SyscallIds::kFstat:          *ret_value = Fstat(args[0], args[1]);                               break;
+        case SyscallIds::kClockGettime:
+        case SyscallIds::kClockGettime64: *ret_value = ClockGettime(args[0], args[1]);                        break;
+        case SyscallIds::kGettimeofday:   *ret_value = Gettimeofday(args[0]);                                 break;
+        case SyscallIds::kBrk:            *ret_value = Brk(args[0]);                                          break;
+        case SyscallIds::kExit:
+        case SyscallIds::kExitGroup: {
+            io_backend_->Flush();
+
+            is_exited_ = true;
+            exit_code_ = static_cast<int>(args[0]);
+            *ret_value = args[0];
+            spdlog::info("Guest exited with code {}", exit_code_);
+        }
+        break;
+        default:
+            spdlog::error("Unknown syscall {}", syscall_id);
+            *ret_value = ErrnoToRet(ENOSYS);
+            return SyscallError::kUnknownSyscall;
+    }
+
+    return SyscallError::kOk;
+}
+
+// SyscallHandler public ------------------------------------------------------
+
+void SyscallHandler::Init(IMemory* memory, IIoBackend* io_backend, const Address program_end) {
+    LogFunctionEntry();
+
+    assert(memory != nullptr);
+    assert(io_backend != nullptr);
+
+    memory_ = memory;
+    io_backend_ = io_backend;
+    host_fds_ = {DefaultDesriptors::kStdin, DefaultDesriptors::kStdout, DefaultDesriptors::kStderr};
+
+    const Address kBreakAlignment = 16;
+    initial_break_ = (program_end + kBreakAlignment - 1) & ~(kBreakAlignment - 1);
+    program_break_ = initial_break_;
+
+    is_exited_ = false;
+    exit_code_ = 0;
+    is_nondeterministic_ = false;
+
+    n_syscalls_ = 0;
+    is_timed_ = false;
+    syscall_time_ns_ = 0;
+}
+
+SyscallHandler::~SyscallHandler() {
+    for (int host_fd : host_fds_) {
+        if (host_fd > DefaultDesriptors::kStderr) {
+            io_backend_->Sync(host_fd);
+            close(host_fd);
+        }
+    }
+}
+
+SyscallError SyscallHandler::Handle(const Register syscall_id, const SyscallArgs& args, Register* ret_value) {
+    LogFunctionEntry();
+
+    assert(ret_value != nullptr);
+
+    n_syscalls_++;
+    if (!is_timed_) {
+        return Dispatch(syscall_id, args, ret_value);
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+    SyscallError err = Dispatch(syscall_id, args, ret_value);
+    syscall_time_ns_ += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_time).count();
+
+    return err;
+}
+
+bool SyscallHandler::GetIsExited() const {
+    return is_exited_;
+}
+
+int SyscallHandler::GetExitCode() const {
+    return exit_code_;
+}
+
+bool SyscallHandler::GetIsNondeterministic() const {
+    return is_nondeterministic_;
+}
+
+// clock is read around every syscall, so handler is timed only on request
+void SyscallHandler::SetIsTimed(bool is_timed) {
+    is_timed_ = is_timed;
+}
+
+uint64_t SyscallHandler::GetNSyscalls() const {
+    return n_syscalls_;
+}
+
+uint64_t SyscallHandler::GetSyscallTimeNs() const {
+    return syscall_time_ns_;
+}
+
+// global ---------------------------------------------------------------------
+
+const char* SyscallErrorToStr(SyscallError error) {
+    switch (error) {
+        case SyscallError::kOk:             return "no error";
+        case SyscallError::kUnknownSyscall: return "unknown syscall";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+// errno values below 35 are the same for newlib and linux
+// host errno to guest -errno, errors newlib has no number for become EIO
+static Register ErrnoToRet(const int error) {
+    if (error > 0 && error <= static_cast<int>(kGuestErange)) {
+        return static_cast<Register>(-error);
+    }
+
+    Register guest_error = kGuestEio;
+    switch (error) {
+        case ENOMSG:       guest_error = kGuestEnomsg;       break;
+        case EIDRM:        guest_error = kGuestEidrm;        break;
+        case EDEADLK:      guest_error = kGuestEdeadlk;      break;
+        case ENOLCK:       guest_error = kGuestEnolck;       break;
+        case ENOSTR:       guest_error = kGuestEnostr;       break;
+        case ENODATA:      guest_error = kGuestEnodata;      break;
+        case ETIME:        guest_error = kGuestEtime;        break;
+        case ENOSR:        guest_error = kGuestEnosr;        break;
+        case ENOLINK:      guest_error = kGuestEnolink;      break;
+        case EPROTO:       guest_error = kGuestEproto;       break;
+        case EMULTIHOP:    guest_error = kGuestEmultihop;    break;
+        case EBADMSG:      guest_error = kGuestEbadmsg;      break;
+        case ENOSYS:       guest_error = kGuestEnosys;       break;
+        case ENOTEMPTY:    guest_error = kGuestEnotempty;    break;
+        case ENAMETOOLONG: guest_error = kGuestEnametoolong; break;
+        case ELOOP:        guest_error = kGuestEloop;        break;
+        case EOPNOTSUPP:   guest_error = kGuestEopnotsupp;   break;
+        case ECONNRESET:   guest_error = kGuestEconnreset;   break;
+        case ENOBUFS:      guest_error = kGuestEnobufs;      break;
+        case ENOTSOCK:     guest_error = kGuestEnotsock;     break;
+        case ECONNREFUSED: guest_error = kGuestEconnrefused; break;
+        case EADDRINUSE:   guest_error = kGuestEaddrinuse;   break;
+        case ETIMEDOUT:    guest_error = kGuestEtimedout;    break;
+        case EINPROGRESS:  guest_error = kGuestEinprogress;  break;
+        case EALREADY:     guest_error = kGuestEalready;     break;
+        case EDQUOT:       guest_error = kGuestEdquot;       break;
+        case ESTALE:       guest_error = kGuestEstale;       break;
+        case EILSEQ:       guest_error = kGuestEilseq;       break;
+        case EOVERFLOW:    guest_error = kGuestEoverflow;    break;
+        case ECANCELED:    guest_error = kGuestEcanceled;    break;
+        default:
+            spdlog::warn("Host errno {} has no newlib value, returned as EIO", error);
+            break;
+    }
+
+    return static_cast<Register>(-static_cast<IRegister>(guest_error));
+}
+
+static int ToHostOpenFlags(const Register guest_flags) {
+    int host_flags = 0;
+
+    switch (guest_flags & kGuestAccessMask) {
+        case 0:  host_flags = O_RDONLY; break;
+        case 1:  host_flags = O_WRONLY; break;
+        default: host_flags = O_RDWR;   break;
+    }
+
+    if (guest_flags & kGuestAppend)   { host_flags |= O_APPEND;   }
+    if (guest_flags & kGuestCreat)    { host_flags |= O_CREAT;    }
+    if (guest_flags & kGuestTrunc)    { host_flags |= O_TRUNC;    }
+    if (guest_flags & kGuestExcl)     { host_flags |= O_EXCL;     }
+    if (guest_flags & kGuestSync)     { host_flags |= O_SYNC;     }
+    if (guest_flags & kGuestNonblock) { host_flags |= O_NONBLOCK; }
+
+    return host_flags;
+}
+
+// guest is little endian as the host
+static void StoreGuest32(uint8_t* guest_ptr, const uint32_t value) {
+    std::memcpy(guest_ptr, &value, sizeof(value));
+}
+
+static void StoreGuest64(uint8_t* guest_ptr, const uint64_t value) {
+    std::memcpy(guest_ptr, &value, sizeof(value));
+}
+
+static void StoreGuestTime(uint8_t* guest_ptr, const int64_t seconds, const uint32_t fraction) {
+    StoreGuest64(guest_ptr, static_cast<uint64_t>(seconds));
+    StoreGuest32(guest_ptr + kGuestTimeFractionOffset, fraction);
+}
+
+} // namespace sim
@@ -0,0 +1,75 @@
+#include "timer.hpp"
+
+#include <cassert>
+#include <climits>
+
+#include "log_helper.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+// registers are 64 bit, halves and bytes of them may be accessed too
+static uint64_t ReadPart(const uint64_t value, const MemAddress shift, const size_t size);
+static uint64_t WritePart(const uint64_t value, const uint64_t data, const MemAddress shift, const size_t size);
+
+// Timer private --------------------------------------------------------------
+
+uint64_t Timer::GetTime() const {
+    return *n_retired_instrs_ + time_offset_;
+}
+
+// Timer public ---------------------------------------------------------------
+
+void Timer::Init(const uint64_t* n_retired_instrs) {
+    LogFunctionEntry();
+
+    assert(n_retired_instrs != nullptr);
+
+    n_retired_instrs_ = n_retired_instrs;
+    time_offset_ = 0;
+    mtimecmp_ = UINT64_MAX;
+}
+
+const char* Timer::GetName() const {
+    return "timer";
+}
+
+size_t Timer::GetSize() const {
+    return kSize;
+}
+
+uint64_t Timer::Read(const MemAddress offset, const size_t size) {
+    if (offset - kMtimeOffset < sizeof(uint64_t)) {
+        return ReadPart(GetTime(), offset - kMtimeOffset, size);
+    }
+
+    if (offset - kMtimecmpOffset < sizeof(uint64_t)) {
+        return ReadPart(mtimecmp_, offset - kMtimecmpOffset, size);
+    }
+
+    return 0;
+}
+
+void Timer::Write(const uint64_t data, const MemAddress offset, const size_t size) {
+    if (offset - kMtimeOffset < sizeof(uint64_t)) {
+        time_offset_ = WritePart(GetTime(), data, offset - kMtimeOffset, size) - *n_retired_instrs_;
+    } else if (offset - kMtimecmpOffset < sizeof(uint64_t)) {
+        mtimecmp_ = WritePart(mtimecmp_, data, offset - kMtimecmpOffset, size);
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+static uint64_t ReadPart(const uint64_t value, const MemAddress shift, const size_t size) {
+    uint64_t part = value >> (shift * CHAR_BIT);
+    return size >= sizeof(uint64_t) ? part : part & ((uint64_t{1} << (size * CHAR_BIT)) - 1);
+}
+
+static uint64_t WritePart(const uint64_t value, const uint64_t data, const MemAddress shift, const size_t size) {
+    uint64_t mask = size >= sizeof(uint64_t) ? UINT64_MAX : (uint64_t{1} << (size * CHAR_BIT)) - 1;
+    mask <<= shift * CHAR_BIT;
+    return (value & ~mask) | ((data << (shift * CHAR_BIT)) & mask);
+}
+
+} // namespace sim
@@ -0,0 +1,85 @@
+#include "uart.hpp"
+
+#include <cassert>
+#include <unistd.h>
+
+#include "log_helper.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+static const size_t kUartSize = 0x100;
+
+enum UartRegister {
+    kRbrThr = 0, // receive buffer / transmit holding
+    kIer    = 1,
+    kIirFcr = 2, // interrupt identification / fifo control
+    kLcr    = 3,
+    kMcr    = 4,
+    kLsr    = 5,
+    kMsr    = 6,
+    kScr    = 7,
+};
+
+static const uint8_t kLcrDlab = 1u << 7;     // divisor latch is at 0 and 1
+static const uint8_t kIirNoInterrupt = 1u << 0;
+static const uint8_t kLsrThrEmpty = 1u << 5;
+static const uint8_t kLsrTransmitterEmpty = 1u << 6;
+
+// Uart public ----------------------------------------------------------------
+
+void Uart::Init(IIoBackend* io_backend) {
+    LogFunctionEntry();
+
+    assert(io_backend != nullptr);
+
+    io_backend_ = io_backend;
+    registers_ = {};
+}
+
+const char* Uart::GetName() const {
+    return "uart";
+}
+
+size_t Uart::GetSize() const {
+    return kUartSize;
+}
+
+// registers are byte wide, wider accesses see the addressed one
+uint64_t Uart::Read(const MemAddress offset, const size_t /*size*/) {
+    if (offset >= kNRegisters) {
+        return 0;
+    }
+
+    switch (offset) {
+        case kRbrThr:
+            return (registers_[kLcr] & kLcrDlab) != 0 ? registers_[kRbrThr] : 0;
+        case kIirFcr:
+            return kIirNoInterrupt;
+        case kLsr:
+            return kLsrThrEmpty | kLsrTransmitterEmpty;
+        case kMsr:
+            return 0;
+        default:
+            return registers_[offset];
+    }
+}
+
+void Uart::Write(const uint64_t data, const MemAddress offset, const size_t /*size*/) {
+    if (offset >= kNRegisters) {
+        return ;
+    }
+
+    const uint8_t byte = static_cast<uint8_t>(data);
+    if (offset == kRbrThr && (registers_[kLcr] & kLcrDlab) == 0) {
+        if (io_backend_->Write(STDOUT_FILENO, &byte, sizeof(byte)) < 0) {
+            spdlog::warn("Uart output is lost");
+        }
+        return ;
+    }
+
+    registers_[offset] = byte;
+}
+
+} // namespace sim
@@ -0,0 +1,644 @@
+#include "uring_io_backend.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#if defined(SIM_HAS_IO_URING)
+#include <linux/io_uring.h>
+#endif // SIM_HAS_IO_URING
+
+#include "log_helper.hpp"
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+#if defined(SIM_HAS_IO_URING)
+
+static ssize_t WriteAll(const int fd, const uint8_t* buffer, const size_t size);
+
+// liburing is not required: rings are driven by raw syscalls
+static int IoUringSetup(const unsigned entries, io_uring_params* params);
+static int IoUringEnter(const int ring_fd, const unsigned to_submit, const unsigned min_complete, const unsigned flags);
+
+// UringIoBackend private -----------------------------------------------------
+
+// nullptr if ring is full and can not be entered any more
+io_uring_sqe* UringIoBackend::GetSqe() {
+    unsigned tail = *sq_tail_;
+    unsigned head = std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire);
+    if (tail - head == *sq_entries_) {
+        Enter(0);
+        head = std::atomic_ref<unsigned>(*sq_head_).load(std::memory_order_acquire);
+        if (tail - head == *sq_entries_) {
+            assert(ring_error_ != 0);
+            return nullptr;
+        }
+    }
+
+    unsigned index = tail & *sq_mask_;
+    sq_array_[index] = index;
+
+    io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+
+    return sqe;
+}
+
+void UringIoBackend::PushSqe() {
+    std::atomic_ref<unsigned>(*sq_tail_).store(*sq_tail_ + 1, std::memory_order_release);
+    n_unsubmitted_++;
+}
+
+// kernel is short of memory or completions are not reaped yet, the same enter may succeed later
+void UringIoBackend::Enter(const unsigned min_complete) {
+    if (ring_error_ != 0) {
+        return;
+    }
+
+    unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+
+    int n_submitted = IoUringEnter(ring_fd_, n_unsubmitted_, min_complete, flags);
+    n_host_syscalls_++;
+    if (n_submitted < 0) {
+        if (n_submitted != -EAGAIN && n_submitted != -EBUSY) {
+            spdlog::error("io_uring_enter failed: {}, falling back to blocking i/o", std::strerror(-n_submitted));
+            ring_error_ = n_submitted;
+        }
+        return;
+    }
+
+    n_unsubmitted_ -= std::min(n_unsubmitted_, static_cast<unsigned>(n_submitted));
+}
+
+void UringIoBackend::ReapCompletions() {
+    unsigned head = *cq_head_;
+    unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(std::memory_order_acquire);
+
+    while (head != tail) {
+        const io_uring_cqe& cqe = cqes_[head & *cq_mask_];
+        Complete(cqe.user_data, cqe.res);
+        head++;
+    }
+
+    std::atomic_ref<unsigned>(*cq_head_).store(head, std::memory_order_release);
+}
+
+// requests failed by FailInFlight() may still complete, their results are dropped
+void UringIoBackend::Complete(const uint64_t user_data, const int32_t result) {
+    if (user_data & kReadTag) {
+        int fd = static_cast<int>(user_data & ~kReadTag);
+        auto read_ahead_it = read_aheads_.find(fd);
+        if (read_ahead_it == read_aheads_.end() || !read_ahead_it->second.is_in_flight) {
+            return;
+        }
+
+        ReadAhead& read_ahead = read_ahead_it->second;
+        read_ahead.is_in_flight = false;
+        if (result > 0) {
+            read_ahead.end = static_cast<size_t>(result);
+            read_ahead.file_offset += result;
+        } else if (result == 0) {
+            read_ahead.is_eof = true;
+        } else {
+            read_ahead.error = result;
+        }
+
+        return;
+    }
+
+    WriteBatch& batch = batches_[user_data >> 32];
+    if (batch.n_in_flight == 0) {
+        return;
+    }
+    batch.writes[user_data & UINT32_MAX].result = result;
+    batch.n_in_flight--;
+}
+
+// requests ring will never complete get ring_error_ as their result
+void UringIoBackend::FailInFlight() {
+    assert(ring_error_ != 0);
+
+    for (WriteBatch& batch : batches_) {
+        if (batch.n_in_flight == 0) {
+            continue;
+        }
+
+        for (PendingWrite& write : batch.writes) {
+            if (write.result == 0) {
+                write.result = ring_error_;
+            }
+        }
+        batch.n_in_flight = 0;
+    }
+
+    for (auto& [fd, read_ahead] : read_aheads_) {
+        if (read_ahead.is_in_flight) {
+            read_ahead.is_in_flight = false;
+            read_ahead.error = ring_error_;
+        }
+    }
+}
+
+template <typename Predicate>
+int UringIoBackend::WaitUntil(Predicate is_done) {
+    ReapCompletions();
+    while (!is_done()) {
+        if (ring_error_ != 0) {
+            FailInFlight();
+            return ring_error_;
+        }
+
+        Enter(1);
+        ReapCompletions();
+    }
+
+    return 0;
+}
+
+// writes are linked to keep their order, batch is drained after the previous one,
+// "-1" offset writes at file position
+void UringIoBackend::SubmitBatch(const size_t batch_i) {
+    LogFunctionEntry();
+
+    WriteBatch& batch = batches_[batch_i];
+    assert(batch.n_in_flight == 0);
+
+    for (size_t write_i = 0; write_i < batch.writes.size(); write_i++) {
+        PendingWrite& write = batch.writes[write_i];
+
+        // writes after a broken chain would land out of order, so they fail as well
+        io_uring_sqe* sqe = ring_error_ == 0 ? GetSqe() : nullptr;
+        if (sqe == nullptr) {
+            for (size_t failed_i = write_i; failed_i < batch.writes.size(); failed_i++) {
+                batch.writes[failed_i].result = ring_error_;
+            }
+            break;
+        }
+
+        sqe->opcode = IORING_OP_WRITE;
+        sqe->fd = write.fd;
+        sqe->addr = reinterpret_cast<uint64_t>(batch.data.data() + write.offset);
+        sqe->len = static_cast<uint32_t>(write.size);
+        sqe->off = static_cast<uint64_t>(-1);
+        sqe->flags = write_i + 1 < batch.writes.size() ? IOSQE_IO_LINK : 0;
+        if (write_i == 0) {
+            sqe->flags |= IOSQE_IO_DRAIN;
+        }
+        sqe->user_data = (static_cast<uint64_t>(batch_i) << 32) | write_i;
+        PushSqe();
+        batch.n_in_flight++;
+    }
+
+    if (batch.n_in_flight != 0) {
+        Enter(0);
+    }
+}
+
+// short write breaks the chain, so the rest of batch is redone in order
+void UringIoBackend::WaitBatch(const size_t batch_i) {
+    LogFunctionEntry();
+
+    WriteBatch& batch = batches_[batch_i];
+    WaitUntil([&batch]{ return batch.n_in_flight == 0; });
+
+    for (const PendingWrite& write : batch.writes) {
+        size_t n_written = write.result > 0 ? static_cast<size_t>(write.result) : 0;
+        int error = write.result < 0 && write.result != -ECANCELED ? static_cast<int>(write.result) : 0;
+        if (error == 0 && n_written < write.size) {
+            n_host_syscalls_++;
+            if (WriteAll(write.fd, batch.data.data() + write.offset + n_written, write.size - n_written) < 0) {
+                error = -errno;
+            }
+        }
+
+        if (error != 0) {
+            spdlog::error("Deferred write to fd {} failed: {}", write.fd, std::strerror(-error));
+            write_errors_.emplace(write.fd, error);
+        }
+    }
+
+    batch.data.clear();
+    batch.writes.clear();
+}
+
+void UringIoBackend::FlushWrites() {
+    LogFunctionEntry();
+
+    size_t other_batch = (current_batch_ + 1) % kNBatches;
+    WaitBatch(other_batch);
+
+    if (!batches_[current_batch_].writes.empty()) {
+        SubmitBatch(current_batch_);
+        WaitBatch(current_batch_);
+    }
+}
+
+int UringIoBackend::TakeWriteError(const int fd) {
+    auto error_it = write_errors_.find(fd);
+    if (error_it == write_errors_.end()) {
+        return 0;
+    }
+
+    int error = error_it->second;
+    write_errors_.erase(error_it);
+    return error;
+}
+
+bool UringIoBackend::HasPendingWrites(const int fd) const {
+    for (const WriteBatch& batch : batches_) {
+        for (const PendingWrite& write : batch.writes) {
+            if (write.fd == fd) {
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+UringIoBackend::ReadAhead& UringIoBackend::GetReadAhead(const int fd) {
+    auto read_ahead_it = read_aheads_.find(fd);
+    if (read_ahead_it != read_aheads_.end()) {
+        return read_ahead_it->second;
+    }
+
+    // pipes and terminals are not read ahead: guest may never want that data
+    struct stat fd_stat = {};
+    n_host_syscalls_++;
+    bool is_regular = fstat(fd, &fd_stat) == 0 && S_ISREG(fd_stat.st_mode);
+
+    ReadAhead read_ahead = {
+        .is_regular = is_regular,
+        .buffer = {},
+        .begin = 0,
+        .end = 0,
+        .file_offset = 0,
+        .is_in_flight = false,
+        .is_eof = false,
+        .error = 0,
+    };
+
+    if (is_regular) {
+        n_host_syscalls_++;
+        read_ahead.file_offset = lseek(fd, 0, SEEK_CUR);
+        read_ahead.buffer.resize(kReadAheadSize);
+    }
+
+    return read_aheads_.emplace(fd, std::move(read_ahead)).first->second;
+}
+
+void UringIoBackend::SubmitReadAhead(const int fd, ReadAhead* read_ahead) {
+    assert(read_ahead != nullptr);
+    assert(!read_ahead->is_in_flight);
+
+    read_ahead->begin = 0;
+    read_ahead->end = 0;
+    read_ahead->is_in_flight = true;
+
+    io_uring_sqe* sqe = ring_error_ == 0 ? GetSqe() : nullptr;
+    if (sqe == nullptr) {
+        n_host_syscalls_++;
+        ssize_t n_read = pread(fd, read_ahead->buffer.data(), read_ahead->buffer.size(), read_ahead->file_offset);
+        Complete(kReadTag | static_cast<uint64_t>(fd), n_read < 0 ? -errno : static_cast<int32_t>(n_read));
+        return;
+    }
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(read_ahead->buffer.data());
+    sqe->len = static_cast<uint32_t>(read_ahead->buffer.size());
+    sqe->off = static_cast<uint64_t>(read_ahead->file_offset);
+    sqe->user_data = kReadTag | static_cast<uint64_t>(fd);
+    PushSqe();
+
+    Enter(0);
+}
+
+// moves host file position to the one seen by guest and drops buffered data
+void UringIoBackend::ResetReadAhead(const int fd) {
+    auto read_ahead_it = read_aheads_.find(fd);
+    if (read_ahead_it == read_aheads_.end()) {
+        return;
+    }
+
+    ReadAhead& read_ahead = read_ahead_it->second;
+    if (read_ahead.is_regular) {
+        WaitUntil([&read_ahead]{ return !read_ahead.is_in_flight; });
+
+        off_t guest_offset = read_ahead.file_offset - static_cast<off_t>(read_ahead.end - read_ahead.begin);
+        n_host_syscalls_++;
+        lseek(fd, guest_offset, SEEK_SET);
+    }
+
+    read_aheads_.erase(read_ahead_it);
+}
+
+// UringIoBackend public ------------------------------------------------------
+
+IoBackendError UringIoBackend::Init() {
+    LogFunctionEntry();
+
+    io_uring_params params = {};
+    int ring_fd = IoUringSetup(kRingEntries, &params);
+    if (ring_fd < 0) {
+        spdlog::warn("io_uring_setup failed: {}", std::strerror(-ring_fd));
+        return IoBackendError::kSetupFailed;
+    }
+
+    if (!(params.features & IORING_FEAT_RW_CUR_POS)) {
+        close(ring_fd);
+        return IoBackendError::kUnsupported;
+    }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool is_single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (is_single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    cq_ring_ = is_single_mmap ? sq_ring_
+             : mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sq_ring_ == MAP_FAILED || cq_ring_ == MAP_FAILED || sqes == MAP_FAILED) {
+        spdlog::warn("io_uring ring mmap failed");
+        close(ring_fd);
+        return IoBackendError::kSetupFailed;
+    }
+
+    uint8_t* sq_ring = static_cast<uint8_t*>(sq_ring_);
+    uint8_t* cq_ring = static_cast<uint8_t*>(cq_ring_);
+    sq_head_    = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.head);
+    sq_tail_    = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.tail);
+    sq_mask_    = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_mask);
+    sq_entries_ = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.ring_entries);
+    sq_array_   = reinterpret_cast<unsigned*>(sq_ring + params.sq_off.array);
+    cq_head_    = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.head);
+    cq_tail_    = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.tail);
+    cq_mask_    = reinterpret_cast<unsigned*>(cq_ring + params.cq_off.ring_mask);
+    cqes_       = reinterpret_cast<io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+    sqes_       = static_cast<io_uring_sqe*>(sqes);
+    n_unsubmitted_ = 0;
+    ring_error_ = 0;
+
+    // batch data is never reallocated while its writes are in flight
+    for (WriteBatch& batch : batches_) {
+        batch.data.reserve(kBatchCapacity);
+        batch.writes.reserve(kMaxBatchWrites);
+        batch.n_in_flight = 0;
+    }
+    current_batch_ = 0;
+
+    n_guest_reads_ = 0;
+    n_guest_writes_ = 0;
+    n_host_syscalls_ = 0;
+
+    ring_fd_ = ring_fd;
+    spdlog::info("io_uring backend initialized, {} sq entries", params.sq_entries);
+
+    return IoBackendError::kOk;
+}
+
+UringIoBackend::~UringIoBackend() {
+    if (ring_fd_ < 0) {
+        return;
+    }
+
+    Flush();
+
+    spdlog::info("io_uring backend: {} guest reads, {} guest writes, {} host syscalls",
+                 n_guest_reads_, n_guest_writes_, n_host_syscalls_);
+
+    munmap(sqes_, sqes_size_);
+    if (cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    munmap(sq_ring_, sq_ring_size_);
+    close(ring_fd_);
+}
+
+ssize_t UringIoBackend::Read(const int fd, uint8_t* buffer, const size_t size) {
+    LogFunctionEntry();
+
+    n_guest_reads_++;
+
+    // file position is known only after writes to fd are done
+    if (HasPendingWrites(fd)) {
+        FlushWrites();
+    }
+
+    int write_error = TakeWriteError(fd);
+    if (write_error != 0) {
+        return write_error;
+    }
+
+    ReadAhead& read_ahead = GetReadAhead(fd);
+    if (!read_ahead.is_regular) {
+        // guest may wait for input after its prompt
+        FlushWrites();
+
+        n_host_syscalls_++;
+        ssize_t n_read = read(fd, buffer, size);
+        return n_read < 0 ? -errno : n_read;
+    }
+
+    if (read_ahead.begin == read_ahead.end && read_ahead.is_in_flight) {
+        WaitUntil([&read_ahead]{ return !read_ahead.is_in_flight; });
+    }
+
+    if (read_ahead.begin == read_ahead.end && !read_ahead.is_eof && read_ahead.error == 0) {
+        // big reads go straight to guest memory
+        if (size >= kReadAheadSize) {
+            n_host_syscalls_++;
+            ssize_t n_read = pread(fd, buffer, size, read_ahead.file_offset);
+            if (n_read < 0) {
+                return -errno;
+            }
+
+            read_ahead.file_offset += n_read;
+            return n_read;
+        }
+
+        SubmitReadAhead(fd, &read_ahead);
+        WaitUntil([&read_ahead]{ return !read_ahead.is_in_flight; });
+    }
+
+    if (read_ahead.begin == read_ahead.end) {
+        // file may grow after end of file or error, so next read tries again
+        int error = read_ahead.error;
+        read_ahead.error = 0;
+        read_ahead.is_eof = false;
+
+        return error;
+    }
+
+    size_t n_read = std::min(size, read_ahead.end - read_ahead.begin);
+    std::memcpy(buffer, read_ahead.buffer.data() + read_ahead.begin, n_read);
+    read_ahead.begin += n_read;
+
+    if (read_ahead.begin == read_ahead.end && !read_ahead.is_eof) {
+        SubmitReadAhead(fd, &read_ahead);
+    }
+
+    return static_cast<ssize_t>(n_read);
+}
+
+ssize_t UringIoBackend::Write(const int fd, const uint8_t* buffer, const size_t size) {
+    LogFunctionEntry();
+
+    n_guest_writes_++;
+    ResetReadAhead(fd);
+
+    int write_error = TakeWriteError(fd);
+    if (write_error != 0) {
+        return write_error;
+    }
+
+    if (size > kBatchCapacity || ring_error_ != 0) {
+        FlushWrites();
+
+        n_host_syscalls_++;
+        ssize_t n_written = WriteAll(fd, buffer, size);
+        return n_written < 0 ? -errno : n_written;
+    }
+
+    WriteBatch* batch = &batches_[current_batch_];
+    if (batch->data.size() + size > kBatchCapacity || batch->writes.size() == kMaxBatchWrites) {
+        SubmitBatch(current_batch_);
+
+        current_batch_ = (current_batch_ + 1) % kNBatches;
+        WaitBatch(current_batch_);
+        batch = &batches_[current_batch_];
+    }
+
+    if (!batch->writes.empty() && batch->writes.back().fd == fd) {
+        batch->writes.back().size += size;
+    } else {
+        batch->writes.push_back({.fd = fd, .offset = batch->data.size(), .size = size, .result = 0});
+    }
+    batch->data.insert(batch->data.end(), buffer, buffer + size);
+
+    return static_cast<ssize_t>(size);
+}
+
+off_t UringIoBackend::Seek(const int fd, const off_t offset, const int whence) {
+    LogFunctionEntry();
+
+    int write_error = Sync(fd);
+    if (write_error != 0) {
+        return write_error;
+    }
+
+    n_host_syscalls_++;
+    off_t new_offset = lseek(fd, offset, whence);
+    return new_offset < 0 ? -errno : new_offset;
+}
+
+int UringIoBackend::Sync(const int fd) {
+    LogFunctionEntry();
+
+    FlushWrites();
+    ResetReadAhead(fd);
+
+    return TakeWriteError(fd);
+}
+
+void UringIoBackend::Flush() {
+    LogFunctionEntry();
+
+    FlushWrites();
+    WaitUntil([this]{
+        return std::none_of(read_aheads_.begin(), read_aheads_.end(),
+                            [](const auto& fd_read_ahead) { return fd_read_ahead.second.is_in_flight; });
+    });
+}
+
+// static ---------------------------------------------------------------------
+
+static int IoUringSetup(const unsigned entries, io_uring_params* params) {
+    long ret = syscall(__NR_io_uring_setup, entries, params);
+    return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+static int IoUringEnter(const int ring_fd, const unsigned to_submit, const unsigned min_complete, const unsigned flags) {
+    long ret = 0;
+    do {
+        ret = syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, nullptr, 0);
+    } while (ret < 0 && errno == EINTR);
+
+    return ret < 0 ? -errno : static_cast<int>(ret);
+}
+
+static ssize_t WriteAll(const int fd, const uint8_t* buffer, const size_t size) {
+    size_t n_written = 0;
+    while (n_written < size) {
+        ssize_t ret = write(fd, buffer + n_written, size - n_written);
+        if (ret < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+
+            return -1;
+        }
+
+        n_written += static_cast<size_t>(ret);
+    }
+
+    return static_cast<ssize_t>(n_written);
+}
+
+#else // SIM_HAS_IO_URING
+
+// UringIoBackend public ------------------------------------------------------
+
+IoBackendError UringIoBackend::Init() {
+    return IoBackendError::kUnsupported;
+}
+
+UringIoBackend::~UringIoBackend() {}
+
+ssize_t UringIoBackend::Read(const int, uint8_t*, const size_t) {
+    assert(0 && "io_uring backend is not supported");
+    return -ENOSYS;
+}
+
+ssize_t UringIoBackend::Write(const int, const uint8_t*, const size_t) {
+    assert(0 && "io_uring backend is not supported");
+    return -ENOSYS;
+}
+
+off_t UringIoBackend::Seek(const int, const off_t, const int) {
+    assert(0 && "io_uring backend is not supported");
+    return -ENOSYS;
+}
+
+int UringIoBackend::Sync(const int) { return 0; }
+void UringIoBackend::Flush() {}
+
+#endif // SIM_HAS_IO_URING
+
+// global ---------------------------------------------------------------------
+
+const char* IoBackendErrorToStr(IoBackendError error) {
+    switch (error) {
+        case IoBackendError::kOk:          return "no error";
+        case IoBackendError::kUnsupported: return "io_uring is not supported";
+        case IoBackendError::kSetupFailed: return "io_uring setup failed";
+        default:
+            assert(0 && "unknown enum value");
+            return "<unknown enum value>";
+    }
+}
+
+} // namespace sim
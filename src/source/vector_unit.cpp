@@ -0,0 +1,834 @@
+#include "vector_unit.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cstring>
+#include <string>
+
+#include "log_helper.hpp"
+
+#include "cpu.hpp"
+#include "cpu_defs.hpp"
+#include "instructions.hpp"
+#include "sim_cfg.hpp"
+#include "spdlog/spdlog.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#endif
+
+namespace sim {
+
+// static ---------------------------------------------------------------------
+
+// elementwise operations of host kernels, compares produce all ones elements
+enum class VectorAluOp {
+    kAdd, kSub, kMul,
+    kMinu, kMin, kMaxu, kMax,
+    kAnd, kOr, kXor,
+    kSll, kSrl, kSra,
+    kSeq, kSne, kSltu, kSlt, kSleu, kSle, kSgtu, kSgt,
+};
+
+// group of kMaxLmul registers of the widest vlen
+static const size_t kMaxGroupBytes = kMaxLmul * kMaxVlenBytes;
+
+static Register EvaluateElement(const VectorAluOp op, const size_t sew, const Register lhs, const Register rhs);
+static bool RunHostKernel(const VectorAluOp op, const size_t sew, uint8_t* dst, const uint8_t* lhs, const uint8_t* rhs,
+                          const size_t n_bytes, const bool is_rhs_uniform);
+static void ApplyKernel(const VectorAluOp op, const size_t sew, uint8_t* dst, const uint8_t* lhs, const uint8_t* rhs,
+                        const size_t n_bytes, const bool is_rhs_uniform);
+static void Splat(uint8_t* dst, const size_t sew, const Register value, const size_t n_bytes);
+static void BlendBody(uint8_t* dst, const uint8_t* src, const size_t vl, const size_t sew, const uint8_t* mask);
+static bool GetAluOp(InstructionMnemonic mnemonic, VectorAluOp* op);
+
+// VectorUnit private ---------------------------------------------------------
+
+Register VectorUnit::GetElement(const uint8_t* group, const size_t elem_i) const {
+    Register value = 0;
+    std::memcpy(&value, group + elem_i * sew_, sew_);
+
+    return value;
+}
+
+void VectorUnit::SetElement(uint8_t* group, const size_t elem_i, const Register value) const {
+    std::memcpy(group + elem_i * sew_, &value, sew_);
+}
+
+void VectorUnit::SetConfig(const Register avl, const Register vtype) {
+    LogFunctionEntry();
+
+    const Register kVsewShift = 3;
+    const Register kVlmulMask = 0b111;
+    const Register kVsewMask = 0b111;
+    const Register kReservedMask = ~0xffu; // above vta, vma
+
+    const size_t sew = 1u << ((vtype >> kVsewShift) & kVsewMask);
+    const Register vlmul = vtype & kVlmulMask;
+    // fractional lmul is 1/2^(8 - vlmul), vlmul 4 is reserved
+    const size_t lmul_num = vlmul < 4 ? 1u << vlmul : 1;
+    const size_t lmul_den = vlmul > 4 ? 1u << (8 - vlmul) : 1;
+
+    const bool is_legal = (vtype & kReservedMask) == 0 && vlmul != 4
+                       && sew * CHAR_BIT <= kMaxVectorElen
+                       && sew * CHAR_BIT * lmul_den <= kMaxVectorElen * lmul_num;
+    if (!is_legal) {
+        vtype_ = kVtypeIllegal;
+        vl_ = 0;
+        sew_ = 0;
+        lmul_ = 1;
+        vlmax_ = 0;
+        return ;
+    }
+
+    vtype_ = vtype;
+    sew_ = sew;
+    lmul_ = lmul_num;
+    vlmax_ = lmul_num * vlenb_ / (sew * lmul_den);
+    vl_ = static_cast<Register>(std::min<size_t>(avl, vlmax_));
+}
+
+void VectorUnit::WriteBody(const Register vd, const uint8_t* result, const bool is_masked) {
+    BlendBody(GetGroup(vd), result, vl_, sew_, is_masked ? registers_.data() : nullptr);
+}
+
+InstructionError VectorUnit::ExecuteConfig(const DecodedInstr& dec_instr, Cpu* cpu) {
+    LogFunctionEntry();
+
+    const auto& v_type = dec_instr.instr.v_type;
+
+    Register vtype = v_type.imm;
+    if (dec_instr.instr_mnem == InstructionMnemonic::kVsetvl) {
+        vtype = cpu->GetRegisterValue(v_type.vs2);
+    }
+
+    Register avl = 0;
+    if (dec_instr.instr_mnem == InstructionMnemonic::kVsetivli) {
+        avl = v_type.rs1;
+    } else if (v_type.rs1 != RegisterAliases::kMachineZero) {
+        avl = cpu->GetRegisterValue(v_type.rs1);
+    } else if (v_type.vd != RegisterAliases::kMachineZero) {
+        avl = UINT32_MAX; // vlmax
+    } else {
+        avl = vl_; // keeps vl
+    }
+
+    SetConfig(avl, vtype);
+    cpu->SetRegisterValue(v_type.vd, vl_);
+
+    return InstructionError::kOk;
+}
+
+InstructionError VectorUnit::ExecuteMemory(const DecodedInstr& dec_instr, Cpu* cpu, IMemory* memory) {
+    LogFunctionEntry();
+
+    const auto& v_type = dec_instr.instr.v_type;
+    const InstructionMnemonic mnemonic = dec_instr.instr_mnem;
+
+    // element width of access is encoded in instruction, not taken from vtype
+    size_t eew = 0;
+    bool is_load = false;
+    switch (mnemonic) {
+        case InstructionMnemonic::kVle8:  case InstructionMnemonic::kVlse8:  eew = 1; is_load = true;  break;
+        case InstructionMnemonic::kVle16: case InstructionMnemonic::kVlse16: eew = 2; is_load = true;  break;
+        case InstructionMnemonic::kVle32: case InstructionMnemonic::kVlse32: eew = 4; is_load = true;  break;
+        case InstructionMnemonic::kVse8:  case InstructionMnemonic::kVsse8:  eew = 1; is_load = false; break;
+        case InstructionMnemonic::kVse16: case InstructionMnemonic::kVsse16: eew = 2; is_load = false; break;
+        case InstructionMnemonic::kVse32: case InstructionMnemonic::kVsse32: eew = 4; is_load = false; break;
+        default:
+            assert(0 && "not a vector memory instruction");
+            return InstructionError::kUnknownInstruction;
+    }
+
+    // group of eew elements: emul = eew / sew * lmul
+    const size_t emul = std::max<size_t>(1, eew * lmul_ / sew_);
+    if (eew * lmul_ > kMaxLmul * sew_ || v_type.vd % emul != 0 || (is_load && v_type.is_masked && v_type.vd == 0)) {
+        return InstructionError::kUnknownInstruction;
+    }
+
+    const Address base = cpu->GetRegisterValue(v_type.rs1);
+    const Register stride = IsVectorStridedInstr(mnemonic) ? cpu->GetRegisterValue(v_type.vs2)
+                                                           : static_cast<Register>(eew);
+
+    if (is_load) {
+        alignas(32) uint8_t elements[kMaxGroupBytes] = {};
+        for (size_t elem_i = 0; elem_i < vl_; elem_i++) {
+            if (!IsActive(elem_i, v_type.is_masked)) {
+                continue;
+            }
+
+            const Address address = base + static_cast<Register>(elem_i) * stride;
+            Register value = 0;
+            switch (eew) {
+                case 1: value = memory->ReadFromMemory8b(address);  break;
+                case 2: value = memory->ReadFromMemory16b(address); break;
+                case 4: value = memory->ReadFromMemory32b(address); break;
+                default: break;
+            }
+
+            std::memcpy(elements + elem_i * eew, &value, eew);
+        }
+
+        BlendBody(GetGroup(v_type.vd), elements, vl_, eew, v_type.is_masked ? registers_.data() : nullptr);
+        return InstructionError::kOk;
+    }
+
+    const uint8_t* elements = GetGroup(v_type.vd);
+    for (size_t elem_i = 0; elem_i < vl_; elem_i++) {
+        if (!IsActive(elem_i, v_type.is_masked)) {
+            continue;
+        }
+
+        const Address address = base + static_cast<Register>(elem_i) * stride;
+        Register value = 0;
+        std::memcpy(&value, elements + elem_i * eew, eew);
+        switch (eew) {
+            case 1: memory->WriteToMemory8b(static_cast<uint8_t>(value), address);   break;
+            case 2: memory->WriteToMemory16b(static_cast<uint16_t>(value), address); break;
+            case 4: memory->WriteToMemory32b(value, address);                         break;
+            default: break;
+        }
+    }
+
+    return InstructionError::kOk;
+}
+
+InstructionError VectorUnit::ExecuteArithm(const DecodedInstr& dec_instr, Cpu* cpu) {
+    LogFunctionEntry();
+
+    const auto& v_type = dec_instr.instr.v_type;
+    const bool is_vector_operand = v_type.operand == VectorOperand::kVector;
+
+    if (!IsGroupAligned(v_type.vd) || !IsGroupAligned(v_type.vs2)
+        || (is_vector_operand && !IsGroupAligned(v_type.rs1)) || (v_type.is_masked && v_type.vd == 0)) {
+        return InstructionError::kUnknownInstruction;
+    }
+
+    VectorAluOp op = VectorAluOp::kAdd;
+    bool is_known = GetAluOp(dec_instr.instr_mnem, &op);
+    assert(is_known);
+    (void)is_known;
+
+    const size_t n_bytes = lmul_ * vlenb_;
+    alignas(32) uint8_t splat[kMaxGroupBytes] = {};
+    const uint8_t* operand = GetGroup(v_type.rs1);
+    if (!is_vector_operand) {
+        Splat(splat, sew_, v_type.operand == VectorOperand::kScalar ? cpu->GetRegisterValue(v_type.rs1) : v_type.imm, n_bytes);
+        operand = splat;
+    }
+
+    alignas(32) uint8_t result[kMaxGroupBytes] = {};
+    if (dec_instr.instr_mnem == InstructionMnemonic::kVrsub) {
+        ApplyKernel(op, sew_, result, operand, GetGroup(v_type.vs2), n_bytes, false);
+    } else {
+        ApplyKernel(op, sew_, result, GetGroup(v_type.vs2), operand, n_bytes, !is_vector_operand);
+    }
+
+    WriteBody(v_type.vd, result, v_type.is_masked);
+
+    return InstructionError::kOk;
+}
+
+// destination is a single mask register, it may overlap sources
+InstructionError VectorUnit::ExecuteCompare(const DecodedInstr& dec_instr, Cpu* cpu) {
+    LogFunctionEntry();
+
+    const auto& v_type = dec_instr.instr.v_type;
+    const bool is_vector_operand = v_type.operand == VectorOperand::kVector;
+
+    if (!IsGroupAligned(v_type.vs2) || (is_vector_operand && !IsGroupAligned(v_type.rs1))) {
+        return InstructionError::kUnknownInstruction;
+    }
+
+    VectorAluOp op = VectorAluOp::kSeq;
+    bool is_known = GetAluOp(dec_instr.instr_mnem, &op);
+    assert(is_known);
+    (void)is_known;
+
+    const size_t n_bytes = lmul_ * vlenb_;
+    alignas(32) uint8_t splat[kMaxGroupBytes] = {};
+    const uint8_t* operand = GetGroup(v_type.rs1);
+    if (!is_vector_operand) {
+        Splat(splat, sew_, v_type.operand == VectorOperand::kScalar ? cpu->GetRegisterValue(v_type.rs1) : v_type.imm, n_bytes);
+        operand = splat;
+    }
+
+    alignas(32) uint8_t result[kMaxGroupBytes] = {};
+    ApplyKernel(op, sew_, result, GetGroup(v_type.vs2), operand, n_bytes, !is_vector_operand);
+
+    // mask of v0 is read before vd (possibly v0) is written
+    alignas(32) uint8_t mask[kMaxVlenBytes];
+    std::memcpy(mask, GetGroup(v_type.vd), vlenb_);
+    for (size_t elem_i = 0; elem_i < vl_; elem_i++) {
+        if (IsActive(elem_i, v_type.is_masked)) {
+            const uint8_t bit = static_cast<uint8_t>(1u << (elem_i % CHAR_BIT));
+            mask[elem_i / CHAR_BIT] = result[elem_i * sew_] != 0 ? (mask[elem_i / CHAR_BIT] | bit)
+                                                                 : (mask[elem_i / CHAR_BIT] & ~bit);
+        }
+    }
+
+    std::memcpy(GetGroup(v_type.vd), mask, vlenb_);
+
+    return InstructionError::kOk;
+}
+
+// vd[0] = vs1[0] op active elements of vs2, inactive ones are replaced by identity
+InstructionError VectorUnit::ExecuteReduction(const DecodedInstr& dec_instr) {
+    LogFunctionEntry();
+
+    const auto& v_type = dec_instr.instr.v_type;
+
+    if (!IsGroupAligned(v_type.vs2)) {
+        return InstructionError::kUnknownInstruction;
+    }
+    if (vl_ == 0) {
+        return InstructionError::kOk;
+    }
+
+    const Register sign_bit = 1u << (sew_ * CHAR_BIT - 1);
+    const Register all_ones = sign_bit | (sign_bit - 1);
+
+    VectorAluOp op = VectorAluOp::kAdd;
+    Register identity = 0;
+    switch (dec_instr.instr_mnem) {
+        case InstructionMnemonic::kVredsum:  op = VectorAluOp::kAdd;  identity = 0;            break;
+        case InstructionMnemonic::kVredand:  op = VectorAluOp::kAnd;  identity = all_ones;     break;
+        case InstructionMnemonic::kVredor:   op = VectorAluOp::kOr;   identity = 0;            break;
+        case InstructionMnemonic::kVredxor:  op = VectorAluOp::kXor;  identity = 0;            break;
+        case InstructionMnemonic::kVredminu: op = VectorAluOp::kMinu; identity = all_ones;     break;
+        case InstructionMnemonic::kVredmin:  op = VectorAluOp::kMin;  identity = sign_bit - 1; break;
+        case InstructionMnemonic::kVredmaxu: op = VectorAluOp::kMaxu; identity = 0;            break;
+        case InstructionMnemonic::kVredmax:  op = VectorAluOp::kMax;  identity = sign_bit;     break;
+        default:
+            assert(0 && "not a vector reduction");
+            return InstructionError::kUnknownInstruction;
+    }
+
+    size_t n_bytes = lmul_ * vlenb_;
+    alignas(32) uint8_t elements[kMaxGroupBytes] = {};
+    Splat(elements, sew_, identity, n_bytes);
+    BlendBody(elements, GetGroup(v_type.vs2), vl_, sew_, v_type.is_masked ? registers_.data() : nullptr);
+
+    // halves are folded by host kernels down to one register
+    while (n_bytes > vlenb_) {
+        n_bytes /= 2;
+        ApplyKernel(op, sew_, elements, elements, elements + n_bytes, n_bytes, false);
+    }
+
+    Register value = GetElement(GetGroup(v_type.rs1), 0);
+    for (size_t elem_i = 0; elem_i < n_bytes / sew_; elem_i++) {
+        value = EvaluateElement(op, sew_, value, GetElement(elements, elem_i));
+    }
+
+    SetElement(GetGroup(v_type.vd), 0, value);
+
+    return InstructionError::kOk;
+}
+
+InstructionError VectorUnit::ExecuteMask(const DecodedInstr& dec_instr, Cpu* cpu) {
+    LogFunctionEntry();
+
+    const auto& v_type = dec_instr.instr.v_type;
+    const uint8_t* lhs = GetGroup(v_type.vs2);
+    const uint8_t* rhs = GetGroup(v_type.rs1);
+
+    if (dec_instr.instr_mnem == InstructionMnemonic::kVcpop || dec_instr.instr_mnem == InstructionMnemonic::kVfirst) {
+        Register n_set = 0;
+        Register first = UINT32_MAX; // -1 if none
+        for (size_t elem_i = 0; elem_i < vl_; elem_i++) {
+            if (IsActive(elem_i, v_type.is_masked) && ((lhs[elem_i / CHAR_BIT] >> (elem_i % CHAR_BIT)) & 1u)) {
+                first = std::min(first, static_cast<Register>(elem_i));
+                n_set++;
+            }
+        }
+
+        cpu->SetRegisterValue(v_type.vd, dec_instr.instr_mnem == InstructionMnemonic::kVcpop ? n_set : first);
+        return InstructionError::kOk;
+    }
+
+    if (v_type.is_masked) {
+        return InstructionError::kUnknownInstruction;
+    }
+
+    // whole registers are combined, only bits of body are written back
+    alignas(32) uint8_t result[kMaxGroupBytes] = {};
+    alignas(32) uint8_t not_rhs[kMaxGroupBytes] = {};
+    const uint8_t ones[kMaxVlenBytes] = {
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+        0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff,
+    };
+
+    bool is_negated = false;
+    switch (dec_instr.instr_mnem) {
+        case InstructionMnemonic::kVmand:  ApplyKernel(VectorAluOp::kAnd, 1, result, lhs, rhs, vlenb_, false); break;
+        case InstructionMnemonic::kVmor:   ApplyKernel(VectorAluOp::kOr,  1, result, lhs, rhs, vlenb_, false); break;
+        case InstructionMnemonic::kVmxor:  ApplyKernel(VectorAluOp::kXor, 1, result, lhs, rhs, vlenb_, false); break;
+        case InstructionMnemonic::kVmnand: ApplyKernel(VectorAluOp::kAnd, 1, result, lhs, rhs, vlenb_, false); is_negated = true; break;
+        case InstructionMnemonic::kVmnor:  ApplyKernel(VectorAluOp::kOr,  1, result, lhs, rhs, vlenb_, false); is_negated = true; break;
+        case InstructionMnemonic::kVmxnor: ApplyKernel(VectorAluOp::kXor, 1, result, lhs, rhs, vlenb_, false); is_negated = true; break;
+        case InstructionMnemonic::kVmandn: {
+            ApplyKernel(VectorAluOp::kXor, 1, not_rhs, rhs, ones, vlenb_, false);
+            ApplyKernel(VectorAluOp::kAnd, 1, result, lhs, not_rhs, vlenb_, false);
+        }
+        break;
+        case InstructionMnemonic::kVmorn: {
+            ApplyKernel(VectorAluOp::kXor, 1, not_rhs, rhs, ones, vlenb_, false);
+            ApplyKernel(VectorAluOp::kOr,  1, result, lhs, not_rhs, vlenb_, false);
+        }
+        break;
+        default:
+            assert(0 && "not a vector mask instruction");
+            return InstructionError::kUnknownInstruction;
+    }
+
+    if (is_negated) {
+        ApplyKernel(VectorAluOp::kXor, 1, result, result, ones, vlenb_, false);
+    }
+
+    uint8_t* mask = GetGroup(v_type.vd);
+    const size_t n_full_bytes = vl_ / CHAR_BIT;
+    std::memcpy(mask, result, n_full_bytes);
+    if (vl_ % CHAR_BIT != 0) {
+        const uint8_t body_bits = static_cast<uint8_t>((1u << (vl_ % CHAR_BIT)) - 1);
+        mask[n_full_bytes] = static_cast<uint8_t>((mask[n_full_bytes] & ~body_bits) | (result[n_full_bytes] & body_bits));
+    }
+
+    return InstructionError::kOk;
+}
+
+InstructionError VectorUnit::ExecuteMove(const DecodedInstr& dec_instr, Cpu* cpu) {
+    LogFunctionEntry();
+
+    const auto& v_type = dec_instr.instr.v_type;
+    const size_t n_bytes = lmul_ * vlenb_;
+
+    switch (dec_instr.instr_mnem) {
+        case InstructionMnemonic::kVmv_x_s: {
+            // sign extended element 0, even if vl is 0
+            const size_t shift = (sizeof(Register) - sew_) * CHAR_BIT;
+            const Register value = GetElement(GetGroup(v_type.vs2), 0);
+            cpu->SetRegisterValue(v_type.vd, static_cast<Register>(static_cast<IRegister>(value << shift) >> shift));
+        }
+        break;
+        case InstructionMnemonic::kVmv_s_x: {
+            if (vl_ != 0) {
+                SetElement(GetGroup(v_type.vd), 0, cpu->GetRegisterValue(v_type.rs1));
+            }
+        }
+        break;
+        case InstructionMnemonic::kVid: {
+            if (!IsGroupAligned(v_type.vd) || (v_type.is_masked && v_type.vd == 0)) {
+                return InstructionError::kUnknownInstruction;
+            }
+
+            alignas(32) uint8_t result[kMaxGroupBytes] = {};
+            for (size_t elem_i = 0; elem_i < vl_; elem_i++) {
+                SetElement(result, elem_i, static_cast<Register>(elem_i));
+            }
+
+            WriteBody(v_type.vd, result, v_type.is_masked);
+        }
+        break;
+        case InstructionMnemonic::kVmv_v:
+        case InstructionMnemonic::kVmerge: {
+            const bool is_vector_operand = v_type.operand == VectorOperand::kVector;
+            if (!IsGroupAligned(v_type.vd) || !IsGroupAligned(v_type.vs2)
+                || (is_vector_operand && !IsGroupAligned(v_type.rs1)) || (v_type.is_masked && v_type.vd == 0)) {
+                return InstructionError::kUnknownInstruction;
+            }
+
+            alignas(32) uint8_t result[kMaxGroupBytes] = {};
+            if (is_vector_operand) {
+                std::memcpy(result, GetGroup(v_type.rs1), n_bytes);
+            } else {
+                Splat(result, sew_, v_type.operand == VectorOperand::kScalar ? cpu->GetRegisterValue(v_type.rs1) : v_type.imm, n_bytes);
+            }
+
+            // elements of vmerge with clear mask bit come from vs2
+            if (dec_instr.instr_mnem == InstructionMnemonic::kVmerge) {
+                alignas(32) uint8_t merged[kMaxGroupBytes] = {};
+                std::memcpy(merged, GetGroup(v_type.vs2), n_bytes);
+                BlendBody(merged, result, vl_, sew_, registers_.data());
+                WriteBody(v_type.vd, merged, false);
+            } else {
+                WriteBody(v_type.vd, result, false);
+            }
+        }
+        break;
+        default:
+            assert(0 && "not a vector move");
+            return InstructionError::kUnknownInstruction;
+    }
+
+    return InstructionError::kOk;
+}
+
+// VectorUnit public ----------------------------------------------------------
+
+void VectorUnit::Init(const size_t vlen) {
+    LogFunctionEntry();
+
+    assert(vlen == kMinVlen || vlen == kMaxVlen);
+
+    vlenb_ = vlen / CHAR_BIT;
+    registers_.fill(0);
+
+    // reset state is illegal, guest sets it with vset*
+    vtype_ = kVtypeIllegal;
+    vl_ = 0;
+    sew_ = 0;
+    lmul_ = 1;
+    vlmax_ = 0;
+}
+
+size_t VectorUnit::GetVlen() const {
+    return vlenb_ * CHAR_BIT;
+}
+
+Register VectorUnit::GetVl() const {
+    return vl_;
+}
+
+Register VectorUnit::GetVtype() const {
+    return vtype_;
+}
+
+InstructionError VectorUnit::Execute(const DecodedInstr& dec_instr, Cpu* cpu, IMemory* memory) {
+    LogFunctionEntry();
+
+    assert(dec_instr.instr_type == InstrType::VType);
+    assert(cpu != nullptr);
+    assert(memory != nullptr);
+
+    const InstructionMnemonic mnemonic = dec_instr.instr_mnem;
+
+    if (mnemonic == InstructionMnemonic::kVsetvli || mnemonic == InstructionMnemonic::kVsetivli
+        || mnemonic == InstructionMnemonic::kVsetvl) {
+        return ExecuteConfig(dec_instr, cpu);
+    }
+
+    if (sew_ == 0) {
+        spdlog::error("Vector instruction {} with illegal vtype", InstructionMnemonicToStr(mnemonic));
+        return InstructionError::kUnknownInstruction;
+    }
+
+    InstructionError err = InstructionError::kOk;
+    if (IsVectorMemInstr(mnemonic)) {
+        err = ExecuteMemory(dec_instr, cpu, memory);
+    } else if (InstructionMnemonic::kVadd <= mnemonic && mnemonic <= InstructionMnemonic::kVmul) {
+        err = ExecuteArithm(dec_instr, cpu);
+    } else if (InstructionMnemonic::kVmseq <= mnemonic && mnemonic <= InstructionMnemonic::kVmsgt) {
+        err = ExecuteCompare(dec_instr, cpu);
+    } else if (InstructionMnemonic::kVredsum <= mnemonic && mnemonic <= InstructionMnemonic::kVredmax) {
+        err = ExecuteReduction(dec_instr);
+    } else if (InstructionMnemonic::kVmandn <= mnemonic && mnemonic <= InstructionMnemonic::kVfirst) {
+        err = ExecuteMask(dec_instr, cpu);
+    } else {
+        err = ExecuteMove(dec_instr, cpu);
+    }
+
+    if (err != InstructionError::kOk) {
+        spdlog::error("Vector instruction {} with illegal operands", InstructionMnemonicToStr(mnemonic));
+    }
+
+    return err;
+}
+
+void VectorUnit::Dump() const {
+    LogFunctionEntry();
+
+    spdlog::info("Vector vlen: {}, vl: {}, vtype: 0x{:x}", GetVlen(), vl_, vtype_);
+
+    for (size_t reg_i = 0; reg_i < kNVectorRegisters; reg_i++) {
+        const uint8_t* reg = GetGroup(static_cast<Register>(reg_i));
+        if (std::all_of(reg, reg + vlenb_, [](uint8_t byte) { return byte == 0; })) {
+            continue;
+        }
+
+        // most significant byte first
+        std::string bytes;
+        for (size_t byte_i = vlenb_; byte_i-- > 0;) {
+            bytes += fmt::format("{:02x}", reg[byte_i]);
+        }
+
+        spdlog::info("Register v{}: 0x{}", reg_i, bytes);
+    }
+}
+
+// static ---------------------------------------------------------------------
+
+// single definition of element semantics, used by scalar fallback and folds
+static Register EvaluateElement(const VectorAluOp op, const size_t sew, const Register lhs, const Register rhs) {
+    const size_t n_bits = sew * CHAR_BIT;
+    const size_t ext_shift = sizeof(Register) * CHAR_BIT - n_bits;
+    const Register elem_mask = ~Register{0} >> ext_shift;
+    const Register shamt = rhs & (n_bits - 1);
+
+    const Register ulhs = lhs & elem_mask;
+    const Register urhs = rhs & elem_mask;
+    const IRegister ilhs = static_cast<IRegister>(lhs << ext_shift) >> ext_shift;
+    const IRegister irhs = static_cast<IRegister>(rhs << ext_shift) >> ext_shift;
+
+    Register result = 0;
+    switch (op) {
+        case VectorAluOp::kAdd:  result = ulhs + urhs; break;
+        case VectorAluOp::kSub:  result = ulhs - urhs; break;
+        case VectorAluOp::kMul:  result = ulhs * urhs; break;
+        case VectorAluOp::kMinu: result = std::min(ulhs, urhs); break;
+        case VectorAluOp::kMin:  result = static_cast<Register>(std::min(ilhs, irhs)); break;
+        case VectorAluOp::kMaxu: result = std::max(ulhs, urhs); break;
+        case VectorAluOp::kMax:  result = static_cast<Register>(std::max(ilhs, irhs)); break;
+        case VectorAluOp::kAnd:  result = ulhs & urhs; break;
+        case VectorAluOp::kOr:   result = ulhs | urhs; break;
+        case VectorAluOp::kXor:  result = ulhs ^ urhs; break;
+        case VectorAluOp::kSll:  result = ulhs << shamt; break;
+        case VectorAluOp::kSrl:  result = ulhs >> shamt; break;
+        case VectorAluOp::kSra:  result = static_cast<Register>(ilhs >> shamt); break;
+        case VectorAluOp::kSeq:  result = ulhs == urhs ? elem_mask : 0; break;
+        case VectorAluOp::kSne:  result = ulhs != urhs ? elem_mask : 0; break;
+        case VectorAluOp::kSltu: result = ulhs <  urhs ? elem_mask : 0; break;
+        case VectorAluOp::kSlt:  result = ilhs <  irhs ? elem_mask : 0; break;
+        case VectorAluOp::kSleu: result = ulhs <= urhs ? elem_mask : 0; break;
+        case VectorAluOp::kSle:  result = ilhs <= irhs ? elem_mask : 0; break;
+        case VectorAluOp::kSgtu: result = ulhs >  urhs ? elem_mask : 0; break;
+        case VectorAluOp::kSgt:  result = ilhs >  irhs ? elem_mask : 0; break;
+        default:
+            assert(0 && "unknown vector alu op");
+    }
+
+    return result & elem_mask;
+}
+
+#if defined(__AVX2__) || defined(__SSE4_1__)
+
+#if defined(__AVX2__)
+using HostVector = __m256i;
+#define HOST_VECTOR_OP(name) _mm256_##name
+
+static inline HostVector LoadHost(const uint8_t* src) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src)); }
+static inline void StoreHost(uint8_t* dst, HostVector value) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), value); }
+static inline HostVector AndHost(HostVector lhs, HostVector rhs) { return _mm256_and_si256(lhs, rhs); }
+static inline HostVector OrHost (HostVector lhs, HostVector rhs) { return _mm256_or_si256(lhs, rhs); }
+static inline HostVector XorHost(HostVector lhs, HostVector rhs) { return _mm256_xor_si256(lhs, rhs); }
+#else
+using HostVector = __m128i;
+#define HOST_VECTOR_OP(name) _mm_##name
+
+static inline HostVector LoadHost(const uint8_t* src) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(src)); }
+static inline void StoreHost(uint8_t* dst, HostVector value) { _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), value); }
+static inline HostVector AndHost(HostVector lhs, HostVector rhs) { return _mm_and_si128(lhs, rhs); }
+static inline HostVector OrHost (HostVector lhs, HostVector rhs) { return _mm_or_si128(lhs, rhs); }
+static inline HostVector XorHost(HostVector lhs, HostVector rhs) { return _mm_xor_si128(lhs, rhs); }
+#endif
+
+static inline HostVector OnesHost() { return HOST_VECTOR_OP(set1_epi32)(-1); }
+
+// buffers of kernels are at least kMaxVlenBytes long and n_bytes is a multiple
+// of 16, so the last 32 byte step of vlen 128 reads past the group but stays
+// inside of the buffer, extra result bytes are never written back
+static_assert(sizeof(HostVector) <= kMaxVlenBytes);
+
+template <typename Kernel>
+static inline void RunChunks(uint8_t* dst, const uint8_t* lhs, const uint8_t* rhs, const size_t n_bytes, Kernel kernel) {
+    alignas(32) uint8_t last[sizeof(HostVector)];
+
+    size_t offset = 0;
+    for (; offset + sizeof(HostVector) <= n_bytes; offset += sizeof(HostVector)) {
+        StoreHost(dst + offset, kernel(LoadHost(lhs + offset), LoadHost(rhs + offset)));
+    }
+
+    if (offset < n_bytes) {
+        StoreHost(last, kernel(LoadHost(lhs + offset), LoadHost(rhs + offset)));
+        std::memcpy(dst + offset, last, n_bytes - offset);
+    }
+}
+
+// 8 bit lanes have no multiply, even and odd bytes are multiplied as 16 bit
+static inline HostVector MulLo8(HostVector lhs, HostVector rhs) {
+    const HostVector even = HOST_VECTOR_OP(mullo_epi16)(lhs, rhs);
+    const HostVector odd = HOST_VECTOR_OP(mullo_epi16)(HOST_VECTOR_OP(srli_epi16)(lhs, 8), HOST_VECTOR_OP(srli_epi16)(rhs, 8));
+
+    return OrHost(AndHost(even, HOST_VECTOR_OP(set1_epi16)(0x00ff)), HOST_VECTOR_OP(slli_epi16)(odd, 8));
+}
+
+#define SEW_KERNELS(expr8, expr16, expr32)                                                                          \
+    switch (sew) {                                                                                                  \
+        case 1: RunChunks(dst, lhs, rhs, n_bytes, [=](HostVector a, [[maybe_unused]] HostVector b) { return expr8;  }); return true; \
+        case 2: RunChunks(dst, lhs, rhs, n_bytes, [=](HostVector a, [[maybe_unused]] HostVector b) { return expr16; }); return true; \
+        case 4: RunChunks(dst, lhs, rhs, n_bytes, [=](HostVector a, [[maybe_unused]] HostVector b) { return expr32; }); return true; \
+        default: return false;                                                                                      \
+    }
+
+static bool RunHostKernel(const VectorAluOp op, const size_t sew, uint8_t* dst, const uint8_t* lhs, const uint8_t* rhs,
+                          const size_t n_bytes, const bool is_rhs_uniform) {
+    const HostVector ones = OnesHost();
+
+    switch (op) {
+        case VectorAluOp::kAdd: SEW_KERNELS(HOST_VECTOR_OP(add_epi8)(a, b), HOST_VECTOR_OP(add_epi16)(a, b), HOST_VECTOR_OP(add_epi32)(a, b))
+        case VectorAluOp::kSub: SEW_KERNELS(HOST_VECTOR_OP(sub_epi8)(a, b), HOST_VECTOR_OP(sub_epi16)(a, b), HOST_VECTOR_OP(sub_epi32)(a, b))
+        case VectorAluOp::kMul: SEW_KERNELS(MulLo8(a, b), HOST_VECTOR_OP(mullo_epi16)(a, b), HOST_VECTOR_OP(mullo_epi32)(a, b))
+
+        case VectorAluOp::kMinu: SEW_KERNELS(HOST_VECTOR_OP(min_epu8)(a, b), HOST_VECTOR_OP(min_epu16)(a, b), HOST_VECTOR_OP(min_epu32)(a, b))
+        case VectorAluOp::kMin:  SEW_KERNELS(HOST_VECTOR_OP(min_epi8)(a, b), HOST_VECTOR_OP(min_epi16)(a, b), HOST_VECTOR_OP(min_epi32)(a, b))
+        case VectorAluOp::kMaxu: SEW_KERNELS(HOST_VECTOR_OP(max_epu8)(a, b), HOST_VECTOR_OP(max_epu16)(a, b), HOST_VECTOR_OP(max_epu32)(a, b))
+        case VectorAluOp::kMax:  SEW_KERNELS(HOST_VECTOR_OP(max_epi8)(a, b), HOST_VECTOR_OP(max_epi16)(a, b), HOST_VECTOR_OP(max_epi32)(a, b))
+
+        case VectorAluOp::kAnd: SEW_KERNELS(AndHost(a, b), AndHost(a, b), AndHost(a, b))
+        case VectorAluOp::kOr:  SEW_KERNELS(OrHost(a, b),  OrHost(a, b),  OrHost(a, b))
+        case VectorAluOp::kXor: SEW_KERNELS(XorHost(a, b), XorHost(a, b), XorHost(a, b))
+
+        case VectorAluOp::kSeq: SEW_KERNELS(HOST_VECTOR_OP(cmpeq_epi8)(a, b), HOST_VECTOR_OP(cmpeq_epi16)(a, b), HOST_VECTOR_OP(cmpeq_epi32)(a, b))
+        case VectorAluOp::kSne: SEW_KERNELS(XorHost(HOST_VECTOR_OP(cmpeq_epi8)(a, b), ones),
+                                            XorHost(HOST_VECTOR_OP(cmpeq_epi16)(a, b), ones),
+                                            XorHost(HOST_VECTOR_OP(cmpeq_epi32)(a, b), ones))
+        case VectorAluOp::kSgt: SEW_KERNELS(HOST_VECTOR_OP(cmpgt_epi8)(a, b), HOST_VECTOR_OP(cmpgt_epi16)(a, b), HOST_VECTOR_OP(cmpgt_epi32)(a, b))
+        case VectorAluOp::kSlt: SEW_KERNELS(HOST_VECTOR_OP(cmpgt_epi8)(b, a), HOST_VECTOR_OP(cmpgt_epi16)(b, a), HOST_VECTOR_OP(cmpgt_epi32)(b, a))
+        case VectorAluOp::kSle: SEW_KERNELS(XorHost(HOST_VECTOR_OP(cmpgt_epi8)(a, b), ones),
+                                            XorHost(HOST_VECTOR_OP(cmpgt_epi16)(a, b), ones),
+                                            XorHost(HOST_VECTOR_OP(cmpgt_epi32)(a, b), ones))
+        // unsigned a <= b if max(a, b) == b
+        case VectorAluOp::kSleu: SEW_KERNELS(HOST_VECTOR_OP(cmpeq_epi8)(HOST_VECTOR_OP(max_epu8)(a, b), b),
+                                             HOST_VECTOR_OP(cmpeq_epi16)(HOST_VECTOR_OP(max_epu16)(a, b), b),
+                                             HOST_VECTOR_OP(cmpeq_epi32)(HOST_VECTOR_OP(max_epu32)(a, b), b))
+        case VectorAluOp::kSgtu: SEW_KERNELS(XorHost(HOST_VECTOR_OP(cmpeq_epi8)(HOST_VECTOR_OP(max_epu8)(a, b), b), ones),
+                                             XorHost(HOST_VECTOR_OP(cmpeq_epi16)(HOST_VECTOR_OP(max_epu16)(a, b), b), ones),
+                                             XorHost(HOST_VECTOR_OP(cmpeq_epi32)(HOST_VECTOR_OP(max_epu32)(a, b), b), ones))
+        case VectorAluOp::kSltu: SEW_KERNELS(XorHost(HOST_VECTOR_OP(cmpeq_epi8)(HOST_VECTOR_OP(max_epu8)(a, b), a), ones),
+                                             XorHost(HOST_VECTOR_OP(cmpeq_epi16)(HOST_VECTOR_OP(max_epu16)(a, b), a), ones),
+                                             XorHost(HOST_VECTOR_OP(cmpeq_epi32)(HOST_VECTOR_OP(max_epu32)(a, b), a), ones))
+
+        case VectorAluOp::kSll:
+        case VectorAluOp::kSrl:
+        case VectorAluOp::kSra: {
+            if (!is_rhs_uniform) {
+#if defined(__AVX2__)
+                // per element amounts have host instructions for 32 bit lanes only
+                if (sew == 4) {
+                    const HostVector shamt_mask = _mm256_set1_epi32(31);
+                    switch (op) {
+                        case VectorAluOp::kSll: RunChunks(dst, lhs, rhs, n_bytes, [=](HostVector a, HostVector b) { return _mm256_sllv_epi32(a, AndHost(b, shamt_mask)); }); return true;
+                        case VectorAluOp::kSrl: RunChunks(dst, lhs, rhs, n_bytes, [=](HostVector a, HostVector b) { return _mm256_srlv_epi32(a, AndHost(b, shamt_mask)); }); return true;
+                        case VectorAluOp::kSra: RunChunks(dst, lhs, rhs, n_bytes, [=](HostVector a, HostVector b) { return _mm256_srav_epi32(a, AndHost(b, shamt_mask)); }); return true;
+                        default: break;
+                    }
+                }
+#endif
+                return false;
+            }
+
+            Register first = 0;
+            std::memcpy(&first, rhs, sew);
+            const int shamt = static_cast<int>(first & (sew * CHAR_BIT - 1));
+            const __m128i count = _mm_cvtsi32_si128(shamt);
+
+            // 8 bit lanes are shifted as 16 bit, bits crossing bytes are cleared,
+            // sign of arithmetic shift is restored as (x ^ m) - m
+            const HostVector low_bytes = HOST_VECTOR_OP(set1_epi8)(static_cast<char>(0xffu << shamt));
+            const HostVector high_bytes = HOST_VECTOR_OP(set1_epi8)(static_cast<char>(0xffu >> shamt));
+            const HostVector sign_bytes = HOST_VECTOR_OP(set1_epi8)(static_cast<char>(0x80u >> shamt));
+
+            switch (op) {
+                case VectorAluOp::kSll: SEW_KERNELS(AndHost(HOST_VECTOR_OP(sll_epi16)(a, count), low_bytes),
+                                                    HOST_VECTOR_OP(sll_epi16)(a, count), HOST_VECTOR_OP(sll_epi32)(a, count))
+                case VectorAluOp::kSrl: SEW_KERNELS(AndHost(HOST_VECTOR_OP(srl_epi16)(a, count), high_bytes),
+                                                    HOST_VECTOR_OP(srl_epi16)(a, count), HOST_VECTOR_OP(srl_epi32)(a, count))
+                case VectorAluOp::kSra: SEW_KERNELS(HOST_VECTOR_OP(sub_epi8)(XorHost(AndHost(HOST_VECTOR_OP(srl_epi16)(a, count), high_bytes), sign_bytes), sign_bytes),
+                                                    HOST_VECTOR_OP(sra_epi16)(a, count), HOST_VECTOR_OP(sra_epi32)(a, count))
+                default: break;
+            }
+        }
+        break;
+
+        default:
+            break;
+    }
+
+    return false;
+}
+
+#undef SEW_KERNELS
+#undef HOST_VECTOR_OP
+
+#else
+
+// no host simd, everything runs through the scalar fallback
+static bool RunHostKernel(const VectorAluOp /*op*/, const size_t /*sew*/, uint8_t* /*dst*/, const uint8_t* /*lhs*/,
+                          const uint8_t* /*rhs*/, const size_t /*n_bytes*/, const bool /*is_rhs_uniform*/) {
+    return false;
+}
+
+#endif
+
+// dst may be the same as lhs or rhs
+static void ApplyKernel(const VectorAluOp op, const size_t sew, uint8_t* dst, const uint8_t* lhs, const uint8_t* rhs,
+                        const size_t n_bytes, const bool is_rhs_uniform) {
+    if (RunHostKernel(op, sew, dst, lhs, rhs, n_bytes, is_rhs_uniform)) {
+        return ;
+    }
+
+    for (size_t offset = 0; offset < n_bytes; offset += sew) {
+        Register lhs_value = 0;
+        Register rhs_value = 0;
+        std::memcpy(&lhs_value, lhs + offset, sew);
+        std::memcpy(&rhs_value, rhs + offset, sew);
+
+        Register result = EvaluateElement(op, sew, lhs_value, rhs_value);
+        std::memcpy(dst + offset, &result, sew);
+    }
+}
+
+static void Splat(uint8_t* dst, const size_t sew, const Register value, const size_t n_bytes) {
+    for (size_t offset = 0; offset < n_bytes; offset += sew) {
+        std::memcpy(dst + offset, &value, sew);
+    }
+}
+
+// unmasked body is a prefix of the group
+static void BlendBody(uint8_t* dst, const uint8_t* src, const size_t vl, const size_t sew, const uint8_t* mask) {
+    if (mask == nullptr) {
+        std::memcpy(dst, src, vl * sew);
+        return ;
+    }
+
+    for (size_t elem_i = 0; elem_i < vl; elem_i++) {
+        if ((mask[elem_i / CHAR_BIT] >> (elem_i % CHAR_BIT)) & 1u) {
+            std::memcpy(dst + elem_i * sew, src + elem_i * sew, sew);
+        }
+    }
+}
+
+static bool GetAluOp(InstructionMnemonic mnemonic, VectorAluOp* op) {
+    assert(op != nullptr);
+
+    switch (mnemonic) {
+        case InstructionMnemonic::kVadd:   *op = VectorAluOp::kAdd;  return true;
+        case InstructionMnemonic::kVsub:   *op = VectorAluOp::kSub;  return true;
+        case InstructionMnemonic::kVrsub:  *op = VectorAluOp::kSub;  return true;
+        case InstructionMnemonic::kVmul:   *op = VectorAluOp::kMul;  return true;
+        case InstructionMnemonic::kVminu:  *op = VectorAluOp::kMinu; return true;
+        case InstructionMnemonic::kVmin:   *op = VectorAluOp::kMin;  return true;
+        case InstructionMnemonic::kVmaxu:  *op = VectorAluOp::kMaxu; return true;
+        case InstructionMnemonic::kVmax:   *op = VectorAluOp::kMax;  return true;
+        case InstructionMnemonic::kVand:   *op = VectorAluOp::kAnd;  return true;
+        case InstructionMnemonic::kVor:    *op = VectorAluOp::kOr;   return true;
+        case InstructionMnemonic::kVxor:   *op = VectorAluOp::kXor;  return true;
+        case InstructionMnemonic::kVsll:   *op = VectorAluOp::kSll;  return true;
+        case InstructionMnemonic::kVsrl:   *op = VectorAluOp::kSrl;  return true;
+        case InstructionMnemonic::kVsra:   *op = VectorAluOp::kSra;  return true;
+        case InstructionMnemonic::kVmseq:  *op = VectorAluOp::kSeq;  return true;
+        case InstructionMnemonic::kVmsne:  *op = VectorAluOp::kSne;  return true;
+        case InstructionMnemonic::kVmsltu: *op = VectorAluOp::kSltu; return true;
+        case InstructionMnemonic::kVmslt:  *op = VectorAluOp::kSlt;  return true;
+        case InstructionMnemonic::kVmsleu: *op = VectorAluOp::kSleu; return true;
+        case InstructionMnemonic::kVmsle:  *op = VectorAluOp::kSle;  return true;
+        case InstructionMnemonic::kVmsgtu: *op = VectorAluOp::kSgtu; return true;
+        case InstructionMnemonic::kVmsgt:  *op = VectorAluOp::kSgt;  return true;
+        default:
+            return false;
+    }
+}
+
+} // namespace sim
@@ -0,0 +1,19 @@
+    .section .text
+    .globl _start
+
+/*
+counts retired instructions from inside the guest, exits with 32: the first
+rdinstret, addi and 10 iterations of 3 instructions
+*/
+_start:
+    rdinstret t0
+    addi  t1, zero, 10
+count_loop:
+    addi  t1, t1, -1
+    nop
+    bnez  t1, count_loop
+    rdinstret t2
+    sub   a0, t2, t0
+
+    li    a7, 93
+    ecall
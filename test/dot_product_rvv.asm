@@ -0,0 +1,36 @@
+    .section .data
+vec_a:  .word 1, 2, 3, 4, 5, 6, 7, 8, 9, 10
+vec_b:  .word 10, 9, 8, 7, 6, 5, 4, 3, 2, 1
+
+    .section .text
+    .globl _start
+
+/*
+strip mined dot product of 10 words with rvv, build with
+compile_asm.sh dot_product_rvv.asm rv32i_zve32x
+*/
+_start:
+    la    a1, vec_a
+    la    a2, vec_b
+    li    a3, 10                    # elements left
+    vsetvli t0, zero, e32, m4
+    vmv.v.i v8, 0                   # partial sums
+dot_loop:
+    vsetvli t0, a3, e32, m4         # t0 = elements of this pass
+    vle32.v v16, (a1)
+    vle32.v v20, (a2)
+    vmul.vv v24, v16, v20
+    vadd.vv v8, v8, v24             # tail of v8 is undisturbed
+    slli  t1, t0, 2
+    add   a1, a1, t1
+    add   a2, a2, t1
+    sub   a3, a3, t0
+    bnez  a3, dot_loop
+
+    vsetvli t0, zero, e32, m4
+    vmv.s.x v4, zero
+    vredsum.vs v4, v8, v4
+    vmv.x.s a0, v4                  # 220
+
+    li    a7, 93                    # exit with dot product as status
+    ecall
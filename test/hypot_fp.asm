@@ -0,0 +1,36 @@
+    .section .data
+sides:  .double 3.0, 4.0
+
+    .section .text
+    .globl _start
+
+/*
+hypotenuse with fused multiply-add and square root, then distance in ulps
+of 1/3 rounded up and down, exits with 51. Build with
+compile_asm.sh hypot_fp.asm rv32id
+*/
+_start:
+    la    a1, sides
+    fld   fa0, 0(a1)
+    fld   fa1, 8(a1)
+    fmul.d  fa2, fa1, fa1
+    fmadd.d fa2, fa0, fa0, fa2      # 3 * 3 + 4 * 4 rounded once
+    fsqrt.d fa2, fa2
+    fcvt.w.d a0, fa2, rtz           # 5
+    slli  t0, a0, 3
+    slli  a0, a0, 1
+    add   a0, a0, t0                # 50
+
+    li    t0, 1
+    li    t1, 3
+    fcvt.s.w fa3, t0
+    fcvt.s.w fa4, t1
+    fdiv.s  fa5, fa3, fa4, rup
+    fdiv.s  fa6, fa3, fa4, rdn
+    fmv.x.w t0, fa5
+    fmv.x.w t1, fa6
+    sub   t0, t0, t1                # 1 ulp
+    add   a0, a0, t0
+
+    li    a7, 93
+    ecall
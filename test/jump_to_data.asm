@@ -0,0 +1,19 @@
+    .section .data
+    .balign 4
+/*
+valid addi encoding, but data segment is not executable: fetch faults and
+run stops without exiting
+*/
+not_code:
+    addi  a0, zero, 1
+
+    .section .text
+    .globl _start
+
+_start:
+    la    t0, not_code
+    jalr  zero, 0(t0)
+
+    li    a0, 0
+    li    a7, 93
+    ecall
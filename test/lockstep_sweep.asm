@@ -0,0 +1,55 @@
+    .section .text
+    .globl _start
+
+/*
+Parameter sweep for lockstep runs: every instance seeds a xorshift generator with
+its mhartid and mixes 200000 values with data dependent branches. Exit status is
+a hash of the result, so instances differ and lanes diverge and reconverge.
+Run as: simulator --lanes=16 --first-hart=100 lockstep_sweep
+*/
+_start:
+    csrr  s0, mhartid
+    addi  s0, s0, 1
+    addi  s1, zero, 0
+    li    s2, 200000
+
+loop:
+    # xorshift32
+    slli  t0, s0, 13
+    xor   s0, s0, t0
+    srli  t0, s0, 17
+    xor   s0, s0, t0
+    slli  t0, s0, 5
+    xor   s0, s0, t0
+
+    andi  t1, s0, 1
+    beqz  t1, even
+    # end around carry add
+    add   s1, s1, s0
+    sltu  t4, s1, s0
+    add   s1, s1, t4
+    j     next
+even:
+    sub   s1, s1, s0
+    srai  t2, s1, 3
+    xor   s1, s1, t2
+    slt   t4, s1, zero
+    sll   t5, s1, t4
+    or    s1, s1, t5
+next:
+    # each instance has its own stack
+    sw    s1, -16(sp)
+    lbu   t3, -15(sp)
+    add   s1, s1, t3
+    addi  s2, s2, -1
+    bnez  s2, loop
+
+    rdinstret t6
+    add   s1, s1, t6
+    srli  t0, s1, 8
+    xor   s1, s1, t0
+    srli  t0, s1, 16
+    xor   a0, s1, t0
+    andi  a0, a0, 255
+    li    a7, 93
+    ecall
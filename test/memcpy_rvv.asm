@@ -0,0 +1,44 @@
+    .section .data
+src:    .byte  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19
+        .byte 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37
+dst:    .space 37
+
+    .section .text
+    .globl _start
+
+/*
+strip mined memcpy of 37 bytes with rvv, checked byte by byte afterwards,
+exits with 0 if copy matches, build with
+compile_asm.sh memcpy_rvv.asm rv32i_zve32x
+*/
+_start:
+    la    a1, src
+    la    a2, dst
+    li    a3, 37                    # bytes left
+copy_loop:
+    vsetvli t0, a3, e8, m8          # t0 = bytes of this pass
+    vle8.v v8, (a1)
+    vse8.v v8, (a2)
+    add   a1, a1, t0
+    add   a2, a2, t0
+    sub   a3, a3, t0
+    bnez  a3, copy_loop
+
+    la    a1, src
+    la    a2, dst
+    li    a3, 37
+    li    a0, 0
+check_loop:
+    lbu   t1, 0(a1)
+    lbu   t2, 0(a2)
+    bne   t1, t2, mismatch
+    addi  a1, a1, 1
+    addi  a2, a2, 1
+    addi  a3, a3, -1
+    bnez  a3, check_loop
+    j     done
+mismatch:
+    li    a0, 1
+done:
+    li    a7, 93                    # exit with 0 on match
+    ecall
@@ -0,0 +1,92 @@
+    .section .text
+    .globl _start
+
+/*
+rv64i base instructions: sign extension of word results, doubleword memory
+accesses and 6 bit shift amounts. Every passed check adds one to a0, exits with 8.
+Build for rv64: as -mabi=lp64 -march=rv64i, ld -melf64lriscv
+*/
+_start:
+    addi  a0, zero, 0
+
+    # lui sign extends its 32 bit result
+    lui   t0, 0x80000
+    srli  t1, t0, 32
+    addi  t2, zero, -1
+    srli  t2, t2, 32
+    bne   t1, t2, fail_lui
+    addi  a0, a0, 1
+fail_lui:
+
+    # 64 bit shifts keep high bits
+    addi  t0, zero, 1
+    slli  t0, t0, 40
+    srli  t1, t0, 40
+    addi  t2, zero, 1
+    bne   t1, t2, fail_shift
+    addi  a0, a0, 1
+fail_shift:
+
+    # addiw wraps and sign extends
+    lui   t1, 0x80000
+    addiw t1, t1, -1
+    addiw t1, t1, 1
+    bge   t1, zero, fail_addiw
+    addi  a0, a0, 1
+fail_addiw:
+
+    # doubleword store and load
+    addi  sp, sp, -16
+    sd    t0, 0(sp)
+    ld    t1, 0(sp)
+    bne   t0, t1, fail_ld
+    lw    t2, 4(sp)
+    addi  t3, zero, 256
+    bne   t2, t3, fail_ld
+    addi  a0, a0, 1
+fail_ld:
+
+    # lw sign extends, lwu zero extends
+    addi  t0, zero, -1
+    sw    t0, 8(sp)
+    lw    t1, 8(sp)
+    bne   t0, t1, fail_lwu
+    lwu   t2, 8(sp)
+    srli  t3, t0, 32
+    bne   t2, t3, fail_lwu
+    addi  a0, a0, 1
+fail_lwu:
+
+    # sraiw shifts the low word only, srai the whole register
+    lui   t0, 0x80000
+    sw    t0, 8(sp)
+    lwu   t0, 8(sp)
+    sraiw t1, t0, 4
+    srai  t2, t0, 4
+    lui   t3, 0xf8000
+    bne   t1, t3, fail_sraiw
+    lui   t3, 0x8000
+    bne   t2, t3, fail_sraiw
+    addi  a0, a0, 1
+fail_sraiw:
+
+    # word shifts use 5 bits of rs2
+    addi  t0, zero, 1
+    addi  t1, zero, 33
+    sllw  t2, t0, t1
+    addi  t3, zero, 2
+    bne   t2, t3, fail_sllw
+    addi  a0, a0, 1
+fail_sllw:
+
+    # srai takes 6 bit shift amount
+    addi  t0, zero, -8
+    srai  t1, t0, 63
+    addi  t2, zero, -1
+    bne   t1, t2, fail_srai
+    addi  a0, a0, 1
+fail_srai:
+
+    addi  sp, sp, 16
+    addi  a7, zero, 93
+    ecall